@@ -26,6 +26,18 @@ public:
     {
         m_generatedImage.resize(xDim * yDim);
         m_evaluator.m_evalIterations = 3;
+
+        // Input values of all the pixels. They are the same for every genome.
+        m_inputValues.resize(xDim * yDim * 2);
+        for (unsigned int x = 0; x < m_xDim; x++)
+        {
+            for (unsigned int y = 0; y < m_yDim; y++)
+            {
+                const int index = coords2index(x, y);
+                m_inputValues[index * 2] = (float)(x) / (float)m_xDim;
+                m_inputValues[index * 2 + 1] = (float)(y) / (float)m_yDim;
+            }
+        }
     }
 
     inline int coords2index(unsigned int x, unsigned int y)
@@ -73,33 +85,33 @@ public:
 
     void generateImage(GenomeBase* genome)
     {
-        std::vector<float> inputValues;
-        inputValues.resize(2);
+        // Evaluate all the pixels at once.
+        const int numOutputs = (int)genome->getOutputNodes().size();
+        m_outputValues.resize(m_xDim * m_yDim * numOutputs);
+        evaluateGenomeBatch(genome, m_inputValues.data(), m_xDim * m_yDim, m_outputValues.data(), 1.0f);
+
         for (unsigned int x = 0; x < m_xDim; x++)
         {
             for (unsigned int y = 0; y < m_yDim; y++)
             {
-                inputValues[0] = (float)(x) / (float)m_xDim;
-                inputValues[1] = (float)(y) / (float)m_yDim;
-                evaluateGenome(genome, inputValues, 1.0f);
-                unsigned char r = floatToUCharColor(genome->getNodeValue(genome->getOutputNodes()[0]));
+                const int index = coords2index(x, y);
+                const float* outputs = &m_outputValues[index * numOutputs];
+                unsigned char r = floatToUCharColor(outputs[0]);
 
                 if (s_grayScale)
                 {
-                    m_generatedImage[coords2index(x, y)].red = r;
-                    m_generatedImage[coords2index(x, y)].green = r;
-                    m_generatedImage[coords2index(x, y)].blue = r;
+                    m_generatedImage[index].red = r;
+                    m_generatedImage[index].green = r;
+                    m_generatedImage[index].blue = r;
                 }
                 else
                 {
-                    unsigned char g = floatToUCharColor(genome->getNodeValue(genome->getOutputNodes()[1]));
-                    unsigned char b = floatToUCharColor(genome->getNodeValue(genome->getOutputNodes()[2]));
-                    m_generatedImage[coords2index(x, y)].red = r;
-                    m_generatedImage[coords2index(x, y)].green = g;
-                    m_generatedImage[coords2index(x, y)].blue = b;
+                    unsigned char g = floatToUCharColor(outputs[1]);
+                    unsigned char b = floatToUCharColor(outputs[2]);
+                    m_generatedImage[index].red = r;
+                    m_generatedImage[index].green = g;
+                    m_generatedImage[index].blue = b;
                 }
-
-
             }
         }
     }
@@ -172,6 +184,8 @@ protected:
     const unsigned int m_yDim;
     const Image& m_referenceImage;
     Image m_generatedImage;
+    std::vector<float> m_inputValues;
+    std::vector<float> m_outputValues;
 };
 
 int main()
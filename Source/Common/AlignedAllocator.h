@@ -0,0 +1,45 @@
+/*
+* AlignedAllocator.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+// Allocator for std containers which aligns memory to ALIGNMENT bytes.
+template <typename T, std::size_t ALIGNMENT>
+class AlignedAllocator
+{
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, ALIGNMENT>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) {}
+
+    inline T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(ALIGNMENT)));
+    }
+
+    inline void deallocate(T* p, std::size_t)
+    {
+        ::operator delete(p, std::align_val_t(ALIGNMENT));
+    }
+
+    template <typename U>
+    inline bool operator==(const AlignedAllocator<U, ALIGNMENT>&) const { return true; }
+
+    template <typename U>
+    inline bool operator!=(const AlignedAllocator<U, ALIGNMENT>&) const { return false; }
+};
@@ -0,0 +1,107 @@
+/*
+* CounterBasedRandom.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <Common/PseudoRandom.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+// Counter based random generator.
+// The n-th random number of a stream is a hash of the key of the stream and n, so there is no hidden state other than the counter.
+// Independent streams can be created cheaply by deriving keys from values such as (generation, genome index, purpose) by makeKey().
+// This makes results reproducible regardless of how work is distributed to threads as long as each stream is used by a single thread.
+// The class is final so calling functions through CounterBasedRandom (not RandomGenerator) doesn't need virtual calls and can be inlined.
+class CounterBasedRandom final : public RandomGenerator
+{
+public:
+    // Constructor
+    CounterBasedRandom(uint64_t key, uint64_t counter = 0) : m_key(key), m_counter(counter) {}
+
+    // Derive a key of a stream from a parent key and values identifying the stream.
+    static inline auto makeKey(uint64_t key)->uint64_t { return key; }
+    template <typename... Values>
+    static inline auto makeKey(uint64_t key, uint64_t value, Values... values)->uint64_t;
+
+    // Get a random 64 bits integer and advance the counter.
+    inline auto randomUint64()->uint64_t { return mix(m_key ^ mix(m_counter++ + s_gamma)); }
+
+    // Get a random float between [0, 1] (both bounds are inclusive).
+    inline virtual float randomReal01() override;
+
+    // Get a random float between [min, max) (upper bound is exclusive).
+    inline virtual float randomReal(float min, float max) override;
+
+    // Get a random integer between [min, max] (both bounds are inclusive).
+    inline virtual int randomInteger(int min, int max) override;
+
+    // Get a random boolean.
+    inline virtual bool randomBoolean() override { return (randomUint64() >> 63) != 0; }
+
+    // Return the key of this stream.
+    inline auto getKey() const->uint64_t { return m_key; }
+
+    // Return the number of random numbers generated so far.
+    inline auto getCounter() const->uint64_t { return m_counter; }
+
+private:
+    // SplitMix64 finalizer. This is a bijection so different counters never produce the same number in a stream.
+    static inline auto mix(uint64_t z)->uint64_t
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    static constexpr uint64_t s_gamma = 0x9e3779b97f4a7c15ull;
+
+    uint64_t m_key;       // Key of this stream.
+    uint64_t m_counter;   // Index of the next random number in this stream.
+};
+
+template <typename... Values>
+inline auto CounterBasedRandom::makeKey(uint64_t key, uint64_t value, Values... values)->uint64_t
+{
+    return makeKey(mix(key ^ mix(value + s_gamma)), (uint64_t)values...);
+}
+
+// Return key and clear hasKeyInOut if the key is set. Otherwise draw a new key from random.
+// Generators and modifiers use this to take the key of random streams given for their next run.
+inline auto consumeRandomStreamKey(uint64_t key, bool& hasKeyInOut, RandomGenerator& random)->uint64_t
+{
+    if (hasKeyInOut)
+    {
+        hasKeyInOut = false;
+        return key;
+    }
+
+    return ((uint64_t)random.randomInteger(0, std::numeric_limits<int>::max()) << 32) | (uint64_t)random.randomInteger(0, std::numeric_limits<int>::max());
+}
+
+inline float CounterBasedRandom::randomReal01()
+{
+    // Use upper 24 bits which fit in mantissa of float.
+    const float v = (float)(randomUint64() >> 40) * (1.f / 16777215.f);
+    return std::min(v, 1.f);
+}
+
+inline float CounterBasedRandom::randomReal(float min, float max)
+{
+    const float v = min + (max - min) * ((float)(randomUint64() >> 40) * (1.f / 16777216.f));
+    // Rounding error can make v equal to max.
+    return v < max ? v : std::nextafter(max, min);
+}
+
+inline int CounterBasedRandom::randomInteger(int min, int max)
+{
+    assert(min <= max);
+    const uint64_t range = (uint64_t)((int64_t)max - (int64_t)min) + 1;
+    return (int)((int64_t)min + (int64_t)(((randomUint64() >> 32) * range) >> 32));
+}
@@ -0,0 +1,148 @@
+/*
+* LinearArena.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <Common/Common.h>
+#include <Common/LinearArena.h>
+
+#include <cstdint>
+#include <algorithm>
+
+namespace
+{
+    // The current arena of each thread.
+    thread_local LinearArena::ArenaPtr s_currentArena;
+}
+
+//
+// LinearArena::Scope
+//
+
+LinearArena::Scope::Scope(const ArenaPtr& arena)
+    : m_prevArena(s_currentArena)
+{
+    s_currentArena = arena;
+}
+
+LinearArena::Scope::~Scope()
+{
+    s_currentArena = m_prevArena;
+}
+
+//
+// LinearArena::Block
+//
+
+LinearArena::Block::Block(size_t size)
+    : m_memory(new char[size])
+    , m_size(size)
+    , m_offset(0)
+{
+}
+
+//
+// LinearArena
+//
+
+LinearArena::LinearArena(size_t blockSize)
+    : m_numAllocations(0)
+    , m_blockSize(blockSize)
+{
+    assert(m_blockSize > 0);
+    m_blocks.push_back(std::make_unique<Block>(m_blockSize));
+    m_currentBlock = m_blocks[0].get();
+}
+
+LinearArena::~LinearArena()
+{
+    assert(m_numAllocations == 0);
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment)
+{
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    // Reserve extra bytes so that we can align the address regardless of the offset.
+    const size_t paddedSize = size + alignment - 1;
+
+    while (true)
+    {
+        Block* block = m_currentBlock.load();
+        const size_t offset = block->m_offset.fetch_add(paddedSize);
+        if (offset + paddedSize <= block->m_size)
+        {
+            const uintptr_t address = reinterpret_cast<uintptr_t>(block->m_memory.get() + offset);
+            const uintptr_t alignedAddress = (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+            m_numAllocations++;
+            return reinterpret_cast<void*>(alignedAddress);
+        }
+
+        // The block is full. Move to the next block and try again.
+        advanceBlock(block, paddedSize);
+    }
+}
+
+void LinearArena::deallocate(void* ptr, size_t /*size*/)
+{
+    assert(ptr);
+    assert(m_numAllocations > 0);
+    m_numAllocations--;
+}
+
+bool LinearArena::reset()
+{
+    if (m_numAllocations > 0)
+    {
+        return false;
+    }
+
+    for (std::unique_ptr<Block>& block : m_blocks)
+    {
+        block->m_offset = 0;
+    }
+
+    m_currentBlockIndex = 0;
+    m_currentBlock = m_blocks[0].get();
+
+    return true;
+}
+
+void LinearArena::advanceBlock(Block* fullBlock, size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_blockLock);
+
+    if (m_currentBlock.load() != fullBlock)
+    {
+        // Other thread has already advanced the block.
+        return;
+    }
+
+    // Find a recycled block which is large enough.
+    int index = m_currentBlockIndex + 1;
+    while (index < (int)m_blocks.size() && m_blocks[index]->m_size < size)
+    {
+        index++;
+    }
+
+    if (index == (int)m_blocks.size())
+    {
+        // Allocate a new block.
+        m_blocks.push_back(std::make_unique<Block>(std::max(m_blockSize, size)));
+    }
+    else if (index != m_currentBlockIndex + 1)
+    {
+        // Move the found block right after the current block so that skipped blocks can be used later.
+        std::swap(m_blocks[index], m_blocks[m_currentBlockIndex + 1]);
+        index = m_currentBlockIndex + 1;
+    }
+
+    m_currentBlockIndex = index;
+    m_currentBlock = m_blocks[index].get();
+}
+
+auto LinearArena::getCurrentArena()->const ArenaPtr&
+{
+    return s_currentArena;
+}
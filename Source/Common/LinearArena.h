@@ -0,0 +1,132 @@
+/*
+* LinearArena.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <cassert>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+// Memory arena which allocates memory linearly from large blocks.
+// Allocation is a single atomic increment in most cases and can be done from multiple threads at the same time.
+// Deallocation doesn't free memory. All the memory is recycled at once by reset() when there is no live allocation.
+// Objects allocated by LinearArena::Allocator hold a reference to the arena so the arena outlives all of its objects.
+class LinearArena
+{
+public:
+    // Type declarations.
+    using ArenaPtr = std::shared_ptr<LinearArena>;
+
+    // STL compatible allocator allocating from a LinearArena.
+    template <typename T>
+    class Allocator
+    {
+    public:
+        using value_type = T;
+
+        Allocator(const ArenaPtr& arena) : m_arena(arena) { assert(m_arena); }
+        template <typename U>
+        Allocator(const Allocator<U>& other) : m_arena(other.m_arena) {}
+
+        inline T* allocate(std::size_t n) { return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T))); }
+        inline void deallocate(T* ptr, std::size_t n) { m_arena->deallocate(ptr, n * sizeof(T)); }
+
+        template <typename U>
+        inline bool operator==(const Allocator<U>& other) const { return m_arena == other.m_arena; }
+        template <typename U>
+        inline bool operator!=(const Allocator<U>& other) const { return m_arena != other.m_arena; }
+
+    private:
+        ArenaPtr m_arena;
+
+        template <typename U>
+        friend class Allocator;
+    };
+
+    // Helper class to set the current arena of this thread during the lifetime of the scope.
+    class Scope
+    {
+    public:
+        Scope(const ArenaPtr& arena);
+        ~Scope();
+
+    private:
+        Scope(const Scope&) = delete;
+        void operator=(const Scope&) = delete;
+
+        ArenaPtr m_prevArena;
+    };
+
+    // Constructor
+    LinearArena(size_t blockSize = s_defaultBlockSize);
+
+    // Destructor
+    ~LinearArena();
+
+    // Allocate memory. This is thread safe.
+    void* allocate(size_t size, size_t alignment);
+
+    // Deallocate memory. Memory is not freed until reset() is called. This is thread safe.
+    void deallocate(void* ptr, size_t size);
+
+    // Recycle all the memory if there is no live allocation and return true. Otherwise return false and do nothing.
+    // This must not be called while other threads are allocating from this arena.
+    bool reset();
+
+    // Return the number of live allocations.
+    inline int getNumAllocations() const { return m_numAllocations.load(); }
+
+    // Return the number of memory blocks owned by this arena.
+    inline int getNumBlocks() const { return (int)m_blocks.size(); }
+
+    // Return the current arena of this thread. Return nullptr if there is no current arena.
+    static auto getCurrentArena()->const ArenaPtr&;
+
+    // Create an object managed by shared_ptr.
+    // The object is allocated from the current arena of this thread if there is any. Otherwise it's allocated by std::make_shared.
+    template <typename T, typename... Args>
+    static auto makeShared(Args&&... args)->std::shared_ptr<T>;
+
+    static constexpr size_t s_defaultBlockSize = 1 << 20;
+
+private:
+    LinearArena(const LinearArena&) = delete;
+    void operator=(const LinearArena&) = delete;
+
+    // Block of memory.
+    struct Block
+    {
+        Block(size_t size);
+
+        std::unique_ptr<char[]> m_memory;   // The memory.
+        size_t m_size;                      // Size of the memory.
+        std::atomic<size_t> m_offset;       // Offset to the first unused byte. Can exceed m_size when the block is full.
+    };
+
+    // Switch the current block to a block which can hold size bytes. Called when fullBlock is full.
+    void advanceBlock(Block* fullBlock, size_t size);
+
+    std::vector<std::unique_ptr<Block>> m_blocks;   // All the blocks owned by this arena.
+    std::atomic<Block*> m_currentBlock;             // Block used for allocation.
+    int m_currentBlockIndex = 0;                    // Index of m_currentBlock in m_blocks.
+    std::mutex m_blockLock;                         // Lock to add or advance blocks.
+    std::atomic<int> m_numAllocations;              // The number of live allocations.
+    const size_t m_blockSize;                       // Default size of a block.
+};
+
+template <typename T, typename... Args>
+auto LinearArena::makeShared(Args&&... args)->std::shared_ptr<T>
+{
+    const ArenaPtr& arena = getCurrentArena();
+    if (arena)
+    {
+        return std::allocate_shared<T>(Allocator<T>(arena), std::forward<Args>(args)...);
+    }
+
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
@@ -79,6 +79,10 @@ public:
     // Return length^2 of this vector using the first N components.
     template<int N> constexpr SimdFloat lengthSq() const { return dot<N>(*this); }
 
+    // Access to the underlying data
+    inline const QuadrupleFloat& getQuad() const { return m_quad; }
+    inline QuadrupleFloat& accessQuad() { return m_quad; }
+
 private:
 
     ALIGN16(QuadrupleFloat) m_quad; // The data.
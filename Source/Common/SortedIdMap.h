@@ -0,0 +1,183 @@
+/*
+* SortedIdMap.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <cassert>
+#include <vector>
+#include <algorithm>
+
+// Associative container which stores elements in a single array sorted by their ids.
+// It provides a subset of std::unordered_map interface.
+// Lookup is binary search and insertion/erasure costs O(N) except appending an element with the largest id which is O(1).
+// Copying the container is just copying a single array, which is much cheaper than copying hash maps.
+// Note that insertion and erasure invalidate any references and iterators to elements.
+template <typename Key, typename Value>
+class SortedIdMap
+{
+public:
+    // Type definition
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<Key, Value>;
+    using Container = std::vector<value_type>;
+    using iterator = typename Container::iterator;
+    using const_iterator = typename Container::const_iterator;
+    using size_type = typename Container::size_type;
+
+    // Constructors
+    SortedIdMap() = default;
+    SortedIdMap(const SortedIdMap& other) = default;
+    SortedIdMap(SortedIdMap&& other) = default;
+    SortedIdMap& operator=(const SortedIdMap& other) = default;
+    SortedIdMap& operator=(SortedIdMap&& other) = default;
+
+    //
+    // Iterators
+    //
+
+    inline auto begin()->iterator { return m_elements.begin(); }
+    inline auto end()->iterator { return m_elements.end(); }
+    inline auto begin() const->const_iterator { return m_elements.begin(); }
+    inline auto end() const->const_iterator { return m_elements.end(); }
+    inline auto cbegin() const->const_iterator { return m_elements.cbegin(); }
+    inline auto cend() const->const_iterator { return m_elements.cend(); }
+
+    //
+    // Capacity
+    //
+
+    inline auto size() const->size_type { return m_elements.size(); }
+    inline bool empty() const { return m_elements.empty(); }
+    inline void reserve(size_type size) { m_elements.reserve(size); }
+    inline void clear() { m_elements.clear(); }
+
+    //
+    // Lookup
+    //
+
+    // Return iterator to the element of the key. Return end() if the key doesn't exist.
+    inline auto find(const Key& key)->iterator;
+    inline auto find(const Key& key) const->const_iterator;
+
+    // Return 1 if the key exists. Otherwise return 0.
+    inline auto count(const Key& key) const->size_type { return find(key) != end() ? 1 : 0; }
+
+    // Return the value of the key. The key has to exist.
+    inline auto at(const Key& key)->Value&;
+    inline auto at(const Key& key) const->const Value&;
+
+    // Return the value of the key. A default constructed value is inserted if the key doesn't exist.
+    inline auto operator[](const Key& key)->Value&;
+
+    //
+    // Modifiers
+    //
+
+    // Insert an element. Nothing happens if the key already exists.
+    // Return a pair of iterator to the element of the key and true if insertion took place.
+    auto insert(const value_type& element)->std::pair<iterator, bool>;
+
+    // Erase the element of the key. Return the number of erased elements.
+    auto erase(const Key& key)->size_type;
+
+private:
+    // Return iterator to the first element whose key is not less than the given key.
+    inline auto lowerBound(const Key& key)->iterator;
+    inline auto lowerBound(const Key& key) const->const_iterator;
+
+    Container m_elements;   // Elements sorted by their keys.
+};
+
+template <typename Key, typename Value>
+inline auto SortedIdMap<Key, Value>::lowerBound(const Key& key)->iterator
+{
+    // Fast path for appending since ids are usually assigned in increasing order.
+    if (m_elements.empty() || m_elements.back().first < key)
+    {
+        return m_elements.end();
+    }
+
+    return std::lower_bound(m_elements.begin(), m_elements.end(), key, [](const value_type& elem, const Key& k) { return elem.first < k; });
+}
+
+template <typename Key, typename Value>
+inline auto SortedIdMap<Key, Value>::lowerBound(const Key& key) const->const_iterator
+{
+    if (m_elements.empty() || m_elements.back().first < key)
+    {
+        return m_elements.end();
+    }
+
+    return std::lower_bound(m_elements.begin(), m_elements.end(), key, [](const value_type& elem, const Key& k) { return elem.first < k; });
+}
+
+template <typename Key, typename Value>
+inline auto SortedIdMap<Key, Value>::find(const Key& key)->iterator
+{
+    iterator itr = lowerBound(key);
+    return (itr != m_elements.end() && itr->first == key) ? itr : m_elements.end();
+}
+
+template <typename Key, typename Value>
+inline auto SortedIdMap<Key, Value>::find(const Key& key) const->const_iterator
+{
+    const_iterator itr = lowerBound(key);
+    return (itr != m_elements.end() && itr->first == key) ? itr : m_elements.end();
+}
+
+template <typename Key, typename Value>
+inline auto SortedIdMap<Key, Value>::at(const Key& key)->Value&
+{
+    iterator itr = find(key);
+    assert(itr != m_elements.end());
+    return itr->second;
+}
+
+template <typename Key, typename Value>
+inline auto SortedIdMap<Key, Value>::at(const Key& key) const->const Value&
+{
+    const_iterator itr = find(key);
+    assert(itr != m_elements.end());
+    return itr->second;
+}
+
+template <typename Key, typename Value>
+inline auto SortedIdMap<Key, Value>::operator[](const Key& key)->Value&
+{
+    iterator itr = lowerBound(key);
+    if (itr == m_elements.end() || !(itr->first == key))
+    {
+        itr = m_elements.insert(itr, value_type(key, Value()));
+    }
+
+    return itr->second;
+}
+
+template <typename Key, typename Value>
+auto SortedIdMap<Key, Value>::insert(const value_type& element)->std::pair<iterator, bool>
+{
+    iterator itr = lowerBound(element.first);
+    if (itr != m_elements.end() && itr->first == element.first)
+    {
+        return { itr, false };
+    }
+
+    return { m_elements.insert(itr, element), true };
+}
+
+template <typename Key, typename Value>
+auto SortedIdMap<Key, Value>::erase(const Key& key)->size_type
+{
+    iterator itr = find(key);
+    if (itr == m_elements.end())
+    {
+        return 0;
+    }
+
+    m_elements.erase(itr);
+    return 1;
+}
@@ -16,8 +16,19 @@ CppnCellCreature::CppnCellCreature(const Cinfo& cinfo)
     , m_numMaxCells(cinfo.m_numMaxCells)
     , m_stiffness(cinfo.m_connectionStiffness)
 {
+    reset(cinfo.m_genome, cinfo.m_network);
+}
+
+void CppnCellCreature::reset(GenomeBase* genome, CompiledNetworkPtr network)
+{
+    m_genome = genome;
+    m_intervalCounter = 0;
+
     // Set 0 as generation index to initial cells.
-    m_generationCounts.resize(m_simulation->getVertexPositions().size(), 0);
+    m_generationCounts.assign(m_simulation->getVertexPositions().size(), 0);
+
+    // Compile the genome since it's evaluated for every cell at every division.
+    m_network = network ? network : m_genome->compile();
 }
 
 void CppnCellCreature::step(float deltaTime)
@@ -292,23 +303,26 @@ void CppnCellCreature::divide()
 
 bool CppnCellCreature::evaluateDivision(const std::vector<float>& inputNodeValues, Vector4& directionOut)
 {
-    // Set input values
-    m_genome->clearNodeValues();
-    m_genome->setInputNodeValues(inputNodeValues, 1.0f);
+    assert(m_network->getNumInputNodes() == (int)inputNodeValues.size());
+    assert(m_network->getNumOutputNodes() == (int)OutputNode::NUM_OUTPUT_NODES);
+
+    // Set bias value
+    m_network->clearNodeValues();
+    m_network->setNodeValue(m_genome->getBiasNode(), 1.0f);
 
     // Evaluate the genome
-    m_genome->evaluate();
+    float outputNodeValues[(int)OutputNode::NUM_OUTPUT_NODES];
+    m_network->evaluate(inputNodeValues.data(), outputNodeValues);
 
-    const GenomeBase::Network::NodeIds& outputNodes = m_genome->getOutputNodes();
-    if (m_genome->getNodeValue(outputNodes[(int)OutputNode::DIVIDE]) < 0.5f)
+    if (outputNodeValues[(int)OutputNode::DIVIDE] < 0.5f)
     {
         return false;
     }
 
     // Set direction of division
-    directionOut.setComponent<0>(SimdFloat(m_genome->getNodeValue(outputNodes[(int)OutputNode::DIRECTION_X])));
-    directionOut.setComponent<1>(SimdFloat(m_genome->getNodeValue(outputNodes[(int)OutputNode::DIRECTION_Y])));
-    directionOut.setComponent<2>(SimdFloat(m_genome->getNodeValue(outputNodes[(int)OutputNode::DIRECTION_Z])));
+    directionOut.setComponent<0>(SimdFloat(outputNodeValues[(int)OutputNode::DIRECTION_X]));
+    directionOut.setComponent<1>(SimdFloat(outputNodeValues[(int)OutputNode::DIRECTION_Y]));
+    directionOut.setComponent<2>(SimdFloat(outputNodeValues[(int)OutputNode::DIRECTION_Z]));
 
     // We cannot divide the cell there is no valid direction.
     if (directionOut.lengthSq<3>() == SimdFloat_0)
@@ -8,6 +8,7 @@
 
 #include <Physics/Systems/PointBasedSystem.h>
 #include <EvoAlgo/GeneticAlgorithms/Base/GenomeBase.h>
+#include <EvoAlgo/NeuralNetwork/CompiledNeuralNetwork.h>
 
 // A class which represents multi-cellular organism.
 // Cells are divided by CPPN genome.
@@ -18,6 +19,7 @@ public:
     // Type definition
     using PBSPtr = std::shared_ptr<PointBasedSystem>;
     using GenomePtr = std::shared_ptr<GenomeBase>;
+    using CompiledNetworkPtr = std::shared_ptr<CompiledNeuralNetwork>;
 
     // Type of input nodes
     enum class InputNode : uint16_t
@@ -78,9 +80,13 @@ public:
         // The point based system to run particle simulation.
         PBSPtr m_simulation;
 
-        // The CPPN genome.
+        // The CPPN genome. It's compiled at construction so any further changes to the genome are not reflected.
         GenomeBase* m_genome;
 
+        // Compiled network of m_genome. When this is null, the genome is compiled at construction.
+        // Pass a network compiled beforehand when creatures of the same genome are constructed on multiple threads.
+        CompiledNetworkPtr m_network;
+
         // The maximum number of cells.
         int m_numMaxCells = 500;
 
@@ -98,6 +104,10 @@ public:
     // Step function. We perform cell divisions here if necessary.
     virtual void step(float deltaTime) override;
 
+    // Start over with a new genome. The point based system has to be reset to the initial cells beforehand.
+    // network is the compiled network of the genome. When it's null, the genome is compiled here, which modifies the genome.
+    void reset(GenomeBase* genome, CompiledNetworkPtr network = nullptr);
+
 private:
     // Evaluate if a cell should divide or not.
     // Return true when the cell divides. Direction in which the new cell should be created is stored in 'direction'.
@@ -110,6 +120,7 @@ private:
     PBSPtr m_simulation;                    // Pointer to point based simulation.
 
     GenomeBase* m_genome;                   // The genomes.
+    CompiledNetworkPtr m_network;           // Compiled network of the genome.
     std::vector<int> m_generationCounts;    // Generation index of each cell.
 
     int m_divisionInterval;                 // Step interval between cell divisions.
@@ -0,0 +1,103 @@
+/*
+* PhysicsFitnessCalculator.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <EvoAlgo/EvoAlgo.h>
+#include <EvoAlgo/CppnCellDivision/PhysicsFitnessCalculator.h>
+
+#include <omp.h>
+
+PhysicsFitnessCalculator::PhysicsFitnessCalculator(const Cinfo& cinfo)
+    : m_cinfo(cinfo)
+{
+    assert(m_cinfo.m_numThreads > 0);
+    assert(m_cinfo.m_numSteps >= 0 && m_cinfo.m_deltaTime > 0.f);
+    assert(m_cinfo.m_fitnessFunc);
+
+    // Allocate all the systems upfront.
+    m_slots.resize(m_cinfo.m_numThreads);
+    for (Slot& slot : m_slots)
+    {
+        slot.m_system = std::make_shared<PointBasedSystem>();
+        slot.m_system->init(m_cinfo.m_systemCinfo);
+    }
+}
+
+float PhysicsFitnessCalculator::calcFitness(GenomeBase* genome)
+{
+    return simulate(m_slots[0], genome, nullptr);
+}
+
+void PhysicsFitnessCalculator::calcFitnesses(GenomeBase* const* genomes, int numGenomes, float* fitnessesOut)
+{
+    const int numThreads = (int)m_slots.size();
+
+    // Compiling a genome bakes its network, which modifies the genome. Compile them serially so that threads don't touch genomes.
+    // Each simulation gets its own compiled network even if the same genome appears multiple times.
+    m_networks.resize(numGenomes);
+    for (int i = 0; i < numGenomes; i++)
+    {
+        assert(genomes[i]);
+        m_networks[i] = genomes[i]->compile();
+    }
+
+    #pragma omp parallel num_threads(numThreads) if(numThreads > 1)
+    {
+        // Each thread uses its own slot.
+        const int threadId = omp_get_thread_num();
+        assert(threadId < numThreads);
+        Slot& slot = m_slots[threadId];
+
+        // Creatures grow differently so the cost of simulation varies a lot.
+        #pragma omp for schedule(dynamic, 1)
+        for (int i = 0; i < numGenomes; i++)
+        {
+            fitnessesOut[i] = simulate(slot, genomes[i], m_networks[i]);
+        }
+    }
+
+    // Don't keep networks alive until the next call.
+    m_networks.clear();
+}
+
+auto PhysicsFitnessCalculator::clone() const->FitnessCalcPtr
+{
+    Cinfo cinfo = m_cinfo;
+    cinfo.m_numThreads = 1;
+    return std::make_shared<PhysicsFitnessCalculator>(cinfo);
+}
+
+float PhysicsFitnessCalculator::simulate(Slot& slot, GenomeBase* genome, const CppnCellCreature::CompiledNetworkPtr& network)
+{
+    assert(genome);
+
+    if (slot.m_creature)
+    {
+        // Start over from the initial cells.
+        slot.m_system->reset(m_cinfo.m_systemCinfo);
+        slot.m_creature->reset(genome, network);
+    }
+    else
+    {
+        // The system is freshly initialized.
+        CppnCellCreature::Cinfo creatureCinfo;
+        creatureCinfo.m_simulation = slot.m_system;
+        creatureCinfo.m_genome = genome;
+        creatureCinfo.m_network = network;
+        creatureCinfo.m_numMaxCells = m_cinfo.m_numMaxCells;
+        creatureCinfo.m_divisionInterval = m_cinfo.m_divisionInterval;
+        creatureCinfo.m_connectionStiffness = m_cinfo.m_connectionStiffness;
+        slot.m_creature = std::make_unique<CppnCellCreature>(creatureCinfo);
+    }
+
+    // The creature divides cells before the system is stepped.
+    for (int i = 0; i < m_cinfo.m_numSteps; i++)
+    {
+        slot.m_creature->step(m_cinfo.m_deltaTime);
+        slot.m_system->step(m_cinfo.m_deltaTime);
+    }
+
+    return m_cinfo.m_fitnessFunc(*slot.m_system);
+}
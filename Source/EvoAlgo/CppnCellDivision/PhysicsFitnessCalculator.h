@@ -0,0 +1,79 @@
+/*
+* PhysicsFitnessCalculator.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <EvoAlgo/GeneticAlgorithms/Base/GenerationBase.h>
+#include <EvoAlgo/CppnCellDivision/CppnCellCreature.h>
+
+#include <functional>
+
+// Fitness calculator which grows a CppnCellCreature from a genome and simulates it headlessly for a fixed number of steps.
+// Point based systems and creatures are pre-allocated in a pool and reset for every genome instead of being reconstructed.
+class PhysicsFitnessCalculator : public FitnessCalculatorBase
+{
+public:
+    // Type definitions.
+    using FitnessFunc = std::function<float(const PointBasedSystem&)>;
+
+    // Construction info.
+    struct Cinfo
+    {
+        // Initial cells of every creature.
+        PointBasedSystem::Cinfo m_systemCinfo;
+
+        // Parameters of creatures. See CppnCellCreature::Cinfo.
+        int m_numMaxCells = 500;
+        int m_divisionInterval = 60;
+        float m_connectionStiffness = 0.05f;
+
+        // The number of steps to simulate each creature.
+        int m_numSteps = 600;
+
+        // Delta time of each step.
+        float m_deltaTime = 1.f / 60.f;
+
+        // The number of threads used by calcFitnesses(). The same number of systems are pooled. Clones use a single thread.
+        int m_numThreads = 1;
+
+        // Function to reduce the final state of a simulated creature to its fitness.
+        FitnessFunc m_fitnessFunc;
+    };
+
+    // Constructor.
+    PhysicsFitnessCalculator(const Cinfo& cinfo);
+
+    // Simulate a creature of the genome and return its fitness.
+    virtual float calcFitness(GenomeBase* genome) override;
+
+    // Simulate creatures of numGenomes genomes in parallel and store their fitnesses to fitnessesOut.
+    // Genomes are compiled serially beforehand, so the same genome can appear multiple times in genomes.
+    // They must not be modified or evaluated by other threads during this call.
+    void calcFitnesses(GenomeBase* const* genomes, int numGenomes, float* fitnessesOut);
+
+    // Return a clone of this calculator. The clone has its own pool of a single system.
+    // GenerationBase creates a clone per thread and calls calcFitness() only, so clones don't pool systems for calcFitnesses().
+    virtual FitnessCalcPtr clone() const override;
+
+    // Return the number of pooled systems.
+    inline int getNumSlots() const { return (int)m_slots.size(); }
+
+protected:
+    // A pooled simulation.
+    struct Slot
+    {
+        CppnCellCreature::PBSPtr m_system;
+        std::unique_ptr<CppnCellCreature> m_creature;   // Created at the first simulation since a creature needs a genome.
+    };
+
+    // Simulate a creature of the genome using the slot and return its fitness.
+    // network is the compiled network of the genome. When it's null, the genome is compiled by the creature.
+    float simulate(Slot& slot, GenomeBase* genome, const CppnCellCreature::CompiledNetworkPtr& network);
+
+    Cinfo m_cinfo;
+    std::vector<Slot> m_slots;
+    std::vector<CppnCellCreature::CompiledNetworkPtr> m_networks;   // Temporary buffer of compiled networks of genomes given to calcFitnesses().
+};
@@ -39,6 +39,11 @@ RandomActivationProvider::RandomActivationProvider(const ActivationLibrary& libr
 }
 
 auto RandomActivationProvider::getActivation() const->const Activation*
+{
+    return getActivation(*m_random);
+}
+
+auto RandomActivationProvider::getActivation(RandomGenerator& random) const->const Activation*
 {
     if (m_library.getNumActivations() == 0)
     {
@@ -46,6 +51,6 @@ auto RandomActivationProvider::getActivation() const->const Activation*
     }
 
     std::vector<ActivationId> activationIds = m_library.getActivationIds();
-    ActivationId activationId = activationIds[m_random->randomInteger(0, int(activationIds.size()-1))];
+    ActivationId activationId = activationIds[random.randomInteger(0, int(activationIds.size()-1))];
     return m_library.getActivation(activationId).get();
 }
\ No newline at end of file
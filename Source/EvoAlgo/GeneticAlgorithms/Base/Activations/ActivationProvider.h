@@ -17,6 +17,10 @@ class ActivationProvider
 public:
     // Provides an activation function.
     virtual auto getActivation() const->const Activation* = 0;
+
+    // Provides an activation function by using the given random generator.
+    // This is used when genomes are mutated on multiple threads. Override this if getActivation() relies on random numbers.
+    virtual auto getActivation(RandomGenerator& /*random*/) const->const Activation* { return getActivation(); }
 };
 
 // Activation provider which always gives a single default activation function.
@@ -31,6 +35,7 @@ public:
 
     // Provides the default activation function.
     virtual auto getActivation() const->const Activation* override;
+    using ActivationProvider::getActivation;
 
 protected:
     Activation m_defaultActivation;
@@ -45,6 +50,9 @@ public:
     // Provides a random activation function from the library.
     virtual auto getActivation() const->const Activation* override;
 
+    // Provides a random activation function from the library by using the given random generator.
+    virtual auto getActivation(RandomGenerator& random) const->const Activation* override;
+
 protected:
     const ActivationLibrary& m_library;
     RandomGenerator* m_random;
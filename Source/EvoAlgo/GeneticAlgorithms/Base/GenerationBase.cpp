@@ -10,6 +10,8 @@
 #include <EvoAlgo/GeneticAlgorithms/Base/Modifiers/GenomeModifier.h>
 
 #include <omp.h>
+#include <algorithm>
+#include <limits>
 
 //
 // FitnessCalculatorBase
@@ -22,6 +24,11 @@ void FitnessCalculatorBase::evaluateGenome(GenomeBase* genome, const std::vector
     genome->evaluate(&m_evaluator);
 }
 
+void FitnessCalculatorBase::evaluateGenomeBatch(GenomeBase* genome, const float* inputNodeValues, int numSamples, float* outputNodeValues, float biasNodeValue)
+{
+    genome->evaluateBatch(inputNodeValues, numSamples, outputNodeValues, biasNodeValue, &m_evaluator);
+}
+
 //
 // GenerationBase::GenomeData
 //
@@ -50,6 +57,10 @@ GenerationBase::GenerationBase(GenerationId id, int numGenomes, RandomGenerator*
     , m_id(id)
 {
     assert(m_numGenomes > 0);
+    assert(m_randomGenerator);
+
+    m_randomStreamSeed = ((uint64_t)m_randomGenerator->randomInteger(0, std::numeric_limits<int>::max()) << 32) |
+        (uint64_t)m_randomGenerator->randomInteger(0, std::numeric_limits<int>::max());
 }
 
 void GenerationBase::createFitnessCalculators(FitnessCalcPtr fitnessCalc, int numThreads)
@@ -77,6 +88,7 @@ void GenerationBase::evolveGeneration()
 
     // Swap the current generation and the previous generation.
     std::swap(m_genomes, m_prevGenGenomes);
+    std::swap(m_arena, m_prevGenArena);
 
     // Allocate buffer of GenomeData if it's not there yet.
     {
@@ -90,44 +102,71 @@ void GenerationBase::evolveGeneration()
         }
     }
 
-    int numGenomesToAdd = numGenomes;
-    m_numGenomes = 0;
+    // Genomes two generations ago are not used anymore. Release them and reuse their memory.
+    recycleArena();
 
-    // Create genomes for new generations by applying each genome generators.
-    for (GeneratorPtr& generator : m_generators)
+    // Generate and modify genomes. New genomes, networks and baked networks are allocated from the arena.
     {
-        // [todo] Add a way to notify generator that if it's the last generator in this generation
-        //        so that it can generate all the remaining genomes.
-        generator->generate(numGenomes, numGenomesToAdd, selector.get());
+        LinearArena::Scope arenaScope(m_arena);
 
-        // Add generated genomes to the population.
-        const bool protectGenomes = generator->shouldGenomesProtected();
-        for (auto& newGenome : generator->getGeneratedGenomes())
-        {
-            (*m_genomes)[m_numGenomes].init(newGenome, protectGenomes, GenomeId(m_numGenomes));
-            m_numGenomes++;
-        }
+        int numGenomesToAdd = numGenomes;
+        m_numGenomes = 0;
 
-        numGenomesToAdd -= generator->getNumGeneratedGenomes();
-    }
+        // Create genomes for new generations by applying each genome generators.
+        for (int i = 0; i < (int)m_generators.size(); i++)
+        {
+            GeneratorPtr& generator = m_generators[i];
+            generator->setRandomStreamKey(getRandomStreamKey(RSP_GENERATOR, i));
 
-    // We should have added all the genomes at this point.
-    assert(m_numGenomes == m_prevGenGenomes->size());
+            // [todo] Add a way to notify generator that if it's the last generator in this generation
+            //        so that it can generate all the remaining genomes.
+            generator->generate(numGenomes, numGenomesToAdd, selector.get());
 
-    // Modify genomes
-    for (GenomeData& genomeData : *m_genomes)
-    {
-        assert(genomeData.getGenome());
+            // Add generated genomes to the population.
+            const bool protectGenomes = generator->shouldGenomesProtected();
+            for (auto& newGenome : generator->getGeneratedGenomes())
+            {
+                (*m_genomes)[m_numGenomes].init(newGenome, protectGenomes, GenomeId(m_numGenomes));
+                m_numGenomes++;
+            }
 
-        if (genomeData.isProtected())
-        {
-            // Skip protected genome.
-            continue;
+            numGenomesToAdd -= generator->getNumGeneratedGenomes();
         }
 
-        for (ModifierPtr& modifier : m_modifiers)
+        // We should have added all the genomes at this point.
+        assert(m_numGenomes == m_prevGenGenomes->size());
+
+        // Modify genomes
+        if (m_modifiers.size() > 0)
         {
-            modifier->modifyGenomes(genomeData.m_genome);
+            // Collect genomes to modify. Protected genomes are skipped.
+            std::vector<GenomeData*> genomeDatasToModify;
+            GenomeModifier::GenomeBasePtrs genomesToModify;
+            genomeDatasToModify.reserve(m_numGenomes);
+            genomesToModify.reserve(m_numGenomes);
+            for (GenomeData& genomeData : *m_genomes)
+            {
+                assert(genomeData.getGenome());
+
+                if (!genomeData.isProtected())
+                {
+                    genomeDatasToModify.push_back(&genomeData);
+                    genomesToModify.push_back(genomeData.m_genome);
+                }
+            }
+
+            // Modifiers can process all the genomes at once on multiple threads.
+            for (int i = 0; i < (int)m_modifiers.size(); i++)
+            {
+                m_modifiers[i]->setRandomStreamKey(getRandomStreamKey(RSP_MODIFIER, i));
+                m_modifiers[i]->modifyGenomes(genomesToModify);
+            }
+
+            // Modifiers might have replaced genomes.
+            for (int i = 0; i < (int)genomesToModify.size(); i++)
+            {
+                genomeDatasToModify[i]->m_genome = genomesToModify[i];
+            }
         }
     }
 
@@ -140,16 +179,18 @@ void GenerationBase::evolveGeneration()
     m_id = GenerationId(m_id.val() + 1);
 }
 
-namespace
+void GenerationBase::recycleArena()
 {
-    inline float calcFitnessImpl(GenomeBase* genome, FitnessCalculatorBase* calculator, float& bestFitness)
+    for (GenomeData& genomeData : *m_genomes)
     {
-        float fitness = calculator->calcFitness(genome);
-        if (fitness > bestFitness)
-        {
-            bestFitness = fitness;
-        }
-        return fitness;
+        genomeData.m_genome = nullptr;
+    }
+
+    // Genomes can still be referenced from outside of this generation (e.g. species or user code).
+    // In that case, leave the arena to them and start a new one. The old arena is freed when the last genome in it is destroyed.
+    if (!m_arena || !m_arena->reset())
+    {
+        m_arena = std::make_shared<LinearArena>();
     }
 }
 
@@ -157,46 +198,59 @@ void GenerationBase::calcFitness()
 {
     assert(m_fitnessCalculators.size() > 0 && m_fitnessCalculators[0]);
 
-    m_bestFitness = 0;
-
     const int numThreads = (int)m_fitnessCalculators.size();
+    const int numGenomes = (int)m_genomes->size();
+
     if (numThreads > 1)
     {
         // Multi-threaded evaluation
 
-        // Distribute evaluation tasks to each thread.
-        int genomesPerThread = (int)(m_genomes->size() / numThreads);
+        // Best fitness found by each thread. Reduced after all the evaluations are done so that no synchronization is needed.
+        std::vector<float> bestFitnesses(numThreads, 0.f);
 
-        #pragma omp parallel for
-        for (int threadId = 0; threadId < numThreads; threadId++)
+        #pragma omp parallel num_threads(numThreads)
         {
-            FitnessCalcPtr calculator = m_fitnessCalculators[threadId];
-            const int offset = threadId * genomesPerThread;
-            for (int i = 0; i < genomesPerThread; i++)
+            // Each thread uses its own calculator.
+            const int threadId = omp_get_thread_num();
+            assert(threadId < numThreads);
+            FitnessCalculatorBase* calculator = m_fitnessCalculators[threadId].get();
+            float bestFitness = 0.f;
+
+            // Baked networks created during evaluation are allocated from the arena too.
+            LinearArena::Scope arenaScope(m_arena);
+
+            // Cost of evaluation varies a lot between genomes.
+            // Hand out genomes one by one to whichever thread becomes idle instead of splitting them into equal chunks.
+            #pragma omp for schedule(dynamic, 1)
+            for (int i = 0; i < numGenomes; i++)
             {
-                GenomeData& gd = (*m_genomes)[i + offset];
-                gd.setFitness(calcFitnessImpl(gd.m_genome.get(), calculator.get(), m_bestFitness));
+                GenomeData& gd = (*m_genomes)[i];
+                const float fitness = calculator->calcFitness(gd.m_genome.get());
+                gd.setFitness(fitness);
+                bestFitness = std::max(bestFitness, fitness);
             }
-        }
 
-        // Run remaining evaluation tasks.
-        const int offset = numThreads * genomesPerThread;
-        #pragma omp parallel for
-        for (int i = offset; i < (int)m_genomes->size(); i++)
-        {
-            const int threadId = i - offset;
-            assert(threadId < (int)m_fitnessCalculators.size());
-            GenomeData& gd = (*m_genomes)[i];
-            gd.setFitness(calcFitnessImpl(gd.m_genome.get(), m_fitnessCalculators[threadId].get(), m_bestFitness));
+            bestFitnesses[threadId] = bestFitness;
         }
+
+        m_bestFitness = *std::max_element(bestFitnesses.begin(), bestFitnesses.end());
     }
     else
     {
         // Single-threaded evaluation
-        FitnessCalcPtr calculator = m_fitnessCalculators[0];
+        LinearArena::Scope arenaScope(m_arena);
+        FitnessCalculatorBase* calculator = m_fitnessCalculators[0].get();
+        m_bestFitness = 0.f;
         for (GenomeData& gd : *m_genomes)
         {
-            gd.setFitness(calcFitnessImpl(gd.m_genome.get(), calculator.get(), m_bestFitness));
+            const float fitness = calculator->calcFitness(gd.m_genome.get());
+            gd.setFitness(fitness);
+            m_bestFitness = std::max(m_bestFitness, fitness);
         }
     }
 }
+
+auto GenerationBase::getRandomStreamKey(RandomStreamPurpose purpose, int index) const->uint64_t
+{
+    return CounterBasedRandom::makeKey(m_randomStreamSeed, m_id.val(), purpose, index);
+}
@@ -7,6 +7,8 @@
 #pragma once
 
 #include <Common/PseudoRandom.h>
+#include <Common/CounterBasedRandom.h>
+#include <Common/LinearArena.h>
 #include <EvoAlgo/GeneticAlgorithms/Base/GenomeBase.h>
 #include <EvoAlgo/NeuralNetwork/NeuralNetworkEvaluator.h>
 
@@ -29,6 +31,10 @@ protected:
     // This function can be called inside calcFitness() to evaluate a genome to assess its fitness.
     void evaluateGenome(GenomeBase* genome, const std::vector<float>& inputNodeValues, float biasNodeValue = 0.f);
 
+    // This function can be called inside calcFitness() to evaluate a genome for multiple sets of input node values at once.
+    // See BakedNeuralNetwork::evaluateBatch() for the layout of inputNodeValues and outputNodeValues.
+    void evaluateGenomeBatch(GenomeBase* genome, const float* inputNodeValues, int numSamples, float* outputNodeValues, float biasNodeValue = 0.f);
+
 public:
     NeuralNetworkEvaluator m_evaluator;
 };
@@ -46,6 +52,7 @@ public:
     using GeneratorPtrs = std::vector<GeneratorPtr>;
     using ModifierPtr = std::shared_ptr<class GenomeModifier>;
     using ModifierPtrs = std::vector<ModifierPtr>;
+    using ArenaPtr = LinearArena::ArenaPtr;
 
     // Struct holding a genome and its fitness.
     struct GenomeData
@@ -88,6 +95,7 @@ public:
     virtual void evolveGeneration();
 
     // Calculate fitness of all the genomes.
+    // When there are multiple fitness calculators, genomes are distributed dynamically to threads and each thread uses its own calculator.
     void calcFitness();
 
     // Return the number of genomes.
@@ -99,9 +107,15 @@ public:
     // Return generation id.
     inline auto getId() const->GenerationId { return m_id; }
 
+    // Return the best fitness in this generation.
+    inline float getBestFitness() const { return m_bestFitness; }
+
     // Return genome data.
     inline auto getGenomeData() const->const GenomeDatas& { return *m_genomes; }
 
+    // Return the arena which genomes in the current generation are allocated from.
+    inline auto getArena() const->const ArenaPtr& { return m_arena; }
+
 protected:
     // Type declarations.
     using GenomeSelectorPtr = std::shared_ptr<class GenomeSelector>;
@@ -120,12 +134,28 @@ protected:
     // Returns GenomeSelector. This GenomeSelector is used to pass GenomeGenerators in when we evolve a new generation.
     virtual auto createSelector()->GenomeSelectorPtr = 0;
 
+    // Release genomes in m_genomes and recycle m_arena for the new generation.
+    void recycleArena();
+
+    // Purposes of random streams. Streams are keyed by (generation id, purpose, index of generator/modifier).
+    enum RandomStreamPurpose
+    {
+        RSP_GENERATOR,
+        RSP_MODIFIER,
+    };
+
+    // Return the key of random streams of the current generation for the given purpose.
+    auto getRandomStreamKey(RandomStreamPurpose purpose, int index) const->uint64_t;
+
     GeneratorPtrs m_generators;                     // Genome generators used to evolve generation.
     ModifierPtrs m_modifiers;                       // Genome modifiers used to evolve generation.
     FitnessCalculators m_fitnessCalculators;        // The fitness calculator. There is a one calculator per thread.
     GenomeDatasPtr m_genomes;                       // Genomes in the current generation.
     GenomeDatasPtr m_prevGenGenomes;                // Genomes in the previous generation.
+    ArenaPtr m_arena;                               // Arena for genomes, networks and baked networks in the current generation.
+    ArenaPtr m_prevGenArena;                        // Arena for the previous generation.
     RandomGenerator* m_randomGenerator = nullptr;   // Random generator.
+    uint64_t m_randomStreamSeed;                    // Seed of keys of random streams used by generators and modifiers.
     int m_numGenomes;                               // The number of genomes.
     float m_bestFitness = 0;                        // The best fitness in this generation.
     GenerationId m_id;                              // Generation id incremented at every evolveGeneration() call.
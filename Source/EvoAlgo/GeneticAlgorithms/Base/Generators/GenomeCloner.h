@@ -33,15 +33,24 @@ void GenomeCloner<GenomeType>::generate(int /*numTotalGenomes*/, int numRemaning
 
     genomeSelector->preSelection(numRemaningGenomes, GenomeSelector::SELECT_ONE_GENOME);
 
-    m_generatedGenomes.reserve(numRemaningGenomes);
-
-    // Copy genomes
+    // Select genomes first. GenomeSelector is not thread safe.
+    std::vector<const GenomeData*> selectedGenomes(numRemaningGenomes);
     for (int i = 0; i < numRemaningGenomes; i++)
     {
-        const GenomeData* g = genomeSelector->selectGenome();
-        GenomeBasePtr copy = std::make_shared<GenomeType>(*static_cast<const GenomeType*>(g->getGenome().get()));
-        m_generatedGenomes.push_back(std::static_pointer_cast<GenomeBase>(copy));
+        selectedGenomes[i] = genomeSelector->selectGenome();
     }
 
     genomeSelector->postSelection();
+
+    // Copy genomes
+    m_generatedGenomes.resize(numRemaningGenomes);
+    const LinearArena::ArenaPtr arena = LinearArena::getCurrentArena();
+
+    #pragma omp parallel for num_threads(m_numThreads)
+    for (int i = 0; i < numRemaningGenomes; i++)
+    {
+        LinearArena::Scope arenaScope(arena);
+        GenomeBasePtr copy = LinearArena::makeShared<GenomeType>(*static_cast<const GenomeType*>(selectedGenomes[i]->getGenome().get()));
+        m_generatedGenomes[i] = std::static_pointer_cast<GenomeBase>(copy);
+    }
 }
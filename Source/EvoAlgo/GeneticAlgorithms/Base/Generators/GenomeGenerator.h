@@ -7,6 +7,7 @@
 #pragma once
 
 #include <EvoAlgo/GeneticAlgorithms/Base/GenomeBase.h>
+#include <Common/CounterBasedRandom.h>
 
 // Base class which generates a set of new genomes from existing genomes.
 class GenomeGenerator
@@ -29,7 +30,21 @@ public:
     // Return the set of newly generated genomes.
     inline auto getGeneratedGenomes() const->const GenomeBasePtrs { return m_generatedGenomes; }
 
+    // Set the number of threads available for generation.
+    inline void setNumThreads(int numThreads) { assert(numThreads > 0); m_numThreads = numThreads; }
+
+    // Set the key of random streams used by the next generate() call.
+    // Each new genome should use its own stream derived from this key so that the result doesn't depend on the number of threads.
+    inline void setRandomStreamKey(uint64_t key) { m_randomStreamKey = key; m_hasRandomStreamKey = true; }
+
 protected:
     // The newly generated genomes
     GenomeBasePtrs m_generatedGenomes;
+
+    // The number of threads available for generation.
+    int m_numThreads = 1;
+
+    // The key of random streams and whether it's set and not consumed yet.
+    uint64_t m_randomStreamKey = 0;
+    bool m_hasRandomStreamKey = false;
 };
@@ -7,6 +7,7 @@
 #include <EvoAlgo/EvoAlgo.h>
 #include <EvoAlgo/GeneticAlgorithms/Base/GenomeBase.h>
 #include <EvoAlgo/NeuralNetwork/NeuralNetworkEvaluator.h>
+#include <EvoAlgo/NeuralNetwork/CompiledNeuralNetwork.h>
 
 GenomeBase::GenomeBase(NetworkPtr network, NodeId biasNode)
     : m_network(network)
@@ -25,7 +26,7 @@ GenomeBase::GenomeBase(const GenomeBase& other)
 
     if (other.m_bakedNetwork)
     {
-        m_bakedNetwork = std::make_shared<BakedNeuralNetwork>(*other.m_bakedNetwork);
+        m_bakedNetwork = LinearArena::makeShared<BakedNeuralNetwork>(*other.m_bakedNetwork);
     }
 }
 
@@ -38,7 +39,7 @@ void GenomeBase::operator= (const GenomeBase& other)
 
     if (other.m_bakedNetwork)
     {
-        m_bakedNetwork = std::make_shared<BakedNeuralNetwork>(*other.m_bakedNetwork);
+        m_bakedNetwork = LinearArena::makeShared<BakedNeuralNetwork>(*other.m_bakedNetwork);
         m_needRebake = other.m_needRebake;
     }
     else
@@ -50,7 +51,7 @@ void GenomeBase::operator= (const GenomeBase& other)
 
 std::shared_ptr<GenomeBase> GenomeBase::clone() const
 {
-    return std::make_shared<GenomeBase>(*this);
+    return LinearArena::makeShared<GenomeBase>(*this);
 }
 
 void GenomeBase::bake()
@@ -62,6 +63,20 @@ void GenomeBase::bake()
     }
 }
 
+void GenomeBase::updateBakedEdgeWeight(EdgeId edgeId)
+{
+    if (!shouldUpdateBakedNetworkNode())
+    {
+        // The network is going to be rebaked anyway.
+        return;
+    }
+
+    if (!m_bakedNetwork->setEdgeWeight(edgeId, m_network->getWeight(edgeId)))
+    {
+        m_needRebake = true;
+    }
+}
+
 int GenomeBase::getNumEnabledEdges() const
 {
     int num = 0;
@@ -183,3 +198,28 @@ void GenomeBase::evaluate(NeuralNetworkEvaluator* evaluator)
         evaluator->evaluate(m_network->getOutputNodes(), m_bakedNetwork.get());
     }
 }
+
+void GenomeBase::evaluateBatch(const float* inputNodeValues, int numSamples, float* outputNodeValues, float biasNodeValue, const NeuralNetworkEvaluator* evaluator)
+{
+    assert(m_network.get());
+
+    bake();
+
+    // Clear values of nodes which are not inputs so that they start from the same state as evaluate().
+    clearNodeValues();
+    if (m_biasNode.isValid())
+    {
+        setBiasNodeValue(biasNodeValue);
+    }
+
+    const int numIterations = evaluator ? evaluator->m_evalIterations : 1;
+    m_bakedNetwork->evaluateBatch(inputNodeValues, numSamples, outputNodeValues, numIterations);
+}
+
+auto GenomeBase::compile()->CompiledNetworkPtr
+{
+    assert(m_network.get());
+
+    bake();
+    return m_bakedNetwork->compile();
+}
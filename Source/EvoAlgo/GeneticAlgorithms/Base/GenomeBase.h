@@ -13,6 +13,7 @@
 #include <EvoAlgo/NeuralNetwork/BakedNeuralNetwork.h>
 
 class NeuralNetworkEvaluator;
+class CompiledNeuralNetwork;
 
 // Base class of genome used for genetic algorithms.
 class GenomeBase
@@ -24,6 +25,7 @@ public:
     using Network = NeuralNetwork<Node, Edge>;
     using NetworkPtr = std::shared_ptr<Network>;
     using BakedNetworkPtr = std::shared_ptr<BakedNeuralNetwork>;
+    using CompiledNetworkPtr = std::shared_ptr<CompiledNeuralNetwork>;
 
     //
     // Constructors
@@ -57,7 +59,7 @@ public:
     inline float getEdgeWeight(EdgeId edgeId) const { return m_network->getWeight(edgeId); }
 
     // Set weight of edge.
-    inline void setEdgeWeight(EdgeId edgeId, float weight) { m_network->setWeight(edgeId, weight); m_needRebake = true; }
+    inline void setEdgeWeight(EdgeId edgeId, float weight) { m_network->setWeight(edgeId, weight); updateBakedEdgeWeight(edgeId); }
 
     // Get weight of edge regardless if it's enabled or not.
     inline float getEdgeWeightRaw(EdgeId edgeId) const { return m_network->getEdge(edgeId).getWeightRaw(); }
@@ -66,7 +68,7 @@ public:
     inline bool isEdgeEnabled(EdgeId edgeId) const { return m_network->getEdge(edgeId).isEnabled(); }
 
     // Set enable/disable the edge.
-    inline void setEdgeEnabled(EdgeId edgeId, bool enabled) { m_network->accessEdge(edgeId).setEnabled(enabled); m_needRebake = true; }
+    inline void setEdgeEnabled(EdgeId edgeId, bool enabled) { m_network->accessEdge(edgeId).setEnabled(enabled); updateBakedEdgeWeight(edgeId); }
 
     // Return the number of edges.
     inline int getNumEdges() const { return m_network->getNumEdges(); }
@@ -123,10 +125,21 @@ public:
     // Evaluate this genome using the current values of input nodes and the provided evaluator.
     void evaluate(NeuralNetworkEvaluator* evaluator);
 
+    // Evaluate this genome for multiple sets of input node values at once.
+    // See BakedNeuralNetwork::evaluateBatch() for the layout of inputNodeValues and outputNodeValues.
+    // When evaluator is provided, circular network is evaluated m_evalIterations times for every sample regardless of its evaluation type.
+    void evaluateBatch(const float* inputNodeValues, int numSamples, float* outputNodeValues, float biasNodeValue = 0.f, const NeuralNetworkEvaluator* evaluator = nullptr);
+
+    // Compile the network for the fastest evaluation. The compiled network doesn't reflect any further changes to this genome.
+    auto compile()->CompiledNetworkPtr;
+
 protected:
     // Bake the newtork.
     void bake();
 
+    // Patch weight of the edge in the baked network. Rebake is requested only when the edge cannot be patched.
+    void updateBakedEdgeWeight(EdgeId edgeId);
+
     // Return ture if baked network should also update its node values.
     inline bool shouldUpdateBakedNetworkNode() const { return m_bakedNetwork && !m_needRebake; }
 
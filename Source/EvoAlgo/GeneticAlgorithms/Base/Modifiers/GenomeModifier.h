@@ -7,6 +7,7 @@
 #pragma once
 
 #include <EvoAlgo/GeneticAlgorithms/Base/GenomeBase.h>
+#include <Common/CounterBasedRandom.h>
 
 // Base class which modifies genomes.
 class GenomeModifier
@@ -14,7 +15,32 @@ class GenomeModifier
 public:
     // Type declarations
     using GenomeBasePtr = std::shared_ptr<GenomeBase>;
+    using GenomeBasePtrs = std::vector<GenomeBasePtr>;
 
     // Modifies the genomes
     virtual void modifyGenomes(GenomeBasePtr& genome) = 0;
+
+    // Modifies multiple genomes. By default, this calls modifyGenomes() for each genome in order.
+    // Override this to modify genomes on multiple threads. The result should be the same as the default implementation.
+    virtual void modifyGenomes(GenomeBasePtrs& genomes);
+
+    // Set the number of threads available for modification.
+    inline void setNumThreads(int numThreads) { assert(numThreads > 0); m_numThreads = numThreads; }
+
+    // Set the key of random streams used by the next modifyGenomes() call.
+    // Each genome should use its own stream derived from this key so that the result doesn't depend on the number of threads.
+    inline void setRandomStreamKey(uint64_t key) { m_randomStreamKey = key; m_hasRandomStreamKey = true; }
+
+protected:
+    int m_numThreads = 1;               // The number of threads available for modification.
+    uint64_t m_randomStreamKey = 0;     // The key of random streams.
+    bool m_hasRandomStreamKey = false;  // True if m_randomStreamKey is set and not consumed yet.
 };
+
+inline void GenomeModifier::modifyGenomes(GenomeBasePtrs& genomes)
+{
+    for (GenomeBasePtr& genome : genomes)
+    {
+        modifyGenomes(genome);
+    }
+}
@@ -99,12 +99,18 @@ void Generation::init(const Cinfo& cinfo)
 
         // Create genome cloner.
         m_generators.push_back(std::make_unique<GenomeCloner<Genome>>());
+
+        for (GeneratorPtr& generator : m_generators)
+        {
+            generator->setNumThreads(cinfo.m_numThreads);
+        }
     }
 
     // Create modifiers.
     {
         // Create mutator.
         m_mutator = std::make_shared<DefaultMutation>(cinfo.m_mutationParams);
+        m_mutator->setNumThreads(cinfo.m_numThreads);
         m_modifiers.push_back(m_mutator);
     }
 
@@ -268,7 +274,7 @@ void Generation::postUpdateGeneration()
 auto Generation::createSelector()->GenomeSelectorPtr
 {
     // Create a DefaultGenomeSelector.
-    std::shared_ptr<SpeciesBasedGenomeSelector> selector = std::make_shared<SpeciesBasedGenomeSelector>(*m_genomes, m_species, m_genomesSpecies);
+    std::shared_ptr<SpeciesBasedGenomeSelector> selector = std::make_shared<SpeciesBasedGenomeSelector>(*m_genomes, m_species, m_genomesSpecies, m_randomGenerator);
     if(selector->getNumGenomes() > 0)
     {
         selector->setInterSpeciesSelectionRate(m_params.m_interSpeciesCrossOverRate);
@@ -278,7 +284,7 @@ auto Generation::createSelector()->GenomeSelectorPtr
     // DefaultGenomeSelector failed to set up. This must mean all genomes have zero fitness.
     // Create uniform selector instead.
     WARN("All genomes have zero fitness. Use a uniform selector.");
-    return std::static_pointer_cast<GenomeSelector>(std::make_shared<UniformGenomeSelector>(getGenomeData()));
+    return std::static_pointer_cast<GenomeSelector>(std::make_shared<UniformGenomeSelector>(getGenomeData(), m_randomGenerator));
 }
 
 bool Generation::isSpeciesReproducible(SpeciesId speciesId) const
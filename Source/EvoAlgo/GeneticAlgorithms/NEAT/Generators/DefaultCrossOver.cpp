@@ -12,7 +12,14 @@
 
 using namespace NEAT;
 
-auto DefaultCrossOver::crossOver(const GenomeBase& genome1In, const GenomeBase& genome2In, bool sameFittingScore)->GenomeBasePtr
+auto DefaultCrossOver::crossOver(const GenomeBase& genome1, const GenomeBase& genome2, bool sameFittingScore)->GenomeBasePtr
+{
+    RandomGenerator& random = m_params.m_random ? *m_params.m_random : PseudoRandom::getInstance();
+    return crossOverImpl(genome1, genome2, sameFittingScore, random);
+}
+
+template <typename Random>
+auto DefaultCrossOver::crossOverImpl(const GenomeBase& genome1In, const GenomeBase& genome2In, bool sameFittingScore, Random& random) const->GenomeBasePtr
 {
     using Network = Genome::Network;
 
@@ -33,8 +40,6 @@ auto DefaultCrossOver::crossOver(const GenomeBase& genome1In, const GenomeBase&
     assert(inputNodes1.size() == inputNodes2.size());
     assert(outputNodes1.size() == outputNodes2.size());
 
-    RandomGenerator& random = m_params.m_random ? *m_params.m_random : PseudoRandom::getInstance();
-
     const Network* network1 = genome1.getNetwork();
     const Network* network2 = genome2.getNetwork();
 
@@ -242,7 +247,7 @@ auto DefaultCrossOver::crossOver(const GenomeBase& genome1In, const GenomeBase&
     assert(network->validate());
 
     // Create a new genome.
-    return std::make_unique<Genome>(genome1, network, innovations);
+    return LinearArena::makeShared<Genome>(genome1, network, innovations);
 }
 
 void DefaultCrossOver::generate(int numTotalGenomes, int numRemaningGenomes, GenomeSelector* genomeSelector)
@@ -265,9 +270,19 @@ void DefaultCrossOver::generate(int numTotalGenomes, int numRemaningGenomes, Gen
 
     // Clear new genomes output.
     m_generatedGenomes.clear();
-    m_generatedGenomes.reserve(numGenomesToCrossover);
 
-    // Perform cross-over.
+    RandomGenerator& random = m_params.m_random ? *m_params.m_random : PseudoRandom::getInstance();
+
+    // Parents of a new genome.
+    struct Parents
+    {
+        const GenomeData* m_genome1;    // Parent with higher fitness.
+        const GenomeData* m_genome2;    // The other parent.
+        bool m_isSameFitness;           // True if both parents have the same fitness.
+    };
+
+    // Select all the parents first. GenomeSelector is not thread safe.
+    std::vector<Parents> parents(numGenomesToCrossover);
     for (int i = 0; i < numGenomesToCrossover; i++)
     {
         const GenomeData* g1 = nullptr;
@@ -293,11 +308,24 @@ void DefaultCrossOver::generate(int numTotalGenomes, int numRemaningGenomes, Gen
             }
         }
 
-        // Cross-over.
-        GenomeBasePtr newGenome = crossOver(*g1->getGenome(), *g2->getGenome(), isSameFitness);
-
-        m_generatedGenomes.push_back(std::static_pointer_cast<GenomeBase>(newGenome));
+        parents[i] = Parents{ g1, g2, isSameFitness };
     }
 
     genomeSelector->postSelection();
+
+    // Each new genome uses its own random stream keyed by its index.
+    const uint64_t randomStreamKey = consumeRandomStreamKey(m_randomStreamKey, m_hasRandomStreamKey, random);
+
+    // Perform cross-over.
+    m_generatedGenomes.resize(numGenomesToCrossover);
+    const LinearArena::ArenaPtr arena = LinearArena::getCurrentArena();
+
+    #pragma omp parallel for schedule(dynamic) num_threads(m_numThreads)
+    for (int i = 0; i < numGenomesToCrossover; i++)
+    {
+        LinearArena::Scope arenaScope(arena);
+        CounterBasedRandom crossOverRandom(CounterBasedRandom::makeKey(randomStreamKey, i));
+        const Parents& p = parents[i];
+        m_generatedGenomes[i] = crossOverImpl(*p.m_genome1->getGenome(), *p.m_genome2->getGenome(), p.m_isSameFitness, crossOverRandom);
+    }
 }
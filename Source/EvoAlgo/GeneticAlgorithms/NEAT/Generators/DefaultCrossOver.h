@@ -45,10 +45,18 @@ namespace NEAT
 
         // Generate a set of new genomes by using genomeSelector.
         // genomeSelector has to be already configured and available to select existing genomes.
+        // Pairs of genomes are selected serially and then cross-over is performed on multiple threads.
+        // Each new genome uses its own random stream seeded by m_params.m_random so the result doesn't depend on the number of threads.
         virtual void generate(int numTotalGenomes, int numRemaningGenomes, GenomeSelector* genomeSelector) override;
 
     public:
         // The parameter.
         CrossOverParams m_params;
+
+    protected:
+        // Implementation of crossOver() using the given random generator.
+        // Random is templated so that calls to CounterBasedRandom can be inlined.
+        template <typename Random>
+        auto crossOverImpl(const GenomeBase& genome1, const GenomeBase& genome2, bool sameFitness, Random& random) const->GenomeBasePtr;
     };
 }
@@ -65,14 +65,14 @@ void SpeciesChampionSelector::generate(int numTotalGenomes, int numRemaningGenom
 
             if (fitness >= m_bestFitness)
             {
-                m_generatedGenomes.push_back(std::make_shared<Genome>(*best));
+                m_generatedGenomes.push_back(LinearArena::makeShared<Genome>(*best));
                 continue;
             }
 
             if (species->getNumMembers() >= m_minMembersInSpeciesToCopyChampion)
             {
                 // Copy the champion.
-                GenomePtr copiedGenome = std::make_shared<Genome>(*best);
+                GenomePtr copiedGenome = LinearArena::makeShared<Genome>(*best);
 
                 if (canSelectAllChampions)
                 {
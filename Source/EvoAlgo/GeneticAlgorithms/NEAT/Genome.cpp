@@ -160,7 +160,7 @@ void Genome::operator= (const Genome& other)
 
 std::shared_ptr<GenomeBase> Genome::clone() const
 {
-    return std::make_shared<Genome>(*this);
+    return LinearArena::makeShared<Genome>(*this);
 }
 
 void Genome::addNodeAt(EdgeId edgeId, const Activation* activation, NodeId& newNode, EdgeId& newIncomingEdge, EdgeId& newOutgoingEdge)
@@ -281,7 +281,7 @@ void Genome::reassignNodeId(const NodeId originalId, const NodeId newId)
     assert(validate());
 }
 
-void Genome::reassignNewNodeIdAndConnectedEdgeIds(const NodeId originalId)
+auto Genome::reassignNewNodeIdAndConnectedEdgeIds(const NodeId originalId)->NodeId
 {
     NodeId newNodeId = m_innovIdCounter.getNewNodeId();
     reassignNodeId(originalId, newNodeId);
@@ -304,6 +304,8 @@ void Genome::reassignNewNodeIdAndConnectedEdgeIds(const NodeId originalId)
     m_needRebake = true;
 
     assert(validate());
+
+    return newNodeId;
 }
 
 void Genome::reassignInnovation(const EdgeId originalId, const EdgeId newId)
@@ -140,7 +140,8 @@ namespace NEAT
 
         // Reassign a new node id to an existing node.
         // This functionality should be only used by mutator for mutating activation of a node.
-        void reassignNewNodeIdAndConnectedEdgeIds(const NodeId originalId);
+        // Return the new node id.
+        auto reassignNewNodeIdAndConnectedEdgeIds(const NodeId originalId)->NodeId;
 
         // Reassign an innovation id to an existing edge.
         // This functionality should be only used when there is the same structural mutation in more than one genomes in the same generation.
@@ -17,8 +17,17 @@ void DefaultMutation::reset()
 
 void DefaultMutation::mutate(GenomeBase* genomeInOut, MutationOut& mutationOut)
 {
-    mutationOut.clear();
+    Genome* genome = static_cast<Genome*>(genomeInOut);
+    RandomGenerator* random = m_params.m_random ? m_params.m_random : &PseudoRandom::getInstance();
+
+    StructuralMutation structuralMutation;
+    prepareMutation(genome, *random, structuralMutation);
+    applyMutation(genome, structuralMutation, mutationOut);
+}
 
+template <typename Random>
+void DefaultMutation::prepareMutation(Genome* genome, Random& random, StructuralMutation& mutationOut) const
+{
     assert(m_params.m_weightMutationRate >= 0 && m_params.m_weightMutationRate <= 1);
     assert(m_params.m_weightMutationPerturbation >= 0 && m_params.m_weightMutationPerturbation <= 1);
     assert(m_params.m_weightMutationNewValRate >= 0 && m_params.m_weightMutationNewValRate <= 1);
@@ -27,46 +36,40 @@ void DefaultMutation::mutate(GenomeBase* genomeInOut, MutationOut& mutationOut)
     assert(m_params.m_addEdgeMutationRate >= 0 && m_params.m_addEdgeMutationRate <= 1);
     assert(m_params.m_newEdgeMinWeight <= m_params.m_newEdgeMaxWeight);
 
-    Genome::NetworkPtr network = genomeInOut->accessNetwork();
+    Genome::NetworkPtr network = genome->accessNetwork();
     assert(network->validate());
 
-    RandomGenerator* random = m_params.m_random ? m_params.m_random : &PseudoRandom::getInstance();
-
-    int numNewEdges = 0;
-
     // 1. Change weights of edges with a small perturbation.
     for (const auto& elem : network->getEdges())
     {
         EdgeId edgeId = elem.first;
-        if (random->randomReal01() <= m_params.m_weightMutationRate)
+        if (random.randomReal01() <= m_params.m_weightMutationRate)
         {
-            if (random->randomReal01() <= m_params.m_weightMutationNewValRate)
+            if (random.randomReal01() <= m_params.m_weightMutationNewValRate)
             {
                 // Assign a new random weight.
-                genomeInOut->setEdgeWeight(edgeId, random->randomReal(m_params.m_weightMutationValMin, m_params.m_weightMutationValMax));
+                genome->setEdgeWeight(edgeId, random.randomReal(m_params.m_weightMutationValMin, m_params.m_weightMutationValMax));
             }
             else
             {
                 // Mutate the current weight by small perturbation.
                 float weight = network->getWeight(edgeId);
-                const float perturbation = random->randomReal(-m_params.m_weightMutationPerturbation, m_params.m_weightMutationPerturbation);
+                const float perturbation = random.randomReal(-m_params.m_weightMutationPerturbation, m_params.m_weightMutationPerturbation);
                 weight = weight * (1.0f + perturbation);
                 weight = std::max(m_params.m_weightMutationValMin, std::min(m_params.m_weightMutationValMax, weight));
-                genomeInOut->setEdgeWeight(edgeId, weight);
+                genome->setEdgeWeight(edgeId, weight);
             }
         }
     }
 
-    Genome* genome = static_cast<Genome*>(genomeInOut);
-
     // 2. Change activation of a random node.
     NodeId nodeActivationMutated = NodeId::invalid();
-    if (m_params.m_activationProvider && random->randomReal01() < m_params.m_changeActivationRate)
+    if (m_params.m_activationProvider && random.randomReal01() < m_params.m_changeActivationRate)
     {
         auto& nodes = network->getNodes();
 
         // Select a random node.
-        int index = random->randomInteger(0, nodes.size() - 1);
+        int index = random.randomInteger(0, nodes.size() - 1);
 
         // Find NodeId of the node.
         NodeId nodeToChangeActivation;
@@ -88,14 +91,13 @@ void DefaultMutation::mutate(GenomeBase* genomeInOut, MutationOut& mutationOut)
         // We don't change activation functions for input and bias nodes.
         if (nd.m_node.getNodeType() != DefaultNode::Type::BIAS && nd.m_node.getNodeType() != DefaultNode::Type::INPUT)
         {
-            const Activation* activation = m_params.m_activationProvider->getActivation();
+            const Activation* activation = m_params.m_activationProvider->getActivation(random);
             if (activation->m_id != nd.m_node.getActivationId())
             {
                 // Update activation function.
                 genome->setActivation(nodeId, activation);
 
-                // Reset node id and ids of all the connected edges.
-                genome->reassignNewNodeIdAndConnectedEdgeIds(nodeId);
+                // Node id and ids of all the connected edges are reset later by applyMutation().
                 nodeActivationMutated = nodeId;
             }
         }
@@ -104,14 +106,14 @@ void DefaultMutation::mutate(GenomeBase* genomeInOut, MutationOut& mutationOut)
     assert(network->validate());
 
     // 3. Remove a random existing edge.
-    if (random->randomReal01() < m_params.m_removeEdgeMutationRate)
+    if (random.randomReal01() < m_params.m_removeEdgeMutationRate)
     {
         const auto& edges = network->getEdges();
 
         if (edges.size() > 1)
         {
             // Select a random edge to remove.
-            int index = random->randomInteger(0, edges.size() - 1);
+            int index = random.randomInteger(0, edges.size() - 1);
 
             // Find EdgeId of the edge.
             EdgeId edgeToRemove;
@@ -143,8 +145,8 @@ void DefaultMutation::mutate(GenomeBase* genomeInOut, MutationOut& mutationOut)
     // 4. 5. Add a new node and edge
 
     // Decide whether we add a new node/edge
-    const bool addNewNode = random->randomReal01() < m_params.m_addNodeMutationRate;
-    const bool addNewEdge = random->randomReal01() < m_params.m_addEdgeMutationRate;
+    const bool addNewNode = random.randomReal01() < m_params.m_addNodeMutationRate;
+    const bool addNewEdge = random.randomReal01() < m_params.m_addEdgeMutationRate;
 
     // First, collect candidate edges/pairs of nodes where we can add new node/edge.
     // We do this now before we actually add any edge or node in order to prevent
@@ -230,6 +232,81 @@ void DefaultMutation::mutate(GenomeBase* genomeInOut, MutationOut& mutationOut)
         }
     }
 
+    mutationOut.m_nodeActivationMutated = nodeActivationMutated;
+
+    // Select a random edge from candidates to add a new node.
+    if (!edgeCandidates.empty())
+    {
+        mutationOut.m_edgeToAddNode = edgeCandidates[random.randomInteger(0, (int)edgeCandidates.size() - 1)];
+        mutationOut.m_newNodeActivation = m_params.m_activationProvider ? m_params.m_activationProvider->getActivation(random) : nullptr;
+    }
+
+    // Select a random node pair to add a new edge.
+    if (!nodeCandidates.empty())
+    {
+        const NodePair& pair = nodeCandidates[random.randomInteger(0, (int)nodeCandidates.size() - 1)];
+        mutationOut.m_newEdgeInNode = pair.first;
+        mutationOut.m_newEdgeOutNode = pair.second;
+        mutationOut.m_newEdgeWeight = random.randomReal(m_params.m_newEdgeMinWeight, m_params.m_newEdgeMaxWeight);
+    }
+}
+
+void DefaultMutation::applyMutation(Genome* genome, const StructuralMutation& mutation, MutationOut& mutationOut) const
+{
+    mutationOut.clear();
+
+    const Genome::Network* network = genome->getNetwork();
+    int numNewEdges = 0;
+
+    EdgeId edgeToAddNode = mutation.m_edgeToAddNode;
+    NodeId newEdgeInNode = mutation.m_newEdgeInNode;
+    NodeId newEdgeOutNode = mutation.m_newEdgeOutNode;
+
+    // Reset node id and ids of all the connected edges of the node whose activation was changed.
+    if (mutation.m_nodeActivationMutated.isValid())
+    {
+        const NodeId originalNodeId = mutation.m_nodeActivationMutated;
+
+        // Remember the end nodes of the selected edge since its id can be reassigned.
+        NodeId edgeInNode = NodeId::invalid();
+        NodeId edgeOutNode = NodeId::invalid();
+        if (edgeToAddNode.isValid())
+        {
+            edgeInNode = network->getInNode(edgeToAddNode);
+            edgeOutNode = network->getOutNode(edgeToAddNode);
+        }
+
+        const NodeId newNodeId = genome->reassignNewNodeIdAndConnectedEdgeIds(originalNodeId);
+
+        // Fix ids selected by prepareMutation().
+        auto fixNodeId = [originalNodeId, newNodeId](NodeId& nodeId)
+        {
+            if (nodeId == originalNodeId)
+            {
+                nodeId = newNodeId;
+            }
+        };
+
+        fixNodeId(newEdgeInNode);
+        fixNodeId(newEdgeOutNode);
+
+        if (edgeToAddNode.isValid() && (edgeInNode == originalNodeId || edgeOutNode == originalNodeId))
+        {
+            fixNodeId(edgeInNode);
+            fixNodeId(edgeOutNode);
+            edgeToAddNode = EdgeId::invalid();
+            for (EdgeId edge : network->getOutgoingEdges(edgeInNode))
+            {
+                if (network->getOutNode(edge) == edgeOutNode)
+                {
+                    edgeToAddNode = edge;
+                    break;
+                }
+            }
+            assert(edgeToAddNode.isValid());
+        }
+    }
+
     // Function to assign innovation id to newly added edge and store its info in mutationOut.
     auto newEdgeAdded = [&mutationOut, network, &numNewEdges](EdgeId newEdge)
     {
@@ -244,13 +321,11 @@ void DefaultMutation::mutate(GenomeBase* genomeInOut, MutationOut& mutationOut)
     };
 
     // 4. Add a node at a random edge
-    if (!edgeCandidates.empty())
+    if (edgeToAddNode.isValid())
     {
-        // Select a random edge from candidates
-        const EdgeId edgeToAddNode = edgeCandidates[random->randomInteger(0, (int)edgeCandidates.size() - 1)];
+        const Activation* activation = mutation.m_newNodeActivation;
         NodeId newNode;
         EdgeId newIncomingEdge, newOutgoingEdge;
-        const Activation* activation = m_params.m_activationProvider ? m_params.m_activationProvider->getActivation() : nullptr;
         genome->addNodeAt(edgeToAddNode, activation, newNode, newIncomingEdge, newOutgoingEdge);
 
         newEdgeAdded(newIncomingEdge);
@@ -266,21 +341,21 @@ void DefaultMutation::mutate(GenomeBase* genomeInOut, MutationOut& mutationOut)
     assert(network->validate());
 
     // 5. Add an edge between random nodes
-    if (!nodeCandidates.empty())
+    if (newEdgeInNode.isValid())
     {
-        // Select a random node pair.
-        const NodePair& pair = nodeCandidates[random->randomInteger(0, (int)nodeCandidates.size() - 1)];
-        const float weight = random->randomReal(m_params.m_newEdgeMinWeight, m_params.m_newEdgeMaxWeight);
+        const NodeId inNode = newEdgeInNode;
+        const NodeId outNode = newEdgeOutNode;
+        const float weight = mutation.m_newEdgeWeight;
         bool tryAddFlippedEdgeOnFail = false;
-        EdgeId newEdge = genome->addEdgeAt(pair.first, pair.second, weight, tryAddFlippedEdgeOnFail);
+        EdgeId newEdge = genome->addEdgeAt(inNode, outNode, weight, tryAddFlippedEdgeOnFail);
 
         if (!newEdge.isValid() &&
-            !network->getNode(pair.first).isInputOrBias() &&
-            network->getNode(pair.second).getNodeType() != Genome::Node::Type::OUTPUT)
+            !network->getNode(inNode).isInputOrBias() &&
+            network->getNode(outNode).getNodeType() != Genome::Node::Type::OUTPUT)
         {
             // Adding edge was failed most likely because it will cause a circular network.
             // We might still be able to add an edge by flipping inNode and outNode when it's appropriate.
-            newEdge = genome->addEdgeAt(pair.second, pair.first, weight, tryAddFlippedEdgeOnFail);
+            newEdge = genome->addEdgeAt(outNode, inNode, weight, tryAddFlippedEdgeOnFail);
         }
 
         if (newEdge.isValid())
@@ -303,7 +378,45 @@ void DefaultMutation::modifyGenomes(GenomeBasePtr& genomeIn)
 
     MutationOut mutationOut;
     mutate(genome, mutationOut);
+    mergeIdenticalMutation(genome, mutationOut);
+}
 
+void DefaultMutation::modifyGenomes(GenomeBasePtrs& genomes)
+{
+    const int numGenomes = (int)genomes.size();
+    RandomGenerator* random = m_params.m_random ? m_params.m_random : &PseudoRandom::getInstance();
+
+    // Each genome uses its own random stream keyed by its index.
+    const uint64_t randomStreamKey = consumeRandomStreamKey(m_randomStreamKey, m_hasRandomStreamKey, *random);
+
+    // Perform mutations which don't need new ids on multiple threads.
+    std::vector<StructuralMutation> structuralMutations(numGenomes);
+
+    #pragma omp parallel for schedule(dynamic) num_threads(m_numThreads)
+    for (int i = 0; i < numGenomes; i++)
+    {
+        if (genomes[i])
+        {
+            CounterBasedRandom genomeRandom(CounterBasedRandom::makeKey(randomStreamKey, i));
+            prepareMutation(static_cast<Genome*>(genomes[i].get()), genomeRandom, structuralMutations[i]);
+        }
+    }
+
+    // Add new nodes and edges serially in the order of genomes.
+    for (int i = 0; i < numGenomes; i++)
+    {
+        if (genomes[i])
+        {
+            Genome* genome = static_cast<Genome*>(genomes[i].get());
+            MutationOut mutationOut;
+            applyMutation(genome, structuralMutations[i], mutationOut);
+            mergeIdenticalMutation(genome, mutationOut);
+        }
+    }
+}
+
+void DefaultMutation::mergeIdenticalMutation(Genome* genome, const MutationOut& mutationOut)
+{
     // Check if there is already a mutation of the same structural change.
     // If so, assign the same innovation id to it.
     // We iterate over the newly added nodes and check if there's any mutations with the same structural change.
@@ -84,11 +84,41 @@ namespace NEAT
         // so that identical mutations have the same node/edge ids.
         virtual void modifyGenomes(GenomeBasePtr& genome) override;
 
+        // Modifies multiple genomes by mutation.
+        // Mutations which don't require new node/edge ids are performed on multiple threads, each genome with its own random stream
+        // seeded by m_params.m_random. Then new nodes and edges are added serially in the order of genomes
+        // so that assigned ids and deduplication of identical mutations don't depend on the number of threads.
+        virtual void modifyGenomes(GenomeBasePtrs& genomes) override;
+
     public: 
         // The parameter.
         MutationParams m_params;
 
     protected:
+        // Structural mutations which require new node/edge ids. Decided by prepareMutation() and performed by applyMutation().
+        struct StructuralMutation
+        {
+            NodeId m_nodeActivationMutated = NodeId::invalid(); // Node whose activation was changed. It gets new node/edge ids.
+            EdgeId m_edgeToAddNode = EdgeId::invalid();         // Edge to add a new node at.
+            const Activation* m_newNodeActivation = nullptr;    // Activation of the new node.
+            NodeId m_newEdgeInNode = NodeId::invalid();         // In node of the new edge.
+            NodeId m_newEdgeOutNode = NodeId::invalid();        // Out node of the new edge.
+            float m_newEdgeWeight = 0.f;                        // Weight of the new edge.
+        };
+
+        // Mutate weights and activations, remove an edge and decide structural mutations.
+        // This doesn't access the innovation counter so it can be called for different genomes on multiple threads.
+        // Random is templated so that calls to CounterBasedRandom can be inlined.
+        template <typename Random>
+        void prepareMutation(Genome* genome, Random& random, StructuralMutation& mutationOut) const;
+
+        // Perform structural mutations decided by prepareMutation(). This assigns new node/edge ids by the innovation counter.
+        void applyMutation(Genome* genome, const StructuralMutation& mutation, MutationOut& mutationOut) const;
+
+        // Reassign ids of newly added node and edges when there is an identical mutation in m_mutations.
+        // Otherwise, add the mutation to m_mutations.
+        void mergeIdenticalMutation(Genome* genome, const MutationOut& mutationOut);
+
         std::vector<MutationOut> m_mutations;
     };
 }
@@ -24,4 +24,5 @@ struct Activation
     const char* m_name;
     const Func m_func;
     ActivationId m_id = 0;
+    int m_type = -1;        // Type of predefined activation (ActivationFacotry::Type). Negative for user defined activations which can be evaluated only through m_func.
 };
@@ -0,0 +1,335 @@
+/*
+* ActivationKernels.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <EvoAlgo/EvoAlgo.h>
+#include <EvoAlgo/NeuralNetwork/Activations/ActivationKernels.h>
+#include <Common/Math/Simd/SseTypes.h>
+
+#ifdef USE_SSE
+
+//
+// SSE implementation
+//
+// Transcendental functions are polynomial approximations based on Cephes math library.
+// Their results can differ from the scalar versions by a few ulps.
+//
+
+namespace
+{
+    inline __m128 clampQuad(__m128 v)
+    {
+        // Order of operands matters here. NaN becomes s_floatHigh like the scalar version.
+        v = _mm_min_ps(v, _mm_set1_ps(ActivationKernels::s_floatHigh));
+        return _mm_max_ps(v, _mm_set1_ps(-ActivationKernels::s_floatHigh));
+    }
+
+    inline __m128 absQuad(__m128 v)
+    {
+        return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+    }
+
+    inline __m128 selectQuad(__m128 mask, __m128 a, __m128 b)
+    {
+        // Return a where mask is set and b otherwise.
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    // Calculate floor of v. Values whose absolute values are larger than 2^23 are integers already and returned as they are.
+    inline __m128 floorQuad(__m128 v, __m128i& intOut)
+    {
+        intOut = _mm_cvttps_epi32(v);
+        __m128 truncated = _mm_cvtepi32_ps(intOut);
+
+        // Truncation rounds toward zero. Subtract 1 for negative non integer values.
+        __m128 needsAdjust = _mm_cmpgt_ps(truncated, v);
+        intOut = _mm_add_epi32(intOut, _mm_castps_si128(needsAdjust));
+        __m128 floored = _mm_sub_ps(truncated, _mm_and_ps(needsAdjust, _mm_set1_ps(1.f)));
+
+        __m128 isLarge = _mm_cmpge_ps(absQuad(v), _mm_set1_ps(8388608.f));
+        return selectQuad(isLarge, v, floored);
+    }
+
+    inline __m128 expQuad(__m128 x)
+    {
+        const __m128 one = _mm_set1_ps(1.f);
+
+        x = _mm_min_ps(x, _mm_set1_ps(88.3762626647949f));
+        x = _mm_max_ps(x, _mm_set1_ps(-88.3762626647949f));
+
+        // Express exp(x) as exp(g + n*log(2)).
+        __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+        __m128i n;
+        fx = floorQuad(fx, n);
+
+        x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+        x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+
+        __m128 z = _mm_mul_ps(x, x);
+        __m128 y = _mm_set1_ps(1.9875691500E-4f);
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507E-3f));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073E-3f));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894E-2f));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459E-1f));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201E-1f));
+        y = _mm_add_ps(_mm_mul_ps(y, z), x);
+        y = _mm_add_ps(y, one);
+
+        // Build 2^n.
+        n = _mm_add_epi32(n, _mm_set1_epi32(0x7f));
+        n = _mm_slli_epi32(n, 23);
+        return _mm_mul_ps(y, _mm_castsi128_ps(n));
+    }
+
+    inline __m128 logQuad(__m128 x)
+    {
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 input = x;
+
+        // Keep only normalized positive numbers.
+        x = _mm_max_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x00800000)));
+
+        // Split x into exponent and mantissa in [0.5, 1).
+        __m128i exponent = _mm_srli_epi32(_mm_castps_si128(x), 23);
+        x = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(~0x7f800000)));
+        x = _mm_or_ps(x, _mm_set1_ps(0.5f));
+        exponent = _mm_sub_epi32(exponent, _mm_set1_epi32(0x7f));
+        __m128 e = _mm_add_ps(_mm_cvtepi32_ps(exponent), one);
+
+        __m128 mask = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+        __m128 tmp = _mm_and_ps(x, mask);
+        x = _mm_sub_ps(x, one);
+        e = _mm_sub_ps(e, _mm_and_ps(one, mask));
+        x = _mm_add_ps(x, tmp);
+
+        __m128 z = _mm_mul_ps(x, x);
+        __m128 y = _mm_set1_ps(7.0376836292E-2f);
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310E-1f));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.1676998740E-1f));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846E-1f));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.4249322787E-1f));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665E-1f));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(2.0000714765E-1f));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993E-1f));
+        y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(3.3333331174E-1f));
+        y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+        y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+        y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+        x = _mm_add_ps(x, y);
+        x = _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+
+        // Handle special inputs in the same way as logf.
+        const __m128 inf = _mm_set1_ps(INFINITY);
+        x = selectQuad(_mm_cmpeq_ps(input, inf), inf, x);
+        x = selectQuad(_mm_cmpeq_ps(input, _mm_setzero_ps()), _mm_set1_ps(-INFINITY), x);
+        x = _mm_or_ps(x, _mm_cmplt_ps(input, _mm_setzero_ps())); // NaN for negative values
+        x = _mm_or_ps(x, _mm_cmpunord_ps(input, input));          // NaN for NaN
+        return x;
+    }
+
+    // Calculate sin and cos of x at once. This is accurate only for |x| < 8192.
+    inline void sinCosQuad(__m128 x, __m128& sinOut, __m128& cosOut)
+    {
+        const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+        __m128 sinSign = _mm_and_ps(x, signMask);
+        x = absQuad(x);
+
+        // Scale by 4/Pi and get the octant.
+        __m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+        octant = _mm_add_epi32(octant, _mm_set1_epi32(1));
+        octant = _mm_and_si128(octant, _mm_set1_epi32(~1));
+        __m128 y = _mm_cvtepi32_ps(octant);
+
+        sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29)));
+        __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+        __m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_setzero_si128()));
+
+        // Extended precision modular arithmetic.
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+
+        __m128 z = _mm_mul_ps(x, x);
+
+        // Polynomial for cos in [-Pi/4, Pi/4].
+        __m128 c = _mm_set1_ps(2.443315711809948E-005f);
+        c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(-1.388731625493765E-003f));
+        c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(4.166664568298827E-002f));
+        c = _mm_mul_ps(_mm_mul_ps(c, z), z);
+        c = _mm_sub_ps(c, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+        c = _mm_add_ps(c, _mm_set1_ps(1.f));
+
+        // Polynomial for sin in [-Pi/4, Pi/4].
+        __m128 s = _mm_set1_ps(-1.9515295891E-4f);
+        s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(8.3321608736E-3f));
+        s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(-1.6666654611E-1f));
+        s = _mm_mul_ps(_mm_mul_ps(s, z), x);
+        s = _mm_add_ps(s, x);
+
+        sinOut = _mm_xor_ps(selectQuad(polyMask, s, c), sinSign);
+        cosOut = _mm_xor_ps(selectQuad(polyMask, c, s), cosSign);
+    }
+
+    inline __m128 tanhQuad(__m128 x)
+    {
+        const __m128 one = _mm_set1_ps(1.f);
+
+        // Polynomial for small values.
+        __m128 z = _mm_mul_ps(x, x);
+        __m128 p = _mm_set1_ps(-5.70498872745E-3f);
+        p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(2.06390887954E-2f));
+        p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(-5.37397155531E-2f));
+        p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(1.33314422036E-1f));
+        p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(-3.33332819422E-1f));
+        p = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, z), x), x);
+
+        // 1 - 2 / (exp(2x) + 1) for large values.
+        __m128 e = expQuad(_mm_add_ps(x, x));
+        __m128 l = _mm_sub_ps(one, _mm_div_ps(_mm_set1_ps(2.f), _mm_add_ps(e, one)));
+
+        return selectQuad(_mm_cmplt_ps(absQuad(x), _mm_set1_ps(0.625f)), p, l);
+    }
+
+    // Return true if sinCosQuad() can be used for all the values.
+    inline bool isInTrigonometricRange(__m128 x)
+    {
+        return _mm_movemask_ps(_mm_cmplt_ps(absQuad(x), _mm_set1_ps(8192.f))) == 0xf;
+    }
+
+    // Apply the same scalar activation to each of 4 values.
+    template <float (*Func)(float)>
+    inline __m128 scalarQuad(__m128 x)
+    {
+        ALIGN16(float values[4]);
+        _mm_store_ps(values, x);
+        return _mm_set_ps(Func(values[3]), Func(values[2]), Func(values[1]), Func(values[0]));
+    }
+
+    inline __m128 activateQuad(ActivationFacotry::Type type, __m128 x)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.f);
+
+        switch (type)
+        {
+        case ActivationFacotry::AF_SIGMOID:
+            return clampQuad(_mm_add_ps(one, expQuad(_mm_mul_ps(x, _mm_set1_ps(-4.9f)))));
+        case ActivationFacotry::AF_BIPOLAR_SIGMOID:
+        {
+            __m128 e = expQuad(_mm_sub_ps(zero, x));
+            return _mm_div_ps(clampQuad(_mm_sub_ps(one, e)), clampQuad(_mm_add_ps(one, e)));
+        }
+        case ActivationFacotry::AF_RELU:
+            return _mm_max_ps(x, zero);
+        case ActivationFacotry::AF_GAUSSIAN:
+            return clampQuad(_mm_sub_ps(zero, _mm_mul_ps(x, x)));
+        case ActivationFacotry::AF_ABSOLUTE:
+            return absQuad(x);
+        case ActivationFacotry::AF_SINE:
+        case ActivationFacotry::AF_COSINE:
+        case ActivationFacotry::AF_TANGENT:
+        {
+            if (!isInTrigonometricRange(x))
+            {
+                // Fall back to scalar functions for large values.
+                switch (type)
+                {
+                case ActivationFacotry::AF_SINE:    return scalarQuad<ActivationKernels::sine>(x);
+                case ActivationFacotry::AF_COSINE:  return scalarQuad<ActivationKernels::cosine>(x);
+                default:                            return scalarQuad<ActivationKernels::tangent>(x);
+                }
+            }
+
+            __m128 s, c;
+            sinCosQuad(x, s, c);
+            if (type == ActivationFacotry::AF_SINE) return s;
+            if (type == ActivationFacotry::AF_COSINE) return c;
+
+            const __m128 max = _mm_set1_ps(10000.0f);
+            __m128 t = _mm_div_ps(s, c);
+            t = _mm_max_ps(_mm_min_ps(t, max), _mm_sub_ps(zero, max));
+            return t;
+        }
+        case ActivationFacotry::AF_HYPERBOLIC_TANGENT:
+            return tanhQuad(x);
+        case ActivationFacotry::AF_RAMP:
+        {
+            __m128i i;
+            __m128 f = floorQuad(x, i);
+            return clampQuad(_mm_sub_ps(one, _mm_mul_ps(_mm_set1_ps(2.f), _mm_sub_ps(x, f))));
+        }
+        case ActivationFacotry::AF_STEP:
+        {
+            __m128i i;
+            floorQuad(x, i);
+            __m128 isOdd = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(i, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+            return selectQuad(isOdd, _mm_set1_ps(-1.f), one);
+        }
+        case ActivationFacotry::AF_SPIKE:
+        {
+            __m128i i;
+            __m128 f = floorQuad(x, i);
+            __m128 frac2 = _mm_mul_ps(_mm_set1_ps(2.f), _mm_sub_ps(x, f));
+            __m128 isOdd = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(i, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+            return clampQuad(selectQuad(isOdd, _mm_sub_ps(frac2, one), _mm_sub_ps(one, frac2)));
+        }
+        case ActivationFacotry::AF_INVERSE:
+            return clampQuad(_mm_div_ps(one, x));
+        case ActivationFacotry::AF_IDENTITY:
+            return x;
+        case ActivationFacotry::AF_CLAMPED:
+            return _mm_min_ps(_mm_max_ps(x, zero), one);
+        case ActivationFacotry::AF_LOGARITHMIC:
+            return clampQuad(logQuad(x));
+        case ActivationFacotry::AF_EXPONENTIAL:
+            return clampQuad(expQuad(x));
+        case ActivationFacotry::AF_HAT:
+        {
+            __m128 a = absQuad(x);
+            return selectQuad(_mm_cmplt_ps(a, one), _mm_sub_ps(one, a), zero);
+        }
+        case ActivationFacotry::AF_SQUARE:
+            return clampQuad(_mm_mul_ps(x, x));
+        case ActivationFacotry::AF_CUBE:
+            return clampQuad(_mm_mul_ps(_mm_mul_ps(x, x), x));
+        default:
+            assert(0);
+            return x;
+        }
+    }
+}
+
+void ActivationKernels::activate(Type type, const float* values, float* valuesOut, int numValues)
+{
+    int i = 0;
+    for (; i + 4 <= numValues; i += 4)
+    {
+        _mm_storeu_ps(&valuesOut[i], activateQuad(type, _mm_loadu_ps(&values[i])));
+    }
+
+    // Remainders.
+    for (; i < numValues; i++)
+    {
+        valuesOut[i] = activate(type, values[i]);
+    }
+}
+
+#else
+
+//
+// Non SSE implementation
+//
+
+void ActivationKernels::activate(Type type, const float* values, float* valuesOut, int numValues)
+{
+    for (int i = 0; i < numValues; i++)
+    {
+        valuesOut[i] = activate(type, values[i]);
+    }
+}
+
+#endif
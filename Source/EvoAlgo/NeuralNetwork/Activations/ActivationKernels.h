@@ -0,0 +1,99 @@
+/*
+* ActivationKernels.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <EvoAlgo/NeuralNetwork/Activations/ActivationFactory.h>
+
+#include <cmath>
+#include <algorithm>
+
+// Implementations of activation functions predefined in ActivationFacotry.
+// Activations are selected by their type instead of std::function so that they can be inlined and vectorized.
+class ActivationKernels
+{
+public:
+    using Type = ActivationFacotry::Type;
+
+    // Activate a single value by activation of the type.
+    static inline float activate(Type type, float value);
+
+    // Activate numValues values by activation of the type. values and valuesOut can be the same buffer.
+    // Values are processed 4 at once with SSE.
+    static void activate(Type type, const float* values, float* valuesOut, int numValues);
+
+    //
+    // Scalar implementations.
+    //
+
+    static inline float sigmoid(float val) { return clamp(1.f / 1.f + expf(-4.9f * val)); }
+    static inline float bipolarSigmoid(float val) { return clamp(1.f - expf(-val)) / clamp(1.f + expf(-val)); }
+    static inline float relu(float val) { return std::max(0.f, val); }
+    static inline float gaussian(float val) { return clamp(-val * val); }
+    static inline float absolute(float val) { return fabsf(val); }
+    static inline float sine(float val) { return sinf(val); }
+    static inline float cosine(float val) { return cosf(val); }
+    static inline float tangent(float val)
+    {
+        constexpr float max = 10000.0f;
+        val = tanf(val);
+        if (val < max && val > -max) return val;
+        else if (val >= max) return max;
+        else return -max;
+    }
+    static inline float hyperbolicTangent(float val) { return tanhf(val); }
+    static inline float ramp(float val) { return clamp(1.0f - 2.0f * (val - floorf(val))); }
+    static inline float step(float val) { return (int)floorf(val) % 2 ? -1.0f : 1.0f; }
+    static inline float spike(float val) { return clamp((int)floorf(val) % 2 ? -1.0f + 2.0f * (val - floorf(val)) : (1.f - 2.0f * (val - floorf(val)))); }
+    static inline float inverse(float val) { return clamp(1.0f / val); }
+    static inline float identity(float val) { return val; }
+    static inline float clamped(float val) { return val < 0.f ? 0.f : (val > 1.f ? 1.f : val); }
+    static inline float logarithmic(float val) { return clamp(logf(val)); }
+    static inline float exponential(float val) { return clamp(expf(val)); }
+    static inline float hat(float val)
+    {
+        float valAbs = fabsf(val);
+        return valAbs < 1.f ? 1 - valAbs : 0.f;
+    }
+    static inline float square(float val) { return clamp(val * val); }
+    static inline float cube(float val) { return clamp(val * val * val); }
+
+    // Maximum absolute value of outputs of activations which can grow infinitely.
+    static constexpr float s_floatHigh = 1E+10f;
+
+private:
+    static inline float clamp(float v) { return std::max(-s_floatHigh, std::min(s_floatHigh, v)); }
+};
+
+inline float ActivationKernels::activate(Type type, float value)
+{
+    switch (type)
+    {
+    case ActivationFacotry::AF_SIGMOID:             return sigmoid(value);
+    case ActivationFacotry::AF_BIPOLAR_SIGMOID:     return bipolarSigmoid(value);
+    case ActivationFacotry::AF_RELU:                return relu(value);
+    case ActivationFacotry::AF_GAUSSIAN:            return gaussian(value);
+    case ActivationFacotry::AF_ABSOLUTE:            return absolute(value);
+    case ActivationFacotry::AF_SINE:                return sine(value);
+    case ActivationFacotry::AF_COSINE:              return cosine(value);
+    case ActivationFacotry::AF_TANGENT:             return tangent(value);
+    case ActivationFacotry::AF_HYPERBOLIC_TANGENT:  return hyperbolicTangent(value);
+    case ActivationFacotry::AF_RAMP:                return ramp(value);
+    case ActivationFacotry::AF_STEP:                return step(value);
+    case ActivationFacotry::AF_SPIKE:               return spike(value);
+    case ActivationFacotry::AF_INVERSE:             return inverse(value);
+    case ActivationFacotry::AF_IDENTITY:            return identity(value);
+    case ActivationFacotry::AF_CLAMPED:             return clamped(value);
+    case ActivationFacotry::AF_LOGARITHMIC:         return logarithmic(value);
+    case ActivationFacotry::AF_EXPONENTIAL:         return exponential(value);
+    case ActivationFacotry::AF_HAT:                 return hat(value);
+    case ActivationFacotry::AF_SQUARE:              return square(value);
+    case ActivationFacotry::AF_CUBE:                return cube(value);
+    default:
+        assert(0);
+        return value;
+    }
+}
@@ -7,8 +7,11 @@
 #include <EvoAlgo/EvoAlgo.h>
 #include <EvoAlgo/NeuralNetwork/BakedNeuralNetwork.h>
 #include <EvoAlgo/NeuralNetwork/NeuralNetwork.h>
+#include <EvoAlgo/NeuralNetwork/CompiledNeuralNetwork.h>
+#include <Common/Math/Simd/SseTypes.h>
 
 #include <iostream>
+#include <algorithm>
 
 const std::function<float(float)> BakedNeuralNetwork::s_nullActivation = [](float val) { return val; };
 
@@ -106,6 +109,7 @@ BakedNeuralNetwork::BakedNeuralNetwork(const Network* network)
 
                     // Here, we store raw NodeId value for now. We will update it to index of m_nodes later in this function.
                     // This is needed because inNode might not be added to the list yet in the case of circular network.
+                    m_edgeIdIndexMap[incomingId] = (unsigned int)m_edges.size();
                     m_edges.push_back(Edge{ edge.getInNode().m_val, edge.getWeight() });
                 }
 
@@ -115,14 +119,17 @@ BakedNeuralNetwork::BakedNeuralNetwork(const Network* network)
                 {
                     // Get activation function.
                     ActivationFunc func;
+                    int type;
                     const Activation* activation = node.getActivation();
                     if (activation == nullptr)
                     {
                         func = &s_nullActivation;
+                        type = ActivationFacotry::AF_IDENTITY;
                     }
                     else
                     {
                         func = &activation->m_func;
+                        type = activation->m_type;
                     }
 
                     // Check if this activation has already appeared and if so set its index.
@@ -141,6 +148,7 @@ BakedNeuralNetwork::BakedNeuralNetwork(const Network* network)
                     {
                         entry.m_activationFunc = (unsigned short)m_activationFuncs.size();
                         m_activationFuncs.push_back(func);
+                        m_activationTypes.push_back(type);
                     }
                 }
 
@@ -162,6 +170,23 @@ BakedNeuralNetwork::BakedNeuralNetwork(const Network* network)
     {
         e.m_node = m_nodeIdIndexMap.at(NodeId(e.m_node));
     }
+
+    // Store indices of input and output nodes for batch evaluation.
+    {
+        const Network::NodeIds& inputNodes = network->getInputNodes();
+        m_inputNodeIndices.reserve(inputNodes.size());
+        for (NodeId inputNodeId : inputNodes)
+        {
+            auto itr = m_nodeIdIndexMap.find(inputNodeId);
+            m_inputNodeIndices.push_back(itr != m_nodeIdIndexMap.end() ? (int)itr->second : -1);
+        }
+
+        m_outputNodeIndices.reserve(outputNodes.size());
+        for (NodeId outputNodeId : outputNodes)
+        {
+            m_outputNodeIndices.push_back(m_nodeIdIndexMap.at(outputNodeId));
+        }
+    }
 }
 
 void BakedNeuralNetwork::setNodeValue(NodeId node, float value)
@@ -175,7 +200,7 @@ void BakedNeuralNetwork::setNodeValue(NodeId node, float value)
     assert(index >= 0 && index < (int)m_nodes.size());
 
     m_nodes[index].m_value = value;
-    m_nodes[index].m_activatedValue = (*m_activationFuncs[m_nodes[index].m_activationFunc])(value);
+    m_nodes[index].m_activatedValue = activate(m_nodes[index].m_activationFunc, value);
 }
 
 void BakedNeuralNetwork::clearNodeValues()
@@ -187,6 +212,20 @@ void BakedNeuralNetwork::clearNodeValues()
     }
 }
 
+bool BakedNeuralNetwork::setEdgeWeight(EdgeId edge, float weight)
+{
+    auto itr = m_edgeIdIndexMap.find(edge);
+    if (itr == m_edgeIdIndexMap.end())
+    {
+        // Edges with zero weight are not baked. We need to rebake only when the weight becomes non-zero.
+        return weight == 0.f;
+    }
+
+    // Zero weight doesn't break the order of evaluation, so we can just keep the edge.
+    m_edges[itr->second].m_weight = weight;
+    return true;
+}
+
 float BakedNeuralNetwork::getNodeValue(NodeId node) const
 {
     assert(m_nodeIdIndexMap.find(node) != m_nodeIdIndexMap.end());
@@ -219,8 +258,142 @@ void BakedNeuralNetwork::evaluate()
         }
 
         // Activate the value.
-        ActivationFunc activation = m_activationFuncs[node.m_activationFunc];
-        node.m_activatedValue = (*activation)(valueSum);
+        node.m_activatedValue = activate(node.m_activationFunc, valueSum);
         assert(!isnan(node.m_activatedValue) && !isinf(node.m_activatedValue));
     }
 }
+
+auto BakedNeuralNetwork::compile() const->std::shared_ptr<CompiledNeuralNetwork>
+{
+    return std::make_shared<CompiledNeuralNetwork>(*this);
+}
+
+void BakedNeuralNetwork::activate(unsigned short activationIndex, const float* values, float* valuesOut, int numValues) const
+{
+    const int type = m_activationTypes[activationIndex];
+    if (type >= 0)
+    {
+        // Use vectorized kernel for predefined activations.
+        ActivationKernels::activate((ActivationKernels::Type)type, values, valuesOut, numValues);
+        return;
+    }
+
+    // Fall back to std::function for user defined activations.
+    const ActivationFunc activation = m_activationFuncs[activationIndex];
+    for (int i = 0; i < numValues; i++)
+    {
+        valuesOut[i] = (*activation)(values[i]);
+    }
+}
+
+void BakedNeuralNetwork::evaluateBatch(const float* inputs, int numSamples, float* outputs, int numIterations) const
+{
+    assert(numSamples == 0 || (inputs && outputs));
+    assert(numIterations > 0);
+
+    if (!m_isCircularNetwork)
+    {
+        numIterations = 1;
+    }
+
+    const int numNodes = (int)m_nodes.size();
+    const int numInputs = getNumInputNodes();
+    const int numOutputs = getNumOutputNodes();
+
+    // Activated values of nodes in SoA layout. Each node has s_batchBlockSize lanes and one lane corresponds to one sample.
+    // The last row is used to accumulate incoming values of a node.
+    std::vector<float> values((numNodes + 1) * s_batchBlockSize);
+    float* sums = &values[numNodes * s_batchBlockSize];
+
+    // Process samples block by block so that values of all the nodes stay in cache.
+    for (int blockStart = 0; blockStart < numSamples; blockStart += s_batchBlockSize)
+    {
+        const int blockSize = std::min(s_batchBlockSize, numSamples - blockStart);
+        // Round up to multiple of 4 so that SIMD loops don't need remainder loops.
+        const int numLanes = (blockSize + 3) & ~3;
+
+        // Initialize node values.
+        for (int i = 0; i < numNodes; i++)
+        {
+            const Node& node = m_nodes[i];
+            float* row = &values[i * s_batchBlockSize];
+
+            // Nodes without incoming edges use their current value for all the samples. Others are cleared.
+            const float initialValue = node.m_numEdges == 0 ? activate(node.m_activationFunc, node.m_value) : 0.f;
+            std::fill(row, row + numLanes, initialValue);
+        }
+
+        // Set input values.
+        for (int k = 0; k < numInputs; k++)
+        {
+            const int nodeIndex = m_inputNodeIndices[k];
+            if (nodeIndex < 0)
+            {
+                continue;
+            }
+
+            float* row = &values[nodeIndex * s_batchBlockSize];
+            const float* in = &inputs[blockStart * numInputs + k];
+            for (int l = 0; l < blockSize; l++)
+            {
+                row[l] = in[l * numInputs];
+            }
+            activate(m_nodes[nodeIndex].m_activationFunc, row, row, blockSize);
+        }
+
+        for (int itr = 0; itr < numIterations; itr++)
+        {
+            // Evaluate nodes from start to end since they are already sorted in that way.
+            for (int i = 0; i < numNodes; i++)
+            {
+                const Node& node = m_nodes[i];
+                if (node.m_numEdges == 0)
+                {
+                    // Values of nodes without incoming edges never change.
+                    continue;
+                }
+
+                // Accumulate the values from incoming edges for all the lanes.
+                std::fill(sums, sums + numLanes, 0.f);
+                const Edge* edges = &m_edges[node.m_startEdge];
+                for (int j = 0; j < node.m_numEdges; j++)
+                {
+                    const Edge& edge = edges[j];
+                    const float* inRow = &values[edge.m_node * s_batchBlockSize];
+#ifdef USE_SSE
+                    const __m128 weight = _mm_set1_ps(edge.m_weight);
+                    for (int l = 0; l < numLanes; l += 4)
+                    {
+                        const __m128 v = _mm_mul_ps(_mm_loadu_ps(&inRow[l]), weight);
+                        _mm_storeu_ps(&sums[l], _mm_add_ps(_mm_loadu_ps(&sums[l]), v));
+                    }
+#else
+                    for (int l = 0; l < numLanes; l++)
+                    {
+                        sums[l] += inRow[l] * edge.m_weight;
+                    }
+#endif
+                }
+
+                // Activate the values.
+                float* row = &values[i * s_batchBlockSize];
+                activate(node.m_activationFunc, sums, row, numLanes);
+                for (int l = 0; l < numLanes; l++)
+                {
+                    assert(!isnan(row[l]) && !isinf(row[l]));
+                }
+            }
+        }
+
+        // Copy output values.
+        for (int k = 0; k < numOutputs; k++)
+        {
+            const float* row = &values[m_outputNodeIndices[k] * s_batchBlockSize];
+            float* out = &outputs[blockStart * numOutputs + k];
+            for (int l = 0; l < blockSize; l++)
+            {
+                out[l * numOutputs] = row[l];
+            }
+        }
+    }
+}
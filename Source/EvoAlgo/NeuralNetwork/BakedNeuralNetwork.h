@@ -7,13 +7,17 @@
 #pragma once
 
 #include <vector>
+#include <memory>
 #include <unordered_map>
 #include <EvoAlgo/NeuralNetwork/Node.h>
 #include <EvoAlgo/NeuralNetwork/Edge.h>
+#include <EvoAlgo/NeuralNetwork/Activations/ActivationKernels.h>
 
 template<typename Node, typename Edge>
 class NeuralNetwork;
 
+class CompiledNeuralNetwork;
+
 // Neural network whose structure is fixed but much faster to evaluate than general NeuralNetwork type.
 class BakedNeuralNetwork
 {
@@ -22,6 +26,7 @@ public:
     using ActivationFunc = const std::function<float(float)>*;
     using Network = NeuralNetwork<DefaultNode, DefaultEdge>;
     using NodeIdIndexMap = std::unordered_map<NodeId, unsigned int>;
+    using EdgeIdIndexMap = std::unordered_map<EdgeId, unsigned int>;
 
     // Constructors
     BakedNeuralNetwork(const Network* network);
@@ -36,13 +41,38 @@ public:
     // Set all node values to zero.
     void clearNodeValues();
 
+    // Update weight of an edge in place. Weight of a disabled edge should be zero.
+    // Return false if the edge is not a part of this network and it needs to be rebaked to reflect the new weight.
+    bool setEdgeWeight(EdgeId edge, float weight);
+
     // Evaluate this network.
     void evaluate();
 
+    // Evaluate this network for multiple samples at once.
+    // inputs has to contain numSamples * getNumInputNodes() values. Values of each sample are stored contiguously in the same order as input nodes of the original network.
+    // outputs receives numSamples * getNumOutputNodes() values in the same layout.
+    // Nodes which have no incoming edges other than input nodes (e.g. bias node) use their current values for all the samples.
+    // numIterations is the number of evaluations performed for each sample and it's used only for circular network.
+    void evaluateBatch(const float* inputs, int numSamples, float* outputs, int numIterations = 1) const;
+
+    // Return the number of input nodes of the original network.
+    inline int getNumInputNodes() const { return (int)m_inputNodeIndices.size(); }
+
+    // Return the number of output nodes of the original network.
+    inline int getNumOutputNodes() const { return (int)m_outputNodeIndices.size(); }
+
     // Return true if this network contains circular connections.
     inline bool isCircularNetwork() const { return m_isCircularNetwork; }
 
+    // Compile this network into a linear instruction tape which is even faster to evaluate.
+    auto compile() const->std::shared_ptr<CompiledNeuralNetwork>;
+
 private:
+    // Activate a single value by the activation at the index of m_activationFuncs.
+    inline float activate(unsigned short activationIndex, float value) const;
+
+    // Activate numValues values by the activation at the index of m_activationFuncs.
+    void activate(unsigned short activationIndex, const float* values, float* valuesOut, int numValues) const;
 
     // Node data
     struct Node
@@ -63,8 +93,27 @@ private:
     std::vector<Node> m_nodes;                      // List of nodes. They are sorted so that they can evaluate from the first node to the end without revisiting previous nodes.
     std::vector<Edge> m_edges;                      // List of edges in the order of their out nodes.
     std::vector<ActivationFunc> m_activationFuncs;  // List of activation functions.
+    std::vector<int> m_activationTypes;             // Types of activations in m_activationFuncs used for ActivationKernels. Negative if the activation is user defined.
     NodeIdIndexMap m_nodeIdIndexMap;                // Map from NodeId to index of m_nodes.
+    EdgeIdIndexMap m_edgeIdIndexMap;                // Map from EdgeId to index of m_edges.
+    std::vector<int> m_inputNodeIndices;            // Indices of m_nodes for input nodes in the same order as the original network. -1 if the node isn't connected to any output.
+    std::vector<int> m_outputNodeIndices;           // Indices of m_nodes for output nodes in the same order as the original network.
     const bool m_isCircularNetwork;                 // True if this network has any circular connections.
 
     static const std::function<float(float)> s_nullActivation;  // Null activation (activatedValue == value)
+    static constexpr int s_batchBlockSize = 256;                // The number of samples processed together in evaluateBatch(). Has to be multiple of 4.
+
+    friend class CompiledNeuralNetwork;
 };
+
+inline float BakedNeuralNetwork::activate(unsigned short activationIndex, float value) const
+{
+    const int type = m_activationTypes[activationIndex];
+    if (type >= 0)
+    {
+        // Call predefined activation directly instead of through std::function.
+        return ActivationKernels::activate((ActivationKernels::Type)type, value);
+    }
+
+    return (*m_activationFuncs[activationIndex])(value);
+}
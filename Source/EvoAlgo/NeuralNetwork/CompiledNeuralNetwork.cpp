@@ -0,0 +1,288 @@
+/*
+* CompiledNeuralNetwork.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <EvoAlgo/EvoAlgo.h>
+#include <EvoAlgo/NeuralNetwork/CompiledNeuralNetwork.h>
+
+#include <algorithm>
+
+CompiledNeuralNetwork::CompiledNeuralNetwork(const BakedNeuralNetwork& baked)
+    : m_isCircularNetwork(baked.m_isCircularNetwork)
+{
+    using BakedNode = BakedNeuralNetwork::Node;
+
+    const std::vector<BakedNode>& nodes = baked.m_nodes;
+    const std::vector<BakedNeuralNetwork::Edge>& edges = baked.m_edges;
+    const int numNodes = (int)nodes.size();
+
+    auto getActivation = [&baked](unsigned short index)
+    {
+        return ActivationEntry{ baked.m_activationTypes[index], baked.m_activationFuncs[index] };
+    };
+
+    // Find nodes which are connected to any output nodes. Other nodes are dead and stripped from the tape.
+    std::vector<bool> isAlive(numNodes, false);
+    {
+        std::vector<int> stack;
+        for (int index : baked.m_outputNodeIndices)
+        {
+            if (!isAlive[index])
+            {
+                isAlive[index] = true;
+                stack.push_back(index);
+            }
+        }
+
+        while (stack.size() > 0)
+        {
+            const BakedNode& node = nodes[stack.back()];
+            stack.pop_back();
+
+            for (int e = node.m_startEdge; e < node.m_startEdge + node.m_numEdges; e++)
+            {
+                const unsigned int inNode = edges[e].m_node;
+                if (!isAlive[inNode])
+                {
+                    isAlive[inNode] = true;
+                    stack.push_back(inNode);
+                }
+            }
+        }
+    }
+
+    // Index of m_values for each node of the baked network.
+    std::vector<int> slots(numNodes, -1);
+    int numSlots = 0;
+
+    auto isSourceNode = [&](int index) { return index >= 0 && isAlive[index] && nodes[index].m_numEdges == 0; };
+    auto addSourceSlot = [&](int index)
+    {
+        slots[index] = numSlots++;
+        m_sourceActivations.push_back(getActivation(nodes[index].m_activationFunc));
+    };
+
+    // Assign slots to source nodes. Input nodes come first in the same order as the original network.
+    for (int index : baked.m_inputNodeIndices)
+    {
+        if (isSourceNode(index) && slots[index] < 0)
+        {
+            addSourceSlot(index);
+        }
+    }
+    for (int i = 0; i < numNodes; i++)
+    {
+        if (isSourceNode(i) && slots[i] < 0)
+        {
+            addSourceSlot(i);
+        }
+    }
+
+    // Add a dummy slot for input nodes which are not connected to any outputs.
+    const int dummySlot = numSlots++;
+    m_sourceActivations.push_back(ActivationEntry{ ActivationFacotry::AF_IDENTITY, nullptr });
+    m_numSourceSlots = numSlots;
+
+    // Collect nodes to evaluate.
+    std::vector<int> order;
+    order.reserve(numNodes);
+    for (int i = 0; i < numNodes; i++)
+    {
+        if (isAlive[i] && nodes[i].m_numEdges > 0)
+        {
+            order.push_back(i);
+        }
+    }
+
+    if (!m_isCircularNetwork)
+    {
+        // Nodes at the same depth never depend on each other.
+        // Sort nodes by depth and then by activation so that nodes sharing the same activation form a single run.
+        // We cannot do this for circular network because changing the order of evaluation changes its result.
+        std::vector<int> depths(numNodes, 0);
+        for (int i : order)
+        {
+            const BakedNode& node = nodes[i];
+            int depth = 0;
+            for (int e = node.m_startEdge; e < node.m_startEdge + node.m_numEdges; e++)
+            {
+                depth = std::max(depth, depths[edges[e].m_node] + 1);
+            }
+            depths[i] = depth;
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+            {
+                if (depths[a] != depths[b])
+                {
+                    return depths[a] < depths[b];
+                }
+                return nodes[a].m_activationFunc < nodes[b].m_activationFunc;
+            });
+    }
+
+    // Assign slots to evaluated nodes in the order of evaluation.
+    for (int i : order)
+    {
+        slots[i] = numSlots++;
+    }
+
+    // Build the tape.
+    m_numEdges.reserve(order.size());
+    m_edgeSources.reserve(edges.size());
+    m_edgeWeights.reserve(edges.size());
+
+    int runStartSlot = 0;
+    int maxRunSize = 0;
+    for (int i : order)
+    {
+        const BakedNode& node = nodes[i];
+        const int slot = slots[i];
+        const ActivationEntry activation = getActivation(node.m_activationFunc);
+
+        // Start a new run when activation changes or the node depends on another node in the current run.
+        bool startNewRun = m_runs.empty() ||
+            m_runs.back().m_activation.m_type != activation.m_type || m_runs.back().m_activation.m_func != activation.m_func;
+
+        for (int e = node.m_startEdge; e < node.m_startEdge + node.m_numEdges; e++)
+        {
+            const int inSlot = slots[edges[e].m_node];
+            assert(inSlot >= 0);
+
+            if (inSlot >= runStartSlot && inSlot < slot)
+            {
+                startNewRun = true;
+            }
+
+            m_edgeSources.push_back(inSlot);
+            m_edgeWeights.push_back(edges[e].m_weight);
+        }
+
+        if (startNewRun)
+        {
+            m_runs.push_back(Run{ 0, activation });
+            runStartSlot = slot;
+        }
+
+        m_runs.back().m_numNodes++;
+        maxRunSize = std::max(maxRunSize, m_runs.back().m_numNodes);
+        m_numEdges.push_back(node.m_numEdges);
+    }
+
+    m_sums.resize(maxRunSize);
+
+    // Initialize values by the current values of the baked network.
+    m_values.resize(numSlots, 0.f);
+    for (int i = 0; i < numNodes; i++)
+    {
+        if (slots[i] < 0)
+        {
+            continue;
+        }
+
+        const BakedNode& node = nodes[i];
+        m_values[slots[i]] = node.m_numEdges == 0 ? baked.activate(node.m_activationFunc, node.m_value) : node.m_activatedValue;
+    }
+
+    // Set up inputs and outputs.
+    m_inputSlots.reserve(baked.m_inputNodeIndices.size());
+    for (int index : baked.m_inputNodeIndices)
+    {
+        m_inputSlots.push_back(isSourceNode(index) ? slots[index] : dummySlot);
+    }
+
+    m_outputSlots.reserve(baked.m_outputNodeIndices.size());
+    for (int index : baked.m_outputNodeIndices)
+    {
+        m_outputSlots.push_back(slots[index]);
+    }
+
+    // Remember NodeIds of source nodes so that their values can be updated.
+    for (const auto& elem : baked.m_nodeIdIndexMap)
+    {
+        const int slot = slots[elem.second];
+        if (slot >= 0 && slot < dummySlot)
+        {
+            m_sourceSlots[elem.first] = slot;
+        }
+    }
+}
+
+void CompiledNeuralNetwork::setNodeValue(NodeId node, float value)
+{
+    auto itr = m_sourceSlots.find(node);
+    if (itr == m_sourceSlots.end())
+    {
+        return;
+    }
+
+    const int slot = itr->second;
+    m_values[slot] = activate(m_sourceActivations[slot], value);
+}
+
+void CompiledNeuralNetwork::clearNodeValues()
+{
+    // Source nodes are activated with zero value when they are evaluated in BakedNeuralNetwork.
+    for (int i = 0; i < m_numSourceSlots; i++)
+    {
+        m_values[i] = activate(m_sourceActivations[i], 0.f);
+    }
+
+    std::fill(m_values.begin() + m_numSourceSlots, m_values.end(), 0.f);
+}
+
+void CompiledNeuralNetwork::evaluate(const float* inputs, float* outputs)
+{
+    float* values = m_values.data();
+
+    // Set input values.
+    for (int i = 0; i < (int)m_inputSlots.size(); i++)
+    {
+        const int slot = m_inputSlots[i];
+        values[slot] = activate(m_sourceActivations[slot], inputs[i]);
+    }
+
+    // Run the tape.
+    const unsigned short* numEdges = m_numEdges.data();
+    const unsigned int* edgeSources = m_edgeSources.data();
+    const float* edgeWeights = m_edgeWeights.data();
+    float* sums = m_sums.data();
+    float* out = values + m_numSourceSlots;
+
+    for (const Run& run : m_runs)
+    {
+        // Accumulate incoming values of all the nodes in the run.
+        for (int i = 0; i < run.m_numNodes; i++)
+        {
+            float sum = 0.f;
+            for (int e = 0, n = *numEdges++; e < n; e++)
+            {
+                sum += values[*edgeSources++] * *edgeWeights++;
+            }
+            sums[i] = sum;
+        }
+
+        // Activate them at once.
+        if (run.m_activation.m_type >= 0)
+        {
+            ActivationKernels::activate((ActivationKernels::Type)run.m_activation.m_type, sums, out, run.m_numNodes);
+        }
+        else
+        {
+            for (int i = 0; i < run.m_numNodes; i++)
+            {
+                out[i] = (*run.m_activation.m_func)(sums[i]);
+            }
+        }
+
+        out += run.m_numNodes;
+    }
+
+    // Copy output values.
+    for (int i = 0; i < (int)m_outputSlots.size(); i++)
+    {
+        outputs[i] = values[m_outputSlots[i]];
+    }
+}
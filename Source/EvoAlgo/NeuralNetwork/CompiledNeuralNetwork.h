@@ -0,0 +1,90 @@
+/*
+* CompiledNeuralNetwork.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <EvoAlgo/NeuralNetwork/BakedNeuralNetwork.h>
+
+// Neural network compiled from BakedNeuralNetwork into a linear instruction tape.
+// Nodes are evaluated in runs which share the same activation and edge weights are stored contiguously in the order of evaluation.
+// Neither structure nor weights can be changed after compilation. This is the fastest way to evaluate a single sample.
+class CompiledNeuralNetwork
+{
+public:
+    // Type definition
+    using ActivationFunc = BakedNeuralNetwork::ActivationFunc;
+
+    // Constructor
+    CompiledNeuralNetwork(const BakedNeuralNetwork& baked);
+
+    // Set value of a node which doesn't have any incoming edges such as bias node.
+    // Values of input nodes should be passed to evaluate() instead.
+    void setNodeValue(NodeId node, float value);
+
+    // Clear all node values in the same way as BakedNeuralNetwork::clearNodeValues().
+    void clearNodeValues();
+
+    // Evaluate this network.
+    // inputs has to contain getNumInputNodes() values sorted in the same order as input nodes of the original network.
+    // outputs receives getNumOutputNodes() values sorted in the same order as output nodes of the original network.
+    void evaluate(const float* inputs, float* outputs);
+
+    // Return the number of input nodes of the original network.
+    inline int getNumInputNodes() const { return (int)m_inputSlots.size(); }
+
+    // Return the number of output nodes of the original network.
+    inline int getNumOutputNodes() const { return (int)m_outputSlots.size(); }
+
+    // Return the number of nodes evaluated by the tape.
+    inline int getNumEvaluatedNodes() const { return (int)m_numEdges.size(); }
+
+    // Return the number of runs in the tape.
+    inline int getNumRuns() const { return (int)m_runs.size(); }
+
+    // Return true if this network contains circular connections.
+    inline bool isCircularNetwork() const { return m_isCircularNetwork; }
+
+private:
+    // Activation of nodes.
+    struct ActivationEntry
+    {
+        int m_type;                         // Type of activation for ActivationKernels. Negative if the activation is user defined.
+        ActivationFunc m_func;              // Activation function used when m_type is negative.
+    };
+
+    // Run of nodes which share the same activation and don't depend on each other.
+    struct Run
+    {
+        int m_numNodes;                     // The number of nodes in this run.
+        ActivationEntry m_activation;       // Activation of the nodes.
+    };
+
+    // Activate a single value.
+    static inline float activate(const ActivationEntry& activation, float value);
+
+    std::vector<float> m_values;                    // Activated values of all the nodes. Nodes without incoming edges (sources) come first followed by nodes evaluated by the tape.
+    std::vector<ActivationEntry> m_sourceActivations; // Activations of source nodes.
+    std::vector<float> m_sums;                      // Buffer to accumulate incoming values for nodes in a run.
+    std::vector<Run> m_runs;                        // The tape. Runs are evaluated from the first to the last.
+    std::vector<unsigned short> m_numEdges;         // The number of incoming edges of each evaluated node.
+    std::vector<unsigned int> m_edgeSources;        // Index of m_values for in node of each edge in the order of evaluation.
+    std::vector<float> m_edgeWeights;               // Weight of each edge in the order of evaluation.
+    std::vector<int> m_inputSlots;                  // Index of m_values for each input node. Input nodes not connected to any output point to a dummy slot.
+    std::vector<int> m_outputSlots;                 // Index of m_values for each output node.
+    BakedNeuralNetwork::NodeIdIndexMap m_sourceSlots; // Map from NodeId to index of m_values for source nodes.
+    int m_numSourceSlots;                           // The number of source slots including the dummy slot.
+    bool m_isCircularNetwork;                       // True if this network has any circular connections.
+};
+
+inline float CompiledNeuralNetwork::activate(const ActivationEntry& activation, float value)
+{
+    if (activation.m_type >= 0)
+    {
+        return ActivationKernels::activate((ActivationKernels::Type)activation.m_type, value);
+    }
+
+    return (*activation.m_func)(value);
+}
@@ -52,7 +52,7 @@ FeedForwardNetwork<Node, Edge>::FeedForwardNetwork(const Nodes& nodes, const Edg
 template <typename Node, typename Edge>
 auto FeedForwardNetwork<Node, Edge>::clone() const->std::shared_ptr<NeuralNetwork<Node, Edge>>
 {
-    return std::make_shared<FeedForwardNetwork<Node, Edge>>(*this);
+    return LinearArena::makeShared<FeedForwardNetwork<Node, Edge>>(*this);
 }
 
 template <typename Node, typename Edge>
@@ -13,10 +13,15 @@
 #include <memory>
 
 #include <Common/BaseType.h>
+#include <Common/SortedIdMap.h>
+#include <Common/LinearArena.h>
 #include <EvoAlgo/NeuralNetwork/Node.h>
 #include <EvoAlgo/NeuralNetwork/Edge.h>
 #include <EvoAlgo/NeuralNetwork/BakedNeuralNetwork.h>
 
+// Uncomment this to store nodes and edges of NeuralNetwork in hash maps instead of sorted arrays.
+//#define NEURAL_NETWORK_USE_HASH_MAP
+
 // Type of neural network
 enum class NeuralNetworkType
 {
@@ -70,9 +75,19 @@ public:
         friend class NeuralNetwork;
     };
 
-    using NodeDatas = std::unordered_map<NodeId, NodeData>;
-    using Edges = std::unordered_map<EdgeId, Edge>;
-    using Nodes = std::unordered_map<NodeId, Node>;
+    // Container of nodes and edges.
+    // Sorted arrays are used by default so that copying a network is just copying a few arrays.
+#ifdef NEURAL_NETWORK_USE_HASH_MAP
+    template <typename Key, typename Value>
+    using IdMap = std::unordered_map<Key, Value>;
+#else
+    template <typename Key, typename Value>
+    using IdMap = SortedIdMap<Key, Value>;
+#endif
+
+    using NodeDatas = IdMap<NodeId, NodeData>;
+    using Edges = IdMap<EdgeId, Edge>;
+    using Nodes = IdMap<NodeId, Node>;
 
     //
     // Constructors
@@ -255,7 +270,7 @@ NeuralNetwork<Node, Edge>::NeuralNetwork(const Nodes& nodes, const Edges& edges,
 template <typename Node, typename Edge>
 auto NeuralNetwork<Node, Edge>::clone() const->std::shared_ptr<NeuralNetwork<Node, Edge>>
 {
-    return std::make_shared<NeuralNetwork>(*this);
+    return LinearArena::makeShared<NeuralNetwork>(*this);
 }
 
 template <typename Node, typename Edge>
@@ -711,8 +726,10 @@ void NeuralNetwork<Node, Edge>::replaceEdgeId(EdgeId edgeId, EdgeId newId)
     }
 
     // Replace the edge id.
-    m_edges[newId] = m_edges[edgeId];
+    // Copy the edge first since inserting a new edge can invalidate references to existing edges.
+    const Edge edgeCopy = edge;
     m_edges.erase(edgeId);
+    m_edges.insert({ newId, edgeCopy });
 
     assert(validate());
 }
@@ -813,7 +830,7 @@ void NeuralNetwork<Node, Edge>::evaluate()
 template <typename Node, typename Edge>
 auto NeuralNetwork<Node, Edge>::bake() const->std::shared_ptr<BakedNeuralNetwork>
 {
-    return std::make_shared<BakedNeuralNetwork>(this);
+    return LinearArena::makeShared<BakedNeuralNetwork>(this);
 }
 
 template <typename Node, typename Edge>
@@ -24,9 +24,9 @@ public:
         switch (type)
         {
         case NeuralNetworkType::FEED_FORWARD:
-            return std::make_shared<FeedForwardNetwork<Node, Edge>>(nodes, edges, inputNodes, outputNodes);
+            return LinearArena::makeShared<FeedForwardNetwork<Node, Edge>>(nodes, edges, inputNodes, outputNodes);
         default:
-            return std::make_shared<NeuralNetwork<Node, Edge>>(nodes, edges, inputNodes, outputNodes);
+            return LinearArena::makeShared<NeuralNetwork<Node, Edge>>(nodes, edges, inputNodes, outputNodes);
         }
     }
 };
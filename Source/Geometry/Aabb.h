@@ -0,0 +1,81 @@
+/*
+* Aabb.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <Common/Math/Vector4.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Axis aligned bounding box.
+struct Aabb
+{
+    Vector4 m_min;  // The minimum corner.
+    Vector4 m_max;  // The maximum corner.
+
+    // Set a box covering the whole space.
+    inline void setInfinite()
+    {
+        const float inf = std::numeric_limits<float>::max();
+        m_min = Vector4(-inf, -inf, -inf);
+        m_max = Vector4(inf, inf, inf);
+    }
+
+    // Set the smallest box enclosing two points.
+    inline void set(const Vector4& a, const Vector4& b)
+    {
+        m_min = Vector4(std::min(a(0), b(0)), std::min(a(1), b(1)), std::min(a(2), b(2)));
+        m_max = Vector4(std::max(a(0), b(0)), std::max(a(1), b(1)), std::max(a(2), b(2)));
+    }
+
+    // Enlarge this box to enclose the point.
+    inline void include(const Vector4& point)
+    {
+        m_min = Vector4(std::min(m_min(0), point(0)), std::min(m_min(1), point(1)), std::min(m_min(2), point(2)));
+        m_max = Vector4(std::max(m_max(0), point(0)), std::max(m_max(1), point(1)), std::max(m_max(2), point(2)));
+    }
+
+    // Enlarge this box by margin in all directions.
+    inline void expand(float margin)
+    {
+        const Vector4 extent(margin, margin, margin);
+        m_min -= extent;
+        m_max += extent;
+    }
+
+    // Return true if this box overlaps with the other box. Touching boxes are overlapping.
+    inline bool overlaps(const Aabb& other) const
+    {
+        return m_min(0) <= other.m_max(0) && other.m_min(0) <= m_max(0)
+            && m_min(1) <= other.m_max(1) && other.m_min(1) <= m_max(1)
+            && m_min(2) <= other.m_max(2) && other.m_min(2) <= m_max(2);
+    }
+
+    // Return true if the point is inside this box. Points on the boundary are inside.
+    inline bool contains(const Vector4& point) const
+    {
+        return m_min(0) <= point(0) && point(0) <= m_max(0)
+            && m_min(1) <= point(1) && point(1) <= m_max(1)
+            && m_min(2) <= point(2) && point(2) <= m_max(2);
+    }
+
+    // Return distance from the point to this box. Zero if the point is inside.
+    inline float getDistance(const Vector4& point) const
+    {
+        float distSq = 0.f;
+        for (int i = 0; i < 3; i++)
+        {
+            const float d = std::max(std::max(m_min(i) - point(i), point(i) - m_max(i)), 0.f);
+            distSq += d * d;
+        }
+        return std::sqrt(distSq);
+    }
+
+    // Return true if the two boxes are exactly the same.
+    inline bool exactEquals(const Aabb& other) const { return m_min.exactEquals<3>(other.m_min) && m_max.exactEquals<3>(other.m_max); }
+};
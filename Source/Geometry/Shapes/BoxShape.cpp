@@ -0,0 +1,164 @@
+/*
+* BoxShape.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <Geometry/Geometry.h>
+#include <Geometry/Shapes/BoxShape.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+BoxShape::BoxShape(const Vector4& center, const Vector4& halfExtents, const Matrix33& rotation)
+    : m_center(center)
+    , m_rotation(rotation)
+{
+    setHalfExtents(halfExtents);
+}
+
+auto BoxShape::toLocal(const Vector4& position) const->Vector4
+{
+    const Vector4 d = position - m_center;
+    return Vector4(
+        d.dot<3>(m_rotation.getColumn<0>()),
+        d.dot<3>(m_rotation.getColumn<1>()),
+        d.dot<3>(m_rotation.getColumn<2>()));
+}
+
+void BoxShape::getClosestFace(const Vector4& localPosition, int& axisOut, float& signOut) const
+{
+    float minDistance = std::numeric_limits<float>::max();
+    for (int i = 0; i < 3; i++)
+    {
+        const float distance = m_halfExtents(i) - std::fabs(localPosition(i));
+        if (distance < minDistance)
+        {
+            minDistance = distance;
+            axisOut = i;
+            signOut = localPosition(i) < 0.f ? -1.f : 1.f;
+        }
+    }
+}
+
+void BoxShape::castRay(const Vector4& start, const Vector4& end, RayCastOutput& out) const
+{
+    const Vector4 localStart = toLocal(start);
+    const Vector4 localEnd = toLocal(end);
+
+    // Check if the start is inside the box.
+    if (std::fabs(localStart(0)) <= m_halfExtents(0) && std::fabs(localStart(1)) <= m_halfExtents(1) && std::fabs(localStart(2)) <= m_halfExtents(2))
+    {
+        int axis;
+        float sign;
+        getClosestFace(localStart, axis, sign);
+
+        out.m_hit = true;
+        out.m_fraction = 0.f;
+        out.m_hitPoint = start;
+        out.m_hitNormal = m_rotation.getColumn(axis) * SimdFloat(sign);
+        return;
+    }
+
+    // Clip the ray by slabs of the box.
+    float tMin = 0.f;
+    float tMax = 1.f;
+    int hitAxis = -1;
+    float hitSign = 1.f;
+    for (int i = 0; i < 3; i++)
+    {
+        const float s = localStart(i);
+        const float d = localEnd(i) - s;
+        const float h = m_halfExtents(i);
+        if (d == 0.f)
+        {
+            if (std::fabs(s) > h)
+            {
+                out.m_hit = false;
+                return;
+            }
+            continue;
+        }
+
+        float t0 = (-h - s) / d;
+        float t1 = (h - s) / d;
+        float sign = -1.f;
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+            sign = 1.f;
+        }
+
+        if (t0 > tMin)
+        {
+            tMin = t0;
+            hitAxis = i;
+            hitSign = sign;
+        }
+        tMax = std::min(tMax, t1);
+        if (tMin > tMax)
+        {
+            out.m_hit = false;
+            return;
+        }
+    }
+
+    // The start is outside, so the ray enters through one of the slabs.
+    assert(hitAxis >= 0);
+    out.m_hit = true;
+    out.m_fraction = tMin;
+    out.m_hitPoint = start + (end - start) * SimdFloat(tMin);
+    out.m_hitNormal = m_rotation.getColumn(hitAxis) * SimdFloat(hitSign);
+}
+
+void BoxShape::getClosestPoint(const Vector4& position, ClosestPointOutput& out) const
+{
+    const Vector4 localPosition = toLocal(position);
+
+    // Clamp the position into the box.
+    Vector4 localClosest = localPosition;
+    bool isInside = true;
+    for (int i = 0; i < 3; i++)
+    {
+        const float h = m_halfExtents(i);
+        if (std::fabs(localPosition(i)) > h)
+        {
+            localClosest(i) = localPosition(i) < 0.f ? -h : h;
+            isInside = false;
+        }
+    }
+
+    if (isInside)
+    {
+        // Push the position out through the closest face.
+        int axis;
+        float sign;
+        getClosestFace(localPosition, axis, sign);
+        localClosest(axis) = sign * m_halfExtents(axis);
+        out.m_closestPoint = m_center + m_rotation * localClosest;
+        out.m_normal = m_rotation.getColumn(axis) * SimdFloat(sign);
+        return;
+    }
+
+    out.m_closestPoint = m_center + m_rotation * localClosest;
+    out.m_normal = position - out.m_closestPoint;
+    out.m_normal.setComponent<3>(SimdFloat_0);
+    out.m_normal.normalize<3>();
+}
+
+void BoxShape::getAabb(Aabb& aabbOut) const
+{
+    // Extent along each world axis is the sum of absolute projections of local axes.
+    Vector4 extent = Vec4_0;
+    for (int i = 0; i < 3; i++)
+    {
+        Vector4 axis;
+        axis.setAbs(m_rotation.getColumn(i));
+        extent += axis * SimdFloat(m_halfExtents(i));
+    }
+    extent.setComponent<3>(SimdFloat_0);
+
+    aabbOut.m_min = m_center - extent;
+    aabbOut.m_max = m_center + extent;
+}
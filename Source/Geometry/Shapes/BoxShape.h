@@ -0,0 +1,53 @@
+/*
+* BoxShape.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <Geometry/Shapes/Shape.h>
+#include <Common/Math/Vector4.h>
+#include <Common/Math/Matrix33.h>
+
+// Oriented box shape.
+class BoxShape : public Shape
+{
+public:
+    //
+    // Constructors
+    //
+    // rotation has local axes of the box in its columns. They have to be orthonormal.
+    BoxShape(const Vector4& center, const Vector4& halfExtents, const Matrix33& rotation = Mat33_I);
+
+    //
+    // Accessors to the transform and size.
+    //
+    inline void setCenter(const Vector4& center) { m_center = center; }
+    inline auto getCenter() const->const Vector4& { return m_center; }
+    inline void setHalfExtents(const Vector4& halfExtents) { assert(halfExtents(0) > 0.f && halfExtents(1) > 0.f && halfExtents(2) > 0.f); m_halfExtents = halfExtents; }
+    inline auto getHalfExtents() const->const Vector4& { return m_halfExtents; }
+    inline void setRotation(const Matrix33& rotation) { m_rotation = rotation; }
+    inline auto getRotation() const->const Matrix33& { return m_rotation; }
+
+    //
+    // Query interface
+    //
+    virtual void castRay(const Vector4& start, const Vector4& end, RayCastOutput& out) const override;
+    virtual void getClosestPoint(const Vector4& position, ClosestPointOutput& out) const override;
+    virtual void getAabb(Aabb& aabbOut) const override;
+
+    // Box has interior, so return true.
+    virtual bool hasInterior() const override { return true; }
+
+protected:
+    // Transform the position from world space to local space of the box.
+    auto toLocal(const Vector4& position) const->Vector4;
+
+    // Return the face closest to the local position inside the box. The face is represented by axis and sign.
+    void getClosestFace(const Vector4& localPosition, int& axisOut, float& signOut) const;
+
+    Vector4 m_center;       // Center of the box.
+    Vector4 m_halfExtents;  // Half of size of the box along each local axis.
+    Matrix33 m_rotation;    // Local axes of the box.
+};
@@ -0,0 +1,139 @@
+/*
+* CapsuleShape.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <Geometry/Geometry.h>
+#include <Geometry/Shapes/CapsuleShape.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+CapsuleShape::CapsuleShape(const Vector4& vertexA, const Vector4& vertexB, float radius)
+    : m_vertexA(vertexA)
+    , m_vertexB(vertexB)
+    , m_radius(radius)
+{
+    assert(radius > 0.f);
+}
+
+auto CapsuleShape::getClosestPointOnSegment(const Vector4& position) const->Vector4
+{
+    const Vector4 axis = m_vertexB - m_vertexA;
+    const float axisLengthSq = axis.lengthSq<3>().getFloat();
+    if (axisLengthSq <= 0.f)
+    {
+        return m_vertexA;
+    }
+
+    const float t = std::min(std::max((position - m_vertexA).dot<3>(axis).getFloat() / axisLengthSq, 0.f), 1.f);
+    return m_vertexA + SimdFloat(t) * axis;
+}
+
+auto CapsuleShape::getNormal(const Vector4& position, const Vector4& pointOnSegment) const->Vector4
+{
+    Vector4 normal = position - pointOnSegment;
+    normal.setComponent<3>(SimdFloat_0);
+    if (normal.lengthSq<3>().getFloat() > std::numeric_limits<float>::epsilon())
+    {
+        normal.normalize<3>();
+        return normal;
+    }
+
+    // The position is on the segment. Pick any direction perpendicular to the axis.
+    const Vector4 axis = m_vertexB - m_vertexA;
+    normal = Vector4::cross(axis, std::fabs(axis(0)) < std::fabs(axis(1)) ? Vec4_1000 : Vec4_0100);
+    if (normal.lengthSq<3>().getFloat() <= std::numeric_limits<float>::epsilon())
+    {
+        return Vec4_0100;
+    }
+    normal.normalize<3>();
+    return normal;
+}
+
+void CapsuleShape::castRay(const Vector4& start, const Vector4& end, RayCastOutput& out) const
+{
+    const float radSq = m_radius * m_radius;
+
+    // Check if the start is inside the capsule.
+    const Vector4 startOnSegment = getClosestPointOnSegment(start);
+    if ((start - startOnSegment).lengthSq<3>().getFloat() <= radSq)
+    {
+        out.m_hit = true;
+        out.m_fraction = 0.f;
+        out.m_hitPoint = start;
+        out.m_hitNormal = getNormal(start, startOnSegment);
+        return;
+    }
+
+    const Vector4 ray = end - start;
+    const Vector4 axis = m_vertexB - m_vertexA;
+    const Vector4 toStart = start - m_vertexA;
+    float minFraction = std::numeric_limits<float>::max();
+
+    // Intersect with the side of the cylinder. Solve |x(t) - axis * s(t)|^2 = r^2 for the component of the ray perpendicular to the axis.
+    const float axisLengthSq = axis.lengthSq<3>().getFloat();
+    if (axisLengthSq > 0.f)
+    {
+        const float rayDotAxis = ray.dot<3>(axis).getFloat();
+        const float startDotAxis = toStart.dot<3>(axis).getFloat();
+        const float a = ray.lengthSq<3>().getFloat() - rayDotAxis * rayDotAxis / axisLengthSq;
+        const float b = ray.dot<3>(toStart).getFloat() - rayDotAxis * startDotAxis / axisLengthSq;
+        const float c = toStart.lengthSq<3>().getFloat() - startDotAxis * startDotAxis / axisLengthSq - radSq;
+        const float discriminant = b * b - a * c;
+        if (a > 0.f && discriminant >= 0.f)
+        {
+            const float t = (-b - std::sqrt(discriminant)) / a;
+            const float s = (startDotAxis + t * rayDotAxis) / axisLengthSq;
+            if (t >= 0.f && t <= 1.f && s >= 0.f && s <= 1.f)
+            {
+                minFraction = t;
+            }
+        }
+    }
+
+    // Intersect with spheres at both ends.
+    for (const Vector4* center : { &m_vertexA, &m_vertexB })
+    {
+        const Vector4 toStartFromCenter = start - *center;
+        const float a = ray.lengthSq<3>().getFloat();
+        const float b = ray.dot<3>(toStartFromCenter).getFloat();
+        const float c = toStartFromCenter.lengthSq<3>().getFloat() - radSq;
+        const float discriminant = b * b - a * c;
+        if (a > 0.f && discriminant >= 0.f)
+        {
+            const float t = (-b - std::sqrt(discriminant)) / a;
+            if (t >= 0.f && t <= 1.f)
+            {
+                minFraction = std::min(minFraction, t);
+            }
+        }
+    }
+
+    if (minFraction > 1.f)
+    {
+        // The ray missed
+        out.m_hit = false;
+        return;
+    }
+
+    out.m_hit = true;
+    out.m_fraction = minFraction;
+    out.m_hitPoint = start + SimdFloat(minFraction) * ray;
+    out.m_hitNormal = getNormal(out.m_hitPoint, getClosestPointOnSegment(out.m_hitPoint));
+}
+
+void CapsuleShape::getClosestPoint(const Vector4& position, ClosestPointOutput& out) const
+{
+    const Vector4 pointOnSegment = getClosestPointOnSegment(position);
+    out.m_normal = getNormal(position, pointOnSegment);
+    out.m_closestPoint = pointOnSegment + SimdFloat(m_radius) * out.m_normal;
+}
+
+void CapsuleShape::getAabb(Aabb& aabbOut) const
+{
+    aabbOut.set(m_vertexA, m_vertexB);
+    aabbOut.expand(m_radius);
+}
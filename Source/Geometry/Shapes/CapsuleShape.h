@@ -0,0 +1,50 @@
+/*
+* CapsuleShape.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <Geometry/Shapes/Shape.h>
+#include <Common/Math/Vector4.h>
+
+// Capsule shape which is a set of points within radius from the segment between two vertices.
+class CapsuleShape : public Shape
+{
+public:
+    //
+    // Constructors
+    //
+    CapsuleShape(const Vector4& vertexA, const Vector4& vertexB, float radius);
+
+    //
+    // Accessors to the vertices and radius.
+    //
+    inline void setVertices(const Vector4& vertexA, const Vector4& vertexB) { m_vertexA = vertexA; m_vertexB = vertexB; }
+    inline auto getVertexA() const->const Vector4& { return m_vertexA; }
+    inline auto getVertexB() const->const Vector4& { return m_vertexB; }
+    inline void setRadius(float radius) { assert(radius > 0.f); m_radius = radius; }
+    inline float getRadius() const { return m_radius; }
+
+    //
+    // Query interface
+    //
+    virtual void castRay(const Vector4& start, const Vector4& end, RayCastOutput& out) const override;
+    virtual void getClosestPoint(const Vector4& position, ClosestPointOutput& out) const override;
+    virtual void getAabb(Aabb& aabbOut) const override;
+
+    // Capsule has interior, so return true.
+    virtual bool hasInterior() const override { return true; }
+
+protected:
+    // Return the closest point on the segment from the position.
+    auto getClosestPointOnSegment(const Vector4& position) const->Vector4;
+
+    // Return the outward normal at the surface point closest to the position.
+    auto getNormal(const Vector4& position, const Vector4& pointOnSegment) const->Vector4;
+
+    Vector4 m_vertexA;  // The first vertex of the segment.
+    Vector4 m_vertexB;  // The second vertex of the segment.
+    float m_radius;     // Radius of the capsule.
+};
@@ -75,3 +75,154 @@ void PlaneShape::getClosestPoint(const Vector4& position, ClosestPointOutput& ou
     out.m_closestPoint = position - d * m_plane;
     out.m_normal = m_plane;
 }
+
+void PlaneShape::getAabb(Aabb& aabbOut) const
+{
+    aabbOut.setInfinite();
+
+    // Find the axis of the normal.
+    int axis = -1;
+    for (int i = 0; i < 3; i++)
+    {
+        if (m_plane(i) != 0.f)
+        {
+            if (axis >= 0)
+            {
+                // The plane is not axis aligned.
+                return;
+            }
+            axis = i;
+        }
+    }
+
+    if (axis < 0)
+    {
+        return;
+    }
+
+    // Points behind the plane satisfy normal * x + d <= 0.
+    const float bound = -m_plane(3) / m_plane(axis);
+    if (m_plane(axis) > 0.f)
+    {
+        aabbOut.m_max(axis) = bound;
+    }
+    else
+    {
+        aabbOut.m_min(axis) = bound;
+    }
+}
+
+void PlaneShape::castRays(const Vector4* starts, const Vector4* ends, int numRays, RayCastOutput* outs) const
+{
+    int i = 0;
+
+#ifdef USE_SSE
+    const __m128 nx = _mm_set1_ps(m_plane(0));
+    const __m128 ny = _mm_set1_ps(m_plane(1));
+    const __m128 nz = _mm_set1_ps(m_plane(2));
+    const __m128 nd = _mm_set1_ps(m_plane(3));
+
+    for (; i + 4 <= numRays; i += 4)
+    {
+        // Load starts and ends and transpose them to x, y and z of 4 rays.
+        __m128 sx = starts[i].getQuad();
+        __m128 sy = starts[i + 1].getQuad();
+        __m128 sz = starts[i + 2].getQuad();
+        __m128 sw = starts[i + 3].getQuad();
+        _MM_TRANSPOSE4_PS(sx, sy, sz, sw);
+
+        __m128 ex = ends[i].getQuad();
+        __m128 ey = ends[i + 1].getQuad();
+        __m128 ez = ends[i + 2].getQuad();
+        __m128 ew = ends[i + 3].getQuad();
+        _MM_TRANSPOSE4_PS(ex, ey, ez, ew);
+
+        // Signed distances of the start and the end from the plane.
+        const __m128 a = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, nx), _mm_mul_ps(sy, ny)), _mm_mul_ps(sz, nz)), nd);
+        const __m128 b = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, nx), _mm_mul_ps(ey, ny)), _mm_mul_ps(ez, nz)), nd);
+
+        const __m128 rx = _mm_sub_ps(ex, sx);
+        const __m128 ry = _mm_sub_ps(ey, sy);
+        const __m128 rz = _mm_sub_ps(ez, sz);
+        const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, nx), _mm_mul_ps(ry, ny)), _mm_mul_ps(rz, nz));
+
+        // We handle hits only from front face where the start and the end are located in the opposite side of the plane.
+        const __m128 isHit = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(a, _mm_setzero_ps()), _mm_cmple_ps(_mm_mul_ps(a, b), _mm_setzero_ps())),
+            _mm_cmpneq_ps(dot, _mm_setzero_ps()));
+
+        const __m128 fraction = _mm_div_ps(_mm_sub_ps(_mm_setzero_ps(), a), dot);
+        __m128 hx = _mm_add_ps(sx, _mm_mul_ps(rx, fraction));
+        __m128 hy = _mm_add_ps(sy, _mm_mul_ps(ry, fraction));
+        __m128 hz = _mm_add_ps(sz, _mm_mul_ps(rz, fraction));
+        __m128 hw = _mm_set1_ps(1.f);
+        _MM_TRANSPOSE4_PS(hx, hy, hz, hw);
+        const __m128 hitPoints[4] = { hx, hy, hz, hw };
+
+        alignas(16) float fractions[4];
+        _mm_store_ps(fractions, fraction);
+        const int hitMask = _mm_movemask_ps(isHit);
+
+        for (int j = 0; j < 4; j++)
+        {
+            RayCastOutput& out = outs[i + j];
+            out.m_hit = (hitMask & (1 << j)) != 0;
+            if (out.m_hit)
+            {
+                out.m_fraction = fractions[j];
+                out.m_hitPoint.accessQuad() = hitPoints[j];
+                out.m_hitNormal = m_plane;
+            }
+        }
+    }
+#endif
+
+    // Cast the rest of rays one by one without virtual calls.
+    for (; i < numRays; i++)
+    {
+        PlaneShape::castRay(starts[i], ends[i], outs[i]);
+    }
+}
+
+void PlaneShape::getClosestPoints(const Vector4* positions, int numPositions, ClosestPointOutput* outs) const
+{
+    int i = 0;
+
+#ifdef USE_SSE
+    const __m128 nx = _mm_set1_ps(m_plane(0));
+    const __m128 ny = _mm_set1_ps(m_plane(1));
+    const __m128 nz = _mm_set1_ps(m_plane(2));
+    const __m128 nd = _mm_set1_ps(m_plane(3));
+
+    for (; i + 4 <= numPositions; i += 4)
+    {
+        __m128 px = positions[i].getQuad();
+        __m128 py = positions[i + 1].getQuad();
+        __m128 pz = positions[i + 2].getQuad();
+        __m128 pw = positions[i + 3].getQuad();
+        _MM_TRANSPOSE4_PS(px, py, pz, pw);
+
+        // Move positions along the normal by their signed distances.
+        const __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, nx), _mm_mul_ps(py, ny)), _mm_mul_ps(pz, nz)), nd);
+        __m128 qx = _mm_sub_ps(px, _mm_mul_ps(d, nx));
+        __m128 qy = _mm_sub_ps(py, _mm_mul_ps(d, ny));
+        __m128 qz = _mm_sub_ps(pz, _mm_mul_ps(d, nz));
+        __m128 qw = _mm_sub_ps(pw, _mm_mul_ps(d, nd));
+        _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+        outs[i].m_closestPoint.accessQuad() = qx;
+        outs[i + 1].m_closestPoint.accessQuad() = qy;
+        outs[i + 2].m_closestPoint.accessQuad() = qz;
+        outs[i + 3].m_closestPoint.accessQuad() = qw;
+        for (int j = 0; j < 4; j++)
+        {
+            outs[i + j].m_normal = m_plane;
+        }
+    }
+#endif
+
+    for (; i < numPositions; i++)
+    {
+        PlaneShape::getClosestPoint(positions[i], outs[i]);
+    }
+}
@@ -31,6 +31,13 @@ public:
     virtual void castRay(const Vector4& start, const Vector4& end, RayCastOutput& out) const override;
     virtual void getClosestPoint(const Vector4& position, ClosestPointOutput& out) const override;
 
+    // Batched queries which process 4 rays or positions at once by SIMD.
+    virtual void castRays(const Vector4* starts, const Vector4* ends, int numRays, RayCastOutput* outs) const override;
+    virtual void getClosestPoints(const Vector4* positions, int numPositions, ClosestPointOutput* outs) const override;
+
+    // Return the half space behind the plane if the plane is axis aligned. Otherwise return an infinite box.
+    virtual void getAabb(Aabb& aabbOut) const override;
+
     // Plane has no interior, so return false.
     virtual bool hasInterior() const override { return false; }
 
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <Common/Math/Vector4.h>
+#include <Geometry/Aabb.h>
 
 // Abstract class of shape of geometry.
 class Shape
@@ -16,6 +17,10 @@ public:
     // Return true if the shape has differentiation of interior and exterior.
     virtual bool hasInterior() const = 0;
 
+    // Return true if castRay() is reliable to detect positions crossing the surface of a shape without interior.
+    // Solvers sweep positions from start to end against such shapes instead of testing only where they start.
+    virtual bool supportsSweptQueries() const { return false; }
+
     // Output struct of ray cast query.
     struct RayCastOutput
     {
@@ -39,4 +44,28 @@ public:
     // Find the closest point and its normal on the surface of this shape from the given position.
     // If the position is inside the shape, it returns the closest point to get out from the shape.
     virtual void getClosestPoint(const Vector4& position, ClosestPointOutput& out) const = 0;
+
+    // Cast numRays rays from starts to ends at once and write outputs to outs.
+    // Results are the same as castRay() for each ray within floating point error. Derived shapes override this to process rays by SIMD.
+    virtual void castRays(const Vector4* starts, const Vector4* ends, int numRays, RayCastOutput* outs) const
+    {
+        for (int i = 0; i < numRays; i++)
+        {
+            castRay(starts[i], ends[i], outs[i]);
+        }
+    }
+
+    // Find the closest points from numPositions positions at once and write outputs to outs.
+    // Results are the same as getClosestPoint() for each position within floating point error.
+    virtual void getClosestPoints(const Vector4* positions, int numPositions, ClosestPointOutput* outs) const
+    {
+        for (int i = 0; i < numPositions; i++)
+        {
+            getClosestPoint(positions[i], outs[i]);
+        }
+    }
+
+    // Return a box enclosing all the positions where the queries above can report a collision.
+    // For shapes without interior, this is the region behind the surface. Unbounded shapes return an infinite box.
+    virtual void getAabb(Aabb& aabbOut) const { aabbOut.setInfinite(); }
 };
@@ -86,3 +86,164 @@ void SphereShape::getClosestPoint(const Vector4& position, ClosestPointOutput& o
     out.m_normal = dir;
     return;
 }
+
+void SphereShape::getAabb(Aabb& aabbOut) const
+{
+    const float radius = getRadius().getFloat();
+    const Vector4 extent(radius, radius, radius);
+    aabbOut.m_min = m_centerAndRadius - extent;
+    aabbOut.m_max = m_centerAndRadius + extent;
+}
+
+void SphereShape::castRays(const Vector4* starts, const Vector4* ends, int numRays, RayCastOutput* outs) const
+{
+    int i = 0;
+
+#ifdef USE_SSE
+    const __m128 cx = _mm_set1_ps(m_centerAndRadius(0));
+    const __m128 cy = _mm_set1_ps(m_centerAndRadius(1));
+    const __m128 cz = _mm_set1_ps(m_centerAndRadius(2));
+    const __m128 radSq = _mm_set1_ps(m_centerAndRadius(3) * m_centerAndRadius(3));
+
+    for (; i + 4 <= numRays; i += 4)
+    {
+        // Load starts and ends and transpose them to x, y and z of 4 rays.
+        __m128 sx = starts[i].getQuad();
+        __m128 sy = starts[i + 1].getQuad();
+        __m128 sz = starts[i + 2].getQuad();
+        __m128 sw = starts[i + 3].getQuad();
+        _MM_TRANSPOSE4_PS(sx, sy, sz, sw);
+
+        __m128 ex = ends[i].getQuad();
+        __m128 ey = ends[i + 1].getQuad();
+        __m128 ez = ends[i + 2].getQuad();
+        __m128 ew = ends[i + 3].getQuad();
+        _MM_TRANSPOSE4_PS(ex, ey, ez, ew);
+
+        // Check if the start is inside the sphere.
+        const __m128 scx = _mm_sub_ps(cx, sx);
+        const __m128 scy = _mm_sub_ps(cy, sy);
+        const __m128 scz = _mm_sub_ps(cz, sz);
+        const __m128 lenStartToCenterSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(scx, scx), _mm_mul_ps(scy, scy)), _mm_mul_ps(scz, scz));
+        const __m128 isInside = _mm_cmple_ps(lenStartToCenterSq, radSq);
+
+        // Project the center onto the ray.
+        const __m128 rx = _mm_sub_ps(ex, sx);
+        const __m128 ry = _mm_sub_ps(ey, sy);
+        const __m128 rz = _mm_sub_ps(ez, sz);
+        const __m128 rayLength = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_mul_ps(rz, rz)));
+        const __m128 dx = _mm_div_ps(rx, rayLength);
+        const __m128 dy = _mm_div_ps(ry, rayLength);
+        const __m128 dz = _mm_div_ps(rz, rayLength);
+        const __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, scx), _mm_mul_ps(dy, scy)), _mm_mul_ps(dz, scz));
+
+        const __m128 px = _mm_sub_ps(scx, _mm_mul_ps(dx, t));
+        const __m128 py = _mm_sub_ps(scy, _mm_mul_ps(dy, t));
+        const __m128 pz = _mm_sub_ps(scz, _mm_mul_ps(dz, t));
+        const __m128 perpLenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)), _mm_mul_ps(pz, pz));
+
+        const __m128 dist = _mm_sub_ps(t, _mm_sqrt_ps(_mm_sub_ps(radSq, perpLenSq)));
+        const __m128 fraction = _mm_div_ps(dist, rayLength);
+
+        // Rays going away from the sphere, passing by it or ending before it miss. NaN of degenerated rays fails all the comparisons.
+        const __m128 isHit = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(t, _mm_setzero_ps()), _mm_cmplt_ps(perpLenSq, radSq)),
+            _mm_cmple_ps(fraction, _mm_set1_ps(1.f)));
+
+        // Rays starting inside the sphere hit at the start.
+        __m128 hx = _mm_blendv_ps(_mm_add_ps(sx, _mm_mul_ps(dx, dist)), sx, isInside);
+        __m128 hy = _mm_blendv_ps(_mm_add_ps(sy, _mm_mul_ps(dy, dist)), sy, isInside);
+        __m128 hz = _mm_blendv_ps(_mm_add_ps(sz, _mm_mul_ps(dz, dist)), sz, isInside);
+        __m128 hw = sw;
+
+        __m128 nx = _mm_sub_ps(hx, cx);
+        __m128 ny = _mm_sub_ps(hy, cy);
+        __m128 nz = _mm_sub_ps(hz, cz);
+        const __m128 invNormalLength = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz))));
+        nx = _mm_mul_ps(nx, invNormalLength);
+        ny = _mm_mul_ps(ny, invNormalLength);
+        nz = _mm_mul_ps(nz, invNormalLength);
+        __m128 nw = _mm_setzero_ps();
+
+        _MM_TRANSPOSE4_PS(hx, hy, hz, hw);
+        _MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+        const __m128 hitPoints[4] = { hx, hy, hz, hw };
+        const __m128 hitNormals[4] = { nx, ny, nz, nw };
+
+        alignas(16) float fractions[4];
+        _mm_store_ps(fractions, _mm_andnot_ps(isInside, fraction));
+        const int hitMask = _mm_movemask_ps(_mm_or_ps(isInside, isHit));
+
+        for (int j = 0; j < 4; j++)
+        {
+            RayCastOutput& out = outs[i + j];
+            out.m_hit = (hitMask & (1 << j)) != 0;
+            if (out.m_hit)
+            {
+                out.m_fraction = fractions[j];
+                out.m_hitPoint.accessQuad() = hitPoints[j];
+                out.m_hitNormal.accessQuad() = hitNormals[j];
+            }
+        }
+    }
+#endif
+
+    // Cast the rest of rays one by one without virtual calls.
+    for (; i < numRays; i++)
+    {
+        SphereShape::castRay(starts[i], ends[i], outs[i]);
+    }
+}
+
+void SphereShape::getClosestPoints(const Vector4* positions, int numPositions, ClosestPointOutput* outs) const
+{
+    int i = 0;
+
+#ifdef USE_SSE
+    const __m128 cx = _mm_set1_ps(m_centerAndRadius(0));
+    const __m128 cy = _mm_set1_ps(m_centerAndRadius(1));
+    const __m128 cz = _mm_set1_ps(m_centerAndRadius(2));
+    const __m128 rad = _mm_set1_ps(m_centerAndRadius(3));
+
+    for (; i + 4 <= numPositions; i += 4)
+    {
+        __m128 px = positions[i].getQuad();
+        __m128 py = positions[i + 1].getQuad();
+        __m128 pz = positions[i + 2].getQuad();
+        __m128 pw = positions[i + 3].getQuad();
+        _MM_TRANSPOSE4_PS(px, py, pz, pw);
+
+        // Direction from the center to the position.
+        __m128 dx = _mm_sub_ps(px, cx);
+        __m128 dy = _mm_sub_ps(py, cy);
+        __m128 dz = _mm_sub_ps(pz, cz);
+        const __m128 invLength = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz))));
+        dx = _mm_mul_ps(dx, invLength);
+        dy = _mm_mul_ps(dy, invLength);
+        dz = _mm_mul_ps(dz, invLength);
+        __m128 dw = _mm_setzero_ps();
+
+        __m128 qx = _mm_add_ps(cx, _mm_mul_ps(rad, dx));
+        __m128 qy = _mm_add_ps(cy, _mm_mul_ps(rad, dy));
+        __m128 qz = _mm_add_ps(cz, _mm_mul_ps(rad, dz));
+        __m128 qw = pw;
+
+        _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+        _MM_TRANSPOSE4_PS(dx, dy, dz, dw);
+
+        outs[i].m_closestPoint.accessQuad() = qx;
+        outs[i + 1].m_closestPoint.accessQuad() = qy;
+        outs[i + 2].m_closestPoint.accessQuad() = qz;
+        outs[i + 3].m_closestPoint.accessQuad() = qw;
+        outs[i].m_normal.accessQuad() = dx;
+        outs[i + 1].m_normal.accessQuad() = dy;
+        outs[i + 2].m_normal.accessQuad() = dz;
+        outs[i + 3].m_normal.accessQuad() = dw;
+    }
+#endif
+
+    for (; i < numPositions; i++)
+    {
+        SphereShape::getClosestPoint(positions[i], outs[i]);
+    }
+}
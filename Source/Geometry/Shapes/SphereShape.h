@@ -34,6 +34,11 @@ public:
     virtual void castRay(const Vector4& start, const Vector4& end, RayCastOutput& out) const override;
     virtual void getClosestPoint(const Vector4& position, ClosestPointOutput& out) const override;
 
+    // Batched queries which process 4 rays or positions at once by SIMD.
+    virtual void castRays(const Vector4* starts, const Vector4* ends, int numRays, RayCastOutput* outs) const override;
+    virtual void getClosestPoints(const Vector4* positions, int numPositions, ClosestPointOutput* outs) const override;
+    virtual void getAabb(Aabb& aabbOut) const override;
+
     // Sphere has interior, so return true.
     virtual bool hasInterior() const override { return true; }
 
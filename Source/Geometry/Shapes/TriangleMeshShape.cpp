@@ -0,0 +1,441 @@
+/*
+* TriangleMeshShape.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <Geometry/Geometry.h>
+#include <Geometry/Shapes/TriangleMeshShape.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    // Return surface area of the box.
+    inline float getSurfaceArea(const Aabb& aabb)
+    {
+        const Vector4 d = aabb.m_max - aabb.m_min;
+        return 2.f * (d(0) * d(1) + d(1) * d(2) + d(2) * d(0));
+    }
+
+    // Set an empty box which can be enlarged by include().
+    inline void setEmpty(Aabb& aabb)
+    {
+        const float inf = std::numeric_limits<float>::max();
+        aabb.m_min = Vector4(inf, inf, inf);
+        aabb.m_max = Vector4(-inf, -inf, -inf);
+    }
+
+    // Enlarge the box to enclose the other box.
+    inline void includeAabb(Aabb& aabb, const Aabb& other)
+    {
+        aabb.include(other.m_min);
+        aabb.include(other.m_max);
+    }
+
+    // Return true if the ray hits the box before maxFraction.
+    inline bool intersectAabb(const Aabb& aabb, const Vector4& start, const Vector4& invRay, float maxFraction)
+    {
+        float tMin = 0.f;
+        float tMax = maxFraction;
+        for (int i = 0; i < 3; i++)
+        {
+            float t0 = (aabb.m_min(i) - start(i)) * invRay(i);
+            float t1 = (aabb.m_max(i) - start(i)) * invRay(i);
+            if (t0 > t1)
+            {
+                std::swap(t0, t1);
+            }
+
+            // NaN from a ray parallel to and on the slab doesn't clip the ray.
+            tMin = t0 > tMin ? t0 : tMin;
+            tMax = t1 < tMax ? t1 : tMax;
+            if (tMin > tMax)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Maximum depth of stacks for traversal. Each level of the hierarchy leaves at most one node on the stack.
+    constexpr int s_maxStackSize = TriangleMeshShape::s_maxDepth + 1;
+}
+
+TriangleMeshShape::TriangleMeshShape(const Vertices& vertices, const Triangles& triangles, float thickness)
+    : m_vertices(vertices)
+    , m_triangles(triangles)
+    , m_thickness(thickness)
+{
+    assert(!triangles.empty());
+    assert(thickness >= 0.f);
+
+    buildBvh();
+}
+
+void TriangleMeshShape::buildBvh()
+{
+    const int numTriangles = getNumTriangles();
+
+    std::vector<Aabb> triangleAabbs(numTriangles);
+    Vertices centroids(numTriangles);
+    std::vector<int> order(numTriangles);
+    for (int i = 0; i < numTriangles; i++)
+    {
+        const Triangle& tri = m_triangles[i];
+        for (int k = 0; k < 3; k++)
+        {
+            assert(tri.m_v[k] >= 0 && tri.m_v[k] < (int)m_vertices.size());
+        }
+
+        const Vector4& a = m_vertices[tri.m_v[0]];
+        const Vector4& b = m_vertices[tri.m_v[1]];
+        const Vector4& c = m_vertices[tri.m_v[2]];
+        triangleAabbs[i].set(a, b);
+        triangleAabbs[i].include(c);
+        centroids[i] = (a + b + c) * SimdFloat(1.f / 3.f);
+        order[i] = i;
+    }
+
+    // A binary tree with at least one triangle per leaf has less than 2N nodes.
+    m_nodes.clear();
+    m_nodes.reserve(2 * numTriangles);
+    m_nodes.push_back(Node());
+    buildNode(0, 0, 0, numTriangles, order, triangleAabbs, centroids);
+
+    // Sort triangles by leaves so that each leaf refers to a contiguous range.
+    const Triangles unsortedTriangles = m_triangles;
+    m_normals.resize(numTriangles);
+    for (int i = 0; i < numTriangles; i++)
+    {
+        const Triangle& tri = unsortedTriangles[order[i]];
+        m_triangles[i] = tri;
+
+        const Vector4& a = m_vertices[tri.m_v[0]];
+        Vector4 normal = Vector4::cross(m_vertices[tri.m_v[1]] - a, m_vertices[tri.m_v[2]] - a);
+        normal.setComponent<3>(SimdFloat_0);
+        if (normal.lengthSq<3>() > SimdFloat_0)
+        {
+            normal.normalize<3>();
+        }
+        m_normals[i] = normal;
+    }
+}
+
+void TriangleMeshShape::buildNode(int nodeIndex, int depth, int start, int count, std::vector<int>& order, const std::vector<Aabb>& triangleAabbs, const Vertices& centroids)
+{
+    Aabb nodeAabb;
+    Aabb centroidAabb;
+    setEmpty(nodeAabb);
+    setEmpty(centroidAabb);
+    for (int i = start; i < start + count; i++)
+    {
+        includeAabb(nodeAabb, triangleAabbs[order[i]]);
+        centroidAabb.include(centroids[order[i]]);
+    }
+
+    m_nodes[nodeIndex].m_aabb = nodeAabb;
+    m_nodes[nodeIndex].m_start = start;
+    m_nodes[nodeIndex].m_count = count;
+
+    if (count <= s_maxTrianglesPerLeaf || depth >= s_maxDepth)
+    {
+        return;
+    }
+
+    // Find the split with the lowest cost by surface area heuristic evaluating bins of centroids along each axis.
+    float bestCost = (float)count * getSurfaceArea(nodeAabb);
+    int bestAxis = -1;
+    int bestBin = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float minCentroid = centroidAabb.m_min(axis);
+        const float extent = centroidAabb.m_max(axis) - minCentroid;
+        if (extent <= 0.f)
+        {
+            continue;
+        }
+
+        int binCounts[s_numSahBins] = {};
+        Aabb binAabbs[s_numSahBins];
+        for (Aabb& aabb : binAabbs)
+        {
+            setEmpty(aabb);
+        }
+
+        const float binScale = (float)s_numSahBins / extent;
+        for (int i = start; i < start + count; i++)
+        {
+            const int bin = std::min((int)((centroids[order[i]](axis) - minCentroid) * binScale), s_numSahBins - 1);
+            binCounts[bin]++;
+            includeAabb(binAabbs[bin], triangleAabbs[order[i]]);
+        }
+
+        // Sweep from the right to accumulate costs of right sides, then from the left to evaluate each split.
+        float rightCosts[s_numSahBins];
+        Aabb rightAabb;
+        setEmpty(rightAabb);
+        int rightCount = 0;
+        for (int bin = s_numSahBins - 1; bin > 0; bin--)
+        {
+            rightCount += binCounts[bin];
+            if (binCounts[bin] > 0)
+            {
+                includeAabb(rightAabb, binAabbs[bin]);
+            }
+            rightCosts[bin] = rightCount > 0 ? (float)rightCount * getSurfaceArea(rightAabb) : 0.f;
+        }
+
+        Aabb leftAabb;
+        setEmpty(leftAabb);
+        int leftCount = 0;
+        for (int bin = 0; bin < s_numSahBins - 1; bin++)
+        {
+            leftCount += binCounts[bin];
+            if (binCounts[bin] > 0)
+            {
+                includeAabb(leftAabb, binAabbs[bin]);
+            }
+
+            // Split between bin and bin + 1.
+            if (leftCount == 0 || leftCount == count)
+            {
+                continue;
+            }
+
+            const float cost = (float)leftCount * getSurfaceArea(leftAabb) + rightCosts[bin + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    if (bestAxis < 0)
+    {
+        // Splitting doesn't pay off or all centroids are at the same position.
+        return;
+    }
+
+    const float minCentroid = centroidAabb.m_min(bestAxis);
+    const float binScale = (float)s_numSahBins / (centroidAabb.m_max(bestAxis) - minCentroid);
+    const int* middle = std::partition(order.data() + start, order.data() + start + count, [&](int tri)
+    {
+        return std::min((int)((centroids[tri](bestAxis) - minCentroid) * binScale), s_numSahBins - 1) <= bestBin;
+    });
+    const int leftCount = (int)(middle - (order.data() + start));
+    assert(leftCount > 0 && leftCount < count);
+
+    // Children are adjacent.
+    const int firstChild = (int)m_nodes.size();
+    m_nodes.push_back(Node());
+    m_nodes.push_back(Node());
+    m_nodes[nodeIndex].m_start = firstChild;
+    m_nodes[nodeIndex].m_count = 0;
+
+    buildNode(firstChild, depth + 1, start, leftCount, order, triangleAabbs, centroids);
+    buildNode(firstChild + 1, depth + 1, start + leftCount, count - leftCount, order, triangleAabbs, centroids);
+}
+
+bool TriangleMeshShape::intersectTriangle(int index, const Vector4& start, const Vector4& ray, float& fractionInOut) const
+{
+    // Moller-Trumbore intersection.
+    const Triangle& tri = m_triangles[index];
+    const Vector4& a = m_vertices[tri.m_v[0]];
+    const Vector4 e1 = m_vertices[tri.m_v[1]] - a;
+    const Vector4 e2 = m_vertices[tri.m_v[2]] - a;
+
+    // det is positive only if the ray comes from the front face.
+    const Vector4 p = Vector4::cross(ray, e2);
+    const float det = e1.dot<3>(p).getFloat();
+    if (det <= std::numeric_limits<float>::epsilon())
+    {
+        return false;
+    }
+
+    const float invDet = 1.f / det;
+    const Vector4 s = start - a;
+    const float u = s.dot<3>(p).getFloat() * invDet;
+    if (u < 0.f || u > 1.f)
+    {
+        return false;
+    }
+
+    const Vector4 q = Vector4::cross(s, e1);
+    const float v = ray.dot<3>(q).getFloat() * invDet;
+    if (v < 0.f || u + v > 1.f)
+    {
+        return false;
+    }
+
+    const float t = e2.dot<3>(q).getFloat() * invDet;
+    if (t < 0.f || t > fractionInOut)
+    {
+        return false;
+    }
+
+    fractionInOut = t;
+    return true;
+}
+
+auto TriangleMeshShape::getClosestPointOnTriangle(int index, const Vector4& position) const->Vector4
+{
+    // See "Real-Time Collision Detection" by Ericson, 5.1.5.
+    const Triangle& tri = m_triangles[index];
+    const Vector4& a = m_vertices[tri.m_v[0]];
+    const Vector4& b = m_vertices[tri.m_v[1]];
+    const Vector4& c = m_vertices[tri.m_v[2]];
+
+    const Vector4 ab = b - a;
+    const Vector4 ac = c - a;
+    const Vector4 ap = position - a;
+    const float d1 = ab.dot<3>(ap).getFloat();
+    const float d2 = ac.dot<3>(ap).getFloat();
+    if (d1 <= 0.f && d2 <= 0.f)
+    {
+        return a;
+    }
+
+    const Vector4 bp = position - b;
+    const float d3 = ab.dot<3>(bp).getFloat();
+    const float d4 = ac.dot<3>(bp).getFloat();
+    if (d3 >= 0.f && d4 <= d3)
+    {
+        return b;
+    }
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+    {
+        return a + ab * SimdFloat(d1 / (d1 - d3));
+    }
+
+    const Vector4 cp = position - c;
+    const float d5 = ab.dot<3>(cp).getFloat();
+    const float d6 = ac.dot<3>(cp).getFloat();
+    if (d6 >= 0.f && d5 <= d6)
+    {
+        return c;
+    }
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+    {
+        return a + ac * SimdFloat(d2 / (d2 - d6));
+    }
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+    {
+        return b + (c - b) * SimdFloat((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    // Inside the face.
+    const float denom = 1.f / (va + vb + vc);
+    return a + ab * SimdFloat(vb * denom) + ac * SimdFloat(vc * denom);
+}
+
+void TriangleMeshShape::castRay(const Vector4& start, const Vector4& end, RayCastOutput& out) const
+{
+    const Vector4 ray = end - start;
+    const Vector4 invRay(1.f / ray(0), 1.f / ray(1), 1.f / ray(2));
+
+    float fraction = 1.f;
+    int hitTriangle = -1;
+
+    int stack[s_maxStackSize];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+        if (!intersectAabb(node.m_aabb, start, invRay, fraction))
+        {
+            continue;
+        }
+
+        if (node.isLeaf())
+        {
+            for (int i = node.m_start; i < node.m_start + node.m_count; i++)
+            {
+                if (intersectTriangle(i, start, ray, fraction))
+                {
+                    hitTriangle = i;
+                }
+            }
+        }
+        else
+        {
+            assert(stackSize + 2 <= s_maxStackSize);
+            stack[stackSize++] = node.m_start;
+            stack[stackSize++] = node.m_start + 1;
+        }
+    }
+
+    if (hitTriangle < 0)
+    {
+        out.m_hit = false;
+        return;
+    }
+
+    out.m_hit = true;
+    out.m_fraction = fraction;
+    out.m_hitPoint = start + ray * SimdFloat(fraction);
+    out.m_hitNormal = m_normals[hitTriangle];
+}
+
+void TriangleMeshShape::getClosestPoint(const Vector4& position, ClosestPointOutput& out) const
+{
+    float minDistanceSq = std::numeric_limits<float>::max();
+    int closestTriangle = -1;
+
+    int stack[s_maxStackSize];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+        const float distance = node.m_aabb.getDistance(position);
+        if (distance * distance >= minDistanceSq)
+        {
+            continue;
+        }
+
+        if (node.isLeaf())
+        {
+            for (int i = node.m_start; i < node.m_start + node.m_count; i++)
+            {
+                const Vector4 closestPoint = getClosestPointOnTriangle(i, position);
+                const float distanceSq = (closestPoint - position).lengthSq<3>().getFloat();
+                if (distanceSq < minDistanceSq)
+                {
+                    minDistanceSq = distanceSq;
+                    closestTriangle = i;
+                    out.m_closestPoint = closestPoint;
+                }
+            }
+        }
+        else
+        {
+            // Visit the nearer child first so that the other one is more likely to be pruned.
+            const int first = node.m_start;
+            const bool isSecondNearer = m_nodes[first + 1].m_aabb.getDistance(position) < m_nodes[first].m_aabb.getDistance(position);
+            assert(stackSize + 2 <= s_maxStackSize);
+            stack[stackSize++] = isSecondNearer ? first : first + 1;
+            stack[stackSize++] = isSecondNearer ? first + 1 : first;
+        }
+    }
+
+    assert(closestTriangle >= 0);
+    out.m_normal = m_normals[closestTriangle];
+}
+
+void TriangleMeshShape::getAabb(Aabb& aabbOut) const
+{
+    aabbOut = m_nodes[0].m_aabb;
+    aabbOut.expand(m_thickness);
+}
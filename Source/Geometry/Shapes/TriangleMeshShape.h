@@ -0,0 +1,102 @@
+/*
+* TriangleMeshShape.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <Geometry/Shapes/Shape.h>
+#include <Common/Math/Vector4.h>
+
+#include <vector>
+
+// Triangle mesh shape such as terrain or static obstacles.
+// The mesh is a surface whose front faces are counter-clockwise. Like PlaneShape, positions behind the closest triangle are inside.
+// This is wrong near ridges sharper than 90 degrees, where the closest triangle can face away from a position in front of its neighbor.
+// Triangles are organized in a bounding volume hierarchy built by surface area heuristic, so queries are logarithmic in the number of triangles.
+class TriangleMeshShape : public Shape
+{
+public:
+    // Indices of vertices of a triangle.
+    struct Triangle
+    {
+        int m_v[3];
+    };
+
+    // Node of the bounding volume hierarchy.
+    struct Node
+    {
+        Aabb m_aabb;    // AABB of all the triangles under this node.
+        int m_start;    // Index of the first triangle for a leaf, or index of the first child for an internal node. Children are adjacent.
+        int m_count;    // The number of triangles for a leaf, or zero for an internal node.
+
+        inline bool isLeaf() const { return m_count > 0; }
+    };
+
+    // Type definitions.
+    using Vertices = std::vector<Vector4>;
+    using Triangles = std::vector<Triangle>;
+    using Nodes = std::vector<Node>;
+
+    // Maximum number of triangles in a leaf unless they can't be split or the leaf is at s_maxDepth.
+    static constexpr int s_maxTrianglesPerLeaf = 4;
+
+    // The number of bins to evaluate splits along each axis.
+    static constexpr int s_numSahBins = 16;
+
+    // Maximum depth of the hierarchy. Nodes at this depth become leaves regardless of the number of triangles.
+    static constexpr int s_maxDepth = 63;
+
+    //
+    // Constructors
+    //
+    // Positions within thickness behind the surface are regarded as colliding after culling by AABB.
+    TriangleMeshShape(const Vertices& vertices, const Triangles& triangles, float thickness = 0.1f);
+
+    //
+    // Accessors to the mesh.
+    //
+    inline auto getVertices() const->const Vertices& { return m_vertices; }
+    inline int getNumTriangles() const { return (int)m_triangles.size(); }
+    inline auto getTriangle(int index) const->const Triangle& { return m_triangles[index]; }
+    inline auto getNodes() const->const Nodes& { return m_nodes; }
+    inline float getThickness() const { return m_thickness; }
+
+    //
+    // Query interface
+    //
+    // Return the first hit on front faces.
+    virtual void castRay(const Vector4& start, const Vector4& end, RayCastOutput& out) const override;
+
+    // Return the closest point on the mesh and face normal of the triangle containing it.
+    virtual void getClosestPoint(const Vector4& position, ClosestPointOutput& out) const override;
+
+    // Return the AABB of the mesh expanded by the thickness.
+    virtual void getAabb(Aabb& aabbOut) const override;
+
+    // Triangle mesh has no interior, so return false.
+    virtual bool hasInterior() const override { return false; }
+
+    // Ray casts hit front faces, so positions passing through the surface within a step are detected by sweeping.
+    virtual bool supportsSweptQueries() const override { return true; }
+
+protected:
+    // Build the bounding volume hierarchy and reorder triangles by leaves.
+    void buildBvh();
+
+    // Build the node at depth for triangles [start, start + count) of order. Triangles are partitioned in place.
+    void buildNode(int nodeIndex, int depth, int start, int count, std::vector<int>& order, const std::vector<Aabb>& triangleAabbs, const Vertices& centroids);
+
+    // Intersect the ray with the front face of the triangle. Return true and update fractionInOut if it hits before fractionInOut.
+    bool intersectTriangle(int index, const Vector4& start, const Vector4& ray, float& fractionInOut) const;
+
+    // Return the closest point on the triangle from the position.
+    auto getClosestPointOnTriangle(int index, const Vector4& position) const->Vector4;
+
+    Vertices m_vertices;            // Vertices of the mesh.
+    Triangles m_triangles;          // Triangles sorted by leaves of the hierarchy.
+    std::vector<Vector4> m_normals; // Face normal of each triangle.
+    Nodes m_nodes;                  // Nodes of the hierarchy. The first one is the root.
+    float m_thickness;              // Thickness behind the surface covered by the AABB.
+};
@@ -0,0 +1,340 @@
+/*
+* DynamicAabbTree.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <Physics/Physics.h>
+#include <Physics/Collision/DynamicAabbTree.h>
+
+#include <algorithm>
+
+namespace
+{
+    // Return the smallest box enclosing two boxes.
+    inline auto getUnion(const Aabb& a, const Aabb& b)->Aabb
+    {
+        Aabb aabb = a;
+        aabb.include(b.m_min);
+        aabb.include(b.m_max);
+        return aabb;
+    }
+
+    // Return perimeter of the box. Used as the cost of a node instead of surface area.
+    inline float getPerimeter(const Aabb& aabb)
+    {
+        const Vector4 d = aabb.m_max - aabb.m_min;
+        return 2.f * (d(0) + d(1) + d(2));
+    }
+
+    // Return true if the outer box contains the inner box.
+    inline bool contains(const Aabb& outer, const Aabb& inner)
+    {
+        return outer.m_min(0) <= inner.m_min(0) && outer.m_min(1) <= inner.m_min(1) && outer.m_min(2) <= inner.m_min(2)
+            && inner.m_max(0) <= outer.m_max(0) && inner.m_max(1) <= outer.m_max(1) && inner.m_max(2) <= outer.m_max(2);
+    }
+
+    // Maximum depth of stacks for traversal. Balanced trees are much shallower than this.
+    constexpr int s_maxStackSize = 128;
+}
+
+DynamicAabbTree::DynamicAabbTree(float margin)
+    : m_margin(margin)
+{
+    assert(margin >= 0.f);
+}
+
+auto DynamicAabbTree::clamp(const Aabb& aabb)->Aabb
+{
+    Aabb clamped;
+    clamped.m_min = Vector4(std::max(aabb.m_min(0), -s_maxCoordinate), std::max(aabb.m_min(1), -s_maxCoordinate), std::max(aabb.m_min(2), -s_maxCoordinate));
+    clamped.m_max = Vector4(std::min(aabb.m_max(0), s_maxCoordinate), std::min(aabb.m_max(1), s_maxCoordinate), std::min(aabb.m_max(2), s_maxCoordinate));
+    return clamped;
+}
+
+int DynamicAabbTree::allocateNode()
+{
+    int node = m_freeList;
+    if (node == s_nullNode)
+    {
+        node = (int)m_nodes.size();
+        m_nodes.push_back(Node());
+    }
+    else
+    {
+        m_freeList = m_nodes[node].m_parent;
+    }
+
+    Node& n = m_nodes[node];
+    n.m_parent = s_nullNode;
+    n.m_child1 = s_nullNode;
+    n.m_child2 = s_nullNode;
+    n.m_height = 0;
+    n.m_userData = -1;
+    return node;
+}
+
+void DynamicAabbTree::freeNode(int node)
+{
+    m_nodes[node].m_parent = m_freeList;
+    m_nodes[node].m_height = -1;
+    m_freeList = node;
+}
+
+int DynamicAabbTree::insert(const Aabb& aabb, int userData)
+{
+    const int leaf = allocateNode();
+    Node& node = m_nodes[leaf];
+    node.m_aabb = aabb;
+    node.m_aabb.expand(m_margin);
+    node.m_aabb = clamp(node.m_aabb);
+    node.m_userData = userData;
+
+    insertLeaf(leaf);
+    m_numLeaves++;
+    return leaf;
+}
+
+void DynamicAabbTree::remove(int leaf)
+{
+    assert(leaf >= 0 && leaf < (int)m_nodes.size() && m_nodes[leaf].isLeaf() && m_nodes[leaf].m_height == 0);
+
+    removeLeaf(leaf);
+    freeNode(leaf);
+    m_numLeaves--;
+}
+
+bool DynamicAabbTree::update(int leaf, const Aabb& aabb)
+{
+    assert(leaf >= 0 && leaf < (int)m_nodes.size() && m_nodes[leaf].isLeaf() && m_nodes[leaf].m_height == 0);
+
+    const Aabb clamped = clamp(aabb);
+    if (contains(m_nodes[leaf].m_aabb, clamped))
+    {
+        return false;
+    }
+
+    removeLeaf(leaf);
+
+    Aabb& fatAabb = m_nodes[leaf].m_aabb;
+    fatAabb = clamped;
+    fatAabb.expand(m_margin);
+    fatAabb = clamp(fatAabb);
+
+    insertLeaf(leaf);
+    return true;
+}
+
+void DynamicAabbTree::query(const Aabb& aabb, std::vector<int>& userDataOut) const
+{
+    if (m_root == s_nullNode)
+    {
+        return;
+    }
+
+    int stack[s_maxStackSize];
+    int stackSize = 0;
+    stack[stackSize++] = m_root;
+    while (stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+        if (!node.m_aabb.overlaps(aabb))
+        {
+            continue;
+        }
+
+        if (node.isLeaf())
+        {
+            userDataOut.push_back(node.m_userData);
+        }
+        else
+        {
+            assert(stackSize + 2 <= s_maxStackSize);
+            stack[stackSize++] = node.m_child1;
+            stack[stackSize++] = node.m_child2;
+        }
+    }
+}
+
+void DynamicAabbTree::insertLeaf(int leaf)
+{
+    if (m_root == s_nullNode)
+    {
+        m_root = leaf;
+        m_nodes[leaf].m_parent = s_nullNode;
+        return;
+    }
+
+    // Descend to the sibling which minimizes the increase of perimeters of the new parent and all of its ancestors.
+    const Aabb leafAabb = m_nodes[leaf].m_aabb;
+    int index = m_root;
+    while (!m_nodes[index].isLeaf())
+    {
+        const Node& node = m_nodes[index];
+        const float perimeter = getPerimeter(node.m_aabb);
+        const float combinedPerimeter = getPerimeter(getUnion(node.m_aabb, leafAabb));
+
+        // Cost of creating a new parent of this node and the leaf.
+        const float cost = 2.f * combinedPerimeter;
+
+        // Minimum cost of pushing the leaf further down the tree.
+        const float inheritanceCost = 2.f * (combinedPerimeter - perimeter);
+        float childCosts[2];
+        const int children[2] = { node.m_child1, node.m_child2 };
+        for (int i = 0; i < 2; i++)
+        {
+            const Node& child = m_nodes[children[i]];
+            const float childPerimeter = getPerimeter(getUnion(child.m_aabb, leafAabb));
+            childCosts[i] = (child.isLeaf() ? childPerimeter : childPerimeter - getPerimeter(child.m_aabb)) + inheritanceCost;
+        }
+
+        if (cost < childCosts[0] && cost < childCosts[1])
+        {
+            break;
+        }
+
+        index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+    }
+
+    // Create a new parent of the sibling and the leaf. allocateNode() may reallocate m_nodes.
+    const int sibling = index;
+    const int oldParent = m_nodes[sibling].m_parent;
+    const int newParent = allocateNode();
+    m_nodes[newParent].m_parent = oldParent;
+    m_nodes[newParent].m_aabb = getUnion(leafAabb, m_nodes[sibling].m_aabb);
+    m_nodes[newParent].m_height = m_nodes[sibling].m_height + 1;
+    m_nodes[newParent].m_child1 = sibling;
+    m_nodes[newParent].m_child2 = leaf;
+    m_nodes[sibling].m_parent = newParent;
+    m_nodes[leaf].m_parent = newParent;
+
+    if (oldParent == s_nullNode)
+    {
+        m_root = newParent;
+    }
+    else if (m_nodes[oldParent].m_child1 == sibling)
+    {
+        m_nodes[oldParent].m_child1 = newParent;
+    }
+    else
+    {
+        m_nodes[oldParent].m_child2 = newParent;
+    }
+
+    refitAncestors(newParent);
+}
+
+void DynamicAabbTree::removeLeaf(int leaf)
+{
+    if (leaf == m_root)
+    {
+        m_root = s_nullNode;
+        return;
+    }
+
+    // Replace the parent by the sibling.
+    const int parent = m_nodes[leaf].m_parent;
+    const int grandParent = m_nodes[parent].m_parent;
+    const int sibling = m_nodes[parent].m_child1 == leaf ? m_nodes[parent].m_child2 : m_nodes[parent].m_child1;
+
+    m_nodes[sibling].m_parent = grandParent;
+    freeNode(parent);
+
+    if (grandParent == s_nullNode)
+    {
+        m_root = sibling;
+        return;
+    }
+
+    if (m_nodes[grandParent].m_child1 == parent)
+    {
+        m_nodes[grandParent].m_child1 = sibling;
+    }
+    else
+    {
+        m_nodes[grandParent].m_child2 = sibling;
+    }
+
+    refitAncestors(grandParent);
+}
+
+void DynamicAabbTree::refitAncestors(int node)
+{
+    int index = node;
+    while (index != s_nullNode)
+    {
+        index = balance(index);
+
+        Node& n = m_nodes[index];
+        const Node& child1 = m_nodes[n.m_child1];
+        const Node& child2 = m_nodes[n.m_child2];
+        n.m_height = 1 + std::max(child1.m_height, child2.m_height);
+        n.m_aabb = getUnion(child1.m_aabb, child2.m_aabb);
+
+        index = n.m_parent;
+    }
+}
+
+int DynamicAabbTree::balance(int a)
+{
+    Node& nodeA = m_nodes[a];
+    if (nodeA.isLeaf() || nodeA.m_height < 2)
+    {
+        return a;
+    }
+
+    const int b = nodeA.m_child1;
+    const int c = nodeA.m_child2;
+    const int imbalance = m_nodes[c].m_height - m_nodes[b].m_height;
+    if (imbalance >= -1 && imbalance <= 1)
+    {
+        return a;
+    }
+
+    // Rotate the taller child up. The taller one is the pivot and the shorter one stays under A.
+    const bool isChild2Taller = imbalance > 1;
+    const int pivot = isChild2Taller ? c : b;
+    const int shorter = isChild2Taller ? b : c;
+    Node& nodeP = m_nodes[pivot];
+    const int f = nodeP.m_child1;
+    const int g = nodeP.m_child2;
+
+    // The pivot replaces A.
+    nodeP.m_child1 = a;
+    nodeP.m_parent = nodeA.m_parent;
+    nodeA.m_parent = pivot;
+    if (nodeP.m_parent == s_nullNode)
+    {
+        m_root = pivot;
+    }
+    else if (m_nodes[nodeP.m_parent].m_child1 == a)
+    {
+        m_nodes[nodeP.m_parent].m_child1 = pivot;
+    }
+    else
+    {
+        m_nodes[nodeP.m_parent].m_child2 = pivot;
+    }
+
+    // The taller grandchild stays under the pivot and the other one moves under A.
+    const bool isFTaller = m_nodes[f].m_height > m_nodes[g].m_height;
+    const int keep = isFTaller ? f : g;
+    const int move = isFTaller ? g : f;
+    nodeP.m_child2 = keep;
+    if (isChild2Taller)
+    {
+        nodeA.m_child2 = move;
+    }
+    else
+    {
+        nodeA.m_child1 = move;
+    }
+    m_nodes[move].m_parent = a;
+
+    nodeA.m_aabb = getUnion(m_nodes[shorter].m_aabb, m_nodes[move].m_aabb);
+    nodeA.m_height = 1 + std::max(m_nodes[shorter].m_height, m_nodes[move].m_height);
+    nodeP.m_aabb = getUnion(nodeA.m_aabb, m_nodes[keep].m_aabb);
+    nodeP.m_height = 1 + std::max(nodeA.m_height, m_nodes[keep].m_height);
+
+    return pivot;
+}
@@ -0,0 +1,98 @@
+/*
+* DynamicAabbTree.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <Geometry/Aabb.h>
+
+#include <vector>
+
+// Broadphase which organizes AABBs of objects in a binary tree so that objects overlapping a region are found in logarithmic time.
+// Leaves hold AABBs enlarged by a margin, so objects moving slightly don't have to be reinserted.
+// New leaves are inserted as siblings of the node which minimizes the increase of perimeters, and the tree is kept balanced by rotations.
+// See "Dynamic AABB tree" of Box2D by Erin Catto.
+class DynamicAabbTree
+{
+public:
+    // Index of no node.
+    static constexpr int s_nullNode = -1;
+
+    // Default margin of AABBs of leaves.
+    static constexpr float s_defaultMargin = 0.1f;
+
+    // AABBs are clamped to this coordinate so that infinite AABBs such as planes can be handled.
+    static constexpr float s_maxCoordinate = 1e15f;
+
+    // Constructor
+    DynamicAabbTree(float margin = s_defaultMargin);
+
+    // Insert a leaf of the AABB and return its index. userData is returned by queries.
+    int insert(const Aabb& aabb, int userData);
+
+    // Remove the leaf.
+    void remove(int leaf);
+
+    // Update AABB of the leaf. The leaf is reinserted only if the AABB moved out of the enlarged AABB. Return true if reinserted.
+    bool update(int leaf, const Aabb& aabb);
+
+    // Append user data of leaves whose enlarged AABBs overlap with the AABB to userDataOut.
+    void query(const Aabb& aabb, std::vector<int>& userDataOut) const;
+
+    // Accessors to leaves.
+    inline int getUserData(int leaf) const { return m_nodes[leaf].m_userData; }
+    inline void setUserData(int leaf, int userData) { m_nodes[leaf].m_userData = userData; }
+    inline auto getFatAabb(int leaf) const->const Aabb& { return m_nodes[leaf].m_aabb; }
+
+    // Return the number of leaves.
+    inline int getNumLeaves() const { return m_numLeaves; }
+
+    // Return height of the tree. A tree of a single leaf has height zero.
+    inline int getHeight() const { return m_root == s_nullNode ? 0 : m_nodes[m_root].m_height; }
+
+    // Return margin of AABBs of leaves.
+    inline float getMargin() const { return m_margin; }
+
+protected:
+    // Node of the tree.
+    struct Node
+    {
+        Aabb m_aabb;        // Enlarged AABB for a leaf or AABB enclosing children for an internal node.
+        int m_parent;       // Index of the parent. Index of the next free node if this node is free.
+        int m_child1;       // Index of the first child. s_nullNode for a leaf.
+        int m_child2;       // Index of the second child. s_nullNode for a leaf.
+        int m_height;       // Height of the subtree. Zero for a leaf.
+        int m_userData;     // User data of a leaf.
+
+        inline bool isLeaf() const { return m_child1 == s_nullNode; }
+    };
+
+    // Take a node from the free list or allocate a new one.
+    int allocateNode();
+
+    // Return the node to the free list.
+    void freeNode(int node);
+
+    // Link the leaf into the tree.
+    void insertLeaf(int leaf);
+
+    // Unlink the leaf from the tree. The leaf node itself is kept.
+    void removeLeaf(int leaf);
+
+    // Refit AABBs and heights from the node to the root while balancing the tree.
+    void refitAncestors(int node);
+
+    // Rotate the subtree at the node if it's unbalanced. Return index of the new root of the subtree.
+    int balance(int node);
+
+    // Return the AABB clamped within s_maxCoordinate.
+    static auto clamp(const Aabb& aabb)->Aabb;
+
+    std::vector<Node> m_nodes;      // Nodes including free ones.
+    int m_root = s_nullNode;        // Index of the root.
+    int m_freeList = s_nullNode;    // Index of the first free node.
+    int m_numLeaves = 0;            // The number of leaves.
+    float m_margin;                 // Margin of AABBs of leaves.
+};
@@ -0,0 +1,126 @@
+/*
+* SpatialHashGrid.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <Physics/Physics.h>
+#include <Physics/Collision/SpatialHashGrid.h>
+
+#include <algorithm>
+#include <cmath>
+
+inline auto SpatialHashGrid::getCell(const Vector4& position) const->Cell
+{
+    return Cell{
+        (int)std::floor(position(0) * m_invCellSize),
+        (int)std::floor(position(1) * m_invCellSize),
+        (int)std::floor(position(2) * m_invCellSize) };
+}
+
+inline int SpatialHashGrid::getBucket(const Cell& cell) const
+{
+    // Hash function from "Optimized Spatial Hashing for Collision Detection of Deformable Objects" by Teschner et al.
+    const unsigned int hash = ((unsigned int)cell.m_x * 73856093u) ^ ((unsigned int)cell.m_y * 19349663u) ^ ((unsigned int)cell.m_z * 83492791u);
+    return (int)(hash & (unsigned int)m_bucketMask);
+}
+
+void SpatialHashGrid::build(const Positions& positions, float cellSize)
+{
+    assert(cellSize > 0.f);
+
+    const int numPoints = (int)positions.size();
+    m_invCellSize = 1.f / cellSize;
+
+    // Use twice as many buckets as points to keep hash collisions low.
+    int numBuckets = 1;
+    while (numBuckets < numPoints * 2)
+    {
+        numBuckets <<= 1;
+    }
+    m_bucketMask = numBuckets - 1;
+
+    m_cells.resize(numPoints);
+    m_sortedPoints.resize(numPoints);
+    m_bucketStarts.assign(numBuckets + 1, 0);
+
+    // Count the number of points in each bucket.
+    for (int i = 0; i < numPoints; i++)
+    {
+        m_cells[i] = getCell(positions[i]);
+        m_bucketStarts[getBucket(m_cells[i]) + 1]++;
+    }
+
+    // Calculate start index of each bucket.
+    for (int i = 0; i < numBuckets; i++)
+    {
+        m_bucketStarts[i + 1] += m_bucketStarts[i];
+    }
+
+    // Put points in buckets. Points in a bucket are sorted by their indices.
+    // Use m_candidates temporarily to track the number of points added to each bucket.
+    m_candidates.assign(numBuckets, 0);
+    for (int i = 0; i < numPoints; i++)
+    {
+        const int bucket = getBucket(m_cells[i]);
+        m_sortedPoints[m_bucketStarts[bucket] + m_candidates[bucket]++] = i;
+    }
+}
+
+void SpatialHashGrid::findPairs(const Positions& positions, const SimdFloat& distance, Pairs& pairsOut)
+{
+    const int numPoints = (int)positions.size();
+    if (numPoints < 2 || distance <= SimdFloat_0)
+    {
+        return;
+    }
+
+    // Points closer than distance are always in the same or adjacent cells.
+    build(positions, distance.getFloat());
+
+    const SimdFloat distanceSq = distance * distance;
+
+    for (int i = 0; i < numPoints; i++)
+    {
+        const Vector4& pos = positions[i];
+        const Cell& cell = m_cells[i];
+
+        m_candidates.clear();
+
+        // Check 27 neighboring cells.
+        for (int x = -1; x <= 1; x++)
+        {
+            for (int y = -1; y <= 1; y++)
+            {
+                for (int z = -1; z <= 1; z++)
+                {
+                    const Cell neighbor{ cell.m_x + x, cell.m_y + y, cell.m_z + z };
+                    const int bucket = getBucket(neighbor);
+                    const int end = m_bucketStarts[bucket + 1];
+                    for (int j = m_bucketStarts[bucket]; j < end; j++)
+                    {
+                        const int other = m_sortedPoints[j];
+
+                        // Skip points of different cells hashed to the same bucket so that each point is visited only once.
+                        if (other <= i || !(m_cells[other] == neighbor))
+                        {
+                            continue;
+                        }
+
+                        if ((pos - positions[other]).lengthSq<3>() < distanceSq)
+                        {
+                            m_candidates.push_back(other);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Sort the found points to output pairs in the same order as brute force.
+        std::sort(m_candidates.begin(), m_candidates.end());
+        for (int other : m_candidates)
+        {
+            pairsOut.push_back(Pair{ i, other });
+        }
+    }
+}
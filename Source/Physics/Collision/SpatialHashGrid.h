@@ -0,0 +1,56 @@
+/*
+* SpatialHashGrid.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <Common/Math/Vector4.h>
+
+#include <vector>
+
+// Broadphase which finds pairs of close points by hashing them into a uniform grid.
+// Points are sorted by their hashed cells with counting sort, so building the grid is O(N) and doesn't allocate memory once buffers are warmed up.
+class SpatialHashGrid
+{
+public:
+    // Pair of indices of points. m_a is always smaller than m_b.
+    struct Pair
+    {
+        int m_a, m_b;
+    };
+
+    // Type definitions.
+    using Positions = std::vector<Vector4>;
+    using Pairs = std::vector<Pair>;
+
+    // Find all pairs of points whose distance is less than distance and append them to pairsOut.
+    // Pairs are sorted by m_a first and m_b second, which is the same order as brute force double loop.
+    void findPairs(const Positions& positions, const SimdFloat& distance, Pairs& pairsOut);
+
+protected:
+    // Integer coordinate of a cell.
+    struct Cell
+    {
+        int m_x, m_y, m_z;
+
+        inline bool operator==(const Cell& other) const { return m_x == other.m_x && m_y == other.m_y && m_z == other.m_z; }
+    };
+
+    // Build the grid. Each cell is a cube whose edge length is cellSize.
+    void build(const Positions& positions, float cellSize);
+
+    // Return a cell containing the position.
+    inline auto getCell(const Vector4& position) const->Cell;
+
+    // Return index of bucket of the cell.
+    inline int getBucket(const Cell& cell) const;
+
+    std::vector<Cell> m_cells;          // Cell of each point.
+    std::vector<int> m_bucketStarts;    // Start index of each bucket in m_sortedPoints. Has one extra element at the end.
+    std::vector<int> m_sortedPoints;    // Indices of points sorted by bucket.
+    std::vector<int> m_candidates;      // Temporary buffer of colliding points found for a point.
+    float m_invCellSize = 1.f;          // Inverse of the size of a cell.
+    int m_bucketMask = 0;               // The number of buckets minus 1. The number of buckets is power of two.
+};
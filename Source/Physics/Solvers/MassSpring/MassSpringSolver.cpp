@@ -8,12 +8,88 @@
 #include <Physics/Solvers/MassSpring/MassSpringSolver.h>
 #include <Physics/Systems/PointBasedSystem.h>
 
+#include <omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+namespace
+{
+    // Offset of a slot of spring blocks whose other vertices are not consecutive.
+    constexpr int s_gatheredSlot = std::numeric_limits<int>::min();
+
+    // Minimum number of springs and collider queries per thread to accumulate forces in parallel.
+    constexpr int s_minWorkPerThread = 256;
+
+#ifdef USE_SSE
+    // Calculate spring and damping forces applied to vertex A of 4 springs.
+    // d is position of vertex B minus position of vertex A and dv is velocity of vertex A minus velocity of vertex B.
+    inline void calcSpringForces(
+        __m128 dx, __m128 dy, __m128 dz, __m128 dvx, __m128 dvy, __m128 dvz,
+        __m128 restLength, __m128 springFactor, __m128 dampingFactor,
+        __m128& fxOut, __m128& fyOut, __m128& fzOut)
+    {
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        const __m128 invLength = _mm_div_ps(_mm_set1_ps(1.f), length);
+        const __m128 nx = _mm_mul_ps(dx, invLength);
+        const __m128 ny = _mm_mul_ps(dy, invLength);
+        const __m128 nz = _mm_mul_ps(dz, invLength);
+
+        const __m128 velDiff = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, dvx), _mm_mul_ps(ny, dvy)), _mm_mul_ps(nz, dvz));
+        const __m128 factor = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(length, restLength), springFactor), _mm_mul_ps(dampingFactor, velDiff));
+
+        fxOut = _mm_mul_ps(factor, nx);
+        fyOut = _mm_mul_ps(factor, ny);
+        fzOut = _mm_mul_ps(factor, nz);
+    }
+#endif
+
+#if defined(USE_SSE) && defined(__AVX2__)
+    // Same as above for 8 springs. Springs of zero length have zero forces so that unused lanes can connect a vertex to itself.
+    inline void calcSpringForces(
+        __m256 dx, __m256 dy, __m256 dz, __m256 dvx, __m256 dvy, __m256 dvz,
+        __m256 restLength, __m256 springFactor, __m256 dampingFactor,
+        __m256& fxOut, __m256& fyOut, __m256& fzOut)
+    {
+        const __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+        const __m256 invLength = _mm256_and_ps(_mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_div_ps(_mm256_set1_ps(1.f), length));
+        const __m256 nx = _mm256_mul_ps(dx, invLength);
+        const __m256 ny = _mm256_mul_ps(dy, invLength);
+        const __m256 nz = _mm256_mul_ps(dz, invLength);
+
+        const __m256 velDiff = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, dvx), _mm256_mul_ps(ny, dvy)), _mm256_mul_ps(nz, dvz));
+        const __m256 factor = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(length, restLength), springFactor), _mm256_mul_ps(dampingFactor, velDiff));
+
+        fxOut = _mm256_mul_ps(factor, nx);
+        fyOut = _mm256_mul_ps(factor, ny);
+        fzOut = _mm256_mul_ps(factor, nz);
+    }
+#endif
+}
+
 MassSpringSolver::MassSpringSolver(PointBasedSystem& system, const Vector4& gravity, float dampingFactor)
     : m_positions(system.accessVertexPositions())
     , m_velocities(system.accessVertexVelocities())
     , m_colliders(system.getColliders())
+    , m_colliderTree(system.getColliderTree())
     , m_gravity(gravity)
     , m_dampingFactor(dampingFactor)
+    , m_particleLayout(system.getParticleLayout())
+    , m_positionsSoA(system.accessParticlePositions())
+    , m_velocitiesSoA(system.accessParticleVelocities())
+{
+    createConstraints(system);
+}
+
+void MassSpringSolver::reset(const PointBasedSystem& system)
+{
+    m_particleLayout = system.getParticleLayout();
+    assert(m_particleLayout == ParticleLayout::AOS || m_integrator != Integrator::IMPLICIT_EULER);
+    m_constraints.clear();
+    createConstraints(system);
+}
+
+void MassSpringSolver::createConstraints(const PointBasedSystem& system)
 {
     const int numVertices = (int)m_positions.size();
     m_forces.resize(numVertices);
@@ -37,19 +113,248 @@ MassSpringSolver::MassSpringSolver(PointBasedSystem& system, const Vector4& grav
             }
         }
     }
+
+    if (m_particleLayout == ParticleLayout::SOA)
+    {
+        createSpringBlocks();
+    }
 }
 
-void MassSpringSolver::solve(float deltaTimeIn)
+void MassSpringSolver::createSpringBlocks()
 {
     const int numVertices = (int)m_positions.size();
+    const int blockSize = ParticleArrays::s_padding;
+    const int numBlocks = (numVertices + blockSize - 1) / blockSize;
 
-    for (int i = 0; i < numVertices; i++)
+    std::vector<int> numSprings(numVertices, 0);
+    for (const Constraint& c : m_constraints)
     {
-        m_forces[i] = m_gravity;
+        numSprings[c.m_vertexA]++;
+        numSprings[c.m_vertexB]++;
     }
 
-    const int numConstraints = (int)m_constraints.size();
-    for (int i = 0; i < numConstraints; i++)
+    // Each block has as many slots as springs of its vertex with the most springs.
+    m_blockSlotStarts.resize(numBlocks + 1);
+    m_blockSlotStarts[0] = 0;
+    for (int block = 0; block < numBlocks; block++)
+    {
+        const int first = block * blockSize;
+        const int last = std::min(first + blockSize, numVertices);
+        m_blockSlotStarts[block + 1] = m_blockSlotStarts[block] + *std::max_element(numSprings.begin() + first, numSprings.begin() + last);
+    }
+
+    // Unused lanes connect the vertex to itself.
+    const int numLanes = m_blockSlotStarts[numBlocks] * blockSize;
+    m_slotOtherVertices.resize(numLanes);
+    m_slotLengths.assign(numLanes, 0.f);
+    m_slotSpringFactors.assign(numLanes, 0.f);
+    for (int block = 0; block < numBlocks; block++)
+    {
+        for (int slot = m_blockSlotStarts[block]; slot < m_blockSlotStarts[block + 1]; slot++)
+        {
+            for (int lane = 0; lane < blockSize; lane++)
+            {
+                m_slotOtherVertices[slot * blockSize + lane] = block * blockSize + lane;
+            }
+        }
+    }
+
+    // Store each spring at both of its vertices in the order of springs.
+    std::fill(numSprings.begin(), numSprings.end(), 0);
+    auto addSpring = [this, &numSprings, blockSize](int vertex, int otherVertex, const Constraint& c)
+    {
+        const int slot = m_blockSlotStarts[vertex / blockSize] + numSprings[vertex]++;
+        const int lane = slot * blockSize + vertex % blockSize;
+        m_slotOtherVertices[lane] = otherVertex;
+        m_slotLengths[lane] = c.m_length;
+        m_slotSpringFactors[lane] = c.m_springFactor;
+    };
+
+    for (const Constraint& c : m_constraints)
+    {
+        addSpring(c.m_vertexA, c.m_vertexB, c);
+        addSpring(c.m_vertexB, c.m_vertexA, c);
+    }
+
+    // Find slots connecting 8 vertices to 8 consecutive vertices, which are common in sheets and chains.
+    m_slotOffsets.resize(m_blockSlotStarts[numBlocks]);
+    for (int block = 0; block < numBlocks; block++)
+    {
+        for (int slot = m_blockSlotStarts[block]; slot < m_blockSlotStarts[block + 1]; slot++)
+        {
+            const int* others = &m_slotOtherVertices[slot * blockSize];
+            const int offset = others[0] - block * blockSize;
+            bool isConsecutive = true;
+            for (int lane = 1; lane < blockSize; lane++)
+            {
+                isConsecutive = isConsecutive && others[lane] == others[0] + lane;
+            }
+            m_slotOffsets[slot] = isConsecutive ? offset : s_gatheredSlot;
+        }
+    }
+}
+
+void MassSpringSolver::addRemoveVerticesAndEdges(const EdgeChanges& addedEdges, const EdgeChanges& removedEdges)
+{
+    // Vertices are already added to the external buffers.
+    m_forces.resize(m_positions.size());
+
+    // Remove springs while keeping the order of the rest.
+    if (!removedEdges.empty())
+    {
+        int numRemoved = 0;
+        const int numConstraints = (int)m_constraints.size();
+        for (int i = 0; i < numConstraints; i++)
+        {
+            const Constraint& c = m_constraints[i];
+
+            bool removed = false;
+            for (const EdgeChange& edge : removedEdges)
+            {
+                if ((c.m_vertexA == edge.m_vertexA && c.m_vertexB == edge.m_vertexB) || (c.m_vertexA == edge.m_vertexB && c.m_vertexB == edge.m_vertexA))
+                {
+                    removed = true;
+                    break;
+                }
+            }
+
+            if (removed)
+            {
+                numRemoved++;
+            }
+            else if (numRemoved > 0)
+            {
+                m_constraints[i - numRemoved] = c;
+            }
+        }
+
+        assert(numRemoved == (int)removedEdges.size());
+        m_constraints.resize(numConstraints - numRemoved);
+    }
+
+    for (const EdgeChange& edge : addedEdges)
+    {
+        m_constraints.push_back(Constraint{ edge.m_vertexA, edge.m_vertexB, edge.m_length, edge.m_stiffness });
+    }
+
+    if (m_particleLayout == ParticleLayout::SOA)
+    {
+        createSpringBlocks();
+    }
+}
+
+void MassSpringSolver::solve(float deltaTime)
+{
+    findCandidateColliders();
+
+    switch (m_particleLayout)
+    {
+    case ParticleLayout::AOS:
+        solveAoS(deltaTime);
+        break;
+    case ParticleLayout::SOA:
+        solveSoA(deltaTime);
+        break;
+    default:
+        assert(0);
+        break;
+    }
+}
+
+int MassSpringSolver::calcNumThreadsToUse() const
+{
+    // Don't spawn threads which would have only a few springs or collider queries.
+    const int work = (int)m_constraints.size() + (int)m_positions.size() * (int)m_candidateColliders.size();
+    return std::max(1, std::min(m_numThreads, work / s_minWorkPerThread));
+}
+
+void MassSpringSolver::findCandidateColliders()
+{
+    m_candidateColliders.clear();
+    if (m_colliders.empty() || m_positions.empty())
+    {
+        return;
+    }
+
+    // Penalty forces are applied only to vertices inside colliders, so colliders not touching bounds of the vertices are skipped.
+    Aabb aabb;
+    if (m_particleLayout == ParticleLayout::SOA)
+    {
+        m_positionsSoA.getAabb(aabb);
+    }
+    else
+    {
+        aabb.set(m_positions[0], m_positions[0]);
+        for (const Vector4& position : m_positions)
+        {
+            aabb.include(position);
+        }
+    }
+    m_colliderTree.query(aabb, m_candidateColliders);
+
+    // Keep the order of colliders so that forces are summed up deterministically.
+    std::sort(m_candidateColliders.begin(), m_candidateColliders.end());
+}
+
+void MassSpringSolver::accumulateSpringForces(int start, int end, std::vector<Vector4>& forcesOut) const
+{
+    int i = start;
+
+#ifdef USE_SSE
+    const __m128 dampingFactor = _mm_set1_ps(m_dampingFactor.getFloat());
+    for (; i + 4 <= end; i += 4)
+    {
+        const Constraint* c = &m_constraints[i];
+
+        // Load positions and velocities and transpose them to x, y and z of 4 springs.
+        __m128 ax = m_positions[c[0].m_vertexA].getQuad();
+        __m128 ay = m_positions[c[1].m_vertexA].getQuad();
+        __m128 az = m_positions[c[2].m_vertexA].getQuad();
+        __m128 aw = m_positions[c[3].m_vertexA].getQuad();
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+
+        __m128 bx = m_positions[c[0].m_vertexB].getQuad();
+        __m128 by = m_positions[c[1].m_vertexB].getQuad();
+        __m128 bz = m_positions[c[2].m_vertexB].getQuad();
+        __m128 bw = m_positions[c[3].m_vertexB].getQuad();
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+        __m128 vax = m_velocities[c[0].m_vertexA].getQuad();
+        __m128 vay = m_velocities[c[1].m_vertexA].getQuad();
+        __m128 vaz = m_velocities[c[2].m_vertexA].getQuad();
+        __m128 vaw = m_velocities[c[3].m_vertexA].getQuad();
+        _MM_TRANSPOSE4_PS(vax, vay, vaz, vaw);
+
+        __m128 vbx = m_velocities[c[0].m_vertexB].getQuad();
+        __m128 vby = m_velocities[c[1].m_vertexB].getQuad();
+        __m128 vbz = m_velocities[c[2].m_vertexB].getQuad();
+        __m128 vbw = m_velocities[c[3].m_vertexB].getQuad();
+        _MM_TRANSPOSE4_PS(vbx, vby, vbz, vbw);
+
+        __m128 fx, fy, fz;
+        calcSpringForces(
+            _mm_sub_ps(bx, ax), _mm_sub_ps(by, ay), _mm_sub_ps(bz, az),
+            _mm_sub_ps(vax, vbx), _mm_sub_ps(vay, vby), _mm_sub_ps(vaz, vbz),
+            _mm_setr_ps(c[0].m_length, c[1].m_length, c[2].m_length, c[3].m_length),
+            _mm_setr_ps(c[0].m_springFactor, c[1].m_springFactor, c[2].m_springFactor, c[3].m_springFactor),
+            dampingFactor, fx, fy, fz);
+
+        // Transpose forces back to each spring.
+        // Springs in a batch can share vertices, so forces are added spring by spring.
+        __m128 fw = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(fx, fy, fz, fw);
+        const __m128 forces[4] = { fx, fy, fz, fw };
+        for (int j = 0; j < 4; j++)
+        {
+            __m128& forceA = forcesOut[c[j].m_vertexA].accessQuad();
+            __m128& forceB = forcesOut[c[j].m_vertexB].accessQuad();
+            forceA = _mm_add_ps(forceA, forces[j]);
+            forceB = _mm_sub_ps(forceB, forces[j]);
+        }
+    }
+#endif
+
+    for (; i < end; i++)
     {
         const Constraint& c = m_constraints[i];
         const Vector4& posA = m_positions[c.m_vertexA];
@@ -61,40 +366,452 @@ void MassSpringSolver::solve(float deltaTimeIn)
         aToB.normalize<3>();
         SimdFloat velDiff = aToB.dot<3>(m_velocities[c.m_vertexA] - m_velocities[c.m_vertexB]);
 
-        const SimdFloat factor = (length - c.m_length) * c.m_springFactor - m_dampingFactor * velDiff;
+        const SimdFloat factor = (length - SimdFloat(c.m_length)) * SimdFloat(c.m_springFactor) - m_dampingFactor * velDiff;
 
-        Vector4& forceA = m_forces[c.m_vertexA];
-        Vector4& forceB = m_forces[c.m_vertexB];
+        Vector4& forceA = forcesOut[c.m_vertexA];
+        Vector4& forceB = forcesOut[c.m_vertexB];
         forceA += factor * aToB;
         forceB -= factor * aToB;
     }
+}
+
+void MassSpringSolver::accumulateSpringForces(int startBlock, int endBlock, ParticleArrays& forcesOut) const
+{
+    const int blockSize = ParticleArrays::s_padding;
+    const float* px = m_positionsSoA.m_x.data();
+    const float* py = m_positionsSoA.m_y.data();
+    const float* pz = m_positionsSoA.m_z.data();
+    const float* vx = m_velocitiesSoA.m_x.data();
+    const float* vy = m_velocitiesSoA.m_y.data();
+    const float* vz = m_velocitiesSoA.m_z.data();
+    float* fx = forcesOut.m_x.data();
+    float* fy = forcesOut.m_y.data();
+    float* fz = forcesOut.m_z.data();
+
+#if defined(USE_SSE) && defined(__AVX2__)
+    const __m256 dampingFactor = _mm256_set1_ps(m_dampingFactor.getFloat());
+    const __m256 gravityX = _mm256_set1_ps(m_gravity(0));
+    const __m256 gravityY = _mm256_set1_ps(m_gravity(1));
+    const __m256 gravityZ = _mm256_set1_ps(m_gravity(2));
+    auto gather = [](const float* v, __m256i indices) { return _mm256_i32gather_ps(v, indices, 4); };
+
+    for (int block = startBlock; block < endBlock; block++)
+    {
+        const int first = block * blockSize;
+        const __m256 x = _mm256_load_ps(&px[first]);
+        const __m256 y = _mm256_load_ps(&py[first]);
+        const __m256 z = _mm256_load_ps(&pz[first]);
+        const __m256 u = _mm256_load_ps(&vx[first]);
+        const __m256 v = _mm256_load_ps(&vy[first]);
+        const __m256 w = _mm256_load_ps(&vz[first]);
+
+        // Forces of the 8 vertices are summed in registers since each lane belongs to one vertex.
+        __m256 sumX = gravityX;
+        __m256 sumY = gravityY;
+        __m256 sumZ = gravityZ;
+        for (int slot = m_blockSlotStarts[block]; slot < m_blockSlotStarts[block + 1]; slot++)
+        {
+            const int lane = slot * blockSize;
+
+            // Consecutive other vertices are loaded at once instead of gathered.
+            __m256 ox, oy, oz, ou, ov, ow;
+            if (m_slotOffsets[slot] != s_gatheredSlot)
+            {
+                const int o = first + m_slotOffsets[slot];
+                ox = _mm256_loadu_ps(&px[o]);
+                oy = _mm256_loadu_ps(&py[o]);
+                oz = _mm256_loadu_ps(&pz[o]);
+                ou = _mm256_loadu_ps(&vx[o]);
+                ov = _mm256_loadu_ps(&vy[o]);
+                ow = _mm256_loadu_ps(&vz[o]);
+            }
+            else
+            {
+                const __m256i other = _mm256_load_si256((const __m256i*)&m_slotOtherVertices[lane]);
+                ox = gather(px, other);
+                oy = gather(py, other);
+                oz = gather(pz, other);
+                ou = gather(vx, other);
+                ov = gather(vy, other);
+                ow = gather(vz, other);
+            }
+
+            __m256 forceX, forceY, forceZ;
+            calcSpringForces(
+                _mm256_sub_ps(ox, x), _mm256_sub_ps(oy, y), _mm256_sub_ps(oz, z),
+                _mm256_sub_ps(u, ou), _mm256_sub_ps(v, ov), _mm256_sub_ps(w, ow),
+                _mm256_load_ps(&m_slotLengths[lane]), _mm256_load_ps(&m_slotSpringFactors[lane]), dampingFactor,
+                forceX, forceY, forceZ);
+
+            sumX = _mm256_add_ps(sumX, forceX);
+            sumY = _mm256_add_ps(sumY, forceY);
+            sumZ = _mm256_add_ps(sumZ, forceZ);
+        }
+
+        _mm256_store_ps(&fx[first], sumX);
+        _mm256_store_ps(&fy[first], sumY);
+        _mm256_store_ps(&fz[first], sumZ);
+    }
+#else
+    const float dampingFactor = m_dampingFactor.getFloat();
+    for (int block = startBlock; block < endBlock; block++)
+    {
+        for (int i = block * blockSize; i < (block + 1) * blockSize; i++)
+        {
+            fx[i] = m_gravity(0);
+            fy[i] = m_gravity(1);
+            fz[i] = m_gravity(2);
+        }
+
+        for (int slot = m_blockSlotStarts[block]; slot < m_blockSlotStarts[block + 1]; slot++)
+        {
+            for (int i = block * blockSize; i < (block + 1) * blockSize; i++)
+            {
+                const int lane = slot * blockSize + i % blockSize;
+                const int other = m_slotOtherVertices[lane];
+
+                const float dx = px[other] - px[i];
+                const float dy = py[other] - py[i];
+                const float dz = pz[other] - pz[i];
+                const float length = sqrtf(dx * dx + dy * dy + dz * dz);
+                if (length <= 0.f)
+                {
+                    continue;
+                }
+
+                const float invLength = 1.f / length;
+                const float velDiff = (dx * (vx[i] - vx[other]) + dy * (vy[i] - vy[other]) + dz * (vz[i] - vz[other])) * invLength;
+                const float factor = ((length - m_slotLengths[lane]) * m_slotSpringFactors[lane] - dampingFactor * velDiff) * invLength;
+
+                fx[i] += factor * dx;
+                fy[i] += factor * dy;
+                fz[i] += factor * dz;
+            }
+        }
+    }
+#endif
+}
+
+void MassSpringSolver::accumulateColliderForces(int start, int end, std::vector<Vector4>& forcesInOut)
+{
+    const SimdFloat k(m_colliderStiffness);
+    for (int colIdx : m_candidateColliders)
+    {
+        m_colliders[colIdx].getShape()->getClosestPoints(m_positions.data() + start, end - start, m_closestPoints.data() + start);
+
+        for (int vi = start; vi < end; vi++)
+        {
+            const Shape::ClosestPointOutput& cpOut = m_closestPoints[vi];
+            Vector4 dir = cpOut.m_closestPoint - m_positions[vi];
+            if (dir.dot<3>(cpOut.m_normal) > SimdFloat_0)
+            {
+                forcesInOut[vi] += k * dir;
+            }
+        }
+    }
+}
 
-    const int numColliders = (int)m_colliders.size();
-    const SimdFloat k = SimdFloat(5000.f);
-    for (int vi = 0; vi < numVertices; vi++)
+void MassSpringSolver::accumulateColliderForces(int start, int end, ParticleArrays& forcesInOut)
+{
+    const SimdFloat k(m_colliderStiffness);
+    for (int colIdx : m_candidateColliders)
     {
-        Vector4& pos = m_positions[vi];
-        for (int ci = 0; ci < numColliders; ci++)
+        const Shape* shape = m_colliders[colIdx].getShape();
+        Aabb aabb;
+        shape->getAabb(aabb);
+
+        // Only vertices inside the AABB of the collider can be inside it, so others are not queried.
+        // Vertices in the range are packed at the front of the same range of query buffers.
+        int queryEnd = start;
+        for (int vi = start; vi < end; vi++)
         {
-            const Shape* shape = m_colliders[ci].getShape();
+            const Vector4 position = m_positionsSoA.get(vi);
+            if (aabb.contains(position))
+            {
+                m_queryVertices[queryEnd] = vi;
+                m_queryPositions[queryEnd] = position;
+                queryEnd++;
+            }
+        }
+
+        shape->getClosestPoints(m_queryPositions.data() + start, queryEnd - start, m_closestPoints.data() + start);
 
-            Shape::ClosestPointOutput cpOut;
-            shape->getClosestPoint(pos, cpOut);
-            Vector4 dir = cpOut.m_closestPoint - pos;
+        for (int i = start; i < queryEnd; i++)
+        {
+            const Shape::ClosestPointOutput& cpOut = m_closestPoints[i];
+            Vector4 dir = cpOut.m_closestPoint - m_queryPositions[i];
             if (dir.dot<3>(cpOut.m_normal) > SimdFloat_0)
             {
-                Vector4 uDir = dir;
-                uDir.normalize<3>();
-                Vector4& force = m_forces[vi];
-                force += k * dir;
+                const int vi = m_queryVertices[i];
+                forcesInOut.set(vi, forcesInOut.get(vi) + k * dir);
             }
         }
     }
+}
+
+void MassSpringSolver::solveAoS(float deltaTimeIn)
+{
+    const int numVertices = (int)m_positions.size();
+    const int numConstraints = (int)m_constraints.size();
+    const int numThreads = calcNumThreadsToUse();
+
+    for (int i = 0; i < numVertices; i++)
+    {
+        m_forces[i] = m_gravity;
+    }
+
+    if ((int)m_threadForces.size() < numThreads - 1)
+    {
+        m_threadForces.resize(numThreads - 1);
+    }
+    m_closestPoints.resize(numVertices);
+
+    #pragma omp parallel num_threads(numThreads) if(numThreads > 1)
+    {
+        const int thread = omp_get_thread_num();
+        const int numActiveThreads = omp_get_num_threads();
+
+        // Each thread accumulates spring forces of a contiguous range of springs into its own buffer.
+        // The master thread accumulates directly into m_forces.
+        Forces& forces = thread == 0 ? m_forces : m_threadForces[thread - 1];
+        if (thread > 0)
+        {
+            forces.assign(numVertices, Vec4_0);
+        }
+
+        const int start = (int)((int64_t)numConstraints * thread / numActiveThreads);
+        const int end = (int)((int64_t)numConstraints * (thread + 1) / numActiveThreads);
+        accumulateSpringForces(start, end, forces);
+
+        #pragma omp barrier
+
+        // Sum up forces of all threads.
+        #pragma omp for schedule(static)
+        for (int vi = 0; vi < numVertices; vi++)
+        {
+            Vector4& force = m_forces[vi];
+            for (int t = 1; t < numActiveThreads; t++)
+            {
+                force += m_threadForces[t - 1][vi];
+            }
+        }
+
+        // Add penalty forces of colliders. Each thread queries colliders once for a contiguous range of vertices.
+        const int vertexStart = (int)((int64_t)numVertices * thread / numActiveThreads);
+        const int vertexEnd = (int)((int64_t)numVertices * (thread + 1) / numActiveThreads);
+        accumulateColliderForces(vertexStart, vertexEnd, m_forces);
+    }
 
     SimdFloat dt(deltaTimeIn);
+    switch (m_integrator)
+    {
+    case Integrator::EXPLICIT_EULER:
+        for (int i = 0; i < numVertices; i++)
+        {
+            m_positions[i] += m_velocities[i] * dt;
+            m_velocities[i] += m_forces[i] * dt;
+        }
+        break;
+    case Integrator::SEMI_IMPLICIT_EULER:
+        for (int i = 0; i < numVertices; i++)
+        {
+            m_velocities[i] += m_forces[i] * dt;
+            m_positions[i] += m_velocities[i] * dt;
+        }
+        break;
+    case Integrator::IMPLICIT_EULER:
+        integrateImplicit(deltaTimeIn);
+        break;
+    default:
+        assert(0);
+        break;
+    }
+}
+
+void MassSpringSolver::solveSoA(float deltaTimeIn)
+{
+    // Particles are simulated in the arrays of the system directly. The implicit integrator works only on Vector4 particles.
+    assert(m_integrator != Integrator::IMPLICIT_EULER);
+
+    const int numVertices = m_positionsSoA.getSize();
+    const int numThreads = calcNumThreadsToUse();
+    assert(m_velocitiesSoA.getSize() == numVertices);
+
+    m_forcesSoA.resize(numVertices);
+
+    const int paddedSize = m_positionsSoA.getPaddedSize();
+    const int numBlocks = paddedSize / ParticleArrays::s_padding;
+    m_closestPoints.resize(numVertices);
+    m_queryPositions.resize(numVertices);
+    m_queryVertices.resize(numVertices);
+
+    // Each thread accumulates all the forces of a contiguous range of vertex blocks, so no thread writes forces of the others.
+    #pragma omp parallel num_threads(numThreads) if(numThreads > 1)
+    {
+        const int thread = omp_get_thread_num();
+        const int numActiveThreads = omp_get_num_threads();
+        const int startBlock = (int)((int64_t)numBlocks * thread / numActiveThreads);
+        const int endBlock = (int)((int64_t)numBlocks * (thread + 1) / numActiveThreads);
+
+        accumulateSpringForces(startBlock, endBlock, m_forcesSoA);
+        accumulateColliderForces(std::min(startBlock * ParticleArrays::s_padding, numVertices), std::min(endBlock * ParticleArrays::s_padding, numVertices), m_forcesSoA);
+    }
+
+    // Padding vertices got gravity too, so their forces are cleared to keep padding zero.
+    for (int i = numVertices; i < paddedSize; i++)
+    {
+        m_forcesSoA.m_x[i] = m_forcesSoA.m_y[i] = m_forcesSoA.m_z[i] = 0.f;
+    }
+
+    // Integrate all the particles including padding. Padding stays zero since its forces and velocities are zero.
+    const bool updatePositionsFirst = m_integrator == Integrator::EXPLICIT_EULER;
+    auto integrate = [paddedSize, deltaTimeIn, updatePositionsFirst](float* x, float* v, const float* f)
+    {
+#if defined(USE_SSE) && defined(__AVX__)
+        const __m256 dt = _mm256_set1_ps(deltaTimeIn);
+        for (int i = 0; i < paddedSize; i += 8)
+        {
+            const __m256 oldVel = _mm256_load_ps(&v[i]);
+            const __m256 vel = _mm256_add_ps(oldVel, _mm256_mul_ps(_mm256_load_ps(&f[i]), dt));
+            _mm256_store_ps(&v[i], vel);
+            _mm256_store_ps(&x[i], _mm256_add_ps(_mm256_load_ps(&x[i]), _mm256_mul_ps(updatePositionsFirst ? oldVel : vel, dt)));
+        }
+#else
+        for (int i = 0; i < paddedSize; i++)
+        {
+            const float oldVel = v[i];
+            v[i] += f[i] * deltaTimeIn;
+            x[i] += (updatePositionsFirst ? oldVel : v[i]) * deltaTimeIn;
+        }
+#endif
+    };
+
+    integrate(m_positionsSoA.m_x.data(), m_velocitiesSoA.m_x.data(), m_forcesSoA.m_x.data());
+    integrate(m_positionsSoA.m_y.data(), m_velocitiesSoA.m_y.data(), m_forcesSoA.m_y.data());
+    integrate(m_positionsSoA.m_z.data(), m_velocitiesSoA.m_z.data(), m_forcesSoA.m_z.data());
+}
+
+void MassSpringSolver::integrateImplicit(float deltaTimeIn)
+{
+    // Solve (I - dt * df/dv - dt^2 * df/dx) * dv = dt * (f + dt * df/dx * v) for velocity change dv.
+    // Masses of vertices are one. Forces of gravity and colliders are treated explicitly.
+    const int numVertices = (int)m_positions.size();
+    const int numConstraints = (int)m_constraints.size();
+    const float dt = deltaTimeIn;
+    const float dampingFactor = m_dampingFactor.getFloat();
+
+    m_springJacobians.resize(numConstraints);
+    m_deltaVelocities.resize(numVertices);
+    m_residuals.resize(numVertices);
+    m_searchDirections.resize(numVertices);
+    m_products.resize(numVertices);
+
+    const SimdFloat dtSimd(dt);
+    for (int i = 0; i < numVertices; i++)
+    {
+        m_residuals[i] = m_forces[i] * dtSimd;
+    }
+
+    for (int i = 0; i < numConstraints; i++)
+    {
+        const Constraint& c = m_constraints[i];
+        SpringJacobian& jacobian = m_springJacobians[i];
+
+        Vector4 dir = m_positions[c.m_vertexB] - m_positions[c.m_vertexA];
+        const float length = dir.length<3>().getFloat();
+        if (length <= std::numeric_limits<float>::epsilon())
+        {
+            jacobian.m_direction = Vec4_0;
+            jacobian.m_alpha = jacobian.m_beta = jacobian.m_beta0 = 0.f;
+            continue;
+        }
+
+        dir /= SimdFloat(length);
+        dir.setComponent<3>(SimdFloat_0);
+
+        // df/dx of a spring is k * ((1 - L / l) * I + (L / l) * n * n^T).
+        // The isotropic term is dropped for compressed springs to keep the matrix positive definite.
+        const float stretch = std::max(1.f - c.m_length / length, 0.f);
+        const float kdt2 = c.m_springFactor * dt * dt;
+        jacobian.m_direction = dir;
+        jacobian.m_alpha = kdt2 * stretch;
+        jacobian.m_beta0 = kdt2 * (1.f - stretch);
+        jacobian.m_beta = jacobian.m_beta0 + dt * dampingFactor;
+
+        // Add dt^2 * df/dx * v to the right hand side.
+        const Vector4 relVel = m_velocities[c.m_vertexA] - m_velocities[c.m_vertexB];
+        const Vector4 w = SimdFloat(jacobian.m_alpha) * relVel + (SimdFloat(jacobian.m_beta0) * dir.dot<3>(relVel)) * dir;
+        m_residuals[c.m_vertexA] -= w;
+        m_residuals[c.m_vertexB] += w;
+    }
+
+    // Conjugate gradient starting from dv = 0.
+    SimdFloat rr = SimdFloat_0;
     for (int i = 0; i < numVertices; i++)
     {
-        m_velocities[i] += m_forces[i] * dt;
-        m_positions[i] += m_velocities[i] * dt;
+        m_deltaVelocities[i].setZero();
+        m_searchDirections[i] = m_residuals[i];
+        rr += m_residuals[i].dot<3>(m_residuals[i]);
+    }
+
+    const SimdFloat tolerance = rr * SimdFloat(1e-8f);
+    for (int iter = 0; iter < m_implicitIterations && rr > tolerance; iter++)
+    {
+        multiplySystemMatrix(m_searchDirections, m_products);
+
+        SimdFloat pAp = SimdFloat_0;
+        for (int i = 0; i < numVertices; i++)
+        {
+            pAp += m_searchDirections[i].dot<3>(m_products[i]);
+        }
+
+        if (pAp <= SimdFloat_0)
+        {
+            break;
+        }
+
+        const SimdFloat alpha = rr / pAp;
+        SimdFloat rrNew = SimdFloat_0;
+        for (int i = 0; i < numVertices; i++)
+        {
+            m_deltaVelocities[i] += alpha * m_searchDirections[i];
+            m_residuals[i] -= alpha * m_products[i];
+            rrNew += m_residuals[i].dot<3>(m_residuals[i]);
+        }
+
+        const SimdFloat beta = rrNew / rr;
+        for (int i = 0; i < numVertices; i++)
+        {
+            m_searchDirections[i] = m_residuals[i] + beta * m_searchDirections[i];
+        }
+
+        rr = rrNew;
+    }
+
+    for (int i = 0; i < numVertices; i++)
+    {
+        m_velocities[i] += m_deltaVelocities[i];
+        m_positions[i] += m_velocities[i] * dtSimd;
+    }
+}
+
+void MassSpringSolver::multiplySystemMatrix(const std::vector<Vector4>& vectors, std::vector<Vector4>& productOut) const
+{
+    const int numVertices = (int)vectors.size();
+    for (int i = 0; i < numVertices; i++)
+    {
+        productOut[i] = vectors[i];
+    }
+
+    const int numConstraints = (int)m_constraints.size();
+    for (int i = 0; i < numConstraints; i++)
+    {
+        const Constraint& c = m_constraints[i];
+        const SpringJacobian& jacobian = m_springJacobians[i];
+
+        const Vector4 rel = vectors[c.m_vertexA] - vectors[c.m_vertexB];
+        const Vector4 w = SimdFloat(jacobian.m_alpha) * rel + (SimdFloat(jacobian.m_beta) * jacobian.m_direction.dot<3>(rel)) * jacobian.m_direction;
+        productOut[c.m_vertexA] += w;
+        productOut[c.m_vertexB] -= w;
     }
 }
@@ -7,15 +7,34 @@
 #pragma once
 
 #include <Physics/Solvers/PointBasedSystemSolver.h>
+#include <Physics/Solvers/ParticleArrays.h>
 #include <Physics/Collision/Collider.h>
+#include <Physics/Collision/DynamicAabbTree.h>
 #include <Common/Math/Vector4.h>
 
 class PointBasedSystem;
 
 // Mass spring solver.
+// Spring forces are evaluated for 4 springs at once by SIMD. With multiple threads, each thread accumulates forces of
+// a contiguous range of springs into its own buffer and the buffers are summed per vertex afterwards.
+// When particle layout of the system is SOA, the solver works on the arrays of the system directly and processes 8 vertices
+// at once by AVX instead. Each vertex sums forces of its own springs, so each spring is evaluated twice but forces are
+// written without scattering nor per thread buffers. This is fastest when vertices connected by springs have consecutive
+// indices as in sheets and chains since their particles are loaded without gathering. IMPLICIT_EULER is not supported with SOA.
 class MassSpringSolver : public PointBasedSystemSolver
 {
 public:
+    // Time integration scheme.
+    enum class Integrator
+    {
+        EXPLICIT_EULER,         // Update positions by old velocities. Only stable for very small time steps.
+        SEMI_IMPLICIT_EULER,    // Update positions by new velocities.
+        IMPLICIT_EULER          // Linearized backward Euler solved by conjugate gradient. Stable for stiff springs and large time steps.
+    };
+
+    // Default stiffness of penalty forces of colliders.
+    static constexpr float s_defaultColliderStiffness = 5000.f;
+
     // Constructor.
     MassSpringSolver(PointBasedSystem& system, const Vector4& gravity, float dampingFactor);
 
@@ -24,17 +43,82 @@ public:
 
     virtual Type getType() const override { return Type::MASS_SPRING; }
 
+    // Patch buffers and springs in place for added and removed vertices and edges.
+    virtual void addRemoveVerticesAndEdges(const EdgeChanges& addedEdges, const EdgeChanges& removedEdges) override;
+
+    // Rebuild springs in place reusing buffers.
+    virtual void reset(const PointBasedSystem& system) override;
+
+    inline int getNumConstraints() const { return (int)m_constraints.size(); }
+
     inline auto getDampingFactor() const->const SimdFloat& { return m_dampingFactor; }
 
     inline auto getGravity() const->const Vector4& { return m_gravity; }
 
+    inline float getColliderStiffness() const { return m_colliderStiffness; }
+    inline void setColliderStiffness(float stiffness) { assert(stiffness >= 0.f); m_colliderStiffness = stiffness; }
+
+    inline auto getIntegrator() const->Integrator { return m_integrator; }
+    inline void setIntegrator(Integrator integrator) { assert(m_particleLayout == ParticleLayout::AOS || integrator != Integrator::IMPLICIT_EULER); m_integrator = integrator; }
+
+    // Maximum number of conjugate gradient iterations per step of IMPLICIT_EULER.
+    inline int getImplicitIterations() const { return m_implicitIterations; }
+    inline void setImplicitIterations(int iterations) { assert(iterations > 0); m_implicitIterations = iterations; }
+
+    inline int getNumThreads() const { return m_numThreads; }
+    inline void setNumThreads(int numThreads) { assert(numThreads > 0); m_numThreads = numThreads; }
+
 protected:
+    // Create springs at all edges between vertices in the system.
+    void createConstraints(const PointBasedSystem& system);
+
+    // Store springs into slots of blocks of vertices for SOA layout.
+    void createSpringBlocks();
+
+    // Step and solve with Vector4 particles.
+    void solveAoS(float deltaTime);
+
+    // Step and solve with particles in structure of arrays.
+    void solveSoA(float deltaTime);
+
+    // Return the number of threads to accumulate forces with.
+    int calcNumThreadsToUse() const;
+
+    // Find colliders whose AABBs may contain any vertex by the collider tree.
+    void findCandidateColliders();
+
+    // Add spring forces of springs [start, end) to forcesOut.
+    void accumulateSpringForces(int start, int end, std::vector<Vector4>& forcesOut) const;
+
+    // Set gravity and spring forces of vertices in blocks [startBlock, endBlock) to forcesOut.
+    void accumulateSpringForces(int startBlock, int endBlock, ParticleArrays& forcesOut) const;
+
+    // Add penalty forces of candidate colliders to vertices [start, end). Each collider is queried once for the whole range.
+    void accumulateColliderForces(int start, int end, std::vector<Vector4>& forcesInOut);
+    void accumulateColliderForces(int start, int end, ParticleArrays& forcesInOut);
+
+    // Integrate velocities and positions by m_forces with linearized backward Euler.
+    void integrateImplicit(float deltaTime);
+
+    // Calculate productOut = (I - dt * df/dv - dt^2 * df/dx) * vectors using the spring Jacobians.
+    void multiplySystemMatrix(const std::vector<Vector4>& vectors, std::vector<Vector4>& productOut) const;
+
     // Spring constraint.
     struct Constraint
     {
         int m_vertexA, m_vertexB;   // Indices of two vertices connected by this spring.
-        SimdFloat m_length;         // The natural length of this spring.
-        SimdFloat m_springFactor;   // The spring factor.
+        float m_length;             // The natural length of this spring.
+        float m_springFactor;       // The spring factor.
+    };
+
+    // Jacobian of a spring used by IMPLICIT_EULER.
+    // The system matrix block of the spring applied to relative velocity u is m_alpha * u + m_beta * n * dot(n, u).
+    struct SpringJacobian
+    {
+        Vector4 m_direction;    // Normalized direction n of the spring.
+        float m_alpha;          // Coefficient of the isotropic term.
+        float m_beta;           // Coefficient of the term along the spring.
+        float m_beta0;          // m_beta without damping, used to build the right hand side.
     };
 
     // Type definitions.
@@ -43,12 +127,45 @@ protected:
     using Forces = std::vector<Vector4>;
     using Constraints = std::vector<Constraint>;
     using Colliders = std::vector<Collider>;
+    using SpringJacobians = std::vector<SpringJacobian>;
 
     Positions& m_positions;         // External buffer of vertex positions.
     Velocities& m_velocities;       // External buffer of vertex velocities.
     Forces m_forces;                // Forces for each vertex.
     Constraints m_constraints;      // The springs.
-    const Colliders& m_colliders;   // The colliders.
+    const Colliders& m_colliders;           // The colliders.
+    const DynamicAabbTree& m_colliderTree;  // Broadphase of the colliders.
     Vector4 m_gravity;
     SimdFloat m_dampingFactor;
+
+    ParticleLayout m_particleLayout;    // Memory layout of particles.
+    ParticleArrays& m_positionsSoA;     // External arrays of vertex positions. Used when m_particleLayout is SOA.
+    ParticleArrays& m_velocitiesSoA;    // External arrays of vertex velocities. Used when m_particleLayout is SOA.
+    ParticleArrays m_forcesSoA;         // Forces in structure of arrays. Used when m_particleLayout is SOA.
+
+    // Springs of blocks of s_padding consecutive vertices used when m_particleLayout is SOA.
+    // Lane i of a slot of a block stores a spring of the i-th vertex of the block so that one slot is loaded at once.
+    std::vector<int> m_blockSlotStarts;                                 // Start slot of each block followed by the total number of slots.
+    std::vector<int, AlignedAllocator<int, 32>> m_slotOtherVertices;    // The other vertex of the spring of each lane.
+    ParticleArrays::Floats m_slotLengths;                               // The natural length of the spring of each lane.
+    ParticleArrays::Floats m_slotSpringFactors;                         // The spring factor of each lane. Zero for unused lanes.
+    std::vector<int> m_slotOffsets;                                     // Offset to other vertices of each slot if they are consecutive.
+
+    float m_colliderStiffness = s_defaultColliderStiffness; // Stiffness of penalty forces of colliders.
+    Integrator m_integrator = Integrator::SEMI_IMPLICIT_EULER;
+    int m_implicitIterations = 20;      // Maximum number of conjugate gradient iterations.
+    int m_numThreads = 1;               // The number of threads to accumulate forces with.
+
+    std::vector<Forces> m_threadForces;             // Forces accumulated by threads other than the master thread.
+    std::vector<Shape::ClosestPointOutput> m_closestPoints; // Outputs of closest point queries of each vertex.
+    std::vector<Vector4> m_queryPositions;  // Positions of vertices queried against a collider when m_particleLayout is SOA.
+    std::vector<int> m_queryVertices;       // Indices of vertices queried against a collider when m_particleLayout is SOA.
+    std::vector<int> m_candidateColliders;  // Colliders which may contain any vertex in the current step. Sorted by index.
+
+    // Buffers used by IMPLICIT_EULER.
+    SpringJacobians m_springJacobians;  // Jacobians of springs.
+    Velocities m_deltaVelocities;       // Solution of the linear system.
+    Velocities m_residuals;             // Residuals of conjugate gradient.
+    Velocities m_searchDirections;      // Search directions of conjugate gradient.
+    Velocities m_products;              // Products of the system matrix and the search directions.
 };
@@ -7,32 +7,768 @@
 #include <Physics/Physics.h>
 #include <Physics/Solvers/PBD/Constraints/PBDConstraints.h>
 
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
 namespace PBD
 {
-    StretchConstraint::StretchConstraint(
-        const SimdFloat& length, Vector4* positionA, Vector4* positionB,
-        const SimdFloat& massA, const SimdFloat& massB, const SimdFloat& stiffness)
-        : Constraint(stiffness)
-        , m_positionA(positionA), m_positionB(positionB)
-        , m_massA(massA), m_massB(massB)
-        , m_length(length)
+    void colorConstraints(const int* vertexA, const int* vertexB, int numConstraints, std::vector<int>& orderOut, std::vector<int>& colorStartsOut)
+    {
+        ColoringBuffers buffers;
+        colorConstraints(vertexA, vertexB, numConstraints, orderOut, colorStartsOut, buffers);
+    }
+
+    void colorConstraints(const int* const* vertices, int numVerticesPerConstraint, int numConstraints, std::vector<int>& orderOut, std::vector<int>& colorStartsOut)
+    {
+        ColoringBuffers buffers;
+        colorConstraints(vertices, numVerticesPerConstraint, numConstraints, orderOut, colorStartsOut, buffers);
+    }
+
+    void colorConstraints(const int* vertexA, const int* vertexB, int numConstraints, std::vector<int>& orderOut, std::vector<int>& colorStartsOut, ColoringBuffers& buffers)
+    {
+        const int* vertices[2] = { vertexA, vertexB };
+        colorConstraints(vertices, 2, numConstraints, orderOut, colorStartsOut, buffers);
+    }
+
+    void colorConstraints(const int* const* vertices, int numVerticesPerConstraint, int numConstraints, std::vector<int>& orderOut, std::vector<int>& colorStartsOut, ColoringBuffers& buffers)
+    {
+        orderOut.resize(numConstraints);
+        colorStartsOut.clear();
+
+        int numVertices = 0;
+        for (int k = 0; k < numVerticesPerConstraint; k++)
+        {
+            for (int i = 0; i < numConstraints; i++)
+            {
+                numVertices = std::max(numVertices, vertices[k][i] + 1);
+            }
+        }
+
+        // Bit masks of colors used by constraints of each vertex.
+        // Each vertex has numWords 64 bits masks and numWords grows when more than 64 * numWords colors are needed.
+        int numWords = 1;
+        std::vector<uint64_t>& usedColors = buffers.m_usedColors;
+        std::vector<int>& colors = buffers.m_colors;
+        usedColors.assign(numVertices, 0);
+        colors.resize(numConstraints);
+        int numColors = 0;
+
+        // Assign the smallest color which is not used by constraints of any of the vertices greedily.
+        for (int c = 0; c < numConstraints; c++)
+        {
+            int color = -1;
+            for (int w = 0; w < numWords && color < 0; w++)
+            {
+                uint64_t used = 0;
+                for (int k = 0; k < numVerticesPerConstraint; k++)
+                {
+                    used |= usedColors[vertices[k][c] * numWords + w];
+                }
+
+                const uint64_t freeColors = ~used;
+                if (freeColors)
+                {
+                    int bit = 0;
+                    while (!(freeColors & (1ull << bit)))
+                    {
+                        bit++;
+                    }
+                    color = w * 64 + bit;
+                }
+            }
+
+            if (color < 0)
+            {
+                // All colors are used. Add a new word to each vertex.
+                std::vector<uint64_t>& newUsedColors = buffers.m_newUsedColors;
+                newUsedColors.assign((size_t)numVertices * (numWords + 1), 0);
+                for (int v = 0; v < numVertices; v++)
+                {
+                    std::copy(&usedColors[v * numWords], &usedColors[v * numWords] + numWords, &newUsedColors[v * (numWords + 1)]);
+                }
+                usedColors.swap(newUsedColors);
+                color = numWords * 64;
+                numWords++;
+            }
+
+            for (int k = 0; k < numVerticesPerConstraint; k++)
+            {
+                usedColors[vertices[k][c] * numWords + color / 64] |= 1ull << (color % 64);
+            }
+            colors[c] = color;
+            numColors = std::max(numColors, color + 1);
+        }
+
+        // Sort constraints by colors.
+        colorStartsOut.resize(numColors + 1, 0);
+        for (int c = 0; c < numConstraints; c++)
+        {
+            colorStartsOut[colors[c] + 1]++;
+        }
+        for (int i = 0; i < numColors; i++)
+        {
+            colorStartsOut[i + 1] += colorStartsOut[i];
+        }
+
+        std::vector<int>& offsets = buffers.m_offsets;
+        offsets.assign(colorStartsOut.begin(), colorStartsOut.end() - 1);
+        for (int c = 0; c < numConstraints; c++)
+        {
+            orderOut[offsets[colors[c]]++] = c;
+        }
+    }
+
+    void StretchConstraints::add(int vertexA, int vertexB, float length, float invMassA, float invMassB, float stiffness, float compliance)
+    {
+        assert(vertexA != vertexB);
+        assert(invMassA >= 0.f && invMassB >= 0.f);
+        assert(compliance >= 0.f);
+
+        m_vertexA.push_back(vertexA);
+        m_vertexB.push_back(vertexB);
+        m_length.push_back(length);
+        m_stiffness.push_back(stiffness);
+        m_compliance.push_back(compliance);
+        m_lambda.push_back(0.f);
+        m_invMassA.push_back(invMassA);
+        m_invMassB.push_back(invMassB);
+
+        if (m_colorStarts.empty())
+        {
+            // Colors are not built yet.
+            return;
+        }
+
+        // Find the first color which is not used by both vertices.
+        int color = -1;
+        for (int w = 0; w < m_numColorWords && color < 0; w++)
+        {
+            const uint64_t usedA = vertexA < m_numMaskedVertices ? accessColorMask(vertexA, w) : 0;
+            const uint64_t usedB = vertexB < m_numMaskedVertices ? accessColorMask(vertexB, w) : 0;
+            const uint64_t freeColors = ~(usedA | usedB);
+            if (freeColors)
+            {
+                int bit = 0;
+                while (!(freeColors & (1ull << bit)))
+                {
+                    bit++;
+                }
+                color = w * 64 + bit;
+            }
+        }
+        if (color < 0)
+        {
+            color = m_numColorWords * 64;
+        }
+
+        // Colors which are not used by any constraint are never set in masks, so the color is at most the number of colors.
+        const int numColors = getNumColors();
+        assert(color <= numColors);
+        if (color == numColors)
+        {
+            m_colorStarts.push_back(m_colorStarts.back());
+        }
+
+        growColorMasks(std::max(vertexA, vertexB) + 1, color + 1);
+
+        // Make a room at the end of the color by moving the first constraint of each following color to its end.
+        // The new constraint is at the end of buffers now.
+        int hole = getNumConstraints() - 1;
+        for (int c = getNumColors() - 1; c > color; c--)
+        {
+            const int start = m_colorStarts[c];
+            move(start, hole);
+            hole = start;
+            m_colorStarts[c]++;
+        }
+        m_colorStarts.back()++;
+
+        m_vertexA[hole] = vertexA;
+        m_vertexB[hole] = vertexB;
+        m_length[hole] = length;
+        m_stiffness[hole] = stiffness;
+        m_compliance[hole] = compliance;
+        m_lambda[hole] = 0.f;
+        m_invMassA[hole] = invMassA;
+        m_invMassB[hole] = invMassB;
+
+        accessColorMask(vertexA, color / 64) |= 1ull << (color % 64);
+        accessColorMask(vertexB, color / 64) |= 1ull << (color % 64);
+    }
+
+    void StretchConstraints::remove(const VertexPairs& pairs)
+    {
+        if (pairs.empty())
+        {
+            return;
+        }
+
+        m_pairsToRemove.clear();
+        for (const VertexPair& pair : pairs)
+        {
+            m_pairsToRemove.push_back(VertexPair(std::min(pair.first, pair.second), std::max(pair.first, pair.second)));
+        }
+        std::sort(m_pairsToRemove.begin(), m_pairsToRemove.end());
+
+        // Visit constraints backward since removing a constraint only moves constraints after it.
+        for (int i = getNumConstraints() - 1; i >= 0 && !m_pairsToRemove.empty(); i--)
+        {
+            const VertexPair pair(std::min(m_vertexA[i], m_vertexB[i]), std::max(m_vertexA[i], m_vertexB[i]));
+            auto itr = std::lower_bound(m_pairsToRemove.begin(), m_pairsToRemove.end(), pair);
+            if (itr != m_pairsToRemove.end() && *itr == pair)
+            {
+                m_pairsToRemove.erase(itr);
+                removeAt(i);
+            }
+        }
+
+        // All pairs should have been found.
+        assert(m_pairsToRemove.empty());
+    }
+
+    void StretchConstraints::move(int from, int to)
+    {
+        m_vertexA[to] = m_vertexA[from];
+        m_vertexB[to] = m_vertexB[from];
+        m_length[to] = m_length[from];
+        m_stiffness[to] = m_stiffness[from];
+        m_compliance[to] = m_compliance[from];
+        m_lambda[to] = m_lambda[from];
+        m_invMassA[to] = m_invMassA[from];
+        m_invMassB[to] = m_invMassB[from];
+    }
+
+    void StretchConstraints::removeAt(int index)
+    {
+        if (m_colorStarts.empty())
+        {
+            // Colors are not built yet. Simply swap with the last constraint.
+            move(getNumConstraints() - 1, index);
+        }
+        else
+        {
+            const int color = (int)(std::upper_bound(m_colorStarts.begin(), m_colorStarts.end(), index) - m_colorStarts.begin()) - 1;
+            assert(color >= 0 && color < getNumColors());
+
+            const uint64_t bit = 1ull << (color % 64);
+            accessColorMask(m_vertexA[index], color / 64) &= ~bit;
+            accessColorMask(m_vertexB[index], color / 64) &= ~bit;
+
+            // Fill the gap by the last constraint of the color, and then shift each following color by moving its last constraint to its front.
+            int hole = m_colorStarts[color + 1] - 1;
+            move(hole, index);
+            for (int c = color + 1; c < getNumColors(); c++)
+            {
+                const int last = m_colorStarts[c + 1] - 1;
+                move(last, hole);
+                hole = last;
+                m_colorStarts[c]--;
+            }
+            m_colorStarts.back()--;
+
+            // Remove empty colors at the end.
+            while (getNumColors() > 0 && m_colorStarts[getNumColors() - 1] == m_colorStarts.back())
+            {
+                m_colorStarts.pop_back();
+            }
+        }
+
+        m_vertexA.pop_back();
+        m_vertexB.pop_back();
+        m_length.pop_back();
+        m_stiffness.pop_back();
+        m_compliance.pop_back();
+        m_lambda.pop_back();
+        m_invMassA.pop_back();
+        m_invMassB.pop_back();
+    }
+
+    void StretchConstraints::growColorMasks(int numVertices, int numColors)
+    {
+        const int numWords = std::max(m_numColorWords, (numColors + 63) / 64);
+        if (numWords > m_numColorWords)
+        {
+            // Re-layout masks with the new number of words.
+            std::vector<uint64_t> newMasks((size_t)m_numMaskedVertices * numWords, 0);
+            for (int v = 0; v < m_numMaskedVertices; v++)
+            {
+                std::copy(&m_colorMasks[v * m_numColorWords], &m_colorMasks[v * m_numColorWords] + m_numColorWords, &newMasks[v * numWords]);
+            }
+            m_colorMasks.swap(newMasks);
+            m_numColorWords = numWords;
+        }
+
+        if (numVertices > m_numMaskedVertices)
+        {
+            m_colorMasks.resize((size_t)numVertices * m_numColorWords, 0);
+            m_numMaskedVertices = numVertices;
+        }
+    }
+
+    void StretchConstraints::clear()
+    {
+        m_vertexA.clear();
+        m_vertexB.clear();
+        m_length.clear();
+        m_stiffness.clear();
+        m_compliance.clear();
+        m_lambda.clear();
+        m_invMassA.clear();
+        m_invMassB.clear();
+        m_colorStarts.clear();
+        m_colorMasks.clear();
+        m_numColorWords = 1;
+        m_numMaskedVertices = 0;
+    }
+
+    void StretchConstraints::reserve(int numConstraints)
+    {
+        m_vertexA.reserve(numConstraints);
+        m_vertexB.reserve(numConstraints);
+        m_length.reserve(numConstraints);
+        m_stiffness.reserve(numConstraints);
+        m_compliance.reserve(numConstraints);
+        m_lambda.reserve(numConstraints);
+        m_invMassA.reserve(numConstraints);
+        m_invMassB.reserve(numConstraints);
+    }
+
+    void StretchConstraints::buildColors()
+    {
+        const int numConstraints = getNumConstraints();
+
+        std::vector<int> order;
+        colorConstraints(m_vertexA.data(), m_vertexB.data(), numConstraints, order, m_colorStarts);
+
+        // Reorder arrays.
+        auto reorder = [&order](auto& values)
+        {
+            auto copy = values;
+            for (int i = 0; i < (int)order.size(); i++)
+            {
+                values[i] = copy[order[i]];
+            }
+        };
+
+        reorder(m_vertexA);
+        reorder(m_vertexB);
+        reorder(m_length);
+        reorder(m_stiffness);
+        reorder(m_compliance);
+        reorder(m_lambda);
+        reorder(m_invMassA);
+        reorder(m_invMassB);
+
+        // Record colors used by each vertex for incremental updates.
+        int numVertices = 0;
+        for (int i = 0; i < numConstraints; i++)
+        {
+            numVertices = std::max(numVertices, std::max(m_vertexA[i], m_vertexB[i]) + 1);
+        }
+
+        m_colorMasks.clear();
+        m_numColorWords = 1;
+        m_numMaskedVertices = 0;
+        growColorMasks(numVertices, getNumColors());
+
+        for (int color = 0; color < getNumColors(); color++)
+        {
+            const uint64_t bit = 1ull << (color % 64);
+            for (int i = m_colorStarts[color]; i < m_colorStarts[color + 1]; i++)
+            {
+                accessColorMask(m_vertexA[i], color / 64) |= bit;
+                accessColorMask(m_vertexB[i], color / 64) |= bit;
+            }
+        }
+    }
+
+    void StretchConstraints::resetLambdas()
+    {
+        std::fill(m_lambda.begin(), m_lambda.end(), 0.f);
+    }
+
+    void StretchConstraints::project(Positions& positions, int numThreads, float deltaTime)
+    {
+        assert(getNumConstraints() == 0 || getNumColors() > 0);
+
+        const float invDeltaTimeSq = deltaTime > 0.f ? 1.f / (deltaTime * deltaTime) : 0.f;
+
+        // Don't bother to use threads for small colors.
+        constexpr int minItemsPerThread = 16;
+
+        for (int color = 0; color < getNumColors(); color++)
+        {
+            const int start = m_colorStarts[color];
+            const int end = m_colorStarts[color + 1];
+            const int numBatches = (end - start) / s_batchSize;
+            const int numItems = numBatches + (end - start) % s_batchSize;
+
+            // Constraints of the same color don't share any vertex. We can project them in parallel without any synchronization.
+            #pragma omp parallel for num_threads(numThreads) if(numThreads > 1 && numItems >= numThreads * minItemsPerThread)
+            for (int i = 0; i < numItems; i++)
+            {
+                if (i < numBatches)
+                {
+                    projectBatch(positions, start + i * s_batchSize, invDeltaTimeSq);
+                }
+                else
+                {
+                    const int index = start + numBatches * s_batchSize + (i - numBatches);
+                    projectScalar(positions, index, index + 1, invDeltaTimeSq);
+                }
+            }
+        }
+    }
+
+    void StretchConstraints::projectScalar(Positions& positions, int start, int end, float invDeltaTimeSq)
     {
+        for (int i = start; i < end; i++)
+        {
+            Vector4& posA = positions[m_vertexA[i]];
+            Vector4& posB = positions[m_vertexB[i]];
+
+            Vector4 dir = posA - posB;
+            const SimdFloat lengthSq = dir.lengthSq<3>();
+            const float invMassSum = m_invMassA[i] + m_invMassB[i];
+            if (lengthSq.getFloat() > std::numeric_limits<float>::epsilon() && invMassSum > 0.f)
+            {
+                // Time step scaled compliance. This is zero for constraints without compliance, which makes the correction the same as PBD.
+                const float alpha = m_compliance[i] * invDeltaTimeSq;
+                const SimdFloat curLength = lengthSq.getSqrt();
+                const SimdFloat scale = SimdFloat(m_stiffness[i]) * (curLength - SimdFloat(m_length[i]) + SimdFloat(alpha * m_lambda[i])) / (SimdFloat(invMassSum + alpha) * curLength);
+                m_lambda[i] -= (scale * curLength).getFloat();
+                posA -= (SimdFloat(m_invMassA[i]) * scale) * dir;
+                posB += (SimdFloat(m_invMassB[i]) * scale) * dir;
+
+                assert(!isnan(posA(0)) && !isnan(posA(1)) && !isnan(posA(2)));
+                assert(!isnan(posB(0)) && !isnan(posB(1)) && !isnan(posB(2)));
+            }
+        }
     }
 
-    void StretchConstraint::project()
+#ifdef USE_SSE
+
+    void StretchConstraints::projectBatch(Positions& positions, int start, float invDeltaTimeSq)
     {
-        Vector4 dir = *m_positionA - *m_positionB;
-        const SimdFloat curLength = dir.length<3>();
-        if (dir.lengthSq<3>().getFloat() > std::numeric_limits<float>::epsilon())
+        static_assert(s_batchSize == 4, "projectBatch assumes 4 constraints in a batch.");
+
+        const int* vertexA = &m_vertexA[start];
+        const int* vertexB = &m_vertexB[start];
+
+        // Load positions and transpose them to x, y and z of 4 constraints.
+        __m128 ax = positions[vertexA[0]].getQuad();
+        __m128 ay = positions[vertexA[1]].getQuad();
+        __m128 az = positions[vertexA[2]].getQuad();
+        __m128 aw = positions[vertexA[3]].getQuad();
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+
+        __m128 bx = positions[vertexB[0]].getQuad();
+        __m128 by = positions[vertexB[1]].getQuad();
+        __m128 bz = positions[vertexB[2]].getQuad();
+        __m128 bw = positions[vertexB[3]].getQuad();
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+        const __m128 dx = _mm_sub_ps(ax, bx);
+        const __m128 dy = _mm_sub_ps(ay, by);
+        const __m128 dz = _mm_sub_ps(az, bz);
+        const __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        const __m128 curLength = _mm_sqrt_ps(lengthSq);
+
+        const __m128 invMassA = _mm_loadu_ps(&m_invMassA[start]);
+        const __m128 invMassB = _mm_loadu_ps(&m_invMassB[start]);
+        const __m128 invMassSum = _mm_add_ps(invMassA, invMassB);
+
+        // Skip constraints of degenerated edges or fixed vertices.
+        const __m128 isValid = _mm_and_ps(
+            _mm_cmpgt_ps(lengthSq, _mm_set1_ps(std::numeric_limits<float>::epsilon())),
+            _mm_cmpgt_ps(invMassSum, _mm_setzero_ps()));
+
+        const __m128 alpha = _mm_mul_ps(_mm_loadu_ps(&m_compliance[start]), _mm_set1_ps(invDeltaTimeSq));
+        const __m128 lambda = _mm_loadu_ps(&m_lambda[start]);
+
+        __m128 scale = _mm_add_ps(_mm_sub_ps(curLength, _mm_loadu_ps(&m_length[start])), _mm_mul_ps(alpha, lambda));
+        scale = _mm_mul_ps(_mm_loadu_ps(&m_stiffness[start]), scale);
+        scale = _mm_div_ps(scale, _mm_mul_ps(_mm_add_ps(invMassSum, alpha), curLength));
+        scale = _mm_and_ps(scale, isValid);
+
+        _mm_storeu_ps(&m_lambda[start], _mm_sub_ps(lambda, _mm_mul_ps(scale, curLength)));
+
+        const __m128 scaleA = _mm_mul_ps(invMassA, scale);
+        const __m128 scaleB = _mm_mul_ps(invMassB, scale);
+
+        // Transpose corrections back to each vertex.
+        __m128 cax = _mm_mul_ps(scaleA, dx);
+        __m128 cay = _mm_mul_ps(scaleA, dy);
+        __m128 caz = _mm_mul_ps(scaleA, dz);
+        __m128 caw = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(cax, cay, caz, caw);
+
+        __m128 cbx = _mm_mul_ps(scaleB, dx);
+        __m128 cby = _mm_mul_ps(scaleB, dy);
+        __m128 cbz = _mm_mul_ps(scaleB, dz);
+        __m128 cbw = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(cbx, cby, cbz, cbw);
+
+        // Vertices in a batch are all different so the order of writes doesn't matter.
+        QuadrupleFloat& pa0 = positions[vertexA[0]].accessQuad(); pa0 = _mm_sub_ps(pa0, cax);
+        QuadrupleFloat& pa1 = positions[vertexA[1]].accessQuad(); pa1 = _mm_sub_ps(pa1, cay);
+        QuadrupleFloat& pa2 = positions[vertexA[2]].accessQuad(); pa2 = _mm_sub_ps(pa2, caz);
+        QuadrupleFloat& pa3 = positions[vertexA[3]].accessQuad(); pa3 = _mm_sub_ps(pa3, caw);
+        QuadrupleFloat& pb0 = positions[vertexB[0]].accessQuad(); pb0 = _mm_add_ps(pb0, cbx);
+        QuadrupleFloat& pb1 = positions[vertexB[1]].accessQuad(); pb1 = _mm_add_ps(pb1, cby);
+        QuadrupleFloat& pb2 = positions[vertexB[2]].accessQuad(); pb2 = _mm_add_ps(pb2, cbz);
+        QuadrupleFloat& pb3 = positions[vertexB[3]].accessQuad(); pb3 = _mm_add_ps(pb3, cbw);
+    }
+
+#else
+
+    void StretchConstraints::projectBatch(Positions& positions, int start, float invDeltaTimeSq)
+    {
+        projectScalar(positions, start, start + s_batchSize, invDeltaTimeSq);
+    }
+
+#endif
+
+    namespace
+    {
+        // Reorder values by order.
+        template <typename T>
+        void reorderValues(std::vector<T>& values, const std::vector<int>& order)
+        {
+            const std::vector<T> copy = values;
+            for (int i = 0; i < (int)order.size(); i++)
+            {
+                values[i] = copy[order[i]];
+            }
+        }
+
+        // Call projectFunc for each constraint color by color. Constraints of the same color are processed in parallel.
+        template <typename ProjectFunc>
+        void projectByColors(const std::vector<int>& colorStarts, int numThreads, ProjectFunc projectFunc)
+        {
+            // Don't bother to use threads for small colors.
+            constexpr int minItemsPerThread = 16;
+
+            for (int color = 0; color + 1 < (int)colorStarts.size(); color++)
+            {
+                const int start = colorStarts[color];
+                const int end = colorStarts[color + 1];
+
+                #pragma omp parallel for num_threads(numThreads) if(numThreads > 1 && end - start >= numThreads * minItemsPerThread)
+                for (int i = start; i < end; i++)
+                {
+                    projectFunc(i);
+                }
+            }
+        }
+    }
+
+    void BendingConstraints::add(int vertexA, int vertexB, int vertexC, const Positions& positions, float invMassA, float invMassB, float invMassC, float stiffness, float compliance)
+    {
+        assert(vertexA != vertexB && vertexB != vertexC && vertexC != vertexA);
+        assert(invMassA >= 0.f && invMassB >= 0.f && invMassC >= 0.f);
+        assert(compliance >= 0.f);
+
+        const Vector4 centroid = (positions[vertexA] + positions[vertexB] + positions[vertexC]) * SimdFloat(1.f / 3.f);
+
+        m_vertices[0].push_back(vertexA);
+        m_vertices[1].push_back(vertexB);
+        m_vertices[2].push_back(vertexC);
+        m_invMasses[0].push_back(invMassA);
+        m_invMasses[1].push_back(invMassB);
+        m_invMasses[2].push_back(invMassC);
+        m_restDistance.push_back((positions[vertexB] - centroid).length<3>().getFloat());
+        m_stiffness.push_back(stiffness);
+        m_compliance.push_back(compliance);
+        m_lambda.push_back(0.f);
+
+        // New constraints are not colored until buildColors() is called.
+        m_colorStarts.clear();
+    }
+
+    void BendingConstraints::clear()
+    {
+        for (int k = 0; k < s_numVertices; k++)
+        {
+            m_vertices[k].clear();
+            m_invMasses[k].clear();
+        }
+        m_restDistance.clear();
+        m_stiffness.clear();
+        m_compliance.clear();
+        m_lambda.clear();
+        m_colorStarts.clear();
+    }
+
+    void BendingConstraints::buildColors()
+    {
+        const int* vertices[s_numVertices] = { m_vertices[0].data(), m_vertices[1].data(), m_vertices[2].data() };
+
+        std::vector<int> order;
+        colorConstraints(vertices, s_numVertices, getNumConstraints(), order, m_colorStarts);
+
+        for (int k = 0; k < s_numVertices; k++)
         {
-            dir.normalize<3>();
-            const Vector4 constraint = (curLength - m_length) * dir;
-            const SimdFloat invCombinedMass(SimdFloat_1 / (m_massA + m_massB) * m_stiffness);
-            *m_positionA += -m_massA * invCombinedMass * constraint;
-            *m_positionB += m_massB * invCombinedMass * constraint;
+            reorderValues(m_vertices[k], order);
+            reorderValues(m_invMasses[k], order);
+        }
+        reorderValues(m_restDistance, order);
+        reorderValues(m_stiffness, order);
+        reorderValues(m_compliance, order);
+        reorderValues(m_lambda, order);
+    }
 
-            assert(!isnan((*m_positionA)(0)) && !isnan((*m_positionA)(1)) && !isnan((*m_positionA)(2)));
-            assert(!isnan((*m_positionB)(0)) && !isnan((*m_positionB)(1)) && !isnan((*m_positionB)(2)));
+    void BendingConstraints::resetLambdas()
+    {
+        std::fill(m_lambda.begin(), m_lambda.end(), 0.f);
+    }
+
+    void BendingConstraints::project(Positions& positions, int numThreads, float deltaTime)
+    {
+        assert(getNumConstraints() == 0 || getNumColors() > 0);
+
+        const float invDeltaTimeSq = deltaTime > 0.f ? 1.f / (deltaTime * deltaTime) : 0.f;
+        projectByColors(m_colorStarts, numThreads, [this, &positions, invDeltaTimeSq](int i) { projectScalar(positions, i, invDeltaTimeSq); });
+    }
+
+    void BendingConstraints::projectScalar(Positions& positions, int index, float invDeltaTimeSq)
+    {
+        Vector4& posA = positions[m_vertices[0][index]];
+        Vector4& posB = positions[m_vertices[1][index]];
+        Vector4& posC = positions[m_vertices[2][index]];
+        const float invMassA = m_invMasses[0][index];
+        const float invMassB = m_invMasses[1][index];
+        const float invMassC = m_invMasses[2][index];
+
+        // C = |xB - centroid| - h0. Gradient is 2/3 n for B and -1/3 n for A and C where n is the direction from the centroid to B.
+        const Vector4 dir = posB - (posA + posB + posC) * SimdFloat(1.f / 3.f);
+        const SimdFloat distanceSq = dir.lengthSq<3>();
+        const float weightSum = (invMassA + 4.f * invMassB + invMassC) / 9.f;
+        if (distanceSq.getFloat() <= std::numeric_limits<float>::epsilon() || weightSum <= 0.f)
+        {
+            return;
+        }
+
+        const SimdFloat distance = distanceSq.getSqrt();
+        const float alpha = m_compliance[index] * invDeltaTimeSq;
+        const float c = distance.getFloat() - m_restDistance[index];
+        const float deltaLambda = m_stiffness[index] * (-c - alpha * m_lambda[index]) / (weightSum + alpha);
+        m_lambda[index] += deltaLambda;
+
+        const Vector4 normal = dir / distance;
+        posA -= SimdFloat(invMassA * deltaLambda / 3.f) * normal;
+        posB += SimdFloat(invMassB * deltaLambda * 2.f / 3.f) * normal;
+        posC -= SimdFloat(invMassC * deltaLambda / 3.f) * normal;
+    }
+
+    float VolumeConstraints::calcVolume(const Vector4& p0, const Vector4& p1, const Vector4& p2, const Vector4& p3)
+    {
+        return Vector4::cross(p1 - p0, p2 - p0).dot<3>(p3 - p0).getFloat() / 6.f;
+    }
+
+    void VolumeConstraints::add(const int* vertices, const Positions& positions, const float* invMasses, float stiffness, float compliance)
+    {
+        assert(compliance >= 0.f);
+
+        for (int k = 0; k < s_numVertices; k++)
+        {
+            assert(invMasses[k] >= 0.f);
+            m_vertices[k].push_back(vertices[k]);
+            m_invMasses[k].push_back(invMasses[k]);
+        }
+        m_restVolume.push_back(calcVolume(positions[vertices[0]], positions[vertices[1]], positions[vertices[2]], positions[vertices[3]]));
+        m_stiffness.push_back(stiffness);
+        m_compliance.push_back(compliance);
+        m_lambda.push_back(0.f);
+
+        // New constraints are not colored until buildColors() is called.
+        m_colorStarts.clear();
+    }
+
+    void VolumeConstraints::clear()
+    {
+        for (int k = 0; k < s_numVertices; k++)
+        {
+            m_vertices[k].clear();
+            m_invMasses[k].clear();
+        }
+        m_restVolume.clear();
+        m_stiffness.clear();
+        m_compliance.clear();
+        m_lambda.clear();
+        m_colorStarts.clear();
+    }
+
+    void VolumeConstraints::buildColors()
+    {
+        const int* vertices[s_numVertices] = { m_vertices[0].data(), m_vertices[1].data(), m_vertices[2].data(), m_vertices[3].data() };
+
+        std::vector<int> order;
+        colorConstraints(vertices, s_numVertices, getNumConstraints(), order, m_colorStarts);
+
+        for (int k = 0; k < s_numVertices; k++)
+        {
+            reorderValues(m_vertices[k], order);
+            reorderValues(m_invMasses[k], order);
+        }
+        reorderValues(m_restVolume, order);
+        reorderValues(m_stiffness, order);
+        reorderValues(m_compliance, order);
+        reorderValues(m_lambda, order);
+    }
+
+    void VolumeConstraints::resetLambdas()
+    {
+        std::fill(m_lambda.begin(), m_lambda.end(), 0.f);
+    }
+
+    void VolumeConstraints::project(Positions& positions, int numThreads, float deltaTime)
+    {
+        assert(getNumConstraints() == 0 || getNumColors() > 0);
+
+        const float invDeltaTimeSq = deltaTime > 0.f ? 1.f / (deltaTime * deltaTime) : 0.f;
+        projectByColors(m_colorStarts, numThreads, [this, &positions, invDeltaTimeSq](int i) { projectScalar(positions, i, invDeltaTimeSq); });
+    }
+
+    void VolumeConstraints::projectScalar(Positions& positions, int index, float invDeltaTimeSq)
+    {
+        Vector4* pos[s_numVertices];
+        for (int k = 0; k < s_numVertices; k++)
+        {
+            pos[k] = &positions[m_vertices[k][index]];
+        }
+
+        const Vector4& p0 = *pos[0];
+        const Vector4& p1 = *pos[1];
+        const Vector4& p2 = *pos[2];
+        const Vector4& p3 = *pos[3];
+
+        // Gradients of 6 times the volume.
+        Vector4 grads[s_numVertices];
+        grads[1] = Vector4::cross(p2 - p0, p3 - p0);
+        grads[2] = Vector4::cross(p3 - p0, p1 - p0);
+        grads[3] = Vector4::cross(p1 - p0, p2 - p0);
+        grads[0] = -(grads[1] + grads[2] + grads[3]);
+
+        float weightSum = 0.f;
+        for (int k = 0; k < s_numVertices; k++)
+        {
+            weightSum += m_invMasses[k][index] * grads[k].lengthSq<3>().getFloat() / 36.f;
+        }
+        if (weightSum <= 0.f)
+        {
+            return;
+        }
+
+        const float alpha = m_compliance[index] * invDeltaTimeSq;
+        const float c = grads[3].dot<3>(p3 - p0).getFloat() / 6.f - m_restVolume[index];
+        const float deltaLambda = m_stiffness[index] * (-c - alpha * m_lambda[index]) / (weightSum + alpha);
+        m_lambda[index] += deltaLambda;
+
+        for (int k = 0; k < s_numVertices; k++)
+        {
+            *pos[k] += SimdFloat(m_invMasses[k][index] * deltaLambda / 6.f) * grads[k];
         }
     }
 }
@@ -6,22 +6,229 @@
 
 #pragma once
 
-#include <Physics/Solvers/PBD/PBDSolver.h>
+#include <Common/Math/Vector4.h>
+
+#include <vector>
+#include <utility>
+#include <cstdint>
 
 namespace PBD
 {
-    // A constraint which tries to maintain the original length between two points.
-    struct StretchConstraint : public Constraint
+    // Group constraints between pairs of vertices by colors so that constraints of the same color don't share any vertex.
+    // Constraints of the same color can be projected in any order or in parallel.
+    // orderOut receives indices of constraints sorted by their colors and colorStartsOut receives start index of each color in orderOut.
+    // colorStartsOut has one extra element at the end which is the number of constraints.
+    void colorConstraints(const int* vertexA, const int* vertexB, int numConstraints, std::vector<int>& orderOut, std::vector<int>& colorStartsOut);
+
+    // Same as above for constraints of numVerticesPerConstraint vertices. vertices[k][i] is the k-th vertex of the i-th constraint.
+    void colorConstraints(const int* const* vertices, int numVerticesPerConstraint, int numConstraints, std::vector<int>& orderOut, std::vector<int>& colorStartsOut);
+
+    // Temporary buffers used by colorConstraints().
+    // Pass the same instance every time constraints are colored repeatedly to avoid allocations.
+    struct ColoringBuffers
+    {
+        std::vector<uint64_t> m_usedColors;     // Bit masks of colors used by constraints of each vertex.
+        std::vector<uint64_t> m_newUsedColors;  // Bit masks while growing the number of words per vertex.
+        std::vector<int> m_colors;              // Color of each constraint.
+        std::vector<int> m_offsets;             // Write position of each color while sorting constraints.
+    };
+
+    // Same as above with temporary buffers given by the caller.
+    void colorConstraints(const int* vertexA, const int* vertexB, int numConstraints, std::vector<int>& orderOut, std::vector<int>& colorStartsOut, ColoringBuffers& buffers);
+    void colorConstraints(const int* const* vertices, int numVerticesPerConstraint, int numConstraints, std::vector<int>& orderOut, std::vector<int>& colorStartsOut, ColoringBuffers& buffers);
+
+    // Constraints which try to maintain the original length between two points.
+    // Constraints are stored in structure of arrays and projected by non-virtual kernels.
+    // After buildColors() is called, constraints are sorted by colors so that constraints of the same color don't share any vertex.
+    // Every s_batchSize constraints of the same color are projected at once by SIMD and batches of the same color can be projected in parallel.
+    // Once colors are built, constraints can be added and removed incrementally while keeping colors valid.
+    // Constraints with compliance are projected by XPBD when time step is given to project(). See "XPBD: Position-Based Simulation of
+    // Compliant Constrained Dynamics" by Macklin et al. Lagrange multipliers have to be reset by resetLambdas() at the beginning of each step.
+    class StretchConstraints
     {
-        StretchConstraint(
-        const SimdFloat& length, Vector4* positionA, Vector4* positionB,
-        const SimdFloat& massA, const SimdFloat& massB, const SimdFloat& stiffness);
+    public:
+        // Type definitions.
+        using Positions = std::vector<Vector4>;
+        using VertexPair = std::pair<int, int>;
+        using VertexPairs = std::vector<VertexPair>;
+
+        // The number of constraints projected at once.
+        static constexpr int s_batchSize = 4;
+
+        // Add a constraint. Stiffness should be already adjusted by the number of solver iterations. Compliance is inverse of physical stiffness.
+        // If colors are already built, the constraint is inserted into the first color which doesn't use any of its vertices.
+        void add(int vertexA, int vertexB, float length, float invMassA, float invMassB, float stiffness, float compliance = 0.f);
+
+        // Remove one constraint per pair of vertices. Pairs don't have to be sorted. Colors are maintained.
+        void remove(const VertexPairs& pairs);
+
+        // Remove all constraints.
+        void clear();
+
+        // Reserve buffers for numConstraints constraints.
+        void reserve(int numConstraints);
+
+        // Sort constraints by colors. This has to be called after constraints are added.
+        void buildColors();
+
+        // Project all the constraints on numThreads threads.
+        // If deltaTime is positive, compliances are applied and Lagrange multipliers are accumulated. Otherwise compliances are ignored.
+        void project(Positions& positions, int numThreads = 1, float deltaTime = 0.f);
+
+        // Reset Lagrange multipliers of all the constraints to zero.
+        void resetLambdas();
+
+        // Return the number of constraints.
+        inline int getNumConstraints() const { return (int)m_vertexA.size(); }
+
+        // Return the number of colors.
+        inline int getNumColors() const { return (int)m_colorStarts.size() - 1; }
+
+        // Return start index of constraints of the color. getColorStart(getNumColors()) returns the number of constraints.
+        inline int getColorStart(int color) const { return m_colorStarts[color]; }
+
+        // Return indices of vertices of the constraint.
+        inline int getVertexA(int index) const { return m_vertexA[index]; }
+        inline int getVertexB(int index) const { return m_vertexB[index]; }
+
+    protected:
+        // Project constraints [start, end) one by one. invDeltaTimeSq is zero if compliances are ignored.
+        void projectScalar(Positions& positions, int start, int end, float invDeltaTimeSq);
+
+        // Project the batch of constraints [start, start + s_batchSize) at once.
+        void projectBatch(Positions& positions, int start, float invDeltaTimeSq);
+
+        // Copy the constraint at index from to index to.
+        void move(int from, int to);
+
+        // Remove the constraint at index and close the gap while maintaining colors.
+        void removeAt(int index);
+
+        // Return the mask of colors used by the vertex at the word.
+        inline auto accessColorMask(int vertex, int word)->uint64_t& { return m_colorMasks[vertex * m_numColorWords + word]; }
+
+        // Grow color masks so that they can hold numVertices vertices and numColors colors.
+        void growColorMasks(int numVertices, int numColors);
+
+        std::vector<int> m_vertexA;         // Index of the first vertex.
+        std::vector<int> m_vertexB;         // Index of the second vertex.
+        std::vector<float> m_length;        // Rest length.
+        std::vector<float> m_stiffness;     // Stiffness.
+        std::vector<float> m_compliance;    // Compliance.
+        std::vector<float> m_lambda;        // Lagrange multiplier accumulated in the current step.
+        std::vector<float> m_invMassA;      // Inverse mass of the first vertex.
+        std::vector<float> m_invMassB;      // Inverse mass of the second vertex.
+        std::vector<int> m_colorStarts;     // Start index of constraints of each color. Has one extra element at the end.
+        std::vector<uint64_t> m_colorMasks; // Bit masks of colors used by constraints of each vertex. Each vertex has m_numColorWords words.
+        int m_numColorWords = 1;            // The number of 64 bits words of color mask per vertex.
+        int m_numMaskedVertices = 0;        // The number of vertices which have color masks.
+        VertexPairs m_pairsToRemove;        // Temporary buffer of pairs of vertices to remove.
+    };
+
+    // Constraints which try to maintain the original bending at the middle of three vertices.
+    // Distance between the middle vertex and the centroid of the three vertices is kept.
+    // See "A Triangle Bending Constraint Model for Position-Based Dynamics" by Kelager et al.
+    // Constraints are stored in structure of arrays and sorted by colors by buildColors() so that each color can be projected in parallel.
+    class BendingConstraints
+    {
+    public:
+        // Type definitions.
+        using Positions = std::vector<Vector4>;
+
+        // The number of vertices of a constraint.
+        static constexpr int s_numVertices = 3;
+
+        // Add a constraint. vertexB is the middle vertex. The rest distance is calculated from positions.
+        void add(int vertexA, int vertexB, int vertexC, const Positions& positions, float invMassA, float invMassB, float invMassC, float stiffness, float compliance = 0.f);
+
+        // Remove all constraints.
+        void clear();
+
+        // Sort constraints by colors. This has to be called after constraints are added.
+        void buildColors();
+
+        // Project all the constraints. See StretchConstraints::project().
+        void project(Positions& positions, int numThreads = 1, float deltaTime = 0.f);
+
+        // Reset Lagrange multipliers of all the constraints to zero.
+        void resetLambdas();
+
+        // Return the number of constraints.
+        inline int getNumConstraints() const { return (int)m_restDistance.size(); }
+
+        // Return the number of colors.
+        inline int getNumColors() const { return (int)m_colorStarts.size() - 1; }
+
+        // Return start index of constraints of the color. getColorStart(getNumColors()) returns the number of constraints.
+        inline int getColorStart(int color) const { return m_colorStarts[color]; }
+
+        // Return index of the k-th vertex of the constraint.
+        inline int getVertex(int index, int k) const { return m_vertices[k][index]; }
+
+    protected:
+        // Project a constraint.
+        void projectScalar(Positions& positions, int index, float invDeltaTimeSq);
+
+        std::vector<int> m_vertices[s_numVertices];     // Indices of vertices. The second one is the middle vertex.
+        std::vector<float> m_invMasses[s_numVertices];  // Inverse masses of vertices.
+        std::vector<float> m_restDistance;  // Rest distance between the middle vertex and the centroid.
+        std::vector<float> m_stiffness;     // Stiffness.
+        std::vector<float> m_compliance;    // Compliance.
+        std::vector<float> m_lambda;        // Lagrange multiplier accumulated in the current step.
+        std::vector<int> m_colorStarts;     // Start index of constraints of each color. Has one extra element at the end.
+    };
+
+    // Constraints which try to maintain the original volume of tetrahedra.
+    // Constraints are stored in structure of arrays and sorted by colors by buildColors() so that each color can be projected in parallel.
+    class VolumeConstraints
+    {
+    public:
+        // Type definitions.
+        using Positions = std::vector<Vector4>;
+
+        // The number of vertices of a constraint.
+        static constexpr int s_numVertices = 4;
+
+        // Add a constraint. The rest volume is calculated from positions. It's negative if the tetrahedron is inverted.
+        void add(const int* vertices, const Positions& positions, const float* invMasses, float stiffness, float compliance = 0.f);
+
+        // Remove all constraints.
+        void clear();
+
+        // Sort constraints by colors. This has to be called after constraints are added.
+        void buildColors();
+
+        // Project all the constraints. See StretchConstraints::project().
+        void project(Positions& positions, int numThreads = 1, float deltaTime = 0.f);
+
+        // Reset Lagrange multipliers of all the constraints to zero.
+        void resetLambdas();
+
+        // Return the number of constraints.
+        inline int getNumConstraints() const { return (int)m_restVolume.size(); }
+
+        // Return the number of colors.
+        inline int getNumColors() const { return (int)m_colorStarts.size() - 1; }
+
+        // Return start index of constraints of the color. getColorStart(getNumColors()) returns the number of constraints.
+        inline int getColorStart(int color) const { return m_colorStarts[color]; }
+
+        // Return index of the k-th vertex of the constraint.
+        inline int getVertex(int index, int k) const { return m_vertices[k][index]; }
+
+        // Return signed volume of the tetrahedron.
+        static float calcVolume(const Vector4& p0, const Vector4& p1, const Vector4& p2, const Vector4& p3);
 
-        virtual void project() override;
+    protected:
+        // Project a constraint.
+        void projectScalar(Positions& positions, int index, float invDeltaTimeSq);
 
-        Vector4* m_positionA;
-        Vector4* m_positionB;
-        SimdFloat m_massA, m_massB;
-        SimdFloat m_length;
+        std::vector<int> m_vertices[s_numVertices];     // Indices of vertices.
+        std::vector<float> m_invMasses[s_numVertices];  // Inverse masses of vertices.
+        std::vector<float> m_restVolume;    // Rest volume.
+        std::vector<float> m_stiffness;     // Stiffness.
+        std::vector<float> m_compliance;    // Compliance.
+        std::vector<float> m_lambda;        // Lagrange multiplier accumulated in the current step.
+        std::vector<int> m_colorStarts;     // Start index of constraints of each color. Has one extra element at the end.
     };
-}
\ No newline at end of file
+}
@@ -8,9 +8,13 @@
 #include <Physics/Solvers/PBD/PBDSolver.h>
 #include <Physics/Systems/PointBasedSystem.h>
 #include <Physics/Collision/Collider.h>
-#include <Physics/Solvers/PBD/Constraints/PBDConstraints.h>
 #include <Common/Math/Matrix33.h>
 
+#include <omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
 namespace PBD
 {
     //
@@ -29,11 +33,17 @@ namespace PBD
     DynamicVertexCollisionConstraint::DynamicVertexCollisionConstraint(
         Vector4* positionA, Vector4* positionB,
         const SimdFloat& radiusA, const SimdFloat& radiusB,
+        float invMassA, float invMassB,
         const SimdFloat& stiffness, int solverIterations)
         : Constraint(stiffness)
         , m_positionA(positionA), m_positionB(positionB), m_radiusSq(radiusA + radiusB)
     {
         m_radiusSq *= m_radiusSq;
+
+        // Two pinned vertices don't push each other.
+        const float invMassSum = invMassA + invMassB;
+        m_weightA = invMassSum > 0.f ? invMassA / invMassSum : 0.f;
+        m_weightB = invMassSum > 0.f ? invMassB / invMassSum : 0.f;
     }
 
     void DynamicVertexCollisionConstraint::project()
@@ -54,10 +64,9 @@ namespace PBD
                 dir = Vec4_1000;
             }
 
-            SimdFloat halfDiff = SimdFloat((sqrtf(m_radiusSq.getFloat()) - sqrtf(distSq.getFloat())) * 0.5f);
-            dir *= halfDiff;
-            *m_positionA += dir;
-            *m_positionB -= dir;
+            const float diff = sqrtf(m_radiusSq.getFloat()) - sqrtf(distSq.getFloat());
+            *m_positionA += dir * SimdFloat(diff * m_weightA);
+            *m_positionB -= dir * SimdFloat(diff * m_weightB);
 
             assert(!isnan((*m_positionA)(0)) && !isnan((*m_positionA)(1)) && !isnan((*m_positionA)(2)));
             assert(!isnan((*m_positionB)(0)) && !isnan((*m_positionB)(1)) && !isnan((*m_positionB)(2)));
@@ -91,76 +100,171 @@ namespace PBD
         return 1.0f - powf(1.0f - stiffness.getFloat(), 1.0f / (float)solverIterations);
     }
 
+    // Minimum number of vertices per thread to accumulate moments of SHAPE_MATCH damping in parallel.
+    constexpr int s_minDampingVerticesPerThread = 512;
+
     //
     // Solver
     //
 
-    Solver::Solver(PointBasedSystem& system, const Vector4& gravity, int solverIterations, float dampingFactor)
+    Solver::Solver(PointBasedSystem& system, const Vector4& gravity, int solverIterations, float dampingFactor, bool useXpbd)
         : m_positions(system.accessVertexPositions())
         , m_velocities(system.accessVertexVelocities())
+        , m_invMasses(system.getVertexInvMasses())
         , m_colliders(system.getColliders())
+        , m_colliderTree(system.getColliderTree())
         , m_gravity(gravity)
         , m_solverIterations(solverIterations)
+        , m_useXpbd(useXpbd)
         , m_dampingFactor(dampingFactor)
         , m_vertexRadius(system.getVertexRadius())
     {
         m_newPositions.resize(m_positions.size());
 
-        // Create stretch constraints at all edges between vertices in the point based system.
+        createStretchConstraints(system);
+        createBendingAndVolumeConstraints(system);
+    }
+
+    void Solver::reset(const PointBasedSystem& system)
+    {
+        m_newPositions.resize(m_positions.size());
+        m_vertexRadius = SimdFloat(system.getVertexRadius());
+
+        m_stretchConstraints.clear();
+        createStretchConstraints(system);
+        createBendingAndVolumeConstraints(system);
+
+        // Wake up all the vertices.
+        m_restTimes.clear();
+        m_dampingComponentsDirty = true;
+    }
+
+    void Solver::setSleepParameters(float velocityThreshold, float timeToSleep)
+    {
+        assert(velocityThreshold >= 0.f && timeToSleep >= 0.f);
+        m_sleepVelocityThreshold = velocityThreshold;
+        m_timeToSleep = timeToSleep;
+        m_restTimes.clear();
+    }
+
+    void Solver::getConstraintStiffness(float stiffnessIn, float& stiffnessOut, float& complianceOut) const
+    {
+        if (m_useXpbd)
+        {
+            assert(stiffnessIn > 0.f);
+            stiffnessOut = 1.f;
+            complianceOut = 1.f / stiffnessIn;
+        }
+        else
         {
-            SimdFloat mass(system.getVertexMass());
+            stiffnessOut = getAdjustedStiffness(SimdFloat(stiffnessIn), m_solverIterations);
+            complianceOut = 0.f;
+        }
+    }
 
-            const PointBasedSystem::Vertices& vertices = system.getVertices();
-            const PointBasedSystem::Edges& edges = system.getEdges();
+    void Solver::createStretchConstraints(const PointBasedSystem& system)
+    {
+        // Create stretch constraints at all edges between vertices in the point based system.
+        const PointBasedSystem::Vertices& vertices = system.getVertices();
+        const PointBasedSystem::Edges& edges = system.getEdges();
 
-            m_constraints.reserve(edges.size());
+        m_stretchConstraints.reserve((int)edges.size());
 
-            const int numVerts = getNumVertices();
+        const int numVerts = getNumVertices();
 
-            for (int vtxIdx = 0; vtxIdx < numVerts; vtxIdx++)
+        for (int vtxIdx = 0; vtxIdx < numVerts; vtxIdx++)
+        {
+            const PointBasedSystem::Vertex& vertex = vertices[vtxIdx];
+            if(vertex.m_numEdges > 0)
             {
-                const PointBasedSystem::Vertex& vertex = vertices[vtxIdx];
-                if(vertex.m_numEdges > 0)
-                {
-                    const int edgeEnd = vertex.m_edgeStart + vertex.m_numEdges;
+                const int edgeEnd = vertex.m_edgeStart + vertex.m_numEdges;
 
-                    for (int edgeIdx = vertex.m_edgeStart; edgeIdx < edgeEnd; edgeIdx++)
-                    {
-                        const PointBasedSystem::Edge& edge = edges[edgeIdx];
+                for (int edgeIdx = vertex.m_edgeStart; edgeIdx < edgeEnd; edgeIdx++)
+                {
+                    const PointBasedSystem::Edge& edge = edges[edgeIdx];
 
-                        SimdFloat stiffness = SimdFloat(getAdjustedStiffness(edge.m_stiffness, m_solverIterations));
+                    float stiffness, compliance;
+                    getConstraintStiffness(edge.m_stiffness, stiffness, compliance);
 
-                        // Create stretch constraint
-                        m_constraints.push_back(new StretchConstraint(
-                            SimdFloat(edge.m_length), &m_newPositions[vtxIdx], &m_newPositions[edge.m_otherVertex],
-                            mass, mass, stiffness));
-                    }
+                    // Create stretch constraint
+                    m_stretchConstraints.add(vtxIdx, edge.m_otherVertex, edge.m_length, m_invMasses[vtxIdx], m_invMasses[edge.m_otherVertex], stiffness, compliance);
                 }
             }
         }
+
+        // Colors are computed only once here. They are updated incrementally when topology of the system changes.
+        m_stretchConstraints.buildColors();
     }
 
-    Solver::~Solver()
+    void Solver::createBendingAndVolumeConstraints(const PointBasedSystem& system)
     {
-        // Clear constraint
-        for (int i = 0; i < (int)m_constraints.size(); i++)
+        m_bendingConstraints.clear();
+        m_volumeConstraints.clear();
+
+        // Rest shapes are taken from the current positions.
+        float stiffness, compliance;
+        for (const PointBasedSystem::Cinfo::Bend& bend : system.getBends())
         {
-            delete m_constraints[i];
+            getConstraintStiffness(bend.m_stiffness, stiffness, compliance);
+            m_bendingConstraints.add(bend.m_vA, bend.m_vB, bend.m_vC, m_positions,
+                m_invMasses[bend.m_vA], m_invMasses[bend.m_vB], m_invMasses[bend.m_vC], stiffness, compliance);
         }
-        m_constraints.clear();
+        m_bendingConstraints.buildColors();
+
+        for (const PointBasedSystem::Cinfo::Tetrahedron& tet : system.getTetrahedra())
+        {
+            const float invMasses[VolumeConstraints::s_numVertices] = { m_invMasses[tet.m_v[0]], m_invMasses[tet.m_v[1]], m_invMasses[tet.m_v[2]], m_invMasses[tet.m_v[3]] };
+            getConstraintStiffness(tet.m_stiffness, stiffness, compliance);
+            m_volumeConstraints.add(tet.m_v, m_positions, invMasses, stiffness, compliance);
+        }
+        m_volumeConstraints.buildColors();
+    }
+
+    void Solver::addRemoveVerticesAndEdges(const EdgeChanges& addedEdges, const EdgeChanges& removedEdges)
+    {
+        // Vertices are already added to the external buffers.
+        m_newPositions.resize(m_positions.size());
+
+        m_edgesToRemove.clear();
+        for (const EdgeChange& edge : removedEdges)
+        {
+            m_edgesToRemove.push_back(StretchConstraints::VertexPair(edge.m_vertexA, edge.m_vertexB));
+        }
+        m_stretchConstraints.remove(m_edgesToRemove);
+
+        for (const EdgeChange& edge : addedEdges)
+        {
+            float stiffness, compliance;
+            getConstraintStiffness(edge.m_stiffness, stiffness, compliance);
+            m_stretchConstraints.add(edge.m_vertexA, edge.m_vertexB, edge.m_length, m_invMasses[edge.m_vertexA], m_invMasses[edge.m_vertexB], stiffness, compliance);
+        }
+
+        // Wake up all the vertices.
+        m_restTimes.clear();
+        m_dampingComponentsDirty = true;
     }
 
     void Solver::solve(float deltaTimeIn)
     {
         const SimdFloat dt(deltaTimeIn);
+        const bool sleepingEnabled = m_sleepVelocityThreshold > 0.f;
+
+        if (sleepingEnabled)
+        {
+            wakeUpDisturbedVertices();
+        }
 
         // Apply gravity
         if (dt > SimdFloat_0 && m_gravity.lengthSq<3>() > SimdFloat_0)
         {
             Vector4 deltaV = m_gravity * dt;
-            for (Vector4& vel : m_velocities)
+            const int numVelocities = (int)m_velocities.size();
+            for (int i = 0; i < numVelocities; i++)
             {
-                vel += deltaV;
+                if (m_invMasses[i] > 0.f && !isVertexSleeping(i))
+                {
+                    m_velocities[i] += deltaV;
+                }
             }
         }
 
@@ -172,19 +276,27 @@ namespace PBD
         assert(numVertices == (int)m_velocities.size());
         assert(numVertices == (int)m_newPositions.size());
 
-        // Move vertices to the new positions.
+        // Move vertices to the new positions. Sleeping vertices and pinned vertices stay.
         for (int i = 0; i < numVertices; i++)
         {
-            m_newPositions[i] = m_positions[i] + dt * m_velocities[i];
+            m_newPositions[i] = (m_invMasses[i] == 0.f || isVertexSleeping(i)) ? m_positions[i] : m_positions[i] + dt * m_velocities[i];
         }
 
         // Generate constraints due to collisions.
         generateCollisionConstraints();
 
+        // Lagrange multipliers are accumulated over iterations of a step.
+        if (m_useXpbd)
+        {
+            m_stretchConstraints.resetLambdas();
+            m_bendingConstraints.resetLambdas();
+            m_volumeConstraints.resetLambdas();
+        }
+
         // Project all constraints and repeat.
         for (int i = 0; i < m_solverIterations; i++)
         {
-            projectConstraints();
+            projectConstraints(deltaTimeIn);
         }
 
         // Update velocities and positions of vertices.
@@ -192,168 +304,648 @@ namespace PBD
         for (int i = 0; i < numVertices; i++)
         {
             m_velocities[i] = (m_newPositions[i] - m_positions[i]) * invDt;
+
+            // Sleeping vertices which are moved only slightly by constraints are kept where they are.
+            if (sleepingEnabled && updateVertexSleeping(i, deltaTimeIn))
+            {
+                continue;
+            }
+
             m_positions[i] = m_newPositions[i];
         }
     }
 
+    void Solver::wakeUpDisturbedVertices()
+    {
+        const int numVertices = getNumVertices();
+        if ((int)m_restTimes.size() != numVertices)
+        {
+            m_restTimes.assign(numVertices, 0.f);
+            return;
+        }
+
+        // Velocities of sleeping vertices are zero unless someone modified them.
+        for (int i = 0; i < numVertices; i++)
+        {
+            if (isVertexSleeping(i) && m_velocities[i].lengthSq<3>() > SimdFloat_0)
+            {
+                m_restTimes[i] = 0.f;
+            }
+        }
+    }
+
+    bool Solver::updateVertexSleeping(int index, float deltaTime)
+    {
+        float& restTime = m_restTimes[index];
+        Vector4& velocity = m_velocities[index];
+
+        const SimdFloat threshold(m_sleepVelocityThreshold);
+        if (velocity.lengthSq<3>() >= threshold * threshold)
+        {
+            restTime = 0.f;
+            return false;
+        }
+
+        restTime = std::min(restTime + deltaTime, m_timeToSleep);
+        if (restTime >= m_timeToSleep)
+        {
+            velocity.setZero();
+            return true;
+        }
+
+        return false;
+    }
+
     void Solver::dampVelocities()
     {
         switch (m_dampingType)
         {
             case VelocityDampingType::SHAPE_MATCH:
+            {
+                dampVelocitiesByShapeMatch();
+                break;
+            }
+            case VelocityDampingType::SIMPLE:
             {
                 const int numVerts = getNumVertices();
-                Vector4 avgPos = Vec4_0;
-                Vector4 avgVel = Vec4_0;
-
                 for (int i = 0; i < numVerts; i++)
                 {
-                    avgPos += m_positions[i];
-                    avgVel += m_velocities[i];
+                    m_velocities[i] *= (SimdFloat_1 - m_dampingFactor);
                 }
+                break;
+            }
+            default:
+                break;
+        }
+    }
 
-                SimdFloat invNumVerts(1.f / (float)numVerts);
+    void Solver::buildDampingComponents()
+    {
+        const int numVerts = getNumVertices();
+        m_dampingComponentsDirty = false;
+        m_componentReferences.clear();
 
-                avgPos *= invNumVerts;
-                avgVel *= invNumVerts;
+        if (!m_dampPerComponent)
+        {
+            m_vertexComponents.assign(numVerts, 0);
+            if (numVerts > 0)
+            {
+                m_componentReferences.push_back(0);
+            }
+            return;
+        }
 
-                std::vector<Vector4> r;
-                r.resize(numVerts);
-                Vector4 l = Vec4_0;
-                Matrix33 inertia = Mat33_0;
-                for (int i = 0; i < numVerts; i++)
-                {
-                    Vector4& ri = r[i];
-                    ri = m_positions[i] - avgPos;
-                    l += Vector4::cross(ri, m_velocities[i]);
+        // Union find over vertices of constraints. The root of each set is always its smallest vertex.
+        std::vector<int>& parents = m_vertexComponents;
+        parents.resize(numVerts);
+        for (int i = 0; i < numVerts; i++)
+        {
+            parents[i] = i;
+        }
 
-                    Matrix33 m;
-                    m.setColumn<0>(Vector4(SimdFloat_0, ri.getComponent<2>(), -ri.getComponent<1>()));
-                    m.setColumn<1>(Vector4(-ri.getComponent<2>(), SimdFloat_0, ri.getComponent<0>()));
-                    m.setColumn<2>(Vector4(ri.getComponent<1>(), -ri.getComponent<0>(), SimdFloat_0));
+        auto findRoot = [&parents](int v)
+        {
+            while (parents[v] != v)
+            {
+                parents[v] = parents[parents[v]];
+                v = parents[v];
+            }
+            return v;
+        };
 
-                    inertia += ((m * m.transpose()));
-                }
+        auto unite = [&parents, &findRoot](int a, int b)
+        {
+            a = findRoot(a);
+            b = findRoot(b);
+            if (a != b)
+            {
+                parents[std::max(a, b)] = std::min(a, b);
+            }
+        };
 
-                if (inertia.getDeterminant() == SimdFloat_0)
+        for (int i = 0; i < m_stretchConstraints.getNumConstraints(); i++)
+        {
+            unite(m_stretchConstraints.getVertexA(i), m_stretchConstraints.getVertexB(i));
+        }
+
+        for (int i = 0; i < m_bendingConstraints.getNumConstraints(); i++)
+        {
+            for (int k = 1; k < BendingConstraints::s_numVertices; k++)
+            {
+                unite(m_bendingConstraints.getVertex(i, 0), m_bendingConstraints.getVertex(i, k));
+            }
+        }
+
+        for (int i = 0; i < m_volumeConstraints.getNumConstraints(); i++)
+        {
+            for (int k = 1; k < VolumeConstraints::s_numVertices; k++)
+            {
+                unite(m_volumeConstraints.getVertex(i, 0), m_volumeConstraints.getVertex(i, k));
+            }
+        }
+
+        // Point all the vertices to their roots directly.
+        for (int i = 0; i < numVerts; i++)
+        {
+            parents[i] = findRoot(i);
+        }
+
+        // Replace roots by indices of components. Roots are visited before the other vertices of their components.
+        for (int i = 0; i < numVerts; i++)
+        {
+            const int root = parents[i];
+            if (root == i)
+            {
+                parents[i] = (int)m_componentReferences.size();
+                m_componentReferences.push_back(i);
+            }
+            else
+            {
+                parents[i] = parents[root];
+            }
+        }
+    }
+
+    void Solver::dampVelocitiesByShapeMatch()
+    {
+        const int numVerts = getNumVertices();
+        if (m_dampingComponentsDirty || (int)m_vertexComponents.size() != numVerts)
+        {
+            buildDampingComponents();
+        }
+
+        const int numComponents = (int)m_componentReferences.size();
+        if (numComponents == 0)
+        {
+            return;
+        }
+
+        const int numThreads = std::max(1, std::min(m_numThreads, numVerts / s_minDampingVerticesPerThread));
+
+        // Accumulate moments of each component. Each thread accumulates a contiguous range of vertices into its own moments.
+        // Pinned vertices have infinite mass and don't take part in shape matching.
+        const ShapeMatchMoments zeroMoments{ Vec4_0, Vec4_0, Vec4_0, Vec4_0, Vec4_0 };
+        m_shapeMatchMoments.assign(numThreads * numComponents, zeroMoments);
+
+        #pragma omp parallel num_threads(numThreads) if(numThreads > 1)
+        {
+            const int thread = omp_get_thread_num();
+            const int numActiveThreads = omp_get_num_threads();
+            const int start = (int)((int64_t)numVerts * thread / numActiveThreads);
+            const int end = (int)((int64_t)numVerts * (thread + 1) / numActiveThreads);
+            ShapeMatchMoments* moments = &m_shapeMatchMoments[thread * numComponents];
+
+            for (int i = start; i < end; i++)
+            {
+                if (m_invMasses[i] == 0.f)
                 {
-                    break;
+                    continue;
                 }
 
+                const int component = m_vertexComponents[i];
+                const SimdFloat mass(1.f / m_invMasses[i]);
+                const Vector4& v = m_velocities[i];
+
+                // Positions relative to the reference vertex keep precision of the moments far from the origin.
+                // w is one so that the sum of mass is accumulated in w.
+                Vector4 x = m_positions[i] - m_positions[m_componentReferences[component]];
+                x.setComponent<3>(SimdFloat_1);
+                const Vector4 mx = x * mass;
+
+                ShapeMatchMoments& m = moments[component];
+                m.m_position += mx;
+                m.m_momentum += v * mass;
+                m.m_angularMomentum += Vector4::cross(mx, v);
+                m.m_diagonal += mx * x;
+                m.m_offDiagonal += mx * Vector4(x.getComponent<1>(), x.getComponent<2>(), x.getComponent<0>());
+            }
+        }
+
+        // Sum up moments of all threads and calculate rigid motion of each component.
+        m_shapeMatchMotions.resize(numComponents);
+        for (int c = 0; c < numComponents; c++)
+        {
+            ShapeMatchMoments& m = m_shapeMatchMoments[c];
+            for (int t = 1; t < numThreads; t++)
+            {
+                const ShapeMatchMoments& threadMoments = m_shapeMatchMoments[t * numComponents + c];
+                m.m_position += threadMoments.m_position;
+                m.m_momentum += threadMoments.m_momentum;
+                m.m_angularMomentum += threadMoments.m_angularMomentum;
+                m.m_diagonal += threadMoments.m_diagonal;
+                m.m_offDiagonal += threadMoments.m_offDiagonal;
+            }
+
+            ShapeMatchMotion& motion = m_shapeMatchMotions[c];
+            const float mass = m.m_position(3);
+            if (mass <= 0.f)
+            {
+                motion = ShapeMatchMotion{ Vec4_0, Vec4_0, Vec4_0 };
+                continue;
+            }
+
+            const SimdFloat invMass(1.f / mass);
+            Vector4 center = m.m_position * invMass;
+            center.setComponent<3>(SimdFloat_0);
+            motion.m_linearVelocity = m.m_momentum * invMass;
+
+            // Angular momentum around the center of mass.
+            const Vector4 angularMomentum = m.m_angularMomentum - Vector4::cross(center, m.m_momentum);
+
+            // Covariance around the center of mass and the inertia tensor I = trace(C) * E - C.
+            const float cx = center(0), cy = center(1), cz = center(2);
+            const float cxx = m.m_diagonal(0) - mass * cx * cx;
+            const float cyy = m.m_diagonal(1) - mass * cy * cy;
+            const float czz = m.m_diagonal(2) - mass * cz * cz;
+            const float cxy = m.m_offDiagonal(0) - mass * cx * cy;
+            const float cyz = m.m_offDiagonal(1) - mass * cy * cz;
+            const float czx = m.m_offDiagonal(2) - mass * cz * cx;
+            const float trace = cxx + cyy + czz;
+
+            if (trace > 0.f)
+            {
+                // Regularize the inertia tensor so that degenerate components such as straight chains don't rotate around their axes.
+                const float epsilon = 1e-6f * trace;
+                Matrix33 inertia(
+                    cyy + czz + epsilon, -cxy, -czx,
+                    -cxy, czz + cxx + epsilon, -cyz,
+                    -czx, -cyz, cxx + cyy + epsilon);
                 inertia.setInverse(inertia);
+                motion.m_angularVelocity = inertia * angularMomentum;
+            }
+            else
+            {
+                // A single vertex or vertices at the same position don't rotate.
+                motion.m_angularVelocity = Vec4_0;
+            }
 
-                Vector4 angVel = inertia * l;
+            motion.m_center = m_positions[m_componentReferences[c]] + center;
+        }
 
-                for (int i = 0; i < numVerts; i++)
-                {
-                    m_velocities[i] += m_dampingFactor * (avgVel + Vector4::cross(angVel, r[i]) - m_velocities[i]);
-                }
+        // Damp velocities toward the rigid motion.
+        #pragma omp parallel for num_threads(numThreads) if(numThreads > 1)
+        for (int i = 0; i < numVerts; i++)
+        {
+            if (m_invMasses[i] == 0.f)
+            {
+                continue;
+            }
+
+            const ShapeMatchMotion& motion = m_shapeMatchMotions[m_vertexComponents[i]];
+            const Vector4 r = m_positions[i] - motion.m_center;
+            m_velocities[i] += m_dampingFactor * (motion.m_linearVelocity + Vector4::cross(motion.m_angularVelocity, r) - m_velocities[i]);
+        }
+    }
+
+    void Solver::generateCollisionConstraints()
+    {
+        m_dynamicVertexCollisionConstraints.clear();
+        m_staticCollisionConstraints.clear();
+
+        const int numVerts = getNumVertices();
+
+        // Find collisions against colliders.
+        generateStaticCollisionConstraints();
+
+        // Find collisions between vertices.
+        m_collidingPairs.clear();
+        switch (m_broadphaseType)
+        {
+            case BroadphaseType::SPATIAL_HASH:
+            {
+                m_spatialHashGrid.findPairs(m_newPositions, SimdFloat_2 * m_vertexRadius, m_collidingPairs);
                 break;
             }
-            case VelocityDampingType::SIMPLE:
+            case BroadphaseType::BRUTE_FORCE:
             {
-                const int numVerts = getNumVertices();
-                for (int i = 0; i < numVerts; i++)
+                // Detect collision by brute force O(N^2) approach
+                SimdFloat minDistSq = SimdFloat_2 * m_vertexRadius;
+                minDistSq *= minDistSq;
+                for (int posAIdx = 0; posAIdx < numVerts - 1; posAIdx++)
                 {
-                    m_velocities[i] *= (SimdFloat_1 - m_dampingFactor);
+                    const Vector4& posA = m_newPositions[posAIdx];
+                    for (int posBIdx = posAIdx + 1; posBIdx < numVerts; posBIdx++)
+                    {
+                        if ((posA - m_newPositions[posBIdx]).lengthSq<3>() < minDistSq)
+                        {
+                            m_collidingPairs.push_back(SpatialHashGrid::Pair{ posAIdx, posBIdx });
+                        }
+                    }
                 }
                 break;
             }
             default:
+                assert(0);
                 break;
         }
+
+        // Sort colliding pairs by colors when constraints are projected in parallel.
+        if (m_numThreads > 1)
+        {
+            colorCollisionConstraints();
+        }
+        else
+        {
+            m_collisionColorStarts.clear();
+        }
+
+        m_dynamicVertexCollisionConstraints.reserve(m_collidingPairs.size());
+        for (const SpatialHashGrid::Pair& pair : m_collidingPairs)
+        {
+            m_dynamicVertexCollisionConstraints.push_back(DynamicVertexCollisionConstraint(&m_newPositions[pair.m_a], &m_newPositions[pair.m_b], m_vertexRadius, m_vertexRadius,
+                m_invMasses[pair.m_a], m_invMasses[pair.m_b], SimdFloat_1, m_solverIterations));
+        }
     }
 
-    void Solver::generateCollisionConstraints()
+    void Solver::updateColliderAabbs()
     {
-        // Detect collision by brute force O(N^2) approach
-        // [TODO] Implement a smarter way
+        const int numColliders = getNumColliders();
+        bool changed = (int)m_colliderAabbs.size() != numColliders;
+        m_colliderAabbs.resize(numColliders);
+        for (int i = 0; i < numColliders; i++)
+        {
+            m_colliders[i].getShape()->getAabb(m_newColliderAabb);
+            if (!m_newColliderAabb.exactEquals(m_colliderAabbs[i]))
+            {
+                m_colliderAabbs[i] = m_newColliderAabb;
+                changed = true;
+            }
+        }
 
-        m_dynamicVertexCollisionConstraints.clear();
-        m_staticCollisionConstraints.clear();
+        // Sleeping vertices are not tested against colliders, so wake them all up if colliders changed.
+        if (changed)
+        {
+            std::fill(m_restTimes.begin(), m_restTimes.end(), 0.f);
+        }
+
+        // Clearances are measured against the old AABBs.
+        const int numVerts = getNumVertices();
+        if (changed || (int)m_colliderClearances.size() != numVerts)
+        {
+            m_colliderClearances.assign(numVerts, Vec4_0);
+            for (Vector4& clearance : m_colliderClearances)
+            {
+                clearance.setComponent<3>(-SimdFloat_1);
+            }
+        }
+    }
+
+    void Solver::generateStaticCollisionConstraints()
+    {
+        updateColliderAabbs();
 
         const int numVerts = getNumVertices();
 
-        // Find collisions against colliders.
+        // Find colliders around swept bounds of vertices which can move.
+        // The bounds are enlarged by the vertex radius so that clearances of vertices on the boundary don't vanish.
+        Aabb queryAabb;
+        bool hasMovingVertex = false;
+        for (int posIdx = 0; posIdx < numVerts; posIdx++)
         {
-            const int numColliders = getNumColliders();
-            for (int posIdx = 0; posIdx < numVerts; posIdx++)
+            // Pinned vertices are never pushed by colliders.
+            if (m_invMasses[posIdx] == 0.f || isVertexSleeping(posIdx))
             {
-                const Vector4& start = m_positions[posIdx];
-                const Vector4& end = m_newPositions[posIdx];
+                continue;
+            }
 
-                for (int colIdx = 0; colIdx < numColliders; colIdx++)
+            if (!hasMovingVertex)
+            {
+                queryAabb.set(m_positions[posIdx], m_newPositions[posIdx]);
+                hasMovingVertex = true;
+            }
+            else
+            {
+                queryAabb.include(m_positions[posIdx]);
+                queryAabb.include(m_newPositions[posIdx]);
+            }
+        }
+
+        m_candidateColliders.clear();
+        if (hasMovingVertex)
+        {
+            queryAabb.expand(m_vertexRadius.getFloat());
+            m_colliderTree.query(queryAabb, m_candidateColliders);
+        }
+
+        // Keep the order of colliders so that constraints are generated deterministically.
+        std::sort(m_candidateColliders.begin(), m_candidateColliders.end());
+        if (m_candidateColliders.empty())
+        {
+            return;
+        }
+
+        // Find vertices which may collide with colliders.
+        m_activeVertices.clear();
+        m_sweptAabbs.clear();
+        for (int posIdx = 0; posIdx < numVerts; posIdx++)
+        {
+            if (m_invMasses[posIdx] == 0.f || isVertexSleeping(posIdx))
+            {
+                continue;
+            }
+
+            const Vector4& start = m_positions[posIdx];
+            const Vector4& end = m_newPositions[posIdx];
+
+            // Skip the vertex if it stays inside its clearance. The clearance is convex so the whole path is inside too.
+            Vector4& clearance = m_colliderClearances[posIdx];
+            const SimdFloat clearanceRadius = clearance.getComponent<3>();
+            if (clearanceRadius > SimdFloat_0)
+            {
+                const SimdFloat clearanceRadiusSq = clearanceRadius * clearanceRadius;
+                if ((start - clearance).lengthSq<3>() < clearanceRadiusSq && (end - clearance).lengthSq<3>() < clearanceRadiusSq)
+                {
+                    continue;
+                }
+            }
+
+            // Colliders other than candidates are outside the query bounds, so the clearance is limited by distance to the boundary.
+            float minDistance = std::numeric_limits<float>::max();
+            for (int i = 0; i < 3; i++)
+            {
+                minDistance = std::min(minDistance, std::min(start(i) - queryAabb.m_min(i), queryAabb.m_max(i) - start(i)));
+            }
+
+            for (int colIdx : m_candidateColliders)
+            {
+                minDistance = std::min(minDistance, m_colliderAabbs[colIdx].getDistance(start));
+            }
+
+            // Remember the sphere around the start which doesn't touch any collider.
+            clearance = start;
+            clearance.setComponent<3>(SimdFloat(minDistance));
+
+            Aabb sweptAabb;
+            sweptAabb.set(start, end);
+            m_activeVertices.push_back(posIdx);
+            m_sweptAabbs.push_back(sweptAabb);
+        }
+
+        // Query each collider once for all the vertices whose swept bounds touch its AABB.
+        // Constraints of each vertex are still generated in the order of colliders.
+        const int numActiveVertices = (int)m_activeVertices.size();
+        for (int colIdx : m_candidateColliders)
+        {
+            const Aabb& colliderAabb = m_colliderAabbs[colIdx];
+
+            m_queryVertices.clear();
+            m_queryStarts.clear();
+            m_queryEnds.clear();
+            for (int i = 0; i < numActiveVertices; i++)
+            {
+                if (colliderAabb.overlaps(m_sweptAabbs[i]))
                 {
-                    Shape::RayCastOutput rcOut;
-                    const Shape* shape = m_colliders[colIdx].getShape();
+                    const int posIdx = m_activeVertices[i];
+                    m_queryVertices.push_back(posIdx);
+                    m_queryStarts.push_back(m_positions[posIdx]);
+                    m_queryEnds.push_back(m_newPositions[posIdx]);
+                }
+            }
 
-                    if (shape->hasInterior())
+            const int numQueries = (int)m_queryVertices.size();
+            if (numQueries == 0)
+            {
+                continue;
+            }
+
+            const Shape* shape = m_colliders[colIdx].getShape();
+            if (shape->hasInterior())
+            {
+                m_rayCastOutputs.resize(numQueries);
+                shape->castRays(m_queryStarts.data(), m_queryEnds.data(), numQueries, m_rayCastOutputs.data());
+
+                // Vertices starting inside the shape are pushed out to the closest points. Pack them at the front of query buffers.
+                int numInside = 0;
+                for (int i = 0; i < numQueries; i++)
+                {
+                    const Shape::RayCastOutput& rcOut = m_rayCastOutputs[i];
+                    if (!rcOut.m_hit)
                     {
-                        shape->castRay(start, end, rcOut);
-                        if (rcOut.m_hit)
-                        {
-                            if (rcOut.m_fraction > 0.f)
-                            {
-                                m_staticCollisionConstraints.push_back(StaticCollisionConstraint(&m_newPositions[posIdx], rcOut.m_hitPoint, rcOut.m_hitNormal, SimdFloat_1, m_solverIterations));
-                            }
-                            else
-                            {
-                                Shape::ClosestPointOutput cpOut;
-                                shape->getClosestPoint(start, cpOut);
-                                m_staticCollisionConstraints.push_back(StaticCollisionConstraint(&m_newPositions[posIdx], cpOut.m_closestPoint, cpOut.m_normal, SimdFloat_1, m_solverIterations));
-                            }
-                        }
+                        continue;
+                    }
+
+                    if (rcOut.m_fraction > 0.f)
+                    {
+                        m_staticCollisionConstraints.push_back(StaticCollisionConstraint(&m_newPositions[m_queryVertices[i]], rcOut.m_hitPoint, rcOut.m_hitNormal, SimdFloat_1, m_solverIterations));
                     }
                     else
                     {
-                        Shape::ClosestPointOutput cpOut;
-                        shape->getClosestPoint(start, cpOut);
-                        Vector4 dir = cpOut.m_closestPoint - start;
-                        if (dir.dot<3>(cpOut.m_normal) > SimdFloat_0)
-                        {
-                            m_staticCollisionConstraints.push_back(StaticCollisionConstraint(&m_newPositions[posIdx], cpOut.m_closestPoint, cpOut.m_normal, SimdFloat_1, m_solverIterations));
-                        }
+                        m_queryVertices[numInside] = m_queryVertices[i];
+                        m_queryStarts[numInside] = m_queryStarts[i];
+                        numInside++;
                     }
                 }
-            }
-        }
 
-        // Find collisions between vertices.
-        {
-            SimdFloat minDistSq = SimdFloat_2 * m_vertexRadius;
-            minDistSq *= minDistSq;
-            for (int posAIdx = 0; posAIdx < numVerts - 1; posAIdx++)
+                m_closestPointOutputs.resize(numInside);
+                shape->getClosestPoints(m_queryStarts.data(), numInside, m_closestPointOutputs.data());
+                for (int i = 0; i < numInside; i++)
+                {
+                    const Shape::ClosestPointOutput& cpOut = m_closestPointOutputs[i];
+                    m_staticCollisionConstraints.push_back(StaticCollisionConstraint(&m_newPositions[m_queryVertices[i]], cpOut.m_closestPoint, cpOut.m_normal, SimdFloat_1, m_solverIterations));
+                }
+            }
+            else
             {
-                Vector4& posA = m_newPositions[posAIdx];
-                for (int posBIdx = posAIdx + 1; posBIdx < numVerts; posBIdx++)
+                int numRemaining = numQueries;
+                if (shape->supportsSweptQueries())
                 {
-                    Vector4& posB = m_newPositions[posBIdx];
+                    // Vertices crossing the surface within this step may end beyond the region behind the surface. Catch them by sweeping.
+                    // Pack vertices without a hit at the front of query buffers to test their starts below.
+                    m_rayCastOutputs.resize(numQueries);
+                    shape->castRays(m_queryStarts.data(), m_queryEnds.data(), numQueries, m_rayCastOutputs.data());
 
-                    if ((posA - posB).lengthSq<3>() < minDistSq)
+                    numRemaining = 0;
+                    for (int i = 0; i < numQueries; i++)
+                    {
+                        const Shape::RayCastOutput& rcOut = m_rayCastOutputs[i];
+                        if (rcOut.m_hit)
+                        {
+                            m_staticCollisionConstraints.push_back(StaticCollisionConstraint(&m_newPositions[m_queryVertices[i]], rcOut.m_hitPoint, rcOut.m_hitNormal, SimdFloat_1, m_solverIterations));
+                        }
+                        else
+                        {
+                            m_queryVertices[numRemaining] = m_queryVertices[i];
+                            m_queryStarts[numRemaining] = m_queryStarts[i];
+                            numRemaining++;
+                        }
+                    }
+                }
+
+                m_closestPointOutputs.resize(numRemaining);
+                shape->getClosestPoints(m_queryStarts.data(), numRemaining, m_closestPointOutputs.data());
+                for (int i = 0; i < numRemaining; i++)
+                {
+                    const Shape::ClosestPointOutput& cpOut = m_closestPointOutputs[i];
+                    Vector4 dir = cpOut.m_closestPoint - m_queryStarts[i];
+                    if (dir.dot<3>(cpOut.m_normal) > SimdFloat_0)
                     {
-                        m_dynamicVertexCollisionConstraints.push_back(DynamicVertexCollisionConstraint(&posA, &posB, m_vertexRadius, m_vertexRadius, SimdFloat_1, m_solverIterations));
+                        m_staticCollisionConstraints.push_back(StaticCollisionConstraint(&m_newPositions[m_queryVertices[i]], cpOut.m_closestPoint, cpOut.m_normal, SimdFloat_1, m_solverIterations));
                     }
                 }
             }
         }
     }
 
-    void Solver::projectConstraints()
+    void Solver::colorCollisionConstraints()
     {
-        // Solve input constraints.
-        for (Constraint* c : m_constraints)
+        const int numPairs = (int)m_collidingPairs.size();
+
+        m_collisionVertexA.resize(numPairs);
+        m_collisionVertexB.resize(numPairs);
+        for (int i = 0; i < numPairs; i++)
+        {
+            m_collisionVertexA[i] = m_collidingPairs[i].m_a;
+            m_collisionVertexB[i] = m_collidingPairs[i].m_b;
+        }
+
+        colorConstraints(m_collisionVertexA.data(), m_collisionVertexB.data(), numPairs, m_collisionOrder, m_collisionColorStarts, m_collisionColoringBuffers);
+
+        for (int i = 0; i < numPairs; i++)
         {
-            c->project();
+            const int pairIdx = m_collisionOrder[i];
+            m_collidingPairs[i] = SpatialHashGrid::Pair{ m_collisionVertexA[pairIdx], m_collisionVertexB[pairIdx] };
         }
+    }
+
+    void Solver::projectConstraints(float deltaTime)
+    {
+        // Compliances are used only in XPBD mode.
+        const float xpbdDeltaTime = m_useXpbd ? deltaTime : 0.f;
+
+        // Solve stretch, bending and volume constraints.
+        m_stretchConstraints.project(m_newPositions, m_numThreads, xpbdDeltaTime);
+        m_bendingConstraints.project(m_newPositions, m_numThreads, xpbdDeltaTime);
+        m_volumeConstraints.project(m_newPositions, m_numThreads, xpbdDeltaTime);
 
         // Solve dynamic collision constraints.
-        for (Constraint& c : m_dynamicVertexCollisionConstraints)
+        if (m_collisionColorStarts.empty())
         {
-            c.project();
+            for (DynamicVertexCollisionConstraint& c : m_dynamicVertexCollisionConstraints)
+            {
+                c.project();
+            }
+        }
+        else
+        {
+            // Constraints of the same color don't share any vertex.
+            const int numColors = (int)m_collisionColorStarts.size() - 1;
+            for (int color = 0; color < numColors; color++)
+            {
+                const int start = m_collisionColorStarts[color];
+                const int end = m_collisionColorStarts[color + 1];
+
+                #pragma omp parallel for num_threads(m_numThreads) if(end - start >= 64)
+                for (int i = start; i < end; i++)
+                {
+                    m_dynamicVertexCollisionConstraints[i].project();
+                }
+            }
         }
 
         // Solve static collision constraints.
-        for (Constraint& c : m_staticCollisionConstraints)
+        // They are projected serially since a vertex can collide with multiple colliders and each constraint has only one vertex,
+        // which is too little work to pay for coloring them every step.
+        for (StaticCollisionConstraint& c : m_staticCollisionConstraints)
         {
             c.project();
         }
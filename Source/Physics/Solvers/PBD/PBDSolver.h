@@ -8,6 +8,9 @@
 
 #include <Physics/Solvers/PointBasedSystemSolver.h>
 #include <Physics/Collision/Collider.h>
+#include <Physics/Collision/DynamicAabbTree.h>
+#include <Physics/Collision/SpatialHashGrid.h>
+#include <Physics/Solvers/PBD/Constraints/PBDConstraints.h>
 #include <Common/Math/Vector4.h>
 
 #include <vector>
@@ -17,31 +20,33 @@ class PointBasedSystem;
 // Code for Position Based Dynamics.
 namespace PBD
 {
-    // An abstract constraint type.
+    // Base type of collision constraints.
     struct Constraint
     {
     public:
         Constraint(SimdFloat stiffness);
 
-        virtual void project() = 0;
-
         SimdFloat m_stiffness;
     };
 
     // Constraint for collision between two dynamic vertices.
+    // Overlap is resolved by moving vertices in proportion to their inverse masses.
     struct DynamicVertexCollisionConstraint : public Constraint
     {
     public:
         DynamicVertexCollisionConstraint(
             Vector4* positionA, Vector4* positionB,
             const SimdFloat& radiusA, const SimdFloat& radiusB,
+            float invMassA, float invMassB,
             const SimdFloat& stiffness, int solverIterations);
 
-        virtual void project();
+        void project();
 
         Vector4* m_positionA;
         Vector4* m_positionB;
         SimdFloat m_radiusSq;
+        float m_weightA;    // Ratio of the correction applied to the first vertex.
+        float m_weightB;    // Ratio of the correction applied to the second vertex.
     };
 
     // Constraint for collision between a vertex and a static collider.
@@ -52,7 +57,7 @@ namespace PBD
             Vector4* position, const Vector4& target, const Vector4& normal,
             const SimdFloat& stiffness, int solverIterations);
 
-        virtual void project();
+        void project();
 
         Vector4* m_position;
         Vector4 m_targetPosition;
@@ -60,7 +65,9 @@ namespace PBD
     };
 
     // Position Based Dynamic solver.
-    // [TODO] The solver assumes that mass of all vertices are the same.
+    // Each vertex has its own inverse mass and vertices of zero inverse mass are pinned.
+    // In XPBD mode, stiffness of constraints is physical stiffness and constraints are projected with compliance and Lagrange multipliers,
+    // so the result converges to the same material behavior regardless of the number of solver iterations.
     class Solver : public PointBasedSystemSolver
     {
     public:
@@ -68,7 +75,6 @@ namespace PBD
         using Positions = std::vector<Vector4>;
         using Velocities = std::vector<Vector4>;
         using Colliders = std::vector<Collider>;
-        using Constraints = std::vector<Constraint*>;
         using DynamicVertexCollisionConstraints = std::vector<DynamicVertexCollisionConstraint>;
         using StaticCollisionConstraints = std::vector<StaticCollisionConstraint>;
 
@@ -80,17 +86,35 @@ namespace PBD
             SHAPE_MATCH     // Apply damping based on shape match in order to maintain the original shape.
         };
 
-        // Constructor
-        Solver(PointBasedSystem& system, const Vector4& gravity, int solverIterations, float dampingFactor);
+        // Type of broadphase to find collisions between vertices.
+        enum class BroadphaseType
+        {
+            BRUTE_FORCE,    // Check all pairs of vertices. O(N^2). Useful to validate other broadphases.
+            SPATIAL_HASH    // Hash vertices into a uniform grid whose cell size is the diameter of vertex.
+        };
 
-        // Destructor
-        virtual ~Solver();
+        // Constructor
+        Solver(PointBasedSystem& system, const Vector4& gravity, int solverIterations, float dampingFactor, bool useXpbd = false);
 
         // Step and solve the vertices.
         virtual void solve(float deltaTime) override;
 
         virtual Type getType() const override { return Type::POSITION_BASED_DYNAMICS; }
 
+        // Patch buffers and stretch constraints in place for added and removed vertices and edges.
+        virtual void addRemoveVerticesAndEdges(const EdgeChanges& addedEdges, const EdgeChanges& removedEdges) override;
+
+        // Rebuild stretch constraints in place reusing buffers.
+        virtual void reset(const PointBasedSystem& system) override;
+
+        // Vertices slower than velocityThreshold for timeToSleep fall asleep.
+        // Sleeping vertices are not integrated nor tested against colliders. They wake up when constraints move them,
+        // their velocities are modified, colliders change or topology of the system changes.
+        virtual void setSleepParameters(float velocityThreshold, float timeToSleep) override;
+
+        // Return true if the vertex is sleeping.
+        inline bool isVertexSleeping(int index) const { return m_sleepVelocityThreshold > 0.f && index < (int)m_restTimes.size() && m_restTimes[index] >= m_timeToSleep; }
+
         inline int getNumVertices() const { return (int)m_positions.size(); }
         inline int getNumColliders() const { return (int)m_colliders.size(); }
 
@@ -100,26 +124,82 @@ namespace PBD
         inline auto getDampingType() const->VelocityDampingType { return m_dampingType; }
         inline void setDampingType(VelocityDampingType type) { m_dampingType = type; }
 
+        // If true, SHAPE_MATCH damping matches each connected component of vertices separately instead of the whole system.
+        inline bool isDampingPerComponent() const { return m_dampPerComponent; }
+        inline void setDampingPerComponent(bool perComponent) { m_dampPerComponent = perComponent; m_dampingComponentsDirty = true; }
+
+        inline auto getBroadphaseType() const->BroadphaseType { return m_broadphaseType; }
+        inline void setBroadphaseType(BroadphaseType type) { m_broadphaseType = type; }
+
+        inline int getNumThreads() const { return m_numThreads; }
+        inline void setNumThreads(int numThreads) { assert(numThreads > 0); m_numThreads = numThreads; }
+
         inline int getSolverIterations() const { return m_solverIterations; }
 
         inline auto getGravity() const->const Vector4& { return m_gravity; }
 
+        inline bool isXpbd() const { return m_useXpbd; }
+
+        inline auto getStretchConstraints() const->const StretchConstraints& { return m_stretchConstraints; }
+        inline auto getBendingConstraints() const->const BendingConstraints& { return m_bendingConstraints; }
+        inline auto getVolumeConstraints() const->const VolumeConstraints& { return m_volumeConstraints; }
+
     protected:
+        // Create stretch constraints at all edges between vertices in the system.
+        void createStretchConstraints(const PointBasedSystem& system);
+
+        // Create bending and volume constraints from bends and tetrahedra in the system.
+        void createBendingAndVolumeConstraints(const PointBasedSystem& system);
+
+        // Convert stiffness given by the user to stiffness and compliance of constraints.
+        // PBD adjusts stiffness by the number of iterations. XPBD uses full stiffness and compliance which is inverse of the physical stiffness.
+        void getConstraintStiffness(float stiffnessIn, float& stiffnessOut, float& complianceOut) const;
+
         void dampVelocities();
 
+        // Damp velocities toward the rigid motion of each component by shape matching.
+        // Moments of vertices are accumulated in a single parallel pass and the rigid motion is solved in closed form.
+        void dampVelocitiesByShapeMatch();
+
+        // Group vertices into components for SHAPE_MATCH damping.
+        void buildDampingComponents();
+
         void generateCollisionConstraints();
 
-        void projectConstraints();
+        // Generate static collision constraints against colliders.
+        // Only colliders found in the collider tree by swept bounds of the whole system are considered.
+        // Vertices whose swept bounds don't touch the AABB of a collider skip queries against it.
+        // The rest of vertices are queried against each collider by one batched call.
+        void generateStaticCollisionConstraints();
+
+        // Update AABBs of colliders and invalidate clearances of vertices if any of them changed.
+        void updateColliderAabbs();
+
+        // Sort dynamic vertex collision constraints by colors so that they can be projected in parallel.
+        void colorCollisionConstraints();
+
+        void projectConstraints(float deltaTime);
+
+        // Wake up vertices if topology changed or velocities of sleeping vertices were modified.
+        void wakeUpDisturbedVertices();
+
+        // Update rest time of the vertex after its velocity is updated. Return true if the vertex is sleeping.
+        bool updateVertexSleeping(int index, float deltaTime);
 
         Positions& m_positions;     // External buffer of vertex positions.
         Positions m_newPositions;   // Temporary buffer to calculate new vertex positions.
 
         Velocities& m_velocities;   // External buffer of vertex velocities.
 
-        const Colliders& m_colliders;   // The colliders.
+        const std::vector<float>& m_invMasses;  // External buffer of inverse masses of vertices.
+
+        const Colliders& m_colliders;           // The colliders.
+        const DynamicAabbTree& m_colliderTree;  // Broadphase of the colliders.
 
         // Constraints
-        Constraints m_constraints;
+        StretchConstraints m_stretchConstraints;
+        BendingConstraints m_bendingConstraints;
+        VolumeConstraints m_volumeConstraints;
         DynamicVertexCollisionConstraints m_dynamicVertexCollisionConstraints;
         StaticCollisionConstraints m_staticCollisionConstraints;
 
@@ -127,9 +207,71 @@ namespace PBD
 
         int m_solverIterations;
 
+        bool m_useXpbd;             // True if constraints are projected by XPBD.
+
         VelocityDampingType m_dampingType = VelocityDampingType::SIMPLE;
         SimdFloat m_dampingFactor;
 
         SimdFloat m_vertexRadius;
+
+        StretchConstraints::VertexPairs m_edgesToRemove;   // Temporary buffer of pairs of vertices of removed edges.
+
+        BroadphaseType m_broadphaseType = BroadphaseType::SPATIAL_HASH;
+        SpatialHashGrid m_spatialHashGrid;          // Broadphase for BroadphaseType::SPATIAL_HASH.
+        SpatialHashGrid::Pairs m_collidingPairs;    // Temporary buffer of colliding vertex pairs.
+
+        int m_numThreads = 1;                       // The number of threads used to project constraints.
+        std::vector<int> m_collisionColorStarts;    // Start index of each color of dynamic vertex collision constraints. Empty when they are not colored.
+        std::vector<int> m_collisionVertexA;        // Temporary buffer of the first vertex of colliding pairs.
+        std::vector<int> m_collisionVertexB;        // Temporary buffer of the second vertex of colliding pairs.
+        std::vector<int> m_collisionOrder;          // Temporary buffer of colliding pairs sorted by colors.
+        ColoringBuffers m_collisionColoringBuffers; // Temporary buffers to color colliding pairs.
+
+        // Persistent data to skip collision queries against colliders.
+        // Clearance of a vertex is a sphere which doesn't touch any collider AABB. xyz is the center and w is the radius.
+        // While a vertex moves inside its clearance, it is not tested against colliders at all.
+        std::vector<Aabb> m_colliderAabbs;          // AABBs of colliders at the last step.
+        std::vector<Vector4> m_colliderClearances;  // Clearance of each vertex. Radius is negative if it's invalid.
+        Aabb m_newColliderAabb;                     // Temporary AABB of a collider.
+
+        // Temporary buffers of batched collider queries.
+        std::vector<int> m_candidateColliders;      // Colliders which may touch swept bounds of the system. Sorted by index.
+        std::vector<int> m_activeVertices;          // Vertices which are outside of their clearances.
+        std::vector<Aabb> m_sweptAabbs;             // Swept bounds of active vertices.
+        std::vector<int> m_queryVertices;           // Vertices queried against the current collider.
+        Positions m_queryStarts;                    // Start positions of queried vertices.
+        Positions m_queryEnds;                      // End positions of queried vertices.
+        std::vector<Shape::RayCastOutput> m_rayCastOutputs;         // Outputs of ray casts.
+        std::vector<Shape::ClosestPointOutput> m_closestPointOutputs; // Outputs of closest point queries.
+
+        // Moments of vertices of a component for SHAPE_MATCH damping. Positions are relative to the reference vertex of the component.
+        struct ShapeMatchMoments
+        {
+            Vector4 m_position;         // Sum of mass * position. w is the sum of mass.
+            Vector4 m_momentum;         // Sum of mass * velocity.
+            Vector4 m_angularMomentum;  // Sum of mass * position x velocity.
+            Vector4 m_diagonal;         // Sums of mass * (x * x, y * y, z * z).
+            Vector4 m_offDiagonal;      // Sums of mass * (x * y, y * z, z * x).
+        };
+
+        // Rigid motion of a component for SHAPE_MATCH damping.
+        struct ShapeMatchMotion
+        {
+            Vector4 m_center;           // Center of mass.
+            Vector4 m_linearVelocity;   // Velocity of the center of mass.
+            Vector4 m_angularVelocity;  // Angular velocity around the center of mass.
+        };
+
+        // Persistent data of SHAPE_MATCH damping.
+        bool m_dampPerComponent = false;                    // True if each connected component is matched separately.
+        bool m_dampingComponentsDirty = true;               // True if components have to be rebuilt.
+        std::vector<int> m_vertexComponents;                // Component of each vertex.
+        std::vector<int> m_componentReferences;             // The first vertex of each component used as the origin of its moments.
+        std::vector<ShapeMatchMoments> m_shapeMatchMoments; // Moments of each component accumulated by each thread.
+        std::vector<ShapeMatchMotion> m_shapeMatchMotions;  // Rigid motion of each component.
+
+        float m_sleepVelocityThreshold = 0.f;       // Vertices slower than this are at rest. Zero disables sleeping.
+        float m_timeToSleep = 0.f;                  // Time for which a vertex has to be at rest to fall asleep.
+        std::vector<float> m_restTimes;             // Time for which each vertex has been at rest.
     };
 }
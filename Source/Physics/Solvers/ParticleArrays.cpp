@@ -0,0 +1,76 @@
+/*
+* ParticleArrays.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <Physics/Physics.h>
+#include <Physics/Solvers/ParticleArrays.h>
+
+#include <algorithm>
+
+void ParticleArrays::resize(int numParticles)
+{
+    assert(numParticles >= 0);
+
+    const int paddedSize = (numParticles + s_padding - 1) / s_padding * s_padding;
+
+    // Clear padding elements which may have been used by particles before.
+    for (Floats* floats : { &m_x, &m_y, &m_z })
+    {
+        if (numParticles < m_size)
+        {
+            std::fill(floats->begin() + numParticles, floats->begin() + std::min(m_size, paddedSize), 0.f);
+        }
+        floats->resize(paddedSize, 0.f);
+    }
+
+    m_size = numParticles;
+}
+
+void ParticleArrays::fill(const Vector4& v)
+{
+    std::fill(m_x.begin(), m_x.begin() + m_size, v(0));
+    std::fill(m_y.begin(), m_y.begin() + m_size, v(1));
+    std::fill(m_z.begin(), m_z.begin() + m_size, v(2));
+}
+
+void ParticleArrays::gather(const Vectors& vectors)
+{
+    resize((int)vectors.size());
+
+    for (int i = 0; i < m_size; i++)
+    {
+        set(i, vectors[i]);
+    }
+}
+
+void ParticleArrays::scatter(Vectors& vectors) const
+{
+    assert((int)vectors.size() == m_size);
+
+    for (int i = 0; i < m_size; i++)
+    {
+        vectors[i] = get(i);
+    }
+}
+
+void ParticleArrays::getAabb(Aabb& aabbOut) const
+{
+    assert(m_size > 0);
+
+    // Padding is excluded since it's not a particle. Plain loops are vectorized by compilers unlike std::minmax_element.
+    float minX = m_x[0], minY = m_y[0], minZ = m_z[0];
+    float maxX = minX, maxY = minY, maxZ = minZ;
+    for (int i = 1; i < m_size; i++)
+    {
+        minX = std::min(minX, m_x[i]);
+        minY = std::min(minY, m_y[i]);
+        minZ = std::min(minZ, m_z[i]);
+        maxX = std::max(maxX, m_x[i]);
+        maxY = std::max(maxY, m_y[i]);
+        maxZ = std::max(maxZ, m_z[i]);
+    }
+    aabbOut.m_min = Vector4(minX, minY, minZ);
+    aabbOut.m_max = Vector4(maxX, maxY, maxZ);
+}
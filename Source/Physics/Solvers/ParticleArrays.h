@@ -0,0 +1,59 @@
+/*
+* ParticleArrays.h
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#pragma once
+
+#include <Common/Math/Vector4.h>
+#include <Common/AlignedAllocator.h>
+#include <Geometry/Aabb.h>
+
+#include <vector>
+
+// Vectors of particles stored in structure of arrays.
+// Each array is 32 bytes aligned and padded to a multiple of s_padding so that SIMD kernels can process particles without remainder loops.
+// Padded elements are always zero.
+class ParticleArrays
+{
+public:
+    // Type definitions.
+    using Floats = std::vector<float, AlignedAllocator<float, 32>>;
+    using Vectors = std::vector<Vector4>;
+
+    // The number of elements of each array is a multiple of this.
+    static constexpr int s_padding = 8;
+
+    // Resize arrays. New elements are zero.
+    void resize(int numParticles);
+
+    // Set all particles to the vector.
+    void fill(const Vector4& v);
+
+    // Copy xyz of vectors into arrays.
+    void gather(const Vectors& vectors);
+
+    // Copy arrays into xyz of vectors. vectors has to have the same size. w is set to zero.
+    void scatter(Vectors& vectors) const;
+
+    // Calculate the box enclosing all the particles. There has to be at least one particle.
+    void getAabb(Aabb& aabbOut) const;
+
+    // Return the number of particles.
+    inline int getSize() const { return m_size; }
+
+    // Return the number of elements of each array including padding.
+    inline int getPaddedSize() const { return (int)m_x.size(); }
+
+    // Accessors to a particle.
+    inline auto get(int i) const->Vector4 { return Vector4(m_x[i], m_y[i], m_z[i]); }
+    inline void set(int i, const Vector4& v) { m_x[i] = v(0); m_y[i] = v(1); m_z[i] = v(2); }
+
+    Floats m_x;         // X components.
+    Floats m_y;         // Y components.
+    Floats m_z;         // Z components.
+
+protected:
+    int m_size = 0;     // The number of particles.
+};
@@ -6,6 +6,10 @@
 
 #pragma once
 
+#include <vector>
+
+class PointBasedSystem;
+
 // An abstract class of solver for point based system.
 class PointBasedSystemSolver
 {
@@ -16,6 +20,34 @@ public:
         MASS_SPRING,
     };
 
+    // Memory layout of particles used by the solver.
+    enum class ParticleLayout
+    {
+        AOS,    // Array of Vector4.
+        SOA     // Separate aligned arrays of x, y and z. Only MassSpringSolver supports it.
+    };
+
+    // Edge added to or removed from the point based system.
+    struct EdgeChange
+    {
+        int m_vertexA, m_vertexB;   // Indices of vertices connected by the edge.
+        float m_length;             // Default length of the edge.
+        float m_stiffness;          // Stiffness of the edge.
+    };
+
+    using EdgeChanges = std::vector<EdgeChange>;
+
     virtual void solve(float deltaTime) = 0;
     virtual Type getType() const = 0;
+
+    // Update the solver in place after vertices and edges were added to or removed from the system.
+    // New vertices are already appended at the end of buffers of the system.
+    virtual void addRemoveVerticesAndEdges(const EdgeChanges& addedEdges, const EdgeChanges& removedEdges) = 0;
+
+    // Rebuild constraints in place after the system was reset to new vertices and edges. Settings of the solver are kept.
+    virtual void reset(const PointBasedSystem& system) = 0;
+
+    // Set thresholds for sleeping of individual vertices. Zero velocity threshold disables it.
+    // Solvers which don't support sleeping of vertices ignore them.
+    virtual void setSleepParameters(float /*velocityThreshold*/, float /*timeToSleep*/) {}
 };
@@ -9,23 +9,73 @@
 #include <Physics/Solvers/PBD/PBDSolver.h>
 #include <Physics/Solvers/MassSpring/MassSpringSolver.h>
 
+#include <cmath>
+
 void PointBasedSystem::init(const Cinfo& cinfo)
+{
+    initVerticesAndEdges(cinfo);
+
+    createSolver(cinfo);
+    m_solver->setSleepParameters(m_sleepVelocityThreshold, m_timeToSleep);
+
+    onParticlesAdded(cinfo.m_vertexPositions);
+}
+
+void PointBasedSystem::reset(const Cinfo& cinfo)
+{
+    assert(m_solver && m_solver->getType() == cinfo.m_solverType);
+
+    initVerticesAndEdges(cinfo);
+
+    m_solver->reset(*this);
+    m_solver->setSleepParameters(m_sleepVelocityThreshold, m_timeToSleep);
+}
+
+void PointBasedSystem::initVerticesAndEdges(const Cinfo& cinfo)
 {
     // Create vertices and edges
     const int numVertices = (int)cinfo.m_vertexPositions.size();
     const int numEdges = (int)cinfo.m_vertexConnectivity.size();
     assert(numVertices > 0 && cinfo.m_mass > 0.f);
 
-    // Allocate buffers.
-    m_vertices.resize(numVertices);
+    // Allocate buffers. Existing buffers are reused when the system is reset.
+    m_vertices.assign(numVertices, Vertex());
     m_edges.resize(numEdges);
     m_positions = cinfo.m_vertexPositions;
-    m_velocities.resize(numVertices, Vec4_0);
+    m_velocities.assign(numVertices, Vec4_0);
+
+    // Only mass spring solver supports SOA. The arrays are filled before the first step.
+    assert(cinfo.m_particleLayout == ParticleLayout::AOS || cinfo.m_solverType == SolverType::MASS_SPRING);
+    m_particleLayout = cinfo.m_solverType == SolverType::MASS_SPRING ? cinfo.m_particleLayout : ParticleLayout::AOS;
+    m_areVectorsStale = false;
+    m_areArraysStale = true;
 
     // Set mass and radius.
     m_vertexMass = cinfo.m_mass / (float)numVertices;
+    if (cinfo.m_vertexInvMasses.empty())
+    {
+        m_invMasses.assign(numVertices, 1.f / m_vertexMass);
+    }
+    else
+    {
+        assert((int)cinfo.m_vertexInvMasses.size() == numVertices);
+        m_invMasses = cinfo.m_vertexInvMasses;
+    }
     m_vertexRadius = cinfo.m_radius;
 
+    // Set time stepping.
+    assert(cinfo.m_numSubsteps > 0 && cinfo.m_fixedTimeStep >= 0.f && cinfo.m_maxFixedStepsPerCall > 0);
+    m_numSubsteps = cinfo.m_numSubsteps;
+    m_fixedTimeStep = cinfo.m_fixedTimeStep;
+    m_maxFixedStepsPerCall = cinfo.m_maxFixedStepsPerCall;
+    m_timeAccumulator = 0.f;
+
+    // Set sleeping.
+    assert(cinfo.m_sleepVelocityThreshold >= 0.f && cinfo.m_timeToSleep >= 0.f);
+    m_sleepVelocityThreshold = cinfo.m_sleepVelocityThreshold;
+    m_timeToSleep = cinfo.m_timeToSleep;
+    wakeUp();
+
     // Count the number of edges going from each vertex.
     for (int i = 0; i < numEdges; i++)
     {
@@ -62,23 +112,40 @@ void PointBasedSystem::init(const Cinfo& cinfo)
         Vertex& v = m_vertices[vA];
         Edge& e = m_edges[v.m_edgeStart + v.m_numEdges];
         e.m_otherVertex = vB;
-        e.m_length = (c.m_length > 0.f) ? SimdFloat(c.m_length) : (m_positions[vA] - m_positions[vB]).length<3>();
-        e.m_stiffness = SimdFloat(c.m_stiffness);
+        e.m_length = (c.m_length > 0.f) ? c.m_length : (m_positions[vA] - m_positions[vB]).length<3>().getFloat();
+        e.m_stiffness = c.m_stiffness;
         v.m_numEdges++;
     }
 
-    createSolver(cinfo);
-
-    onParticlesAdded(cinfo.m_vertexPositions);
+    // Set bends and tetrahedra.
+    m_bends = cinfo.m_bends;
+    m_tetrahedra = cinfo.m_tetrahedra;
+    for (const Cinfo::Bend& b : m_bends)
+    {
+        assert(b.m_vA >= 0 && b.m_vA < numVertices && b.m_vB >= 0 && b.m_vB < numVertices && b.m_vC >= 0 && b.m_vC < numVertices);
+    }
+    for (const Cinfo::Tetrahedron& t : m_tetrahedra)
+    {
+        assert(t.m_v[0] >= 0 && t.m_v[0] < numVertices && t.m_v[1] >= 0 && t.m_v[1] < numVertices);
+        assert(t.m_v[2] >= 0 && t.m_v[2] < numVertices && t.m_v[3] >= 0 && t.m_v[3] < numVertices);
+    }
 }
 
 void PointBasedSystem::addRemoveVerticesAndEdges(const Positions& newVertices, const Velocities& newVelocities, const Cinfo::Connections& newEdges, const std::vector<int>& edgesToRemove)
 {
     assert(newVertices.size() == newVelocities.size());
 
-    // Preserve previous vertices and edges.
-    Vertices prevVerts = m_vertices;
-    Edges prevEdges = m_edges;
+    // Vertices are added to Vector4 buffers and the arrays are updated before the next step.
+    syncVectors();
+    m_areArraysStale = true;
+
+    // Preserve previous vertices and edges. Reuse buffers to avoid allocations every time.
+    Vertices& prevVerts = m_prevVertices;
+    Edges& prevEdges = m_prevEdges;
+    prevVerts = m_vertices;
+    prevEdges = m_edges;
+    m_addedEdges.clear();
+    m_removedEdges.clear();
 
     const int prevNumVerts = (int)m_positions.size();
     const int newNumVerts = (int)(prevNumVerts + newVertices.size());
@@ -90,6 +157,7 @@ void PointBasedSystem::addRemoveVerticesAndEdges(const Positions& newVertices, c
     m_vertices.reserve(newNumVerts);
     m_positions.reserve(newNumVerts);
     m_velocities.reserve(newNumVerts);
+    m_invMasses.reserve(newNumVerts);
     m_edges.resize(prevNumEdges + numNewEdges - numEdgesToRemove);
 
     // Add new vertices and velocities
@@ -98,6 +166,7 @@ void PointBasedSystem::addRemoveVerticesAndEdges(const Positions& newVertices, c
         m_positions.push_back(newVertices[i]);
         m_vertices.push_back(Vertex{0, 0});
         m_velocities.push_back(newVelocities[i]);
+        m_invMasses.push_back(1.f / m_vertexMass);
     }
 
     // Adjust the number of edges on existing vertices
@@ -119,6 +188,9 @@ void PointBasedSystem::addRemoveVerticesAndEdges(const Positions& newVertices, c
             }
             // Reduce the number of edges in the vertex.
             m_vertices[vertexIndex].m_numEdges--;
+
+            const Edge& edge = prevEdges[edgesToRemove[i]];
+            m_removedEdges.push_back(PointBasedSystemSolver::EdgeChange{ vertexIndex, edge.m_otherVertex, edge.m_length, edge.m_stiffness });
         }
     }
 
@@ -172,13 +244,18 @@ void PointBasedSystem::addRemoveVerticesAndEdges(const Positions& newVertices, c
         Vertex& v = m_vertices[vA];
         Edge& e = m_edges[v.m_edgeStart + v.m_numEdges];
         e.m_otherVertex = vB;
-        e.m_length = c.m_length > 0.f ? SimdFloat(c.m_length) : (m_positions[vA] - m_positions[vB]).length<3>();
-        e.m_stiffness = SimdFloat(c.m_stiffness);
+        e.m_length = c.m_length > 0.f ? c.m_length : (m_positions[vA] - m_positions[vB]).length<3>().getFloat();
+        e.m_stiffness = c.m_stiffness;
         v.m_numEdges++;
+
+        m_addedEdges.push_back(PointBasedSystemSolver::EdgeChange{ vA, vB, e.m_length, e.m_stiffness });
     }
 
     updateSolver();
 
+    // Topology changed.
+    wakeUp();
+
     onParticlesAdded(newVertices);
 }
 
@@ -188,7 +265,7 @@ void PointBasedSystem::createSolver(const Cinfo& cinfo)
     {
     case PointBasedSystemSolver::Type::POSITION_BASED_DYNAMICS:
     {
-        m_solver = std::make_shared<PBD::Solver>(*this, cinfo.m_gravity, cinfo.m_solverIterations, cinfo.m_dampingFactor);
+        m_solver = std::make_shared<PBD::Solver>(*this, cinfo.m_gravity, cinfo.m_solverIterations, cinfo.m_dampingFactor, cinfo.m_useXpbd);
         break;
     }
     case PointBasedSystemSolver::Type::MASS_SPRING:
@@ -206,41 +283,231 @@ void PointBasedSystem::updateSolver()
 {
     assert(m_solver);
 
-    // [TODO] Implement proper update function for each solver instead of just recreating them.
-    //        Creating a new PBD::Solver involves allocating all constraints again which can be costly.
-    switch (m_solver->getType())
-    {
-    case PointBasedSystemSolver::Type::POSITION_BASED_DYNAMICS:
+    // Let the solver patch its buffers and constraints in place instead of recreating it.
+    m_solver->addRemoveVerticesAndEdges(m_addedEdges, m_removedEdges);
+}
+
+void PointBasedSystem::step(float deltaTime)
+{
+    assert(m_solver);
+
+    // Skip everything while sleeping.
+    if (m_isSleeping)
     {
-        auto curSolver = static_cast<PBD::Solver*>(m_solver.get());
-        PBD::Solver::VelocityDampingType damingType = curSolver->getDampingType();
-        m_solver = std::make_shared<PBD::Solver>(*this, curSolver->getGravity(), curSolver->getSolverIterations(), curSolver->getDampingFactor().getFloat());
-        static_cast<PBD::Solver*>(m_solver.get())->setDampingType(damingType);
-        break;
+        if (!isTouchedByChangedCollider())
+        {
+            return;
+        }
+
+        wakeUp();
     }
-    case PointBasedSystemSolver::Type::MASS_SPRING:
+
+    updateColliderTree();
+
+    if (m_fixedTimeStep <= 0.f)
     {
-        auto curSolver = static_cast<MassSpringSolver*>(m_solver.get());
-        m_solver = std::make_shared<MassSpringSolver>(*this, curSolver->getGravity(), curSolver->getDampingFactor().getFloat());
-        break;
+        stepSubsteps(deltaTime);
+        return;
     }
-    default:
-        assert(0);
-        break;
+
+    // Advance by fixed steps. Allow a tiny error so that time which is a multiple of the fixed step doesn't lose a step by rounding.
+    m_timeAccumulator += deltaTime;
+    const float threshold = m_fixedTimeStep * (1.f - 1e-4f);
+    for (int i = 0; i < m_maxFixedStepsPerCall && m_timeAccumulator >= threshold && !m_isSleeping; i++)
+    {
+        stepSubsteps(m_fixedTimeStep);
+        m_timeAccumulator -= m_fixedTimeStep;
     }
+
+    // Drop whole steps which couldn't be simulated in this call. Nothing is accumulated while sleeping.
+    m_timeAccumulator = m_isSleeping ? 0.f : std::max(std::fmod(m_timeAccumulator, m_fixedTimeStep), 0.f);
 }
 
-void PointBasedSystem::step(float deltaTime)
+void PointBasedSystem::stepSubsteps(float deltaTime)
 {
-    assert(m_solver);
+    // Solvers with SOA layout simulate the arrays, so Vector4 buffers become stale.
+    syncArrays();
+    m_areVectorsStale = m_particleLayout == ParticleLayout::SOA;
 
     // Solve
-    m_solver->solve(deltaTime);
+    const float substepTime = deltaTime / (float)m_numSubsteps;
+    for (int i = 0; i < m_numSubsteps; i++)
+    {
+        m_solver->solve(substepTime);
+    }
+
+    updateSleeping(deltaTime);
+}
+
+void PointBasedSystem::updateSleeping(float deltaTime)
+{
+    if (m_sleepVelocityThreshold <= 0.f)
+    {
+        return;
+    }
+
+    // Check velocities where the solver has written them.
+    const float thresholdSq = m_sleepVelocityThreshold * m_sleepVelocityThreshold;
+    if (m_particleLayout == ParticleLayout::SOA)
+    {
+        const int numVertices = m_velocityArrays.getSize();
+        for (int i = 0; i < numVertices; i++)
+        {
+            const float vx = m_velocityArrays.m_x[i];
+            const float vy = m_velocityArrays.m_y[i];
+            const float vz = m_velocityArrays.m_z[i];
+            if (vx * vx + vy * vy + vz * vz >= thresholdSq)
+            {
+                m_restTime = 0.f;
+                return;
+            }
+        }
+    }
+    else
+    {
+        for (const Vector4& velocity : m_velocities)
+        {
+            if (velocity.lengthSq<3>().getFloat() >= thresholdSq)
+            {
+                m_restTime = 0.f;
+                return;
+            }
+        }
+    }
+
+    m_restTime += deltaTime;
+    if (m_restTime < m_timeToSleep)
+    {
+        return;
+    }
+
+    // Fall asleep. Vector4 buffers are updated here since they are read while sleeping anyway.
+    syncVectors();
+    m_areArraysStale = m_particleLayout == ParticleLayout::SOA;
+    m_isSleeping = true;
+    for (Vector4& velocity : m_velocities)
+    {
+        velocity.setZero();
+    }
+
+    // Remember the region of the system and colliders to detect colliders moving into the system.
+    m_sleepingAabb.set(m_positions[0], m_positions[0]);
+    for (const Vector4& position : m_positions)
+    {
+        m_sleepingAabb.include(position);
+    }
+    m_sleepingAabb.expand(m_vertexRadius);
+
+    const int numColliders = (int)m_colliders.size();
+    m_sleepingColliderAabbs.resize(numColliders);
+    for (int i = 0; i < numColliders; i++)
+    {
+        m_colliders[i].getShape()->getAabb(m_sleepingColliderAabbs[i]);
+    }
+}
+
+bool PointBasedSystem::isTouchedByChangedCollider() const
+{
+    const int numColliders = (int)m_colliders.size();
+    if (numColliders != (int)m_sleepingColliderAabbs.size())
+    {
+        return true;
+    }
+
+    for (int i = 0; i < numColliders; i++)
+    {
+        Aabb aabb;
+        m_colliders[i].getShape()->getAabb(aabb);
+
+        // A collider moving away from under the system matters as well as one moving into it.
+        if (!aabb.exactEquals(m_sleepingColliderAabbs[i]) && (m_sleepingColliderAabbs[i].overlaps(m_sleepingAabb) || aabb.overlaps(m_sleepingAabb)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void PointBasedSystem::wakeUp()
+{
+    m_isSleeping = false;
+    m_restTime = 0.f;
+}
+
+void PointBasedSystem::applyImpulse(int vertexIndex, const Vector4& impulse)
+{
+    assert(vertexIndex >= 0 && vertexIndex < (int)m_velocities.size());
+
+    const Vector4 deltaVelocity = impulse * SimdFloat(m_invMasses[vertexIndex]);
+    if (m_particleLayout == ParticleLayout::SOA && !m_areArraysStale)
+    {
+        // Modify the arrays directly so that all the particles aren't copied back and forth.
+        m_velocityArrays.set(vertexIndex, m_velocityArrays.get(vertexIndex) + deltaVelocity);
+        m_areVectorsStale = true;
+    }
+    else
+    {
+        m_velocities[vertexIndex] += deltaVelocity;
+    }
+
+    wakeUp();
+}
+
+void PointBasedSystem::getSharedShapes(std::vector<const Shape*>& shapesOut) const
+{
+    for (const Collider& collider : m_colliders)
+    {
+        shapesOut.push_back(collider.getShape());
+    }
 }
 
 void PointBasedSystem::addCollider(const ShapePtr shape)
 {
+    Aabb aabb;
+    shape->getAabb(aabb);
+    m_colliderLeaves.push_back(m_colliderTree.insert(aabb, (int)m_colliders.size()));
     m_colliders.push_back(shape);
+    wakeUp();
+}
+
+void PointBasedSystem::removeCollider(const ShapePtr shape)
+{
+    const int numColliders = (int)m_colliders.size();
+    int index = 0;
+    while (index < numColliders && m_colliders[index].getShape() != shape.get())
+    {
+        index++;
+    }
+
+    assert(index < numColliders);
+    if (index == numColliders)
+    {
+        return;
+    }
+
+    m_colliderTree.remove(m_colliderLeaves[index]);
+    m_colliders.erase(m_colliders.begin() + index);
+    m_colliderLeaves.erase(m_colliderLeaves.begin() + index);
+
+    // Colliders after the removed one are shifted.
+    for (int i = index; i < numColliders - 1; i++)
+    {
+        m_colliderTree.setUserData(m_colliderLeaves[i], i);
+    }
+
+    wakeUp();
+}
+
+void PointBasedSystem::updateColliderTree()
+{
+    const int numColliders = (int)m_colliders.size();
+    for (int i = 0; i < numColliders; i++)
+    {
+        Aabb aabb;
+        m_colliders[i].getShape()->getAabb(aabb);
+        m_colliderTree.update(m_colliderLeaves[i], aabb);
+    }
 }
 
 int PointBasedSystem::subscribeToOnParticleAdded(const OnParticleAddedFunc& f)
@@ -263,6 +530,30 @@ void PointBasedSystem::unsubscribeFromOnParticleAdded(int handle)
     }
 }
 
+void PointBasedSystem::syncVectors() const
+{
+    if (!m_areVectorsStale)
+    {
+        return;
+    }
+
+    m_positionArrays.scatter(m_positions);
+    m_velocityArrays.scatter(m_velocities);
+    m_areVectorsStale = false;
+}
+
+void PointBasedSystem::syncArrays()
+{
+    if (m_particleLayout != ParticleLayout::SOA || !m_areArraysStale)
+    {
+        return;
+    }
+
+    m_positionArrays.gather(m_positions);
+    m_velocityArrays.gather(m_velocities);
+    m_areArraysStale = false;
+}
+
 void PointBasedSystem::onParticlesAdded(const Positions& posOfNewVertices) const
 {
     // Fire callback functions
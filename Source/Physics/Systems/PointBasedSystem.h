@@ -9,7 +9,10 @@
 #include <Physics/Physics.h>
 #include <Physics/Systems/System.h>
 #include <Physics/Solvers/PointBasedSystemSolver.h>
+#include <Physics/Solvers/ParticleArrays.h>
 #include <Physics/Collision/Collider.h>
+#include <Physics/Collision/DynamicAabbTree.h>
+#include <Geometry/Aabb.h>
 
 #include <functional>
 #include <map>
@@ -27,12 +30,12 @@ public:
         int m_numEdges = 0;     // The number of edges going from this vertex.
     };
 
-    // Edge data.
+    // Edge data. Attributes are stored as plain floats to keep edges compact.
     struct Edge
     {
         int m_otherVertex;      // Index of the other vertex.
-        SimdFloat m_length;     // Default length of this edge.
-        SimdFloat m_stiffness;  // Stiffness of this edge.
+        float m_length;         // Default length of this edge.
+        float m_stiffness;      // Stiffness of this edge.
     };
 
     // Type Definitions
@@ -44,6 +47,7 @@ public:
     using SolverPtr = std::shared_ptr<PointBasedSystemSolver>;
     using ShapePtr = std::shared_ptr<Shape>;
     using SolverType = PointBasedSystemSolver::Type;
+    using ParticleLayout = PointBasedSystemSolver::ParticleLayout;
     using OnParticleAddedFunc = std::function<void(const Positions&)>;
     using OnParticleAddedFuncs = std::map<int, OnParticleAddedFunc>; // If we use unordered_map here, we hit a crash by an illegal instruction. It's probably due to a compiler bug.
 
@@ -60,17 +64,66 @@ public:
             float m_length = 0.f;
         };
 
+        // Three vertices whose bending at the middle vertex m_vB is maintained. Only PBD solver supports it.
+        struct Bend
+        {
+            int m_vA, m_vB, m_vC;       // Indices of vertices.
+            float m_stiffness = 1.0f;   // Stiffness of this bend.
+        };
+
+        // Four vertices whose volume is maintained. Only PBD solver supports it.
+        struct Tetrahedron
+        {
+            int m_v[4];                 // Indices of vertices.
+            float m_stiffness = 1.0f;   // Stiffness of this tetrahedron.
+        };
+
         using Connections = std::vector<Connection>;
+        using Bends = std::vector<Bend>;
+        using Tetrahedra = std::vector<Tetrahedron>;
 
         SolverType m_solverType = SolverType::POSITION_BASED_DYNAMICS;
         int m_solverIterations = 1;
 
         Positions m_vertexPositions;
         Connections m_vertexConnectivity;
+        Bends m_bends;
+        Tetrahedra m_tetrahedra;
         float m_mass = 1.0f;
+
+        // Inverse mass of each vertex. Zero pins the vertex so that only the user moves it.
+        // If empty, mass is distributed to all vertices evenly. Mass spring solver always uses the even mass.
+        std::vector<float> m_vertexInvMasses;
         float m_radius = 1.0f;
         float m_dampingFactor = 1.0f;
 
+        // Memory layout of particles simulated by the solver. Only mass spring solver supports SOA and other solvers always use AOS.
+        // With SOA, the solver works on structure of arrays directly and Vector4 positions and velocities are updated only when accessed.
+        // Mass spring solver doesn't support IMPLICIT_EULER integrator with SOA.
+        ParticleLayout m_particleLayout = ParticleLayout::AOS;
+
+        // If true, PBD solver uses XPBD. Stiffness of connections, bends and tetrahedra is then physical stiffness whose inverse is compliance
+        // instead of a ratio of correction, and the result doesn't depend on the number of solver iterations. Infinite stiffness makes constraints rigid.
+        // This is a setting of the solver, so it's not changed by reset().
+        bool m_useXpbd = false;
+
+        // The number of substeps each step is split into. The solver runs once per substep.
+        // Many substeps with one solver iteration are more stable than one step with many iterations at similar cost.
+        int m_numSubsteps = 1;
+
+        // If positive, step() accumulates the given time and advances the simulation by steps of this fixed length.
+        // Time which is shorter than a fixed step is carried over to the next call.
+        float m_fixedTimeStep = 0.f;
+
+        // Maximum number of fixed steps taken in one call of step(). Time beyond this is dropped so that slow frames don't snowball.
+        int m_maxFixedStepsPerCall = 8;
+
+        // The system falls asleep when all the vertices are slower than m_sleepVelocityThreshold for m_timeToSleep.
+        // A sleeping system skips solving entirely until it's woken up. Zero threshold disables sleeping.
+        // Vertices also fall asleep individually if the solver supports it.
+        float m_sleepVelocityThreshold = 0.f;
+        float m_timeToSleep = 0.5f;
+
         Vector4 m_gravity = Vector4{0.f, -9.8f, 0.f};
     };
 
@@ -80,6 +133,10 @@ public:
     // Initialize by Cinfo.
     void init(const Cinfo& cinfo);
 
+    // Reset vertices and edges by Cinfo reusing existing buffers and the solver. This has to be called after init().
+    // Type of the solver has to be the same. Settings of the solver and colliders are kept and callbacks are not fired.
+    void reset(const Cinfo& cinfo);
+
     // Add new vertices and edges and remove some edges.
     // edgesToRemove has to be sorted by edgeId in increasing order.
     // [TODO] Should we support to remove vertices too?
@@ -88,24 +145,70 @@ public:
     // Step this system by deltaTime.
     virtual void step(float deltaTime) override;
 
-    // Add/remove colliders.
+    // Append shapes of the colliders.
+    virtual void getSharedShapes(std::vector<const Shape*>& shapesOut) const override;
+
+    // Add/remove colliders. Colliders are kept in the order of addition.
     void addCollider(const ShapePtr shape);
     void removeCollider(const ShapePtr shape);
 
     // Return mass of each vertex.
     float getVertexMass() const { return m_vertexMass; }
 
+    // Return inverse mass of each vertex. Zero means the vertex is pinned.
+    inline float getVertexInvMass(int index) const { return m_invMasses[index]; }
+    inline const std::vector<float>& getVertexInvMasses() const { return m_invMasses; }
+
     // Return radius of each vertex.
     float getVertexRadius() const { return m_vertexRadius; }
 
+    // Return memory layout of particles used by the solver.
+    auto getParticleLayout() const->ParticleLayout { return m_particleLayout; }
+
+    // Accessors to time stepping settings. See Cinfo for details.
+    inline int getNumSubsteps() const { return m_numSubsteps; }
+    inline void setNumSubsteps(int numSubsteps) { assert(numSubsteps > 0); m_numSubsteps = numSubsteps; }
+    inline float getFixedTimeStep() const { return m_fixedTimeStep; }
+    inline void setFixedTimeStep(float timeStep) { assert(timeStep >= 0.f); m_fixedTimeStep = timeStep; m_timeAccumulator = 0.f; }
+    inline int getMaxFixedStepsPerCall() const { return m_maxFixedStepsPerCall; }
+    inline void setMaxFixedStepsPerCall(int numSteps) { assert(numSteps > 0); m_maxFixedStepsPerCall = numSteps; }
+
+    // Return time accumulated but not simulated yet when fixed time step is used.
+    // Divide this by the fixed time step to interpolate states for rendering.
+    inline float getTimeAccumulator() const { return m_timeAccumulator; }
+
+    // Return true if the system is sleeping.
+    inline bool isSleeping() const { return m_isSleeping; }
+
+    // Wake up the system. This has to be called after positions or velocities are modified directly.
+    void wakeUp();
+
+    // Apply an impulse to the vertex and wake up the system.
+    void applyImpulse(int vertexIndex, const Vector4& impulse);
+
     // Accessors to simulation data.
     inline const Vertices& getVertices() const { return m_vertices; }
     inline const Edges& getEdges() const { return m_edges; }
+    inline const Cinfo::Bends& getBends() const { return m_bends; }
+    inline const Cinfo::Tetrahedra& getTetrahedra() const { return m_tetrahedra; }
     inline const Colliders& getColliders() const { return m_colliders; }
-    inline const Positions& getVertexPositions() const { return m_positions; }
-    inline const Velocities& getVertexVelocities() const { return m_velocities; }
-    inline Positions& accessVertexPositions() { return m_positions; }
-    inline Velocities& accessVertexVelocities() { return m_velocities; }
+
+    // Return the broadphase of colliders. User data of each leaf is index of the collider.
+    // It's updated at the beginning of step(), so solvers can query colliders around the system by its bounds.
+    inline const DynamicAabbTree& getColliderTree() const { return m_colliderTree; }
+
+    // Accessors to positions and velocities of the vertices.
+    // When particle layout is SOA, they are copied from the arrays at the first access after the system is stepped.
+    // Non-const accessors make the arrays copied from them before the next step. Don't access particles while the system is stepped.
+    inline const Positions& getVertexPositions() const { syncVectors(); return m_positions; }
+    inline const Velocities& getVertexVelocities() const { syncVectors(); return m_velocities; }
+    inline Positions& accessVertexPositions() { syncVectors(); m_areArraysStale = true; return m_positions; }
+    inline Velocities& accessVertexVelocities() { syncVectors(); m_areArraysStale = true; return m_velocities; }
+
+    // Accessors to positions and velocities of the vertices in structure of arrays. They are used by solvers when particle layout is SOA.
+    // They are up to date only while the system is stepped.
+    inline ParticleArrays& accessParticlePositions() { return m_positionArrays; }
+    inline ParticleArrays& accessParticleVelocities() { return m_velocityArrays; }
 
     // Subscribe to on particle added callback. Return handle of the callback.
     int subscribeToOnParticleAdded(const OnParticleAddedFunc& f);
@@ -117,22 +220,70 @@ public:
     SolverPtr getSolver() { return m_solver; }
 
 protected:
+    void initVerticesAndEdges(const Cinfo& cinfo);
     void createSolver(const Cinfo& cinfo);
     void updateSolver();
 
+    // Solve deltaTime split into substeps.
+    void stepSubsteps(float deltaTime);
+
+    // Update time at rest and put the system to sleep if it has been at rest long enough.
+    void updateSleeping(float deltaTime);
+
+    // Return true if any collider changed and touches the sleeping system.
+    bool isTouchedByChangedCollider() const;
+
+    // Update AABBs of colliders in the broadphase.
+    void updateColliderTree();
+
     void onParticlesAdded(const Positions& posOfNewVertices) const;
 
+    // Copy particles from the arrays to Vector4 buffers if the arrays are newer.
+    void syncVectors() const;
+
+    // Copy particles from Vector4 buffers to the arrays if Vector4 buffers are newer and particle layout is SOA.
+    void syncArrays();
+
     Vertices m_vertices;        // The vertices
     Edges m_edges;              // The vertex edges.
-    Positions m_positions;      // Positions of the vertices.
-    Velocities m_velocities;    // Velocities of the vertices.
+    mutable Positions m_positions;      // Positions of the vertices. Updated from m_positionArrays on demand when particle layout is SOA.
+    mutable Velocities m_velocities;    // Velocities of the vertices. Updated from m_velocityArrays on demand when particle layout is SOA.
+    std::vector<float> m_invMasses; // Inverse masses of the vertices.
+    Cinfo::Bends m_bends;           // Bends of the vertices.
+    Cinfo::Tetrahedra m_tetrahedra; // Tetrahedra of the vertices.
 
     float m_vertexMass;     // Mass of each vertex.
     float m_vertexRadius;   // Radius of each vertex.
 
-    Colliders m_colliders;  // The colliders.
+    ParticleLayout m_particleLayout = ParticleLayout::AOS; // Memory layout of particles used by the solver.
+    ParticleArrays m_positionArrays;        // Positions of the vertices simulated when particle layout is SOA.
+    ParticleArrays m_velocityArrays;        // Velocities of the vertices simulated when particle layout is SOA.
+    mutable bool m_areVectorsStale = false; // True if m_positions and m_velocities are older than the arrays.
+    bool m_areArraysStale = false;          // True if the arrays are older than m_positions and m_velocities.
+
+    int m_numSubsteps = 1;              // The number of substeps per step.
+    float m_fixedTimeStep = 0.f;        // Length of fixed time step. Zero means variable time step.
+    int m_maxFixedStepsPerCall = 8;     // Maximum number of fixed steps per call of step().
+    float m_timeAccumulator = 0.f;      // Time accumulated but not simulated yet.
+
+    float m_sleepVelocityThreshold = 0.f;   // Vertices slower than this are at rest. Zero disables sleeping.
+    float m_timeToSleep = 0.5f;             // Time for which all vertices have to be at rest to fall asleep.
+    float m_restTime = 0.f;                 // Time for which all vertices have been at rest.
+    bool m_isSleeping = false;              // True if the system is sleeping.
+    Aabb m_sleepingAabb;                    // AABB of vertices expanded by their radius when the system fell asleep.
+    std::vector<Aabb> m_sleepingColliderAabbs; // AABBs of colliders when the system fell asleep.
+
+    Colliders m_colliders;              // The colliders.
+    DynamicAabbTree m_colliderTree;     // Broadphase of the colliders.
+    std::vector<int> m_colliderLeaves;  // Leaf of each collider in m_colliderTree.
 
     SolverPtr m_solver;     // The solver.
 
     OnParticleAddedFuncs m_onParticleAddedFuncs; // List of callback function called after new particles were added to this system.
+
+    // Temporary buffers used to add and remove vertices and edges.
+    Vertices m_prevVertices;
+    Edges m_prevEdges;
+    PointBasedSystemSolver::EdgeChanges m_addedEdges;
+    PointBasedSystemSolver::EdgeChanges m_removedEdges;
 };
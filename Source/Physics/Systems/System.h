@@ -8,6 +8,10 @@
 
 #include <Common/Math/Vector4.h>
 
+#include <vector>
+
+class Shape;
+
 // An abstract class of simulation system.
 class System
 {
@@ -17,4 +21,7 @@ public:
 
     // Step this system by deltaTime.
     virtual void step(float deltaTime) = 0;
+
+    // Append shapes which this system collides against. World can put systems sharing shapes in the same island.
+    virtual void getSharedShapes(std::vector<const Shape*>& /*shapesOut*/) const {}
 };
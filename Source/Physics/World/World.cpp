@@ -8,16 +8,183 @@
 #include <Physics/World/World.h>
 #include <Physics/Systems/System.h>
 
+#include <algorithm>
+#include <functional>
+#include <queue>
+
 void World::step(float deltaTime)
 {
-    // Step all the systems.
-    for (System* system : m_systems)
+    // Shapes of systems can change at any time, so islands by shared shapes have to be detected every step.
+    if (m_scheduleDirty || m_detectSharedShapes)
+    {
+        buildSchedule();
+    }
+
+    // Step all the islands. Each island is stepped by a single thread.
+    const int numIslands = getNumIslands();
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(m_numThreads) if(m_numThreads > 1 && numIslands > 1)
+    for (int island = 0; island < numIslands; island++)
     {
-        system->step(deltaTime);
+        for (int i = m_islandStarts[island]; i < m_islandStarts[island + 1]; i++)
+        {
+            m_systems[m_scheduledSystems[i]]->step(deltaTime);
+        }
     }
 }
 
 void World::addSystem(System& system)
 {
     m_systems.push_back(&system);
+    m_scheduleDirty = true;
+}
+
+void World::addDependency(const System& system, const System& prerequisite)
+{
+    const int systemIndex = getSystemIndex(system);
+    const int prerequisiteIndex = getSystemIndex(prerequisite);
+    assert(systemIndex >= 0 && prerequisiteIndex >= 0);
+    assert(systemIndex != prerequisiteIndex);
+
+    m_dependencies.push_back({ systemIndex, prerequisiteIndex });
+    m_scheduleDirty = true;
+}
+
+int World::getSystemIndex(const System& system) const
+{
+    auto itr = std::find(m_systems.begin(), m_systems.end(), &system);
+    return itr != m_systems.end() ? (int)(itr - m_systems.begin()) : -1;
+}
+
+void World::buildSchedule()
+{
+    const int numSystems = (int)m_systems.size();
+
+    // Find islands by union find.
+    std::vector<int> parents(numSystems);
+    for (int i = 0; i < numSystems; i++)
+    {
+        parents[i] = i;
+    }
+
+    auto findRoot = [&parents](int i)
+    {
+        while (parents[i] != i)
+        {
+            parents[i] = parents[parents[i]];
+            i = parents[i];
+        }
+        return i;
+    };
+
+    auto unite = [&parents, &findRoot](int a, int b)
+    {
+        a = findRoot(a);
+        b = findRoot(b);
+        if (a != b)
+        {
+            // Keep the smaller index as the root so that islands are ordered deterministically.
+            parents[std::max(a, b)] = std::min(a, b);
+        }
+    };
+
+    for (const auto& dependency : m_dependencies)
+    {
+        unite(dependency.first, dependency.second);
+    }
+
+    if (m_detectSharedShapes)
+    {
+        // Sort pairs of shapes and systems so that systems sharing the same shape are adjacent.
+        std::vector<const Shape*> shapes;
+        std::vector<std::pair<const Shape*, int>> shapeSystems;
+        for (int i = 0; i < numSystems; i++)
+        {
+            shapes.clear();
+            m_systems[i]->getSharedShapes(shapes);
+            for (const Shape* shape : shapes)
+            {
+                shapeSystems.push_back({ shape, i });
+            }
+        }
+
+        std::sort(shapeSystems.begin(), shapeSystems.end());
+        for (int i = 1; i < (int)shapeSystems.size(); i++)
+        {
+            if (shapeSystems[i].first == shapeSystems[i - 1].first)
+            {
+                unite(shapeSystems[i].second, shapeSystems[i - 1].second);
+            }
+        }
+    }
+
+    // Sort systems topologically by Kahn's algorithm. Systems without dependencies between them are kept in the order they were added.
+    std::vector<int> numPrerequisites(numSystems, 0);
+    std::vector<std::vector<int>> dependents(numSystems);
+    for (const auto& dependency : m_dependencies)
+    {
+        numPrerequisites[dependency.first]++;
+        dependents[dependency.second].push_back(dependency.first);
+    }
+
+    std::priority_queue<int, std::vector<int>, std::greater<int>> readySystems;
+    for (int i = 0; i < numSystems; i++)
+    {
+        if (numPrerequisites[i] == 0)
+        {
+            readySystems.push(i);
+        }
+    }
+
+    std::vector<int> sortedSystems;
+    sortedSystems.reserve(numSystems);
+    while (!readySystems.empty())
+    {
+        const int system = readySystems.top();
+        readySystems.pop();
+        sortedSystems.push_back(system);
+
+        for (int dependent : dependents[system])
+        {
+            if (--numPrerequisites[dependent] == 0)
+            {
+                readySystems.push(dependent);
+            }
+        }
+    }
+
+    // Dependencies shouldn't be cyclic.
+    assert((int)sortedSystems.size() == numSystems);
+
+    // Number islands by their roots.
+    std::vector<int> islandIds(numSystems, -1);
+    int numIslands = 0;
+    for (int i = 0; i < numSystems; i++)
+    {
+        const int root = findRoot(i);
+        if (islandIds[root] < 0)
+        {
+            islandIds[root] = numIslands++;
+        }
+        islandIds[i] = islandIds[root];
+    }
+
+    // Sort systems by islands while keeping the topological order in each island.
+    m_islandStarts.assign(numIslands + 1, 0);
+    for (int i = 0; i < numSystems; i++)
+    {
+        m_islandStarts[islandIds[i] + 1]++;
+    }
+    for (int i = 0; i < numIslands; i++)
+    {
+        m_islandStarts[i + 1] += m_islandStarts[i];
+    }
+
+    std::vector<int> offsets(m_islandStarts.begin(), m_islandStarts.end() - 1);
+    m_scheduledSystems.resize(numSystems);
+    for (int system : sortedSystems)
+    {
+        m_scheduledSystems[offsets[islandIds[system]]++] = system;
+    }
+
+    m_scheduleDirty = false;
 }
@@ -8,9 +8,14 @@
 
 #include <Physics/Physics.h>
 
+#include <vector>
+#include <utility>
+
 class System;
 
 // A world of physics simulation.
+// Systems are grouped into islands which don't interact with each other, and islands are stepped in parallel.
+// Systems in the same island are stepped serially in the order respecting their dependencies.
 class World
 {
 public:
@@ -23,7 +28,36 @@ public:
     // Add simulation system.
     void addSystem(System& system);
 
+    // Declare that system has to be stepped after prerequisite. Both systems have to be added to this world.
+    // The two systems are always in the same island.
+    void addDependency(const System& system, const System& prerequisite);
+
+    // Set the number of threads used to step islands.
+    inline void setNumThreads(int numThreads) { assert(numThreads > 0); m_numThreads = numThreads; }
+    inline int getNumThreads() const { return m_numThreads; }
+
+    // Enable or disable island detection by shared collider shapes.
+    // When disabled, systems which are not connected by dependencies are stepped independently even if they share shapes.
+    inline void setDetectSharedShapes(bool enable) { m_detectSharedShapes = enable; m_scheduleDirty = true; }
+    inline bool getDetectSharedShapes() const { return m_detectSharedShapes; }
+
+    // Return the number of islands. Valid after the first step.
+    inline int getNumIslands() const { return (int)m_islandStarts.size() - 1; }
+
 protected:
+    // Group systems into islands and sort systems in each island by dependencies.
+    void buildSchedule();
+
+    // Return index of the system in m_systems.
+    int getSystemIndex(const System& system) const;
+
     // The simulation systems.
     Systems m_systems;
+
+    std::vector<std::pair<int, int>> m_dependencies;    // Pairs of indices of systems and their prerequisites.
+    std::vector<int> m_scheduledSystems;                // Indices of systems sorted by islands and dependencies.
+    std::vector<int> m_islandStarts;                    // Start index of each island in m_scheduledSystems. Has one extra element at the end.
+    int m_numThreads = 1;                               // The number of threads to step islands.
+    bool m_detectSharedShapes = false;                  // True to put systems sharing collider shapes in the same island.
+    bool m_scheduleDirty = true;                        // True when the schedule has to be built again.
 };
@@ -0,0 +1,92 @@
+/*
+* CounterBasedRandomTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <Common/CounterBasedRandom.h>
+
+#include <vector>
+
+TEST(CounterBasedRandom, Ranges)
+{
+    CounterBasedRandom random(CounterBasedRandom::makeKey(1234));
+
+    bool hasTrue = false;
+    bool hasFalse = false;
+    bool hasMin = false;
+    bool hasMax = false;
+    for (int i = 0; i < 1000; i++)
+    {
+        const float v01 = random.randomReal01();
+        EXPECT_GE(v01, 0.f);
+        EXPECT_LE(v01, 1.f);
+
+        const float v = random.randomReal(-2.f, 3.f);
+        EXPECT_GE(v, -2.f);
+        EXPECT_LT(v, 3.f);
+
+        const int n = random.randomInteger(-3, 3);
+        EXPECT_GE(n, -3);
+        EXPECT_LE(n, 3);
+        hasMin |= n == -3;
+        hasMax |= n == 3;
+
+        const bool b = random.randomBoolean();
+        hasTrue |= b;
+        hasFalse |= !b;
+    }
+
+    EXPECT_TRUE(hasMin && hasMax);
+    EXPECT_TRUE(hasTrue && hasFalse);
+    EXPECT_EQ(random.getCounter(), 4000);
+    EXPECT_EQ(random.randomInteger(5, 5), 5);
+}
+
+TEST(CounterBasedRandom, Streams)
+{
+    // The same key and counter produce the same sequence.
+    const uint64_t key = CounterBasedRandom::makeKey(42, 3, 7);
+    CounterBasedRandom random1(key);
+    CounterBasedRandom random2(key);
+    std::vector<uint64_t> sequence;
+    for (int i = 0; i < 100; i++)
+    {
+        sequence.push_back(random1.randomUint64());
+        EXPECT_EQ(sequence.back(), random2.randomUint64());
+    }
+
+    // Any position of a stream can be accessed directly by the counter.
+    CounterBasedRandom random3(key, 50);
+    EXPECT_EQ(random3.randomUint64(), sequence[50]);
+
+    // Different keys produce different streams.
+    EXPECT_NE(CounterBasedRandom::makeKey(42, 3, 7), CounterBasedRandom::makeKey(42, 7, 3));
+    EXPECT_NE(CounterBasedRandom::makeKey(42, 3, 7), CounterBasedRandom::makeKey(43, 3, 7));
+    EXPECT_NE(CounterBasedRandom::makeKey(42, 3), CounterBasedRandom::makeKey(42, 3, 0));
+    CounterBasedRandom random4(CounterBasedRandom::makeKey(42, 3, 8));
+    int numSame = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        numSame += random4.randomUint64() == sequence[i] ? 1 : 0;
+    }
+    EXPECT_EQ(numSame, 0);
+}
+
+TEST(CounterBasedRandom, ConsumeRandomStreamKey)
+{
+    // A given key is returned only once.
+    CounterBasedRandom random(7);
+    bool hasKey = true;
+    EXPECT_EQ(consumeRandomStreamKey(123, hasKey, random), 123u);
+    EXPECT_FALSE(hasKey);
+    EXPECT_EQ(random.getCounter(), 0u);
+
+    // Otherwise a key is drawn from the generator.
+    CounterBasedRandom random2(7);
+    const uint64_t key = consumeRandomStreamKey(123, hasKey, random);
+    EXPECT_EQ(consumeRandomStreamKey(123, hasKey, random2), key);
+    EXPECT_GT(random.getCounter(), 0u);
+}
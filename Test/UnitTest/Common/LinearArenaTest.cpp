@@ -0,0 +1,81 @@
+/*
+* LinearArenaTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <Common/LinearArena.h>
+#include <Common/BaseType.h>
+
+namespace
+{
+    struct AlignedData
+    {
+        ALIGN16(float m_values[4]);
+    };
+}
+
+TEST(LinearArena, AllocateAndReset)
+{
+    LinearArena::ArenaPtr arena = std::make_shared<LinearArena>(256);
+    EXPECT_EQ(arena->getNumBlocks(), 1);
+
+    // Allocate memory with alignment.
+    void* ptr1 = arena->allocate(3, 1);
+    void* ptr2 = arena->allocate(sizeof(AlignedData), alignof(AlignedData));
+    EXPECT_NE(ptr1, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr2) % alignof(AlignedData), 0);
+    EXPECT_EQ(arena->getNumAllocations(), 2);
+
+    // Allocation larger than the block size creates a new block.
+    void* ptr3 = arena->allocate(1024, 4);
+    EXPECT_NE(ptr3, nullptr);
+    EXPECT_EQ(arena->getNumBlocks(), 2);
+
+    // Arena cannot be reset while there are live allocations.
+    EXPECT_FALSE(arena->reset());
+    arena->deallocate(ptr1, 3);
+    arena->deallocate(ptr2, sizeof(AlignedData));
+    arena->deallocate(ptr3, 1024);
+    EXPECT_EQ(arena->getNumAllocations(), 0);
+    EXPECT_TRUE(arena->reset());
+
+    // Memory is recycled after reset.
+    EXPECT_EQ(arena->allocate(3, 1), ptr1);
+    arena->deallocate(ptr1, 3);
+    void* ptr4 = arena->allocate(1024, 4);
+    EXPECT_EQ(ptr4, ptr3);
+    EXPECT_EQ(arena->getNumBlocks(), 2);
+    arena->deallocate(ptr4, 1024);
+}
+
+TEST(LinearArena, MakeShared)
+{
+    LinearArena::ArenaPtr arena = std::make_shared<LinearArena>();
+
+    // Objects are allocated by the default allocator without scope.
+    std::shared_ptr<AlignedData> data1 = LinearArena::makeShared<AlignedData>();
+    EXPECT_EQ(arena->getNumAllocations(), 0);
+    EXPECT_EQ(LinearArena::getCurrentArena(), nullptr);
+
+    std::shared_ptr<AlignedData> data2;
+    {
+        LinearArena::Scope scope(arena);
+        EXPECT_EQ(LinearArena::getCurrentArena(), arena);
+
+        data2 = LinearArena::makeShared<AlignedData>();
+        EXPECT_EQ(arena->getNumAllocations(), 1);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(data2.get()) % alignof(AlignedData), 0);
+    }
+    EXPECT_EQ(LinearArena::getCurrentArena(), nullptr);
+
+    // The arena is kept alive by objects allocated from it.
+    std::weak_ptr<LinearArena> weakArena = arena;
+    arena = nullptr;
+    EXPECT_FALSE(weakArena.expired());
+
+    data2 = nullptr;
+    EXPECT_TRUE(weakArena.expired());
+}
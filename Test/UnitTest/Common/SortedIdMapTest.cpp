@@ -0,0 +1,64 @@
+/*
+* SortedIdMapTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <Common/SortedIdMap.h>
+#include <Common/BaseType.h>
+
+DECLARE_ID(SortedIdMapTestId);
+
+TEST(SortedIdMap, BasicOperations)
+{
+    SortedIdMap<SortedIdMapTestId, int> map;
+    EXPECT_TRUE(map.empty());
+
+    // Insert elements in random order.
+    EXPECT_TRUE(map.insert({ SortedIdMapTestId(3), 30 }).second);
+    EXPECT_TRUE(map.insert({ SortedIdMapTestId(1), 10 }).second);
+    EXPECT_TRUE(map.insert({ SortedIdMapTestId(5), 50 }).second);
+    map[SortedIdMapTestId(2)] = 20;
+    EXPECT_EQ(map.size(), 4);
+
+    // Inserting an existing key doesn't change its value.
+    auto result = map.insert({ SortedIdMapTestId(3), 0 });
+    EXPECT_FALSE(result.second);
+    EXPECT_EQ(result.first->second, 30);
+    EXPECT_EQ(map.size(), 4);
+
+    // Elements are iterated in the order of keys.
+    const SortedIdMapTestId expectedIds[] = { SortedIdMapTestId(1), SortedIdMapTestId(2), SortedIdMapTestId(3), SortedIdMapTestId(5) };
+    int i = 0;
+    for (const auto& elem : map)
+    {
+        EXPECT_EQ(elem.first, expectedIds[i]);
+        EXPECT_EQ(elem.second, (int)expectedIds[i].val() * 10);
+        i++;
+    }
+
+    // Lookup.
+    EXPECT_EQ(map.at(SortedIdMapTestId(5)), 50);
+    EXPECT_EQ(map.count(SortedIdMapTestId(2)), 1);
+    EXPECT_EQ(map.count(SortedIdMapTestId(4)), 0);
+    EXPECT_TRUE(map.find(SortedIdMapTestId(0)) == map.end());
+    EXPECT_TRUE(map.find(SortedIdMapTestId(6)) == map.end());
+
+    // Erase.
+    EXPECT_EQ(map.erase(SortedIdMapTestId(2)), 1);
+    EXPECT_EQ(map.erase(SortedIdMapTestId(2)), 0);
+    EXPECT_EQ(map.size(), 3);
+    EXPECT_EQ(map.count(SortedIdMapTestId(2)), 0);
+    EXPECT_EQ(map.at(SortedIdMapTestId(3)), 30);
+
+    // Copy.
+    SortedIdMap<SortedIdMapTestId, int> copy = map;
+    EXPECT_EQ(copy.size(), 3);
+    EXPECT_EQ(copy.at(SortedIdMapTestId(1)), 10);
+
+    map.clear();
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(copy.size(), 3);
+}
@@ -0,0 +1,61 @@
+/*
+* ActivationKernelsTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <EvoAlgo/NeuralNetwork/Activations/ActivationKernels.h>
+
+TEST(ActivationKernels, CompareWithScalarActivations)
+{
+    // Input values. The number of values is not multiple of SIMD width so that remainders are also tested.
+    std::vector<float> inputs;
+    for (float v = -10.f; v <= 10.f; v += 0.37f)
+    {
+        inputs.push_back(v);
+    }
+    inputs.push_back(0.f);
+    inputs.push_back(1.f);
+    inputs.push_back(-1.f);
+    inputs.push_back(1e-3f);
+    inputs.push_back(100.f);
+    inputs.push_back(-100.f);
+    inputs.push_back(12345.6f);
+    inputs.push_back(-1e10f);
+    if (inputs.size() % 4 == 0)
+    {
+        inputs.push_back(0.5f);
+    }
+
+    const int numValues = (int)inputs.size();
+    std::vector<float> outputs(numValues);
+
+    for (int type = ActivationFacotry::AF_SIGMOID; type <= ActivationFacotry::AF_CUBE; type++)
+    {
+        ActivationFacotry::ActivationPtr activation = ActivationFacotry::create((ActivationFacotry::Type)type);
+        EXPECT_EQ(activation->m_type, type);
+
+        ActivationKernels::activate((ActivationFacotry::Type)type, inputs.data(), outputs.data(), numValues);
+
+        for (int i = 0; i < numValues; i++)
+        {
+            const float expected = activation->activate(inputs[i]);
+
+            // Scalar version should give exactly the same result as the activation.
+            EXPECT_EQ(ActivationKernels::activate((ActivationFacotry::Type)type, inputs[i]), expected);
+
+            // Vectorized version should be close enough.
+            EXPECT_NEAR(outputs[i], expected, 1e-5f + fabsf(expected) * 1e-5f) << activation->m_name << "(" << inputs[i] << ")";
+        }
+    }
+
+    // In place activation.
+    std::vector<float> values = inputs;
+    ActivationKernels::activate(ActivationFacotry::AF_HYPERBOLIC_TANGENT, values.data(), values.data(), numValues);
+    for (int i = 0; i < numValues; i++)
+    {
+        EXPECT_NEAR(values[i], tanhf(inputs[i]), 1e-5f);
+    }
+}
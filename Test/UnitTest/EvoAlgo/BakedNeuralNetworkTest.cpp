@@ -78,3 +78,99 @@ TEST(BakedNeuralNetwork, CompareEvalResult)
     EXPECT_EQ(nn.getNode(outNode1).getValue(), baked->getNodeValue(outNode1));
     EXPECT_EQ(nn.getNode(outNode2).getValue(), baked->getNodeValue(outNode2));
 }
+
+TEST(BakedNeuralNetwork, EvaluateBatch)
+{
+    // Set up node and edges.
+    NodeId inNode1(0);
+    NodeId inNode2(1);
+    NodeId outNode1(2);
+    NodeId outNode2(3);
+    NodeId hiddenNode1(4);
+    NodeId hiddenNode2(5);
+
+    NN::Nodes nodes;
+    nodes.insert({ inNode1, DefaultNode() });
+    nodes.insert({ inNode2, DefaultNode() });
+    nodes.insert({ outNode1, DefaultNode() });
+    nodes.insert({ outNode2, DefaultNode() });
+    nodes.insert({ hiddenNode1, DefaultNode() });
+    nodes.insert({ hiddenNode2, DefaultNode() });
+
+    NN::Edges edges;
+    edges.insert({ EdgeId(1), DefaultEdge(inNode1, hiddenNode1, 0.1f) });
+    edges.insert({ EdgeId(2), DefaultEdge(inNode1, hiddenNode2, 0.2f) });
+    edges.insert({ EdgeId(3), DefaultEdge(inNode2, hiddenNode1, 0.3f) });
+    edges.insert({ EdgeId(4), DefaultEdge(inNode2, hiddenNode2, 0.4f) });
+    edges.insert({ EdgeId(5), DefaultEdge(hiddenNode1, outNode1, 0.5f) });
+    edges.insert({ EdgeId(6), DefaultEdge(hiddenNode1, outNode2, 0.6f) });
+    edges.insert({ EdgeId(7), DefaultEdge(hiddenNode2, outNode1, 0.7f, false) });
+    edges.insert({ EdgeId(8), DefaultEdge(hiddenNode2, outNode2, 0.8f) });
+
+    NN::NodeIds inputNodes;
+    inputNodes.push_back(inNode1);
+    inputNodes.push_back(inNode2);
+    NN::NodeIds outputNodes;
+    outputNodes.push_back(outNode1);
+    outputNodes.push_back(outNode2);
+
+    Activation activation1([](float value) { return 2.f * value; });
+    Activation activation2([](float value) { return value + 1.f; });
+
+    // Number of samples which is not multiple of SIMD width.
+    const int numSamples = 11;
+    std::vector<float> inputs(numSamples * 2);
+    for (int i = 0; i < numSamples; i++)
+    {
+        inputs[i * 2] = 0.1f * i;
+        inputs[i * 2 + 1] = 1.f - 0.2f * i;
+    }
+
+    // Evaluate each sample one by one and compare it with the result of batch evaluation.
+    auto compareResults = [&](BakedNeuralNetwork* baked, int numIterations)
+    {
+        EXPECT_EQ(baked->getNumInputNodes(), 2);
+        EXPECT_EQ(baked->getNumOutputNodes(), 2);
+
+        std::vector<float> outputs(numSamples * 2);
+        baked->evaluateBatch(inputs.data(), numSamples, outputs.data(), numIterations);
+
+        for (int i = 0; i < numSamples; i++)
+        {
+            baked->clearNodeValues();
+            baked->setNodeValue(inNode1, inputs[i * 2]);
+            baked->setNodeValue(inNode2, inputs[i * 2 + 1]);
+            for (int j = 0; j < (baked->isCircularNetwork() ? numIterations : 1); j++)
+            {
+                baked->evaluate();
+            }
+
+            EXPECT_EQ(outputs[i * 2], baked->getNodeValue(outNode1));
+            EXPECT_EQ(outputs[i * 2 + 1], baked->getNodeValue(outNode2));
+        }
+    };
+
+    // Feed forward network.
+    {
+        NN nn(nodes, edges, inputNodes, outputNodes);
+        nn.accessNode(hiddenNode1).setActivation(&activation1);
+        nn.accessNode(hiddenNode2).setActivation(&activation2);
+
+        std::shared_ptr<BakedNeuralNetwork> baked = nn.bake();
+        EXPECT_FALSE(baked->isCircularNetwork());
+        compareResults(baked.get(), 1);
+    }
+
+    // Circular network.
+    {
+        edges.insert({ EdgeId(9), DefaultEdge(outNode2, hiddenNode1, 0.9f) });
+
+        NN nn(nodes, edges, inputNodes, outputNodes);
+        nn.accessNode(hiddenNode1).setActivation(&activation1);
+        nn.accessNode(hiddenNode2).setActivation(&activation2);
+
+        std::shared_ptr<BakedNeuralNetwork> baked = nn.bake();
+        EXPECT_TRUE(baked->isCircularNetwork());
+        compareResults(baked.get(), 3);
+    }
+}
@@ -0,0 +1,174 @@
+/*
+* CompiledNeuralNetworkTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <EvoAlgo/NeuralNetwork/NeuralNetwork.h>
+#include <EvoAlgo/NeuralNetwork/BakedNeuralNetwork.h>
+#include <EvoAlgo/NeuralNetwork/CompiledNeuralNetwork.h>
+#include <EvoAlgo/NeuralNetwork/Activations/ActivationFactory.h>
+
+using NN = NeuralNetwork<DefaultNode, DefaultEdge>;
+
+TEST(CompiledNeuralNetwork, CompareEvalResult)
+{
+    // Set up a network with two input nodes, a bias node, two layers of hidden nodes and two output nodes.
+    // Layer 1 has 4 nodes using two kinds of activations in alternate order and layer 2 has 2 nodes.
+    // Hidden node 7 isn't connected to any outputs.
+    NodeId inNode1(0);
+    NodeId inNode2(1);
+    NodeId biasNode(2);
+    NodeId outNode1(10);
+    NodeId outNode2(11);
+
+    NN::Nodes nodes;
+    nodes.insert({ inNode1, DefaultNode(DefaultNode::Type::INPUT) });
+    nodes.insert({ inNode2, DefaultNode(DefaultNode::Type::INPUT) });
+    nodes.insert({ biasNode, DefaultNode(DefaultNode::Type::BIAS) });
+    for (int i = 3; i < 10; i++)
+    {
+        nodes.insert({ NodeId(i), DefaultNode(DefaultNode::Type::HIDDEN) });
+    }
+    nodes.insert({ outNode1, DefaultNode(DefaultNode::Type::OUTPUT) });
+    nodes.insert({ outNode2, DefaultNode(DefaultNode::Type::OUTPUT) });
+
+    NN::Edges edges;
+    int edgeId = 0;
+    auto addEdge = [&](int inNode, int outNode, float weight)
+    {
+        edges.insert({ EdgeId(edgeId++), DefaultEdge(NodeId(inNode), NodeId(outNode), weight) });
+    };
+
+    // Layer 1: node 3, 4, 5, 6
+    for (int i = 3; i <= 6; i++)
+    {
+        addEdge(0, i, 0.1f * i);
+        addEdge(1, i, -0.2f * i);
+        addEdge(2, i, 0.3f);
+    }
+    // Layer 2: node 8, 9
+    for (int i = 8; i <= 9; i++)
+    {
+        for (int j = 3; j <= 6; j++)
+        {
+            addEdge(j, i, 0.05f * (i + j));
+        }
+    }
+    // Outputs
+    addEdge(8, 10, 0.7f);
+    addEdge(9, 10, -0.4f);
+    addEdge(9, 11, 0.9f);
+    addEdge(3, 11, 0.2f);
+    // Dead node
+    addEdge(0, 7, 1.0f);
+
+    NN::NodeIds inputNodes;
+    inputNodes.push_back(inNode1);
+    inputNodes.push_back(inNode2);
+    NN::NodeIds outputNodes;
+    outputNodes.push_back(outNode1);
+    outputNodes.push_back(outNode2);
+
+    NN nn(nodes, edges, inputNodes, outputNodes);
+
+    auto sigmoid = ActivationFacotry::create(ActivationFacotry::AF_BIPOLAR_SIGMOID);
+    auto gaussian = ActivationFacotry::create(ActivationFacotry::AF_GAUSSIAN);
+    auto hat = ActivationFacotry::create(ActivationFacotry::AF_HAT);
+    Activation custom([](float value) { return 0.5f * value; });
+    for (int i = 3; i <= 6; i++)
+    {
+        nn.accessNode(NodeId(i)).setActivation((i % 2) ? sigmoid.get() : gaussian.get());
+    }
+    nn.accessNode(NodeId(8)).setActivation(hat.get());
+    nn.accessNode(NodeId(9)).setActivation(hat.get());
+    nn.accessNode(outNode1).setActivation(&custom);
+    nn.accessNode(outNode2).setActivation(&custom);
+
+    std::shared_ptr<BakedNeuralNetwork> baked = nn.bake();
+    std::shared_ptr<CompiledNeuralNetwork> compiled = baked->compile();
+
+    EXPECT_FALSE(compiled->isCircularNetwork());
+    EXPECT_EQ(compiled->getNumInputNodes(), 2);
+    EXPECT_EQ(compiled->getNumOutputNodes(), 2);
+
+    // Dead node 7 is stripped.
+    EXPECT_EQ(compiled->getNumEvaluatedNodes(), 8);
+
+    // Layer 1 forms two runs (sigmoid and gaussian), layer 2 forms one run and output layer forms one run.
+    EXPECT_EQ(compiled->getNumRuns(), 4);
+
+    for (int i = 0; i < 5; i++)
+    {
+        const float inputs[2] = { 0.3f * i - 0.5f, 1.f - 0.4f * i };
+        float outputs[2];
+
+        baked->clearNodeValues();
+        baked->setNodeValue(biasNode, 1.f);
+        baked->setNodeValue(inNode1, inputs[0]);
+        baked->setNodeValue(inNode2, inputs[1]);
+        baked->evaluate();
+
+        compiled->clearNodeValues();
+        compiled->setNodeValue(biasNode, 1.f);
+        compiled->evaluate(inputs, outputs);
+
+        EXPECT_NEAR(outputs[0], baked->getNodeValue(outNode1), 1e-5f);
+        EXPECT_NEAR(outputs[1], baked->getNodeValue(outNode2), 1e-5f);
+    }
+}
+
+TEST(CompiledNeuralNetwork, CircularNetwork)
+{
+    NodeId inNode(0);
+    NodeId hiddenNode1(1);
+    NodeId hiddenNode2(2);
+    NodeId outNode(3);
+
+    NN::Nodes nodes;
+    nodes.insert({ inNode, DefaultNode(DefaultNode::Type::INPUT) });
+    nodes.insert({ hiddenNode1, DefaultNode(DefaultNode::Type::HIDDEN) });
+    nodes.insert({ hiddenNode2, DefaultNode(DefaultNode::Type::HIDDEN) });
+    nodes.insert({ outNode, DefaultNode(DefaultNode::Type::OUTPUT) });
+
+    NN::Edges edges;
+    edges.insert({ EdgeId(0), DefaultEdge(inNode, hiddenNode1, 0.5f) });
+    edges.insert({ EdgeId(1), DefaultEdge(hiddenNode1, hiddenNode2, 0.8f) });
+    edges.insert({ EdgeId(2), DefaultEdge(hiddenNode2, outNode, 1.2f) });
+    edges.insert({ EdgeId(3), DefaultEdge(hiddenNode2, hiddenNode1, -0.3f) });
+    edges.insert({ EdgeId(4), DefaultEdge(outNode, outNode, 0.1f) });
+
+    NN::NodeIds inputNodes;
+    inputNodes.push_back(inNode);
+    NN::NodeIds outputNodes;
+    outputNodes.push_back(outNode);
+
+    NN nn(nodes, edges, inputNodes, outputNodes);
+
+    auto tanh = ActivationFacotry::create(ActivationFacotry::AF_HYPERBOLIC_TANGENT);
+    nn.accessNode(hiddenNode1).setActivation(tanh.get());
+    nn.accessNode(hiddenNode2).setActivation(tanh.get());
+    nn.accessNode(outNode).setActivation(tanh.get());
+
+    std::shared_ptr<BakedNeuralNetwork> baked = nn.bake();
+    std::shared_ptr<CompiledNeuralNetwork> compiled = baked->compile();
+    EXPECT_TRUE(compiled->isCircularNetwork());
+
+    baked->clearNodeValues();
+    compiled->clearNodeValues();
+
+    // Values of the previous evaluation should be carried over.
+    for (int i = 0; i < 5; i++)
+    {
+        const float input = 0.7f * i - 1.f;
+        float output;
+
+        baked->setNodeValue(inNode, input);
+        baked->evaluate();
+        compiled->evaluate(&input, &output);
+
+        EXPECT_NEAR(output, baked->getNodeValue(outNode), 1e-5f);
+    }
+}
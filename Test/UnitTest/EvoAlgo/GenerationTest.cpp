@@ -7,6 +7,10 @@
 #include <UnitTest/UnitTestPch.h>
 
 #include <EvoAlgo/GeneticAlgorithms/NEAT/Generation.h>
+#include <EvoAlgo/GeneticAlgorithms/Base/Activations/ActivationProvider.h>
+#include <EvoAlgo/NeuralNetwork/Activations/ActivationLibrary.h>
+
+#include <atomic>
 
 namespace
 {
@@ -34,6 +38,34 @@ namespace
             return std::make_shared<MyFitnessCalculator>();
         }
     };
+
+    // Fitness calculator which detects if it's used by multiple threads at the same time.
+    class ExclusiveFitnessCalculator : public MyFitnessCalculator
+    {
+    public:
+        virtual float calcFitness(GenomeBase* genome) override
+        {
+            if (m_numUsers.fetch_add(1) != 0)
+            {
+                s_usedConcurrently = true;
+            }
+
+            const float fitness = MyFitnessCalculator::calcFitness(genome);
+
+            m_numUsers--;
+            return fitness;
+        }
+
+        virtual FitnessCalcPtr clone() const override
+        {
+            return std::make_shared<ExclusiveFitnessCalculator>();
+        }
+
+        std::atomic<int> m_numUsers{ 0 };
+        static std::atomic<bool> s_usedConcurrently;
+    };
+
+    std::atomic<bool> ExclusiveFitnessCalculator::s_usedConcurrently{ false };
 }
 
 TEST(Generation, CreateGeneration)
@@ -154,3 +186,106 @@ TEST(Generation, IncrementGeneration)
     EXPECT_TRUE(generation.getAllSpecies().size() > 0);
     EXPECT_EQ(generation.getId().val(), 6);
 }
+
+TEST(Generation, CalcFitnessMultiThreaded)
+{
+    using namespace NEAT;
+
+    // Create a generation whose population is not a multiple of the number of threads.
+    InnovationCounter innovCounter;
+    Generation::Cinfo cinfo;
+    cinfo.m_numGenomes = 23;
+    cinfo.m_numThreads = 4;
+    cinfo.m_genomeCinfo.m_innovIdCounter = &innovCounter;
+    cinfo.m_genomeCinfo.m_numInputNodes = 3;
+    cinfo.m_genomeCinfo.m_numOutputNodes = 3;
+    cinfo.m_fitnessCalculator = std::make_shared<ExclusiveFitnessCalculator>();
+    Generation generation(cinfo);
+
+    EXPECT_EQ(generation.getFitnessCalculators().size(), 4);
+
+    for (int i = 0; i < 3; i++)
+    {
+        generation.evolveGeneration();
+
+        // Fitness has to be the same as the one calculated by a single thread.
+        MyFitnessCalculator calculator;
+        float bestFitness = 0.f;
+        for (const Generation::GenomeData& gd : generation.getGenomes())
+        {
+            GenomeBase* genome = const_cast<GenomeBase*>(gd.getGenome().get());
+            const float fitness = calculator.calcFitness(genome);
+            EXPECT_EQ(gd.getFitness(), fitness);
+            bestFitness = std::max(bestFitness, fitness);
+        }
+        EXPECT_EQ(generation.getBestFitness(), bestFitness);
+    }
+
+    // A calculator should never be shared by threads.
+    EXPECT_FALSE(ExclusiveFitnessCalculator::s_usedConcurrently);
+}
+
+TEST(Generation, EvolveOnMultipleThreads)
+{
+    using namespace NEAT;
+
+    // Evolve generations with the same random seeds but different numbers of threads.
+    auto evolve = [](int numThreads, InnovationCounter& innovCounter, std::vector<Generation::GenomeDatas>& genomesOut)
+    {
+        PseudoRandom random(123);
+
+        ActivationLibrary activationLibrary;
+        activationLibrary.registerActivations({ ActivationFacotry::AF_SIGMOID, ActivationFacotry::AF_RELU, ActivationFacotry::AF_SINE });
+        RandomActivationProvider activationProvider(activationLibrary, &random);
+
+        Generation::Cinfo cinfo;
+        cinfo.m_numGenomes = 30;
+        cinfo.m_numThreads = numThreads;
+        cinfo.m_genomeCinfo.m_innovIdCounter = &innovCounter;
+        cinfo.m_genomeCinfo.m_numInputNodes = 3;
+        cinfo.m_genomeCinfo.m_numOutputNodes = 2;
+        cinfo.m_fitnessCalculator = std::make_shared<MyFitnessCalculator>();
+        cinfo.m_random = &random;
+        cinfo.m_mutationParams.m_random = &random;
+        cinfo.m_mutationParams.m_addNodeMutationRate = 0.5f;
+        cinfo.m_mutationParams.m_addEdgeMutationRate = 0.5f;
+        cinfo.m_mutationParams.m_changeActivationRate = 0.5f;
+        cinfo.m_mutationParams.m_activationProvider = &activationProvider;
+        cinfo.m_crossOverParams.m_random = &random;
+        Generation generation(cinfo);
+
+        for (int i = 0; i < 5; i++)
+        {
+            generation.evolveGeneration();
+            genomesOut.push_back(generation.getGenomes());
+        }
+    };
+
+    InnovationCounter innovCounter1;
+    std::vector<Generation::GenomeDatas> genomes1;
+    evolve(1, innovCounter1, genomes1);
+
+    InnovationCounter innovCounter2;
+    std::vector<Generation::GenomeDatas> genomes2;
+    evolve(4, innovCounter2, genomes2);
+
+    // Genomes should be identical including node and edge ids.
+    ASSERT_EQ(genomes1.size(), genomes2.size());
+    for (int i = 0; i < (int)genomes1.size(); i++)
+    {
+        ASSERT_EQ(genomes1[i].size(), genomes2[i].size());
+        for (int j = 0; j < (int)genomes1[i].size(); j++)
+        {
+            const Genome* genome1 = static_cast<const Genome*>(genomes1[i][j].getGenome().get());
+            const Genome* genome2 = static_cast<const Genome*>(genomes2[i][j].getGenome().get());
+            EXPECT_EQ(genomes1[i][j].getFitness(), genomes2[i][j].getFitness());
+            ASSERT_EQ(genome1->getInnovations(), genome2->getInnovations());
+            EXPECT_EQ(genome1->getNumNodes(), genome2->getNumNodes());
+            for (EdgeId edge : genome1->getInnovations())
+            {
+                EXPECT_EQ(genome1->getEdgeWeightRaw(edge), genome2->getEdgeWeightRaw(edge));
+                EXPECT_EQ(genome1->isEdgeEnabled(edge), genome2->isEdgeEnabled(edge));
+            }
+        }
+    }
+}
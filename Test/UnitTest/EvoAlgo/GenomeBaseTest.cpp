@@ -41,6 +41,8 @@ namespace
 
             m_network = std::make_shared<FeedForwardNetwork<Node, Edge>>(nodes, edges, inputNodes, outputNodes);
         }
+
+        const BakedNeuralNetwork* getBakedNetwork() const { return m_bakedNetwork.get(); }
     };
 }
 
@@ -130,3 +132,68 @@ TEST(GenomeBase, GenomeBasicOperations)
         EXPECT_EQ(node.second.m_node.getValue(), 0);
     }
 }
+
+TEST(GenomeBase, PatchBakedNetwork)
+{
+    using Network = MyGenome::Network;
+    using Node = MyGenome::Node;
+    using Edge = MyGenome::Edge;
+
+    // Create a genome.
+    MyGenome genome;
+    {
+        Network::Nodes nodes;
+        Network::Edges edges;
+
+        nodes.insert({ NodeId(0), Node(Node::Type::INPUT) });
+        nodes.insert({ NodeId(1), Node(Node::Type::INPUT) });
+        nodes.insert({ NodeId(2), Node(Node::Type::HIDDEN) });
+        nodes.insert({ NodeId(3), Node(Node::Type::OUTPUT) });
+
+        edges.insert({ EdgeId(0), Edge(NodeId(0), NodeId(2), 2.0f) });
+        edges.insert({ EdgeId(1), Edge(NodeId(1), NodeId(2), 3.0f) });
+        edges.insert({ EdgeId(2), Edge(NodeId(2), NodeId(3), 4.0f) });
+        edges.insert({ EdgeId(3), Edge(NodeId(0), NodeId(3), 1.0f, false) });
+
+        genome.createNetwork(nodes, edges);
+    }
+
+    std::vector<float> inputs;
+    inputs.push_back(1.f);
+    inputs.push_back(1.f);
+
+    auto evaluate = [&genome, &inputs]()
+    {
+        genome.clearNodeValues();
+        genome.setInputNodeValues(inputs);
+        genome.evaluate();
+        return genome.getNodeValue(NodeId(3));
+    };
+
+    EXPECT_EQ(evaluate(), 20.f);
+    const BakedNeuralNetwork* baked = genome.getBakedNetwork();
+    EXPECT_NE(baked, nullptr);
+
+    // Changing weight of a baked edge doesn't cause rebake.
+    genome.setEdgeWeight(EdgeId(1), 1.f);
+    EXPECT_EQ(evaluate(), 12.f);
+    EXPECT_EQ(genome.getBakedNetwork(), baked);
+
+    // Disabling and enabling a baked edge doesn't cause rebake either.
+    genome.setEdgeEnabled(EdgeId(0), false);
+    EXPECT_EQ(evaluate(), 4.f);
+    EXPECT_EQ(genome.getBakedNetwork(), baked);
+    genome.setEdgeEnabled(EdgeId(0), true);
+    EXPECT_EQ(evaluate(), 12.f);
+    EXPECT_EQ(genome.getBakedNetwork(), baked);
+
+    // Changing weight of a disabled edge which is not baked doesn't change anything.
+    genome.setEdgeWeight(EdgeId(3), 5.f);
+    EXPECT_EQ(evaluate(), 12.f);
+    EXPECT_EQ(genome.getBakedNetwork(), baked);
+
+    // Enabling an edge which is not baked causes rebake.
+    genome.setEdgeEnabled(EdgeId(3), true);
+    EXPECT_EQ(evaluate(), 17.f);
+    EXPECT_NE(genome.getBakedNetwork(), baked);
+}
@@ -0,0 +1,74 @@
+/*
+* PhysicsFitnessCalculatorTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <EvoAlgo/CppnCellDivision/PhysicsFitnessCalculator.h>
+#include <EvoAlgo/GeneticAlgorithms/NEAT/Genome.h>
+#include <EvoAlgo/GeneticAlgorithms/Base/Activations/ActivationProvider.h>
+
+TEST(PhysicsFitnessCalculator, CalcFitness)
+{
+    using namespace NEAT;
+
+    // Create a genome whose cells always divide and a genome whose cells never divide.
+    InnovationCounter innovCounter;
+    Genome::Cinfo genomeCinfo;
+    genomeCinfo.m_numInputNodes = (int)CppnCellCreature::InputNode::NUM_INPUT_NODES;
+    genomeCinfo.m_numOutputNodes = (int)CppnCellCreature::OutputNode::NUM_OUTPUT_NODES;
+    genomeCinfo.m_createBiasNode = true;
+    genomeCinfo.m_innovIdCounter = &innovCounter;
+
+    DefaultActivationProvider divideActivation([](float) { return 1.f; });
+    genomeCinfo.m_activationProvider = &divideActivation;
+    Genome divideGenome(genomeCinfo);
+
+    DefaultActivationProvider stayActivation([](float) { return 0.f; });
+    genomeCinfo.m_activationProvider = &stayActivation;
+    Genome stayGenome(genomeCinfo);
+
+    // Fitness is the number of cells.
+    PhysicsFitnessCalculator::Cinfo cinfo;
+    cinfo.m_systemCinfo.m_vertexPositions = { Vector4(-0.15f, 0.f, 0.f), Vector4(0.15f, 0.f, 0.f) };
+    cinfo.m_systemCinfo.m_vertexConnectivity = { { 0, 1 } };
+    cinfo.m_systemCinfo.m_radius = 0.15f;
+    cinfo.m_systemCinfo.m_gravity = Vec4_0;
+    cinfo.m_numMaxCells = 20;
+    cinfo.m_divisionInterval = 10;
+    cinfo.m_numSteps = 100;
+    cinfo.m_fitnessFunc = [](const PointBasedSystem& system) { return (float)system.getVertexPositions().size(); };
+
+    PhysicsFitnessCalculator calculator(cinfo);
+    const float divideFitness = calculator.calcFitness(&divideGenome);
+    const float stayFitness = calculator.calcFitness(&stayGenome);
+    EXPECT_GT(divideFitness, 2.f);
+    EXPECT_EQ(stayFitness, 2.f);
+
+    // Reused systems give the same results as fresh ones.
+    EXPECT_EQ(calculator.calcFitness(&divideGenome), divideFitness);
+    PhysicsFitnessCalculator freshCalculator(cinfo);
+    EXPECT_EQ(freshCalculator.calcFitness(&divideGenome), divideFitness);
+
+    // Simulate many creatures in parallel.
+    cinfo.m_numThreads = 4;
+    PhysicsFitnessCalculator parallelCalculator(cinfo);
+    std::vector<GenomeBase*> genomes;
+    for (int i = 0; i < 16; i++)
+    {
+        genomes.push_back(i % 2 == 0 ? static_cast<GenomeBase*>(&divideGenome) : static_cast<GenomeBase*>(&stayGenome));
+    }
+    std::vector<float> fitnesses(genomes.size(), -1.f);
+    parallelCalculator.calcFitnesses(genomes.data(), (int)genomes.size(), fitnesses.data());
+    for (int i = 0; i < (int)genomes.size(); i++)
+    {
+        EXPECT_EQ(fitnesses[i], i % 2 == 0 ? divideFitness : stayFitness);
+    }
+
+    // Clone has its own pool of a single system.
+    FitnessCalculatorBase::FitnessCalcPtr clone = parallelCalculator.clone();
+    EXPECT_EQ(static_cast<PhysicsFitnessCalculator*>(clone.get())->getNumSlots(), 1);
+    EXPECT_EQ(clone->calcFitness(&stayGenome), stayFitness);
+}
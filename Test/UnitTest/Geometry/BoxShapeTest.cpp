@@ -0,0 +1,106 @@
+/*
+* BoxShapeTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <Geometry/Shapes/BoxShape.h>
+#include <Geometry/Aabb.h>
+
+#include <cmath>
+
+TEST(BoxShape, Queries)
+{
+    // Axis aligned box centered at (1, 0, 0) with size 2x1x4.
+    BoxShape box(Vector4(1.f, 0.f, 0.f), Vector4(1.f, 0.5f, 2.f));
+    EXPECT_TRUE(box.hasInterior());
+
+    //
+    // Ray cast
+    //
+
+    // The ray hits the box.
+    {
+        Shape::RayCastOutput output;
+        box.castRay(Vector4(1.f, 2.f, 1.f), Vector4(1.f, -2.f, 1.f), output);
+        EXPECT_TRUE(output.m_hit);
+        EXPECT_NEAR(output.m_fraction, 0.375f, 1e-5f);
+        EXPECT_TRUE(output.m_hitPoint.equals<3>(Vector4(1.f, 0.5f, 1.f), SimdFloat(1e-5f)));
+        EXPECT_TRUE(output.m_hitNormal.equals<3>(Vector4(0.f, 1.f, 0.f), SimdFloat(1e-5f)));
+    }
+
+    // The ray misses the box.
+    {
+        Shape::RayCastOutput output;
+        box.castRay(Vector4(-1.f, 2.f, 0.f), Vector4(-1.f, -2.f, 0.f), output);
+        EXPECT_FALSE(output.m_hit);
+        box.castRay(Vector4(1.f, 2.f, 0.f), Vector4(1.f, 1.f, 0.f), output);
+        EXPECT_FALSE(output.m_hit);
+    }
+
+    // The ray starts inside the box.
+    {
+        Shape::RayCastOutput output;
+        box.castRay(Vector4(1.9f, 0.f, 0.f), Vector4(1.f, 2.f, 0.f), output);
+        EXPECT_TRUE(output.m_hit);
+        EXPECT_EQ(output.m_fraction, 0.f);
+        EXPECT_TRUE(output.m_hitNormal.equals<3>(Vector4(1.f, 0.f, 0.f), SimdFloat(1e-5f)));
+    }
+
+    //
+    // Closest point
+    //
+
+    // The point is outside the box near a corner.
+    {
+        Shape::ClosestPointOutput output;
+        box.getClosestPoint(Vector4(3.f, 1.5f, 0.f), output);
+        EXPECT_TRUE(output.m_closestPoint.equals<3>(Vector4(2.f, 0.5f, 0.f), SimdFloat(1e-5f)));
+        Vector4 dir(1.f, 1.f, 0.f);
+        dir.normalize<3>();
+        EXPECT_TRUE(output.m_normal.equals<3>(dir, SimdFloat(1e-5f)));
+    }
+
+    // The point is inside the box.
+    {
+        Shape::ClosestPointOutput output;
+        box.getClosestPoint(Vector4(1.f, 0.f, -1.8f), output);
+        EXPECT_TRUE(output.m_closestPoint.equals<3>(Vector4(1.f, 0.f, -2.f), SimdFloat(1e-5f)));
+        EXPECT_TRUE(output.m_normal.equals<3>(Vector4(0.f, 0.f, -1.f), SimdFloat(1e-5f)));
+    }
+}
+
+TEST(BoxShape, Rotated)
+{
+    // Unit cube rotated by 45 degrees around z axis.
+    const float c = std::sqrt(0.5f);
+    const Matrix33 rotation(Vector4(c, c, 0.f), Vector4(-c, c, 0.f), Vec4_0010);
+    BoxShape box(Vec4_0, Vector4(0.5f, 0.5f, 0.5f), rotation);
+
+    // The ray along x axis hits the edge of the rotated box.
+    {
+        Shape::RayCastOutput output;
+        box.castRay(Vector4(-2.f, 0.f, 0.f), Vector4(2.f, 0.f, 0.f), output);
+        EXPECT_TRUE(output.m_hit);
+        EXPECT_NEAR(output.m_fraction, (2.f - c) / 4.f, 1e-5f);
+        EXPECT_TRUE(output.m_hitNormal.isNormalized<3>());
+    }
+
+    // The closest point from a point on a diagonal is on the face whose normal is the diagonal.
+    {
+        Shape::ClosestPointOutput output;
+        box.getClosestPoint(Vector4(1.f, 1.f, 0.f), output);
+        EXPECT_TRUE(output.m_closestPoint.equals<3>(Vector4(0.5f * c, 0.5f * c, 0.f), SimdFloat(1e-5f)));
+        EXPECT_TRUE(output.m_normal.equals<3>(Vector4(c, c, 0.f), SimdFloat(1e-5f)));
+    }
+
+    // AABB encloses the rotated box.
+    {
+        Aabb aabb;
+        box.getAabb(aabb);
+        EXPECT_TRUE(aabb.m_min.equals<3>(Vector4(-c, -c, -0.5f), SimdFloat(1e-5f)));
+        EXPECT_TRUE(aabb.m_max.equals<3>(Vector4(c, c, 0.5f), SimdFloat(1e-5f)));
+    }
+}
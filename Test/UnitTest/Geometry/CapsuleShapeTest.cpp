@@ -0,0 +1,91 @@
+/*
+* CapsuleShapeTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <Geometry/Shapes/CapsuleShape.h>
+#include <Geometry/Aabb.h>
+
+TEST(CapsuleShape, Queries)
+{
+    // Capsule along x axis from -1 to 1 with radius 0.5.
+    CapsuleShape capsule(Vector4(-1.f, 0.f, 0.f), Vector4(1.f, 0.f, 0.f), 0.5f);
+    EXPECT_TRUE(capsule.hasInterior());
+
+    //
+    // Ray cast
+    //
+
+    // The ray hits the cylinder part.
+    {
+        Shape::RayCastOutput output;
+        capsule.castRay(Vector4(0.5f, 2.f, 0.f), Vector4(0.5f, -2.f, 0.f), output);
+        EXPECT_TRUE(output.m_hit);
+        EXPECT_NEAR(output.m_fraction, 0.375f, 1e-5f);
+        EXPECT_TRUE(output.m_hitPoint.equals<3>(Vector4(0.5f, 0.5f, 0.f), SimdFloat(1e-5f)));
+        EXPECT_TRUE(output.m_hitNormal.equals<3>(Vector4(0.f, 1.f, 0.f), SimdFloat(1e-5f)));
+    }
+
+    // The ray hits the end cap.
+    {
+        Shape::RayCastOutput output;
+        capsule.castRay(Vector4(3.f, 0.f, 0.f), Vector4(-3.f, 0.f, 0.f), output);
+        EXPECT_TRUE(output.m_hit);
+        EXPECT_NEAR(output.m_fraction, 0.25f, 1e-5f);
+        EXPECT_TRUE(output.m_hitPoint.equals<3>(Vector4(1.5f, 0.f, 0.f), SimdFloat(1e-5f)));
+        EXPECT_TRUE(output.m_hitNormal.equals<3>(Vector4(1.f, 0.f, 0.f), SimdFloat(1e-5f)));
+    }
+
+    // The ray misses the capsule.
+    {
+        Shape::RayCastOutput output;
+        capsule.castRay(Vector4(0.f, 2.f, 0.f), Vector4(0.f, 1.f, 0.f), output);
+        EXPECT_FALSE(output.m_hit);
+        capsule.castRay(Vector4(-3.f, 1.f, 0.f), Vector4(3.f, 1.f, 0.f), output);
+        EXPECT_FALSE(output.m_hit);
+    }
+
+    // The ray starts inside the capsule.
+    {
+        Shape::RayCastOutput output;
+        capsule.castRay(Vector4(0.f, 0.25f, 0.f), Vector4(0.f, 2.f, 0.f), output);
+        EXPECT_TRUE(output.m_hit);
+        EXPECT_EQ(output.m_fraction, 0.f);
+        EXPECT_TRUE(output.m_hitNormal.equals<3>(Vector4(0.f, 1.f, 0.f), SimdFloat(1e-5f)));
+    }
+
+    //
+    // Closest point
+    //
+
+    // The point is outside the capsule.
+    {
+        Shape::ClosestPointOutput output;
+        capsule.getClosestPoint(Vector4(2.f, 0.f, 1.f), output);
+        Vector4 dir(1.f, 0.f, 1.f);
+        dir.normalize<3>();
+        EXPECT_TRUE(output.m_closestPoint.equals<3>(Vector4(1.f, 0.f, 0.f) + dir * SimdFloat(0.5f), SimdFloat(1e-5f)));
+        EXPECT_TRUE(output.m_normal.equals<3>(dir, SimdFloat(1e-5f)));
+    }
+
+    // The point is inside the capsule.
+    {
+        Shape::ClosestPointOutput output;
+        capsule.getClosestPoint(Vector4(0.3f, 0.f, -0.2f), output);
+        EXPECT_TRUE(output.m_closestPoint.equals<3>(Vector4(0.3f, 0.f, -0.5f), SimdFloat(1e-5f)));
+        EXPECT_TRUE(output.m_normal.equals<3>(Vector4(0.f, 0.f, -1.f), SimdFloat(1e-5f)));
+    }
+
+    //
+    // AABB
+    //
+    {
+        Aabb aabb;
+        capsule.getAabb(aabb);
+        EXPECT_TRUE(aabb.m_min.equals<3>(Vector4(-1.5f, -0.5f, -0.5f), SimdFloat(1e-5f)));
+        EXPECT_TRUE(aabb.m_max.equals<3>(Vector4(1.5f, 0.5f, 0.5f), SimdFloat(1e-5f)));
+    }
+}
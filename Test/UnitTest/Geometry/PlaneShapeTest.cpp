@@ -7,6 +7,9 @@
 #include <UnitTest/UnitTestPch.h>
 
 #include <Geometry/Shapes/PlaneShape.h>
+#include <Common/PseudoRandom.h>
+
+#include <vector>
 
 TEST(PlaneShape, BasicOperations)
 {
@@ -170,3 +173,48 @@ TEST(PlaneShape, Queries)
         EXPECT_TRUE(plane.getPlane().equals<3>(output.m_normal, SimdFloat(1E-5f)));
     }
 }
+
+TEST(PlaneShape, BatchQueries)
+{
+    PlaneShape plane(Vector4(1.f, 2.f, 3.f, -1.f));
+
+    // Random rays crossing the plane in both directions. The number of rays is not a multiple of the batch size.
+    PseudoRandom random(8);
+    constexpr int numRays = 103;
+    std::vector<Vector4> starts(numRays), ends(numRays);
+    for (int i = 0; i < numRays; i++)
+    {
+        starts[i] = Vector4(random.randomReal(-4.f, 4.f), random.randomReal(-4.f, 4.f), random.randomReal(-4.f, 4.f));
+        ends[i] = Vector4(random.randomReal(-4.f, 4.f), random.randomReal(-4.f, 4.f), random.randomReal(-4.f, 4.f));
+    }
+
+    // Batched queries give the same results as single queries.
+    std::vector<Shape::RayCastOutput> rayCastOutputs(numRays);
+    plane.castRays(starts.data(), ends.data(), numRays, rayCastOutputs.data());
+    int numHits = 0;
+    for (int i = 0; i < numRays; i++)
+    {
+        Shape::RayCastOutput output;
+        plane.castRay(starts[i], ends[i], output);
+        EXPECT_EQ(rayCastOutputs[i].m_hit, output.m_hit);
+        if (output.m_hit)
+        {
+            numHits++;
+            EXPECT_NEAR(rayCastOutputs[i].m_fraction, output.m_fraction, 1e-4f);
+            EXPECT_TRUE(rayCastOutputs[i].m_hitPoint.equals<3>(output.m_hitPoint));
+            EXPECT_TRUE(rayCastOutputs[i].m_hitNormal.equals<3>(output.m_hitNormal));
+        }
+    }
+    EXPECT_GT(numHits, 0);
+    EXPECT_LT(numHits, numRays);
+
+    std::vector<Shape::ClosestPointOutput> closestPointOutputs(numRays);
+    plane.getClosestPoints(starts.data(), numRays, closestPointOutputs.data());
+    for (int i = 0; i < numRays; i++)
+    {
+        Shape::ClosestPointOutput output;
+        plane.getClosestPoint(starts[i], output);
+        EXPECT_TRUE(closestPointOutputs[i].m_closestPoint.equals<3>(output.m_closestPoint));
+        EXPECT_TRUE(closestPointOutputs[i].m_normal.equals<3>(output.m_normal));
+    }
+}
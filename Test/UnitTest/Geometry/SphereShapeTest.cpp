@@ -7,6 +7,9 @@
 #include <UnitTest/UnitTestPch.h>
 
 #include <Geometry/Shapes/SphereShape.h>
+#include <Common/PseudoRandom.h>
+
+#include <vector>
 
 TEST(SphereShape, BasicOperations)
 {
@@ -206,3 +209,48 @@ TEST(SphereShape, Queries)
         EXPECT_TRUE(output.m_normal.equals<3>(dir, SimdFloat(1E-5f)));
     }
 }
+
+TEST(SphereShape, BatchQueries)
+{
+    SphereShape sphere(Vector4(0.5f, -0.5f, 1.f), 2.f);
+
+    // Random rays including ones starting inside the sphere. The number of rays is not a multiple of the batch size.
+    PseudoRandom random(7);
+    constexpr int numRays = 103;
+    std::vector<Vector4> starts(numRays), ends(numRays);
+    for (int i = 0; i < numRays; i++)
+    {
+        starts[i] = Vector4(random.randomReal(-4.f, 4.f), random.randomReal(-4.f, 4.f), random.randomReal(-4.f, 4.f));
+        ends[i] = Vector4(random.randomReal(-4.f, 4.f), random.randomReal(-4.f, 4.f), random.randomReal(-4.f, 4.f));
+    }
+
+    // Batched queries give the same results as single queries.
+    std::vector<Shape::RayCastOutput> rayCastOutputs(numRays);
+    sphere.castRays(starts.data(), ends.data(), numRays, rayCastOutputs.data());
+    int numHits = 0;
+    for (int i = 0; i < numRays; i++)
+    {
+        Shape::RayCastOutput output;
+        sphere.castRay(starts[i], ends[i], output);
+        EXPECT_EQ(rayCastOutputs[i].m_hit, output.m_hit);
+        if (output.m_hit)
+        {
+            numHits++;
+            EXPECT_NEAR(rayCastOutputs[i].m_fraction, output.m_fraction, 1e-4f);
+            EXPECT_TRUE(rayCastOutputs[i].m_hitPoint.equals<3>(output.m_hitPoint));
+            EXPECT_TRUE(rayCastOutputs[i].m_hitNormal.equals<3>(output.m_hitNormal));
+        }
+    }
+    EXPECT_GT(numHits, 0);
+    EXPECT_LT(numHits, numRays);
+
+    std::vector<Shape::ClosestPointOutput> closestPointOutputs(numRays);
+    sphere.getClosestPoints(starts.data(), numRays, closestPointOutputs.data());
+    for (int i = 0; i < numRays; i++)
+    {
+        Shape::ClosestPointOutput output;
+        sphere.getClosestPoint(starts[i], output);
+        EXPECT_TRUE(closestPointOutputs[i].m_closestPoint.equals<3>(output.m_closestPoint));
+        EXPECT_TRUE(closestPointOutputs[i].m_normal.equals<3>(output.m_normal));
+    }
+}
@@ -0,0 +1,212 @@
+/*
+* TriangleMeshShapeTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <Geometry/Shapes/TriangleMeshShape.h>
+#include <Geometry/Aabb.h>
+#include <Common/PseudoRandom.h>
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // Create a bumpy terrain of (n x n) quads facing +y.
+    void createTerrain(int n, TriangleMeshShape::Vertices& verticesOut, TriangleMeshShape::Triangles& trianglesOut)
+    {
+        for (int z = 0; z <= n; z++)
+        {
+            for (int x = 0; x <= n; x++)
+            {
+                const float height = 0.3f * std::sin(0.7f * x) * std::cos(0.5f * z);
+                verticesOut.push_back(Vector4((float)x, height, (float)z));
+            }
+        }
+
+        for (int z = 0; z < n; z++)
+        {
+            for (int x = 0; x < n; x++)
+            {
+                const int v0 = z * (n + 1) + x;
+                const int v1 = v0 + 1;
+                const int v2 = v0 + n + 1;
+                const int v3 = v2 + 1;
+                trianglesOut.push_back(TriangleMeshShape::Triangle{ v0, v2, v1 });
+                trianglesOut.push_back(TriangleMeshShape::Triangle{ v1, v2, v3 });
+            }
+        }
+    }
+}
+
+TEST(TriangleMeshShape, Bvh)
+{
+    constexpr int n = 24;
+    TriangleMeshShape::Vertices vertices;
+    TriangleMeshShape::Triangles triangles;
+    createTerrain(n, vertices, triangles);
+    TriangleMeshShape mesh(vertices, triangles, 0.2f);
+    EXPECT_FALSE(mesh.hasInterior());
+    EXPECT_TRUE(mesh.supportsSweptQueries());
+    EXPECT_EQ(mesh.getNumTriangles(), 2 * n * n);
+
+    // Every triangle belongs to exactly one leaf and every leaf is enclosed by its parent.
+    const TriangleMeshShape::Nodes& nodes = mesh.getNodes();
+    EXPECT_LT((int)nodes.size(), 2 * mesh.getNumTriangles());
+    std::vector<int> visited(mesh.getNumTriangles(), 0);
+    int maxDepth = 0;
+    std::vector<std::pair<int, int>> stack{ { 0, 0 } };
+    while (!stack.empty())
+    {
+        const int index = stack.back().first;
+        const int depth = stack.back().second;
+        stack.pop_back();
+        maxDepth = std::max(maxDepth, depth);
+
+        const TriangleMeshShape::Node& node = nodes[index];
+        if (node.isLeaf())
+        {
+            EXPECT_LE(node.m_count, TriangleMeshShape::s_maxTrianglesPerLeaf);
+            for (int i = node.m_start; i < node.m_start + node.m_count; i++)
+            {
+                visited[i]++;
+                for (int k = 0; k < 3; k++)
+                {
+                    const Vector4& v = mesh.getVertices()[mesh.getTriangle(i).m_v[k]];
+                    Aabb point;
+                    point.set(v, v);
+                    EXPECT_TRUE(node.m_aabb.overlaps(point));
+                }
+            }
+        }
+        else
+        {
+            for (int child = node.m_start; child < node.m_start + 2; child++)
+            {
+                EXPECT_TRUE(node.m_aabb.overlaps(nodes[child].m_aabb));
+                stack.push_back({ child, depth + 1 });
+            }
+        }
+    }
+
+    for (int count : visited)
+    {
+        EXPECT_EQ(count, 1);
+    }
+
+    // The hierarchy is logarithmic in the number of triangles.
+    EXPECT_LE(maxDepth, 16);
+
+    Aabb aabb;
+    mesh.getAabb(aabb);
+    EXPECT_NEAR(aabb.m_min(0), -0.2f, 1e-5f);
+    EXPECT_NEAR(aabb.m_max(2), (float)n + 0.2f, 1e-5f);
+}
+
+TEST(TriangleMeshShape, Queries)
+{
+    constexpr int n = 12;
+    TriangleMeshShape::Vertices vertices;
+    TriangleMeshShape::Triangles triangles;
+    createTerrain(n, vertices, triangles);
+    TriangleMeshShape mesh(vertices, triangles);
+
+    // Meshes of a single triangle give brute force results.
+    std::vector<TriangleMeshShape> singles;
+    for (const TriangleMeshShape::Triangle& tri : triangles)
+    {
+        singles.push_back(TriangleMeshShape(vertices, TriangleMeshShape::Triangles{ tri }));
+    }
+
+    PseudoRandom random(11);
+    int numHits = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        const Vector4 start(random.randomReal(-1.f, n + 1.f), random.randomReal(-1.f, 2.f), random.randomReal(-1.f, n + 1.f));
+        const Vector4 end(random.randomReal(-1.f, n + 1.f), random.randomReal(-2.f, 1.f), random.randomReal(-1.f, n + 1.f));
+
+        // Ray cast
+        {
+            Shape::RayCastOutput output;
+            mesh.castRay(start, end, output);
+
+            bool hit = false;
+            float fraction = 1.f;
+            for (const TriangleMeshShape& single : singles)
+            {
+                Shape::RayCastOutput singleOutput;
+                single.castRay(start, end, singleOutput);
+                if (singleOutput.m_hit && singleOutput.m_fraction <= fraction)
+                {
+                    hit = true;
+                    fraction = singleOutput.m_fraction;
+                }
+            }
+
+            EXPECT_EQ(output.m_hit, hit);
+            if (hit && output.m_hit)
+            {
+                numHits++;
+                EXPECT_NEAR(output.m_fraction, fraction, 1e-5f);
+                EXPECT_TRUE(output.m_hitPoint.equals<3>(start + (end - start) * SimdFloat(fraction), SimdFloat(1e-4f)));
+
+                // Only front faces are hit.
+                EXPECT_TRUE(output.m_hitNormal.isNormalized<3>());
+                EXPECT_LT(output.m_hitNormal.dot<3>(end - start).getFloat(), 0.f);
+            }
+        }
+
+        // Closest point
+        {
+            Shape::ClosestPointOutput output;
+            mesh.getClosestPoint(start, output);
+
+            float minDistance = std::numeric_limits<float>::max();
+            for (const TriangleMeshShape& single : singles)
+            {
+                Shape::ClosestPointOutput singleOutput;
+                single.getClosestPoint(start, singleOutput);
+                minDistance = std::min(minDistance, (singleOutput.m_closestPoint - start).length<3>().getFloat());
+            }
+
+            EXPECT_NEAR((output.m_closestPoint - start).length<3>().getFloat(), minDistance, 1e-5f);
+        }
+    }
+    EXPECT_GT(numHits, 0);
+}
+
+TEST(TriangleMeshShape, ClosedMesh)
+{
+    // Unit cube whose faces are facing outward.
+    const TriangleMeshShape::Vertices vertices{
+        Vector4(0.f, 0.f, 0.f), Vector4(1.f, 0.f, 0.f), Vector4(1.f, 1.f, 0.f), Vector4(0.f, 1.f, 0.f),
+        Vector4(0.f, 0.f, 1.f), Vector4(1.f, 0.f, 1.f), Vector4(1.f, 1.f, 1.f), Vector4(0.f, 1.f, 1.f) };
+    const TriangleMeshShape::Triangles triangles{
+        { 0, 2, 1 }, { 0, 3, 2 },   // -z
+        { 4, 5, 6 }, { 4, 6, 7 },   // +z
+        { 0, 1, 5 }, { 0, 5, 4 },   // -y
+        { 3, 7, 6 }, { 3, 6, 2 },   // +y
+        { 0, 4, 7 }, { 0, 7, 3 },   // -x
+        { 1, 2, 6 }, { 1, 6, 5 } }; // +x
+    TriangleMeshShape mesh(vertices, triangles);
+
+    // The ray from outside hits the front face.
+    Shape::RayCastOutput output;
+    mesh.castRay(Vector4(0.5f, 0.5f, 3.f), Vector4(0.5f, 0.5f, -3.f), output);
+    EXPECT_TRUE(output.m_hit);
+    EXPECT_NEAR(output.m_fraction, 2.f / 6.f, 1e-5f);
+    EXPECT_TRUE(output.m_hitNormal.equals<3>(Vector4(0.f, 0.f, 1.f), SimdFloat(1e-5f)));
+
+    // The ray from inside passes through back faces.
+    mesh.castRay(Vector4(0.5f, 0.5f, 0.5f), Vector4(0.5f, 0.5f, 3.f), output);
+    EXPECT_FALSE(output.m_hit);
+
+    // The closest point from inside is on the nearest face and the position is behind it.
+    Shape::ClosestPointOutput closest;
+    mesh.getClosestPoint(Vector4(0.9f, 0.5f, 0.4f), closest);
+    EXPECT_TRUE(closest.m_closestPoint.equals<3>(Vector4(1.f, 0.5f, 0.4f), SimdFloat(1e-5f)));
+    EXPECT_TRUE(closest.m_normal.equals<3>(Vector4(1.f, 0.f, 0.f), SimdFloat(1e-5f)));
+}
@@ -0,0 +1,157 @@
+/*
+* DynamicAabbTreeTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <Physics/Collision/DynamicAabbTree.h>
+#include <Common/PseudoRandom.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // Create a random box in [-range, range]^3.
+    Aabb createRandomAabb(PseudoRandom& random, float range, float maxSize)
+    {
+        const Vector4 min(random.randomReal(-range, range), random.randomReal(-range, range), random.randomReal(-range, range));
+        const Vector4 size(random.randomReal(0.f, maxSize), random.randomReal(0.f, maxSize), random.randomReal(0.f, maxSize));
+        Aabb aabb;
+        aabb.set(min, min + size);
+        return aabb;
+    }
+
+    // Check that the tree returns the same objects as brute force against enlarged AABBs and that enlarged AABBs contain the real ones.
+    void checkQueries(const DynamicAabbTree& tree, const std::vector<int>& leaves, const std::vector<Aabb>& aabbs, PseudoRandom& random)
+    {
+        for (int i = 0; i < (int)leaves.size(); i++)
+        {
+            if (leaves[i] == DynamicAabbTree::s_nullNode)
+            {
+                continue;
+            }
+
+            const Aabb& fatAabb = tree.getFatAabb(leaves[i]);
+            EXPECT_EQ(tree.getUserData(leaves[i]), i);
+            for (int k = 0; k < 3; k++)
+            {
+                EXPECT_LE(fatAabb.m_min(k), aabbs[i].m_min(k));
+                EXPECT_GE(fatAabb.m_max(k), aabbs[i].m_max(k));
+            }
+        }
+
+        std::vector<int> found;
+        for (int q = 0; q < 50; q++)
+        {
+            const Aabb queryAabb = createRandomAabb(random, 10.f, 4.f);
+            found.clear();
+            tree.query(queryAabb, found);
+            std::sort(found.begin(), found.end());
+
+            std::vector<int> expected;
+            for (int i = 0; i < (int)leaves.size(); i++)
+            {
+                if (leaves[i] != DynamicAabbTree::s_nullNode && tree.getFatAabb(leaves[i]).overlaps(queryAabb))
+                {
+                    expected.push_back(i);
+                }
+            }
+            EXPECT_EQ(found, expected);
+        }
+    }
+}
+
+TEST(DynamicAabbTree, InsertRemoveUpdate)
+{
+    PseudoRandom random(3);
+    DynamicAabbTree tree(0.2f);
+    EXPECT_EQ(tree.getNumLeaves(), 0);
+    EXPECT_EQ(tree.getHeight(), 0);
+
+    constexpr int numObjects = 300;
+    std::vector<Aabb> aabbs(numObjects);
+    std::vector<int> leaves(numObjects);
+    for (int i = 0; i < numObjects; i++)
+    {
+        aabbs[i] = createRandomAabb(random, 10.f, 1.f);
+        leaves[i] = tree.insert(aabbs[i], i);
+    }
+    EXPECT_EQ(tree.getNumLeaves(), numObjects);
+    checkQueries(tree, leaves, aabbs, random);
+
+    // Remove every third object.
+    for (int i = 0; i < numObjects; i += 3)
+    {
+        tree.remove(leaves[i]);
+        leaves[i] = DynamicAabbTree::s_nullNode;
+    }
+    EXPECT_EQ(tree.getNumLeaves(), numObjects - numObjects / 3);
+    checkQueries(tree, leaves, aabbs, random);
+
+    // Small moves stay in enlarged AABBs and large moves reinsert leaves.
+    for (int i = 1; i < numObjects; i += 3)
+    {
+        const Vector4 smallMove(0.1f, 0.f, 0.f);
+        aabbs[i].m_min += smallMove;
+        aabbs[i].m_max += smallMove;
+        EXPECT_FALSE(tree.update(leaves[i], aabbs[i]));
+
+        aabbs[i] = createRandomAabb(random, 10.f, 1.f);
+        tree.update(leaves[i], aabbs[i]);
+    }
+    checkQueries(tree, leaves, aabbs, random);
+
+    // Removed nodes are reused.
+    for (int i = 0; i < numObjects; i += 3)
+    {
+        aabbs[i] = createRandomAabb(random, 10.f, 1.f);
+        leaves[i] = tree.insert(aabbs[i], i);
+    }
+    EXPECT_EQ(tree.getNumLeaves(), numObjects);
+    checkQueries(tree, leaves, aabbs, random);
+}
+
+TEST(DynamicAabbTree, Balance)
+{
+    // Boxes inserted in sorted order would make a linear chain without rotations.
+    DynamicAabbTree tree;
+    constexpr int numObjects = 1024;
+    for (int i = 0; i < numObjects; i++)
+    {
+        Aabb aabb;
+        aabb.set(Vector4((float)i, 0.f, 0.f), Vector4((float)i + 0.5f, 0.5f, 0.5f));
+        tree.insert(aabb, i);
+    }
+    EXPECT_LE(tree.getHeight(), 2 * (int)std::log2((float)numObjects));
+
+    // A query of a small region finds only the nearby boxes.
+    Aabb queryAabb;
+    queryAabb.set(Vector4(500.6f, 0.f, 0.f), Vector4(500.7f, 0.1f, 0.1f));
+    std::vector<int> found;
+    tree.query(queryAabb, found);
+    EXPECT_EQ(found, std::vector<int>{ 500 });
+}
+
+TEST(DynamicAabbTree, InfiniteAabb)
+{
+    DynamicAabbTree tree;
+    Aabb infinite;
+    infinite.setInfinite();
+    const int plane = tree.insert(infinite, 0);
+
+    Aabb aabb;
+    aabb.set(Vector4(1.f, 1.f, 1.f), Vector4(2.f, 2.f, 2.f));
+    tree.insert(aabb, 1);
+
+    // The infinite AABB overlaps everything and never needs to be reinserted.
+    std::vector<int> found;
+    Aabb queryAabb;
+    queryAabb.set(Vector4(-1000.f, -1000.f, -1000.f), Vector4(-999.f, -999.f, -999.f));
+    tree.query(queryAabb, found);
+    EXPECT_EQ(found, std::vector<int>{ 0 });
+    EXPECT_FALSE(tree.update(plane, infinite));
+}
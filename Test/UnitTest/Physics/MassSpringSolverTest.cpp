@@ -0,0 +1,283 @@
+/*
+* MassSpringSolverTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <Physics/Systems/PointBasedSystem.h>
+#include <Physics/Solvers/ParticleArrays.h>
+#include <Physics/Solvers/MassSpring/MassSpringSolver.h>
+#include <Geometry/Shapes/PlaneShape.h>
+
+#include <cstdint>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    // Create a cinfo of a square sheet of mass spring vertices.
+    PointBasedSystem::Cinfo createSheetCinfo(int numVerticesPerSide, float stiffness)
+    {
+        PointBasedSystem::Cinfo cinfo;
+        cinfo.m_solverType = PointBasedSystem::SolverType::MASS_SPRING;
+        cinfo.m_dampingFactor = 0.1f;
+        for (int i = 0; i < numVerticesPerSide; i++)
+        {
+            for (int j = 0; j < numVerticesPerSide; j++)
+            {
+                const int index = i * numVerticesPerSide + j;
+                cinfo.m_vertexPositions.push_back(Vector4(0.1f * (float)j, 0.5f + 0.01f * (float)(i + j), 0.1f * (float)i));
+                if (j > 0)
+                {
+                    cinfo.m_vertexConnectivity.push_back({ index - 1, index, stiffness });
+                }
+                if (i > 0)
+                {
+                    cinfo.m_vertexConnectivity.push_back({ index - numVerticesPerSide, index, stiffness });
+                }
+            }
+        }
+        return cinfo;
+    }
+
+    MassSpringSolver& accessSolver(PointBasedSystem& system)
+    {
+        return static_cast<MassSpringSolver&>(*system.getSolver());
+    }
+}
+
+TEST(ParticleArrays, Layout)
+{
+    std::vector<Vector4> vectors;
+    for (int i = 0; i < 13; i++)
+    {
+        vectors.push_back(Vector4((float)i, (float)(i * 2), (float)(i * 3)));
+    }
+
+    ParticleArrays arrays;
+    arrays.gather(vectors);
+    EXPECT_EQ(arrays.getSize(), 13);
+    EXPECT_EQ(arrays.getPaddedSize(), 16);
+
+    // Arrays are aligned for SIMD.
+    EXPECT_EQ((uintptr_t)arrays.m_x.data() % 32, 0);
+    EXPECT_EQ((uintptr_t)arrays.m_y.data() % 32, 0);
+    EXPECT_EQ((uintptr_t)arrays.m_z.data() % 32, 0);
+
+    for (int i = 0; i < 13; i++)
+    {
+        EXPECT_TRUE(arrays.get(i).exactEquals<3>(vectors[i]));
+    }
+
+    // Padding is cleared when the arrays shrink.
+    arrays.resize(9);
+    EXPECT_EQ(arrays.getPaddedSize(), 16);
+    for (int i = 9; i < arrays.getPaddedSize(); i++)
+    {
+        EXPECT_EQ(arrays.m_x[i], 0.f);
+        EXPECT_EQ(arrays.m_y[i], 0.f);
+        EXPECT_EQ(arrays.m_z[i], 0.f);
+    }
+
+    std::vector<Vector4> scattered(9);
+    arrays.scatter(scattered);
+    for (int i = 0; i < 9; i++)
+    {
+        EXPECT_TRUE(scattered[i].exactEquals<3>(vectors[i]));
+    }
+}
+
+TEST(MassSpringSolver, ParticleLayouts)
+{
+    // Create a chain of vertices falling onto a plane.
+    PointBasedSystem::Cinfo cinfo;
+    cinfo.m_solverType = PointBasedSystem::SolverType::MASS_SPRING;
+    cinfo.m_dampingFactor = 0.1f;
+    for (int i = 0; i < 21; i++)
+    {
+        cinfo.m_vertexPositions.push_back(Vector4(0.1f * (float)i, 0.5f + 0.01f * (float)i, 0.f));
+        if (i > 0)
+        {
+            cinfo.m_vertexConnectivity.push_back({ i - 1, i, 100.f });
+        }
+    }
+
+    PointBasedSystem systemAoS, systemSoA;
+    systemAoS.init(cinfo);
+    cinfo.m_particleLayout = PointBasedSystem::ParticleLayout::SOA;
+    systemSoA.init(cinfo);
+    EXPECT_EQ(systemSoA.getParticleLayout(), PointBasedSystem::ParticleLayout::SOA);
+
+    auto plane = std::make_shared<PlaneShape>(Vector4(0.f, 1.f, 0.f, 0.f));
+    systemAoS.addCollider(plane);
+    systemSoA.addCollider(plane);
+
+    // Both layouts should give the same results up to rounding errors.
+    for (int i = 0; i < 60; i++)
+    {
+        systemAoS.step(1.f / 600.f);
+        systemSoA.step(1.f / 600.f);
+    }
+
+    const PointBasedSystem::Positions& positionsAoS = systemAoS.getVertexPositions();
+    const PointBasedSystem::Positions& positionsSoA = systemSoA.getVertexPositions();
+    const PointBasedSystem::Velocities& velocitiesAoS = systemAoS.getVertexVelocities();
+    const PointBasedSystem::Velocities& velocitiesSoA = systemSoA.getVertexVelocities();
+    for (int i = 0; i < (int)positionsAoS.size(); i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            EXPECT_NEAR(positionsAoS[i](j), positionsSoA[i](j), 1e-4f);
+            EXPECT_NEAR(velocitiesAoS[i](j), velocitiesSoA[i](j), 1e-3f);
+        }
+    }
+}
+
+TEST(MassSpringSolver, ParallelForces)
+{
+    const PointBasedSystem::ParticleLayout layouts[] = { PointBasedSystem::ParticleLayout::AOS, PointBasedSystem::ParticleLayout::SOA };
+    for (PointBasedSystem::ParticleLayout layout : layouts)
+    {
+        PointBasedSystem::Cinfo cinfo = createSheetCinfo(20, 100.f);
+        cinfo.m_particleLayout = layout;
+
+        PointBasedSystem systemSerial, systemParallel;
+        systemSerial.init(cinfo);
+        systemParallel.init(cinfo);
+        accessSolver(systemParallel).setNumThreads(4);
+        EXPECT_EQ(accessSolver(systemParallel).getNumThreads(), 4);
+
+        auto plane = std::make_shared<PlaneShape>(Vector4(0.f, 1.f, 0.f, 0.f));
+        systemSerial.addCollider(plane);
+        systemParallel.addCollider(plane);
+
+        // Forces are summed in different orders, so results are the same only up to rounding errors.
+        for (int i = 0; i < 60; i++)
+        {
+            systemSerial.step(1.f / 600.f);
+            systemParallel.step(1.f / 600.f);
+        }
+
+        const PointBasedSystem::Positions& positionsSerial = systemSerial.getVertexPositions();
+        const PointBasedSystem::Positions& positionsParallel = systemParallel.getVertexPositions();
+        for (int i = 0; i < (int)positionsSerial.size(); i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                EXPECT_NEAR(positionsSerial[i](j), positionsParallel[i](j), 1e-4f);
+            }
+        }
+    }
+}
+
+TEST(MassSpringSolver, Integrators)
+{
+    // Stiff springs with a large time step. Semi-implicit Euler is unstable because sqrt(2 * k) * dt > 2.
+    PointBasedSystem::Cinfo cinfo = createSheetCinfo(4, 100000.f);
+    cinfo.m_gravity = Vec4_0;
+    for (PointBasedSystem::Cinfo::Connection& connection : cinfo.m_vertexConnectivity)
+    {
+        connection.m_length = 0.09f;
+    }
+
+    auto calcMaxStretch = [](const PointBasedSystem& system)
+    {
+        float maxStretch = 0.f;
+        const PointBasedSystem::Positions& positions = system.getVertexPositions();
+        const PointBasedSystem::Vertices& vertices = system.getVertices();
+        const PointBasedSystem::Edges& edges = system.getEdges();
+        for (int i = 0; i < (int)vertices.size(); i++)
+        {
+            for (int e = vertices[i].m_edgeStart; e < vertices[i].m_edgeStart + vertices[i].m_numEdges; e++)
+            {
+                const float length = (positions[edges[e].m_otherVertex] - positions[i]).length<3>().getFloat();
+                if (!std::isfinite(length))
+                {
+                    return std::numeric_limits<float>::infinity();
+                }
+                maxStretch = std::max(maxStretch, std::abs(length - edges[e].m_length));
+            }
+        }
+        return maxStretch;
+    };
+
+    // The implicit integrator works only with AOS layout.
+    PointBasedSystem systemSemiImplicit, systemImplicit;
+    systemSemiImplicit.init(cinfo);
+    systemImplicit.init(cinfo);
+    EXPECT_EQ(accessSolver(systemSemiImplicit).getIntegrator(), MassSpringSolver::Integrator::SEMI_IMPLICIT_EULER);
+    accessSolver(systemImplicit).setIntegrator(MassSpringSolver::Integrator::IMPLICIT_EULER);
+
+    const float initialStretch = calcMaxStretch(systemImplicit);
+    for (int i = 0; i < 30; i++)
+    {
+        systemSemiImplicit.step(1.f / 60.f);
+        systemImplicit.step(1.f / 60.f);
+    }
+
+    // Implicit Euler damps the oscillation while semi-implicit Euler blows up.
+    const float stretchImplicit = calcMaxStretch(systemImplicit);
+    EXPECT_TRUE(std::isfinite(stretchImplicit));
+    EXPECT_LT(stretchImplicit, initialStretch);
+    EXPECT_GT(calcMaxStretch(systemSemiImplicit), initialStretch * 10.f);
+}
+
+TEST(MassSpringSolver, ParticleArraysOfSystem)
+{
+    PointBasedSystem::Cinfo cinfo;
+    cinfo.m_solverType = PointBasedSystem::SolverType::MASS_SPRING;
+    cinfo.m_particleLayout = PointBasedSystem::ParticleLayout::SOA;
+    cinfo.m_gravity = Vec4_0;
+    cinfo.m_vertexPositions.push_back(Vector4(1.f, 2.f, 3.f));
+
+    PointBasedSystem system;
+    system.init(cinfo);
+
+    // The solver moves particles in the arrays of the system.
+    system.accessVertexVelocities()[0] = Vector4(6.f, 0.f, 0.f);
+    system.step(1.f / 6.f);
+    EXPECT_FLOAT_EQ(system.accessParticlePositions().get(0)(0), 2.f);
+
+    // Vectors are updated when they are read.
+    EXPECT_FLOAT_EQ(system.getVertexPositions()[0](0), 2.f);
+    EXPECT_FLOAT_EQ(system.getVertexVelocities()[0](0), 6.f);
+
+    // Impulses are applied to the arrays.
+    system.applyImpulse(0, Vector4(0.f, -6.f, 0.f));
+    system.step(1.f / 6.f);
+    EXPECT_FLOAT_EQ(system.getVertexPositions()[0](0), 3.f);
+    EXPECT_FLOAT_EQ(system.getVertexPositions()[0](1), 1.f);
+}
+
+TEST(MassSpringSolver, ColliderStiffness)
+{
+    PointBasedSystem::Cinfo cinfo;
+    cinfo.m_solverType = PointBasedSystem::SolverType::MASS_SPRING;
+    cinfo.m_vertexPositions.push_back(Vector4(0.f, 0.1f, 0.f));
+
+    PointBasedSystem systemDefault, systemSoft;
+    systemDefault.init(cinfo);
+    systemSoft.init(cinfo);
+    EXPECT_EQ(accessSolver(systemDefault).getColliderStiffness(), MassSpringSolver::s_defaultColliderStiffness);
+    accessSolver(systemSoft).setColliderStiffness(0.f);
+
+    auto plane = std::make_shared<PlaneShape>(Vector4(0.f, 1.f, 0.f, 0.f));
+    systemDefault.addCollider(plane);
+    systemSoft.addCollider(plane);
+
+    for (int i = 0; i < 600; i++)
+    {
+        systemDefault.step(1.f / 600.f);
+        systemSoft.step(1.f / 600.f);
+    }
+
+    // The vertex rests on the plane with the default stiffness and falls through it without stiffness.
+    EXPECT_GT(systemDefault.getVertexPositions()[0](1), -0.01f);
+    EXPECT_LT(systemSoft.getVertexPositions()[0](1), -1.f);
+
+    // Settings of the solver are kept when the system is reset.
+    systemSoft.reset(cinfo);
+    EXPECT_EQ(accessSolver(systemSoft).getColliderStiffness(), 0.f);
+}
@@ -0,0 +1,799 @@
+/*
+* PBDSolverTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <Physics/Systems/PointBasedSystem.h>
+#include <Physics/Solvers/PBD/PBDSolver.h>
+#include <Physics/Solvers/PBD/Constraints/PBDConstraints.h>
+#include <Physics/Solvers/MassSpring/MassSpringSolver.h>
+#include <Physics/Collision/SpatialHashGrid.h>
+#include <Geometry/Shapes/SphereShape.h>
+#include <Geometry/Shapes/PlaneShape.h>
+#include <Common/PseudoRandom.h>
+
+namespace
+{
+    // Create points scattered randomly in a box.
+    auto createRandomPositions(int numPoints, float boxSize, int seed)->std::vector<Vector4>
+    {
+        PseudoRandom random(seed);
+        std::vector<Vector4> positions(numPoints);
+        for (Vector4& pos : positions)
+        {
+            pos = Vector4(random.randomReal(-boxSize, boxSize), random.randomReal(-boxSize, boxSize), random.randomReal(-boxSize, boxSize));
+        }
+        return positions;
+    }
+
+    // Check that constraints of the same color don't share any vertex.
+    void checkColors(const PBD::StretchConstraints& constraints, int numVertices)
+    {
+        ASSERT_GE(constraints.getNumColors(), 0);
+        EXPECT_EQ(constraints.getColorStart(constraints.getNumColors()), constraints.getNumConstraints());
+        for (int color = 0; color < constraints.getNumColors(); color++)
+        {
+            std::vector<bool> used(numVertices, false);
+            for (int i = constraints.getColorStart(color); i < constraints.getColorStart(color + 1); i++)
+            {
+                EXPECT_FALSE(used[constraints.getVertexA(i)]);
+                EXPECT_FALSE(used[constraints.getVertexB(i)]);
+                used[constraints.getVertexA(i)] = true;
+                used[constraints.getVertexB(i)] = true;
+            }
+        }
+    }
+
+    // Check that bending or volume constraints of the same color don't share any vertex.
+    template <typename Constraints>
+    void checkMultiVertexColors(const Constraints& constraints, int numVertices)
+    {
+        ASSERT_GT(constraints.getNumColors(), 0);
+        EXPECT_EQ(constraints.getColorStart(constraints.getNumColors()), constraints.getNumConstraints());
+        for (int color = 0; color < constraints.getNumColors(); color++)
+        {
+            std::vector<bool> used(numVertices, false);
+            for (int i = constraints.getColorStart(color); i < constraints.getColorStart(color + 1); i++)
+            {
+                for (int k = 0; k < Constraints::s_numVertices; k++)
+                {
+                    EXPECT_FALSE(used[constraints.getVertex(i, k)]);
+                    used[constraints.getVertex(i, k)] = true;
+                }
+            }
+        }
+    }
+
+    // Create a vertical chain hanging from the pinned top vertex.
+    auto createHangingChainCinfo(int numVertices, int solverIterations, float stiffness)->PointBasedSystem::Cinfo
+    {
+        PointBasedSystem::Cinfo cinfo;
+        for (int i = 0; i < numVertices; i++)
+        {
+            cinfo.m_vertexPositions.push_back(Vector4(0.f, -0.1f * (float)i, 0.f));
+        }
+        for (int i = 0; i < numVertices - 1; i++)
+        {
+            PointBasedSystem::Cinfo::Connection connection{ i, i + 1 };
+            connection.m_stiffness = stiffness;
+            cinfo.m_vertexConnectivity.push_back(connection);
+        }
+        cinfo.m_vertexInvMasses.assign(numVertices, 10.f);
+        cinfo.m_vertexInvMasses[0] = 0.f;
+        cinfo.m_radius = 0.01f;
+        cinfo.m_dampingFactor = 0.05f;
+        cinfo.m_solverIterations = solverIterations;
+        cinfo.m_useXpbd = true;
+        return cinfo;
+    }
+
+    // Sphere which counts the number of queries. AABB is optionally disabled.
+    class CountingSphereShape : public SphereShape
+    {
+    public:
+        CountingSphereShape(const Vector4& center, float radius, bool bounded) : SphereShape(center, radius), m_bounded(bounded) {}
+
+        virtual void castRay(const Vector4& start, const Vector4& end, RayCastOutput& out) const override { m_numQueries++; SphereShape::castRay(start, end, out); }
+        virtual void getClosestPoint(const Vector4& position, ClosestPointOutput& out) const override { m_numQueries++; SphereShape::getClosestPoint(position, out); }
+        virtual void castRays(const Vector4* starts, const Vector4* ends, int numRays, RayCastOutput* outs) const override { m_numQueries += numRays; SphereShape::castRays(starts, ends, numRays, outs); }
+        virtual void getClosestPoints(const Vector4* positions, int numPositions, ClosestPointOutput* outs) const override { m_numQueries += numPositions; SphereShape::getClosestPoints(positions, numPositions, outs); }
+        virtual void getAabb(Aabb& aabbOut) const override { m_bounded ? SphereShape::getAabb(aabbOut) : Shape::getAabb(aabbOut); }
+
+        mutable int m_numQueries = 0;
+        bool m_bounded;
+    };
+}
+
+TEST(SpatialHashGrid, FindPairs)
+{
+    const std::vector<Vector4> positions = createRandomPositions(2000, 10.f, 1);
+    const SimdFloat distance(0.5f);
+
+    // Find pairs by brute force.
+    SpatialHashGrid::Pairs expectedPairs;
+    for (int i = 0; i < (int)positions.size(); i++)
+    {
+        for (int j = i + 1; j < (int)positions.size(); j++)
+        {
+            if ((positions[i] - positions[j]).lengthSq<3>() < distance * distance)
+            {
+                expectedPairs.push_back(SpatialHashGrid::Pair{ i, j });
+            }
+        }
+    }
+    EXPECT_GT(expectedPairs.size(), 0);
+
+    // Spatial hash grid should find the same pairs in the same order.
+    SpatialHashGrid grid;
+    SpatialHashGrid::Pairs pairs;
+    grid.findPairs(positions, distance, pairs);
+    ASSERT_EQ(pairs.size(), expectedPairs.size());
+    for (int i = 0; i < (int)pairs.size(); i++)
+    {
+        EXPECT_EQ(pairs[i].m_a, expectedPairs[i].m_a);
+        EXPECT_EQ(pairs[i].m_b, expectedPairs[i].m_b);
+    }
+
+    // Grid can be reused.
+    pairs.clear();
+    grid.findPairs(createRandomPositions(10, 10.f, 2), distance, pairs);
+    EXPECT_EQ(pairs.size(), 0);
+}
+
+TEST(PBDSolver, Broadphases)
+{
+    // Simulate the same system with different broadphases.
+    PointBasedSystem::Cinfo cinfo;
+    cinfo.m_vertexPositions = createRandomPositions(300, 3.f, 3);
+    for (int i = 0; i < (int)cinfo.m_vertexPositions.size() - 1; i += 2)
+    {
+        cinfo.m_vertexConnectivity.push_back({ i, i + 1 });
+    }
+    cinfo.m_radius = 0.3f;
+    cinfo.m_solverIterations = 4;
+
+    PointBasedSystem system1, system2;
+    system1.init(cinfo);
+    system2.init(cinfo);
+    static_cast<PBD::Solver*>(system1.getSolver().get())->setBroadphaseType(PBD::Solver::BroadphaseType::BRUTE_FORCE);
+    static_cast<PBD::Solver*>(system2.getSolver().get())->setBroadphaseType(PBD::Solver::BroadphaseType::SPATIAL_HASH);
+
+    for (int i = 0; i < 10; i++)
+    {
+        system1.step(1.f / 60.f);
+        system2.step(1.f / 60.f);
+    }
+
+    // Results should be identical since collision constraints are generated in the same order.
+    const PointBasedSystem::Positions& positions1 = system1.getVertexPositions();
+    const PointBasedSystem::Positions& positions2 = system2.getVertexPositions();
+    for (int i = 0; i < (int)positions1.size(); i++)
+    {
+        EXPECT_TRUE(positions1[i].equals<3>(positions2[i]));
+    }
+}
+
+TEST(PBDSolver, StretchConstraints)
+{
+    using namespace PBD;
+
+    std::vector<Vector4> positions = createRandomPositions(64, 5.f, 4);
+    const std::vector<Vector4> originalPositions = positions;
+
+    // Create constraints between disjoint pairs of vertices. Every other pair has one fixed vertex.
+    StretchConstraints constraints;
+    for (int i = 0; i < (int)positions.size(); i += 2)
+    {
+        const float invMassB = (i % 4 == 0) ? 1.f : 0.f;
+        constraints.add(i, i + 1, 1.f, 1.f, invMassB, 1.f);
+    }
+
+    // Add constraints sharing vertices which can't have the same color.
+    constraints.add(0, 2, 2.f, 1.f, 1.f, 0.5f);
+    constraints.add(2, 4, 2.f, 1.f, 1.f, 0.5f);
+    const int numConstraints = constraints.getNumConstraints();
+
+    constraints.buildColors();
+    EXPECT_EQ(constraints.getNumConstraints(), numConstraints);
+    EXPECT_GT(constraints.getNumColors(), 1);
+    EXPECT_LE(constraints.getNumColors(), numConstraints);
+
+    constraints.project(positions);
+
+    // Constraints of pairs which are not connected to other constraints are solved exactly.
+    for (int i = 6; i < (int)positions.size(); i += 2)
+    {
+        EXPECT_NEAR((positions[i] - positions[i + 1]).length<3>().getFloat(), 1.f, 1e-4f);
+
+        // Vertex with zero inverse mass doesn't move.
+        if (i % 4 != 0)
+        {
+            EXPECT_TRUE(positions[i + 1].exactEquals<3>(originalPositions[i + 1]));
+        }
+    }
+}
+
+TEST(PBDSolver, ColorConstraints)
+{
+    // Create random constraints.
+    PseudoRandom random(5);
+    const int numVertices = 50;
+    const int numConstraints = 2000;
+    std::vector<int> vertexA(numConstraints), vertexB(numConstraints);
+    for (int i = 0; i < numConstraints; i++)
+    {
+        vertexA[i] = random.randomInteger(0, numVertices - 1);
+        do
+        {
+            vertexB[i] = random.randomInteger(0, numVertices - 1);
+        } while (vertexB[i] == vertexA[i]);
+    }
+
+    std::vector<int> order, colorStarts;
+    PBD::colorConstraints(vertexA.data(), vertexB.data(), numConstraints, order, colorStarts);
+
+    // More than 64 colors are needed since each vertex has 80 constraints on average.
+    const int numColors = (int)colorStarts.size() - 1;
+    EXPECT_GT(numColors, 64);
+    EXPECT_EQ(colorStarts.front(), 0);
+    EXPECT_EQ(colorStarts.back(), numConstraints);
+
+    // Every constraint appears exactly once.
+    std::vector<int> numAppearances(numConstraints, 0);
+    for (int c : order)
+    {
+        numAppearances[c]++;
+    }
+    for (int n : numAppearances)
+    {
+        EXPECT_EQ(n, 1);
+    }
+
+    // Constraints of the same color don't share any vertex.
+    for (int color = 0; color < numColors; color++)
+    {
+        EXPECT_LT(colorStarts[color], colorStarts[color + 1]);
+
+        std::vector<bool> used(numVertices, false);
+        for (int i = colorStarts[color]; i < colorStarts[color + 1]; i++)
+        {
+            const int c = order[i];
+            EXPECT_FALSE(used[vertexA[c]]);
+            EXPECT_FALSE(used[vertexB[c]]);
+            used[vertexA[c]] = true;
+            used[vertexB[c]] = true;
+        }
+    }
+
+    // Reused buffers give the same colors. Color a smaller set first so that the buffers hold stale data.
+    PBD::ColoringBuffers buffers;
+    std::vector<int> reusedOrder, reusedColorStarts;
+    PBD::colorConstraints(vertexA.data(), vertexB.data(), numConstraints / 2, reusedOrder, reusedColorStarts, buffers);
+    PBD::colorConstraints(vertexA.data(), vertexB.data(), numConstraints, reusedOrder, reusedColorStarts, buffers);
+    EXPECT_EQ(reusedOrder, order);
+    EXPECT_EQ(reusedColorStarts, colorStarts);
+}
+
+TEST(PBDSolver, ParallelProjection)
+{
+    // Create a grid of vertices connected to their neighbors.
+    const int gridSize = 16;
+    PointBasedSystem::Cinfo cinfo;
+    for (int i = 0; i < gridSize * gridSize; i++)
+    {
+        cinfo.m_vertexPositions.push_back(Vector4((float)(i % gridSize), (float)(i / gridSize), 0.f));
+        if (i % gridSize < gridSize - 1)
+        {
+            cinfo.m_vertexConnectivity.push_back({ i, i + 1 });
+        }
+        if (i / gridSize < gridSize - 1)
+        {
+            cinfo.m_vertexConnectivity.push_back({ i, i + gridSize });
+        }
+    }
+    cinfo.m_radius = 0.1f;
+    cinfo.m_solverIterations = 4;
+
+    // Stretch constraints are sorted by colors regardless of the number of threads,
+    // so results are identical as long as there are no collisions.
+    PointBasedSystem system1, system2;
+    system1.init(cinfo);
+    system2.init(cinfo);
+    static_cast<PBD::Solver*>(system2.getSolver().get())->setNumThreads(4);
+
+    for (int i = 0; i < 10; i++)
+    {
+        system1.step(1.f / 60.f);
+        system2.step(1.f / 60.f);
+    }
+
+    const PointBasedSystem::Positions& positions1 = system1.getVertexPositions();
+    const PointBasedSystem::Positions& positions2 = system2.getVertexPositions();
+    for (int i = 0; i < (int)positions1.size(); i++)
+    {
+        EXPECT_TRUE(positions1[i].exactEquals<3>(positions2[i]));
+    }
+
+    // Colliding vertices are also handled in parallel.
+    cinfo.m_vertexPositions = createRandomPositions(300, 3.f, 6);
+    cinfo.m_vertexConnectivity.clear();
+    cinfo.m_radius = 0.3f;
+    PointBasedSystem system3;
+    system3.init(cinfo);
+    static_cast<PBD::Solver*>(system3.getSolver().get())->setNumThreads(4);
+    for (int i = 0; i < 10; i++)
+    {
+        system3.step(1.f / 60.f);
+    }
+    for (const Vector4& pos : system3.getVertexPositions())
+    {
+        EXPECT_FALSE(isnan(pos(0)) || isnan(pos(1)) || isnan(pos(2)));
+    }
+}
+
+TEST(PBDSolver, IncrementalColors)
+{
+    using namespace PBD;
+
+    // Build colors of random constraints.
+    PseudoRandom random(7);
+    const int numVertices = 30;
+    StretchConstraints constraints;
+    StretchConstraints::VertexPairs pairs;
+    for (int i = 0; i < 200; i++)
+    {
+        const int a = random.randomInteger(0, numVertices - 2);
+        const int b = random.randomInteger(a + 1, numVertices - 1);
+        constraints.add(a, b, 1.f, 1.f, 1.f, 1.f);
+        pairs.push_back({ a, b });
+    }
+    constraints.buildColors();
+    checkColors(constraints, numVertices);
+
+    // Remove and add constraints incrementally. Colors should stay valid.
+    for (int itr = 0; itr < 20; itr++)
+    {
+        StretchConstraints::VertexPairs pairsToRemove;
+        for (int i = 0; i < 5; i++)
+        {
+            const int index = random.randomInteger(0, (int)pairs.size() - 1);
+            pairsToRemove.push_back({ pairs[index].second, pairs[index].first });
+            pairs.erase(pairs.begin() + index);
+        }
+        constraints.remove(pairsToRemove);
+
+        for (int i = 0; i < 5; i++)
+        {
+            const int a = random.randomInteger(0, numVertices - 1);
+            const int b = random.randomInteger(numVertices, numVertices + 9);
+            constraints.add(a, b, 1.f, 1.f, 1.f, 1.f);
+            pairs.push_back({ a, b });
+        }
+
+        EXPECT_EQ(constraints.getNumConstraints(), (int)pairs.size());
+        checkColors(constraints, numVertices + 10);
+    }
+
+    // Remaining constraints are exactly the expected ones.
+    StretchConstraints::VertexPairs remainingPairs;
+    for (int i = 0; i < constraints.getNumConstraints(); i++)
+    {
+        remainingPairs.push_back({ constraints.getVertexA(i), constraints.getVertexB(i) });
+    }
+    std::sort(remainingPairs.begin(), remainingPairs.end());
+    std::sort(pairs.begin(), pairs.end());
+    EXPECT_EQ(remainingPairs, pairs);
+}
+
+TEST(PBDSolver, AddRemoveVerticesAndEdges)
+{
+    // Create a chain of vertices.
+    PointBasedSystem::Cinfo cinfo;
+    for (int i = 0; i < 10; i++)
+    {
+        cinfo.m_vertexPositions.push_back(Vector4((float)i, 0.f, 0.f));
+        if (i > 0)
+        {
+            cinfo.m_vertexConnectivity.push_back({ i - 1, i });
+        }
+    }
+    cinfo.m_radius = 0.1f;
+
+    for (PointBasedSystem::SolverType type : { PointBasedSystem::SolverType::POSITION_BASED_DYNAMICS, PointBasedSystem::SolverType::MASS_SPRING })
+    {
+        cinfo.m_solverType = type;
+        PointBasedSystem system;
+        system.init(cinfo);
+        system.step(1.f / 60.f);
+
+        const PointBasedSystem::SolverPtr solver = system.getSolver();
+
+        // Add vertices connected to the chain and remove the first two edges.
+        PointBasedSystem::Positions newPositions = { Vector4(0.f, 1.f, 0.f), Vector4(1.f, 1.f, 0.f) };
+        PointBasedSystem::Velocities newVelocities = { Vec4_0, Vec4_0 };
+        PointBasedSystem::Cinfo::Connections newEdges = { { 0, 10 }, { 10, 11 }, { 11, 5 } };
+        system.addRemoveVerticesAndEdges(newPositions, newVelocities, newEdges, { 0, 1 });
+
+        // The solver is updated in place.
+        EXPECT_EQ(system.getSolver(), solver);
+        const int numEdges = (int)system.getEdges().size();
+        EXPECT_EQ(numEdges, 10);
+
+        if (type == PointBasedSystem::SolverType::POSITION_BASED_DYNAMICS)
+        {
+            const PBD::StretchConstraints& constraints = static_cast<PBD::Solver*>(solver.get())->getStretchConstraints();
+            EXPECT_EQ(constraints.getNumConstraints(), numEdges);
+            checkColors(constraints, 12);
+
+            // Removed edges don't have constraints any more.
+            for (int i = 0; i < constraints.getNumConstraints(); i++)
+            {
+                const int vMin = std::min(constraints.getVertexA(i), constraints.getVertexB(i));
+                const int vMax = std::max(constraints.getVertexA(i), constraints.getVertexB(i));
+                EXPECT_FALSE(vMin == 0 && vMax == 1);
+                EXPECT_FALSE(vMin == 1 && vMax == 2);
+            }
+        }
+        else
+        {
+            EXPECT_EQ(static_cast<MassSpringSolver*>(solver.get())->getNumConstraints(), numEdges);
+        }
+
+        // The system can be stepped with new vertices.
+        for (int i = 0; i < 10; i++)
+        {
+            system.step(1.f / 60.f);
+        }
+        EXPECT_EQ(system.getVertexPositions().size(), 12);
+        for (const Vector4& pos : system.getVertexPositions())
+        {
+            EXPECT_FALSE(isnan(pos(0)) || isnan(pos(1)) || isnan(pos(2)));
+        }
+    }
+}
+
+TEST(PBDSolver, ColliderCulling)
+{
+    // AABBs of shapes.
+    Aabb aabb;
+    SphereShape(Vector4(1.f, 2.f, 3.f), 0.5f).getAabb(aabb);
+    EXPECT_TRUE(aabb.m_min.equals<3>(Vector4(0.5f, 1.5f, 2.5f)));
+    EXPECT_TRUE(aabb.m_max.equals<3>(Vector4(1.5f, 2.5f, 3.5f)));
+    EXPECT_EQ(aabb.getDistance(Vector4(1.f, 2.f, 5.f)), 1.5f);
+    PlaneShape(Vector4(0.f, 1.f, 0.f, 2.f)).getAabb(aabb);
+    EXPECT_EQ(aabb.m_max(1), -2.f);
+    EXPECT_TRUE(aabb.overlaps(Aabb{ Vector4(100.f, -2.f, 100.f), Vector4(200.f, 0.f, 200.f) }));
+    EXPECT_FALSE(aabb.overlaps(Aabb{ Vector4(100.f, -1.f, 100.f), Vector4(200.f, 0.f, 200.f) }));
+
+    // Simulate the same system with colliders with and without AABBs.
+    PointBasedSystem::Cinfo cinfo;
+    cinfo.m_vertexPositions = createRandomPositions(200, 3.f, 5);
+    for (int i = 0; i < (int)cinfo.m_vertexPositions.size() - 1; i += 2)
+    {
+        cinfo.m_vertexConnectivity.push_back({ i, i + 1 });
+    }
+    cinfo.m_radius = 0.1f;
+    cinfo.m_solverIterations = 2;
+
+    PointBasedSystem systemCulled, systemReference;
+    systemCulled.init(cinfo);
+    systemReference.init(cinfo);
+
+    auto sphereCulled = std::make_shared<CountingSphereShape>(Vector4(0.f, -3.f, 0.f), 1.f, true);
+    auto sphereReference = std::make_shared<CountingSphereShape>(Vector4(0.f, -3.f, 0.f), 1.f, false);
+    auto farSphereCulled = std::make_shared<CountingSphereShape>(Vector4(50.f, 0.f, 0.f), 1.f, true);
+    auto farSphereReference = std::make_shared<CountingSphereShape>(Vector4(50.f, 0.f, 0.f), 1.f, false);
+    auto plane = std::make_shared<PlaneShape>(Vector4(0.f, 1.f, 0.f, 4.f));
+    systemCulled.addCollider(sphereCulled);
+    systemCulled.addCollider(farSphereCulled);
+    systemCulled.addCollider(plane);
+    systemReference.addCollider(sphereReference);
+    systemReference.addCollider(farSphereReference);
+    systemReference.addCollider(plane);
+
+    for (int i = 0; i < 120; i++)
+    {
+        // Moving a collider invalidates cached clearances.
+        if (i == 60)
+        {
+            sphereCulled->setCenter(Vector4(1.f, -4.f, 0.f));
+            sphereReference->setCenter(Vector4(1.f, -4.f, 0.f));
+        }
+
+        systemCulled.step(1.f / 60.f);
+        systemReference.step(1.f / 60.f);
+    }
+
+    // Skipping queries doesn't change results.
+    const PointBasedSystem::Positions& positionsCulled = systemCulled.getVertexPositions();
+    const PointBasedSystem::Positions& positionsReference = systemReference.getVertexPositions();
+    for (int i = 0; i < (int)positionsCulled.size(); i++)
+    {
+        EXPECT_TRUE(positionsCulled[i].exactEquals<3>(positionsReference[i]));
+    }
+
+    // Vertices hit the sphere and the plane, but the far sphere is never queried.
+    EXPECT_GT(sphereCulled->m_numQueries, 0);
+    EXPECT_LT(sphereCulled->m_numQueries, sphereReference->m_numQueries / 2);
+    EXPECT_EQ(farSphereCulled->m_numQueries, 0);
+    EXPECT_GT(farSphereReference->m_numQueries, 0);
+}
+
+TEST(PBDSolver, Xpbd)
+{
+    // Simulate hanging chains with the physical stiffness and different iterations.
+    constexpr int numVertices = 10;
+    constexpr float stiffness = 1000.f;
+    PointBasedSystem system4, system64;
+    system4.init(createHangingChainCinfo(numVertices, 4, stiffness));
+    system64.init(createHangingChainCinfo(numVertices, 64, stiffness));
+    EXPECT_TRUE(static_cast<PBD::Solver*>(system4.getSolver().get())->isXpbd());
+
+    for (int i = 0; i < 600; i++)
+    {
+        system4.step(1.f / 60.f);
+        system64.step(1.f / 60.f);
+    }
+
+    // The pinned vertex doesn't move.
+    EXPECT_TRUE(system4.getVertexPositions()[0].exactEquals<3>(Vec4_0));
+    EXPECT_TRUE(system64.getVertexPositions()[0].exactEquals<3>(Vec4_0));
+
+    // Each edge is stretched by the weight of vertices below it divided by the stiffness.
+    const float weight = 0.1f * 9.8f;
+    float expectedBottom = 0.f;
+    for (int i = 1; i < numVertices; i++)
+    {
+        expectedBottom -= 0.1f + weight * (float)(numVertices - i) / stiffness;
+    }
+    EXPECT_NEAR(system64.getVertexPositions()[numVertices - 1](1), expectedBottom, 0.005f);
+
+    // The result hardly depends on the number of iterations.
+    EXPECT_NEAR(system4.getVertexPositions()[numVertices - 1](1), system64.getVertexPositions()[numVertices - 1](1), 0.02f);
+
+    // Applying an impulse to the pinned vertex doesn't move it.
+    system64.applyImpulse(0, Vector4(1.f, 0.f, 0.f));
+    system64.step(1.f / 60.f);
+    EXPECT_TRUE(system64.getVertexPositions()[0].exactEquals<3>(Vec4_0));
+}
+
+TEST(PBDSolver, BendingAndVolumeConstraints)
+{
+    using namespace PBD;
+
+    // Zigzag polyline with a bend at every vertex but the ends. The first vertex is pinned.
+    constexpr int numVertices = 20;
+    std::vector<Vector4> positions;
+    for (int i = 0; i < numVertices; i++)
+    {
+        positions.push_back(Vector4((float)i, (float)(i % 2), 0.5f * (float)(i % 3)));
+    }
+
+    BendingConstraints bendingConstraints;
+    std::vector<float> restDistances;
+    for (int i = 0; i + 2 < numVertices; i++)
+    {
+        bendingConstraints.add(i, i + 1, i + 2, positions, i == 0 ? 0.f : 1.f, 1.f, 1.f, 1.f);
+        const Vector4 centroid = (positions[i] + positions[i + 1] + positions[i + 2]) * SimdFloat(1.f / 3.f);
+        restDistances.push_back((positions[i + 1] - centroid).length<3>().getFloat());
+    }
+    bendingConstraints.buildColors();
+    checkMultiVertexColors(bendingConstraints, numVertices);
+
+    // Strip of tetrahedra sharing faces.
+    std::vector<Vector4> tetPositions = createRandomPositions(numVertices, 2.f, 5);
+    VolumeConstraints volumeConstraints;
+    std::vector<float> restVolumes;
+    const float invMasses[4] = { 1.f, 1.f, 1.f, 1.f };
+    for (int i = 0; i + 3 < numVertices; i++)
+    {
+        const int vertices[4] = { i, i + 1, i + 2, i + 3 };
+        volumeConstraints.add(vertices, tetPositions, invMasses, 1.f);
+        restVolumes.push_back(VolumeConstraints::calcVolume(tetPositions[i], tetPositions[i + 1], tetPositions[i + 2], tetPositions[i + 3]));
+    }
+    volumeConstraints.buildColors();
+    checkMultiVertexColors(volumeConstraints, numVertices);
+
+    // Perturb vertices and project constraints repeatedly.
+    const std::vector<Vector4> noise = createRandomPositions(numVertices, 0.1f, 6);
+    const Vector4 pinnedPosition = positions[0];
+    for (int i = 0; i < numVertices; i++)
+    {
+        positions[i] += noise[i];
+        tetPositions[i] += noise[i];
+    }
+    positions[0] = pinnedPosition;
+
+    for (int i = 0; i < 200; i++)
+    {
+        bendingConstraints.project(positions, 2);
+        volumeConstraints.project(tetPositions, 2);
+    }
+
+    // Rest shapes are restored.
+    EXPECT_TRUE(positions[0].exactEquals<3>(pinnedPosition));
+    for (int i = 0; i + 2 < numVertices; i++)
+    {
+        const Vector4 centroid = (positions[i] + positions[i + 1] + positions[i + 2]) * SimdFloat(1.f / 3.f);
+        EXPECT_NEAR((positions[i + 1] - centroid).length<3>().getFloat(), restDistances[i], 1e-3f);
+    }
+    for (int i = 0; i + 3 < numVertices; i++)
+    {
+        EXPECT_NEAR(VolumeConstraints::calcVolume(tetPositions[i], tetPositions[i + 1], tetPositions[i + 2], tetPositions[i + 3]), restVolumes[i], 1e-3f);
+    }
+}
+
+TEST(PBDSolver, SmallVolumeConstraint)
+{
+    using namespace PBD;
+
+    // Centimeter sized tetrahedron whose gradients are tiny compared to float epsilon.
+    constexpr float edge = 0.01f;
+    std::vector<Vector4> positions = { Vector4(0.f, 0.f, 0.f), Vector4(edge, 0.f, 0.f), Vector4(0.f, edge, 0.f), Vector4(0.f, 0.f, edge) };
+    const float restVolume = VolumeConstraints::calcVolume(positions[0], positions[1], positions[2], positions[3]);
+
+    VolumeConstraints volumeConstraints;
+    const int vertices[4] = { 0, 1, 2, 3 };
+    const float invMasses[4] = { 1.f, 1.f, 1.f, 1.f };
+    volumeConstraints.add(vertices, positions, invMasses, 1.f);
+    volumeConstraints.buildColors();
+
+    // Flatten it to half the height and project.
+    positions[3] = Vector4(0.f, 0.f, 0.5f * edge);
+    for (int i = 0; i < 20; i++)
+    {
+        volumeConstraints.project(positions, 1);
+    }
+
+    EXPECT_NEAR(VolumeConstraints::calcVolume(positions[0], positions[1], positions[2], positions[3]), restVolume, 1e-2f * restVolume);
+}
+
+TEST(PBDSolver, ShapeMatchDamping)
+{
+    // Three bodies whose constraints don't move vertices. The last one is a straight chain whose inertia tensor is singular.
+    PointBasedSystem::Cinfo cinfo;
+    cinfo.m_radius = 0.01f;
+    cinfo.m_dampingFactor = 1.f;
+    cinfo.m_gravity = Vec4_0;
+
+    PseudoRandom random(5);
+    const Vector4 bodyOffsets[2] = { Vec4_0, Vector4(10.f, 0.f, 0.f) };
+    std::vector<int> components;
+    for (int body = 0; body < 2; body++)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            cinfo.m_vertexPositions.push_back(bodyOffsets[body] + Vector4(random.randomReal(-1.f, 1.f), random.randomReal(-1.f, 1.f), random.randomReal(-1.f, 1.f)));
+            components.push_back(body);
+        }
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        cinfo.m_vertexPositions.push_back(Vector4(0.5f * (float)i, 10.f, 0.f));
+        components.push_back(2);
+    }
+
+    const int numVertices = (int)cinfo.m_vertexPositions.size();
+    for (int i = 1; i < numVertices; i++)
+    {
+        if (components[i] == components[i - 1])
+        {
+            cinfo.m_vertexConnectivity.push_back({ i - 1, i, 0.f });
+        }
+        cinfo.m_vertexInvMasses.push_back(random.randomReal(0.5f, 2.f));
+    }
+    cinfo.m_vertexInvMasses.push_back(1.f);
+
+    std::vector<Vector4> velocities(numVertices);
+    for (Vector4& velocity : velocities)
+    {
+        velocity = Vector4(random.randomReal(-1.f, 1.f), random.randomReal(-1.f, 1.f), random.randomReal(-1.f, 1.f));
+    }
+
+    // Return linear and angular momentum of the vertices of the component. Negative component means all the vertices.
+    auto calcMomentum = [&](const PointBasedSystem::Positions& positions, const PointBasedSystem::Velocities& vels, int component, Vector4& linearOut, Vector4& angularOut)
+    {
+        float mass = 0.f;
+        Vector4 center = Vec4_0;
+        linearOut = Vec4_0;
+        for (int i = 0; i < numVertices; i++)
+        {
+            if (component < 0 || components[i] == component)
+            {
+                const SimdFloat m(1.f / cinfo.m_vertexInvMasses[i]);
+                mass += m.getFloat();
+                center += positions[i] * m;
+                linearOut += vels[i] * m;
+            }
+        }
+        center *= SimdFloat(1.f / mass);
+
+        angularOut = Vec4_0;
+        for (int i = 0; i < numVertices; i++)
+        {
+            if (component < 0 || components[i] == component)
+            {
+                angularOut += Vector4::cross(positions[i] - center, vels[i]) * SimdFloat(1.f / cinfo.m_vertexInvMasses[i]);
+            }
+        }
+    };
+
+    for (bool perComponent : { true, false })
+    {
+        PointBasedSystem system;
+        system.init(cinfo);
+        PBD::Solver& solver = static_cast<PBD::Solver&>(*system.getSolver());
+        solver.setDampingType(PBD::Solver::VelocityDampingType::SHAPE_MATCH);
+        solver.setDampingPerComponent(perComponent);
+        EXPECT_EQ(solver.isDampingPerComponent(), perComponent);
+
+        system.accessVertexVelocities() = velocities;
+        const PointBasedSystem::Positions positions = system.getVertexPositions();
+        system.step(1.f / 60.f);
+        const PointBasedSystem::Velocities& damped = system.getVertexVelocities();
+
+        // Damping preserves linear and angular momentum of each matched group.
+        for (int component = perComponent ? 0 : -1; component < (perComponent ? 3 : 0); component++)
+        {
+            Vector4 linear, angular, dampedLinear, dampedAngular;
+            calcMomentum(positions, velocities, component, linear, angular);
+            calcMomentum(positions, damped, component, dampedLinear, dampedAngular);
+            EXPECT_TRUE(dampedLinear.equals<3>(linear, SimdFloat(1e-3f)));
+            EXPECT_TRUE(dampedAngular.equals<3>(angular, SimdFloat(1e-3f)));
+        }
+
+        // Full damping makes vertices of a matched group move rigidly, which keeps distances between them.
+        for (int i = 0; i < numVertices; i++)
+        {
+            for (int j = i + 1; j < numVertices; j++)
+            {
+                if (perComponent && components[i] != components[j])
+                {
+                    continue;
+                }
+
+                EXPECT_NEAR((damped[i] - damped[j]).dot<3>(positions[i] - positions[j]).getFloat(), 0.f, 1e-3f);
+            }
+        }
+    }
+}
+
+TEST(PBDSolver, ParallelShapeMatchDamping)
+{
+    // Unconnected vertices. Each of them is its own component.
+    PointBasedSystem::Cinfo cinfo;
+    cinfo.m_radius = 0.001f;
+    cinfo.m_dampingFactor = 0.5f;
+    cinfo.m_gravity = Vec4_0;
+    cinfo.m_vertexPositions = createRandomPositions(2048, 5.f, 9);
+
+    const std::vector<Vector4> velocities = createRandomPositions(2048, 1.f, 10);
+
+    PointBasedSystem systems[3];
+    for (int i = 0; i < 3; i++)
+    {
+        systems[i].init(cinfo);
+        PBD::Solver& solver = static_cast<PBD::Solver&>(*systems[i].getSolver());
+        solver.setDampingType(PBD::Solver::VelocityDampingType::SHAPE_MATCH);
+        solver.setNumThreads(i == 0 ? 1 : 4);
+        solver.setDampingPerComponent(i == 2);
+        systems[i].accessVertexVelocities() = velocities;
+        systems[i].step(1.f / 60.f);
+    }
+
+    // Accumulating moments in parallel gives the same damping as serial.
+    for (int i = 0; i < 2048; i++)
+    {
+        EXPECT_TRUE(systems[1].getVertexVelocities()[i].equals<3>(systems[0].getVertexVelocities()[i], SimdFloat(1e-3f)));
+        EXPECT_FALSE(systems[0].getVertexVelocities()[i].equals<3>(velocities[i], SimdFloat(1e-3f)));
+    }
+
+    // A single vertex is rigid by itself, so it's not damped when components are matched separately.
+    for (int i = 0; i < 2048; i++)
+    {
+        EXPECT_TRUE(systems[2].getVertexVelocities()[i].equals<3>(velocities[i], SimdFloat(1e-3f)));
+    }
+}
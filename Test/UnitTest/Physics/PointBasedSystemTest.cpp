@@ -0,0 +1,324 @@
+/*
+* PointBasedSystemTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <Physics/Systems/PointBasedSystem.h>
+#include <Physics/Solvers/PBD/PBDSolver.h>
+#include <Geometry/Shapes/PlaneShape.h>
+#include <Geometry/Shapes/SphereShape.h>
+#include <Geometry/Shapes/BoxShape.h>
+#include <Geometry/Shapes/TriangleMeshShape.h>
+
+namespace
+{
+    // Create a cinfo of a chain of vertices falling onto a plane.
+    PointBasedSystem::Cinfo createChainCinfo()
+    {
+        PointBasedSystem::Cinfo cinfo;
+        cinfo.m_radius = 0.05f;
+        cinfo.m_dampingFactor = 0.1f;
+        for (int i = 0; i < 10; i++)
+        {
+            cinfo.m_vertexPositions.push_back(Vector4(0.1f * (float)i, 0.3f + 0.02f * (float)i, 0.f));
+            if (i > 0)
+            {
+                cinfo.m_vertexConnectivity.push_back({ i - 1, i, 0.5f });
+            }
+        }
+        return cinfo;
+    }
+
+    void expectSamePositions(const PointBasedSystem& system1, const PointBasedSystem& system2)
+    {
+        const PointBasedSystem::Positions& positions1 = system1.getVertexPositions();
+        const PointBasedSystem::Positions& positions2 = system2.getVertexPositions();
+        ASSERT_EQ(positions1.size(), positions2.size());
+        for (int i = 0; i < (int)positions1.size(); i++)
+        {
+            EXPECT_TRUE(positions1[i].exactEquals<3>(positions2[i]));
+        }
+    }
+}
+
+TEST(PointBasedSystem, Substeps)
+{
+    auto plane = std::make_shared<PlaneShape>(Vector4(0.f, 1.f, 0.f, 0.f));
+
+    PointBasedSystem::Cinfo cinfo = createChainCinfo();
+    PointBasedSystem reference;
+    reference.init(cinfo);
+    reference.addCollider(plane);
+
+    cinfo.m_numSubsteps = 4;
+    PointBasedSystem system;
+    system.init(cinfo);
+    system.addCollider(plane);
+    EXPECT_EQ(system.getNumSubsteps(), 4);
+
+    // A step with substeps is the same as steps of the substep length.
+    for (int i = 0; i < 20; i++)
+    {
+        system.step(1.f / 60.f);
+        for (int j = 0; j < 4; j++)
+        {
+            reference.step(1.f / 60.f / 4.f);
+        }
+    }
+
+    expectSamePositions(system, reference);
+}
+
+TEST(PointBasedSystem, FixedTimeStep)
+{
+    const float fixedTimeStep = 1.f / 120.f;
+
+    PointBasedSystem::Cinfo cinfo = createChainCinfo();
+    PointBasedSystem reference;
+    reference.init(cinfo);
+
+    cinfo.m_fixedTimeStep = fixedTimeStep;
+    cinfo.m_maxFixedStepsPerCall = 8;
+    PointBasedSystem system;
+    system.init(cinfo);
+
+    // A frame of two fixed steps.
+    system.step(1.f / 60.f);
+    reference.step(fixedTimeStep);
+    reference.step(fixedTimeStep);
+    expectSamePositions(system, reference);
+    EXPECT_NEAR(system.getTimeAccumulator(), 0.f, 1e-6f);
+
+    // Frames shorter than a fixed step are accumulated.
+    system.step(1.f / 240.f);
+    expectSamePositions(system, reference);
+    EXPECT_NEAR(system.getTimeAccumulator(), 1.f / 240.f, 1e-6f);
+
+    system.step(1.f / 240.f);
+    reference.step(fixedTimeStep);
+    expectSamePositions(system, reference);
+    EXPECT_NEAR(system.getTimeAccumulator(), 0.f, 1e-6f);
+
+    // A long frame is clamped to the maximum number of fixed steps and the rest is dropped.
+    system.step(1.f);
+    for (int i = 0; i < 8; i++)
+    {
+        reference.step(fixedTimeStep);
+    }
+    expectSamePositions(system, reference);
+    EXPECT_LT(system.getTimeAccumulator(), fixedTimeStep);
+
+    // Accumulated time is cleared by reset.
+    system.step(1.f / 240.f);
+    system.reset(cinfo);
+    EXPECT_EQ(system.getTimeAccumulator(), 0.f);
+}
+
+TEST(PointBasedSystem, Sleeping)
+{
+    PointBasedSystem::Cinfo cinfo = createChainCinfo();
+    cinfo.m_sleepVelocityThreshold = 0.2f;
+    cinfo.m_timeToSleep = 0.3f;
+
+    PointBasedSystem system;
+    system.init(cinfo);
+    system.addCollider(std::make_shared<PlaneShape>(Vector4(0.f, 1.f, 0.f, 0.f)));
+    auto sphere = std::make_shared<SphereShape>(Vector4(10.f, 0.f, 0.f), 0.5f);
+    system.addCollider(sphere);
+    const PBD::Solver& solver = static_cast<const PBD::Solver&>(*system.getSolver());
+
+    // The chain falls onto the plane and settles.
+    int numSteps = 0;
+    for (; numSteps < 600 && !system.isSleeping(); numSteps++)
+    {
+        system.step(1.f / 60.f);
+    }
+    ASSERT_TRUE(system.isSleeping());
+    EXPECT_GT(numSteps, 30);
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_TRUE(solver.isVertexSleeping(i));
+        EXPECT_EQ(system.getVertexVelocities()[i].lengthSq<3>().getFloat(), 0.f);
+    }
+
+    // A sleeping system doesn't move.
+    const PointBasedSystem::Positions sleepingPositions = system.getVertexPositions();
+    for (int i = 0; i < 10; i++)
+    {
+        system.step(1.f / 60.f);
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_TRUE(system.getVertexPositions()[i].exactEquals<3>(sleepingPositions[i]));
+    }
+
+    // Colliders moving away don't wake up the system, but moving into it does.
+    sphere->setCenter(Vector4(20.f, 0.f, 0.f));
+    system.step(1.f / 60.f);
+    EXPECT_TRUE(system.isSleeping());
+    sphere->setCenter(Vector4(0.5f, 0.f, 0.f));
+    system.step(1.f / 60.f);
+    EXPECT_FALSE(system.isSleeping());
+    sphere->setCenter(Vector4(20.f, 0.f, 0.f));
+
+    // Wait until the system falls asleep again and wake it up by an impulse.
+    for (int i = 0; i < 600 && !system.isSleeping(); i++)
+    {
+        system.step(1.f / 60.f);
+    }
+    ASSERT_TRUE(system.isSleeping());
+    system.applyImpulse(0, Vector4(0.f, 10.f * system.getVertexMass(), 0.f));
+    EXPECT_FALSE(system.isSleeping());
+    system.step(1.f / 60.f);
+    EXPECT_FALSE(solver.isVertexSleeping(0));
+    EXPECT_GT(system.getVertexPositions()[0](1), sleepingPositions[0](1));
+
+    // Topology change wakes up the system.
+    for (int i = 0; i < 600 && !system.isSleeping(); i++)
+    {
+        system.step(1.f / 60.f);
+    }
+    ASSERT_TRUE(system.isSleeping());
+    system.addRemoveVerticesAndEdges({ Vector4(1.f, 0.5f, 0.f) }, { Vec4_0 }, { { 9, 10, 0.5f } });
+    EXPECT_FALSE(system.isSleeping());
+}
+
+TEST(PointBasedSystem, WakeUpByGroundMovingAway)
+{
+    PointBasedSystem::Cinfo cinfo = createChainCinfo();
+    cinfo.m_sleepVelocityThreshold = 0.2f;
+    cinfo.m_timeToSleep = 0.3f;
+
+    PointBasedSystem system;
+    system.init(cinfo);
+    auto ground = std::make_shared<BoxShape>(Vector4(0.5f, -0.5f, 0.f), Vector4(2.f, 0.5f, 2.f));
+    system.addCollider(ground);
+
+    // The chain falls onto the ground and settles.
+    for (int i = 0; i < 600 && !system.isSleeping(); i++)
+    {
+        system.step(1.f / 60.f);
+    }
+    ASSERT_TRUE(system.isSleeping());
+    const float height = system.getVertexPositions()[0](1);
+
+    // The ground moving away from under the system wakes it up even though the new position doesn't touch it.
+    ground->setCenter(Vector4(0.5f, -10.f, 0.f));
+    system.step(1.f / 60.f);
+    EXPECT_FALSE(system.isSleeping());
+    for (int i = 0; i < 30; i++)
+    {
+        system.step(1.f / 60.f);
+    }
+    EXPECT_LT(system.getVertexPositions()[0](1), height - 0.5f);
+}
+
+TEST(PointBasedSystem, FastFallOntoTriangleMesh)
+{
+    // Flat square mesh facing up.
+    const TriangleMeshShape::Vertices meshVertices = { Vector4(-2.f, 0.f, -2.f), Vector4(-2.f, 0.f, 2.f), Vector4(2.f, 0.f, 2.f), Vector4(2.f, 0.f, -2.f) };
+    const TriangleMeshShape::Triangles meshTriangles = { { 0, 1, 2 }, { 0, 2, 3 } };
+
+    PointBasedSystem::Cinfo cinfo = createChainCinfo();
+    for (Vector4& position : cinfo.m_vertexPositions)
+    {
+        position += Vector4(0.f, 1.f, 0.f);
+    }
+
+    PointBasedSystem system;
+    system.init(cinfo);
+    system.addCollider(std::make_shared<TriangleMeshShape>(meshVertices, meshTriangles));
+
+    // The chain moves much more than the thickness of the mesh in a step.
+    for (Vector4& velocity : system.accessVertexVelocities())
+    {
+        velocity = Vector4(0.f, -30.f, 0.f);
+    }
+
+    // It doesn't pass through the mesh and stays on top of it.
+    for (int i = 0; i < 60; i++)
+    {
+        system.step(1.f / 60.f);
+    }
+    for (const Vector4& position : system.getVertexPositions())
+    {
+        EXPECT_GT(position(1), -0.01f);
+    }
+}
+
+TEST(PointBasedSystem, ColliderTree)
+{
+    // The chain falls onto the plane among many obstacles far away from it.
+    auto plane = std::make_shared<PlaneShape>(Vector4(0.f, 1.f, 0.f, 0.f));
+    PointBasedSystem reference;
+    reference.init(createChainCinfo());
+    reference.addCollider(plane);
+
+    PointBasedSystem system;
+    system.init(createChainCinfo());
+    std::vector<PointBasedSystem::ShapePtr> obstacles;
+    for (int i = 0; i < 200; i++)
+    {
+        obstacles.push_back(std::make_shared<SphereShape>(Vector4(5.f + (float)(i % 20), 0.f, 5.f + (float)(i / 20)), 0.4f));
+        system.addCollider(obstacles.back());
+        if (i == 100)
+        {
+            system.addCollider(plane);
+        }
+    }
+    EXPECT_EQ(system.getColliderTree().getNumLeaves(), 201);
+
+    // Only the plane is found around the chain.
+    std::vector<int> found;
+    Aabb aabb;
+    aabb.set(Vector4(0.f, 0.f, 0.f), Vector4(1.f, 1.f, 1.f));
+    system.getColliderTree().query(aabb, found);
+    ASSERT_EQ(found.size(), 1u);
+    EXPECT_EQ(system.getColliders()[found[0]].getShape(), plane.get());
+
+    for (int i = 0; i < 60; i++)
+    {
+        reference.step(1.f / 60.f);
+        system.step(1.f / 60.f);
+    }
+    expectSamePositions(reference, system);
+
+    // Removing colliders keeps the order of the others and indices in the tree.
+    for (int i = 0; i < 200; i += 2)
+    {
+        system.removeCollider(obstacles[i]);
+    }
+    const PointBasedSystem::Colliders& colliders = system.getColliders();
+    ASSERT_EQ(colliders.size(), 101u);
+    EXPECT_EQ(system.getColliderTree().getNumLeaves(), 101);
+    EXPECT_EQ(colliders[0].getShape(), obstacles[1].get());
+    EXPECT_EQ(colliders[50].getShape(), plane.get());
+    EXPECT_EQ(colliders[100].getShape(), obstacles[199].get());
+
+    found.clear();
+    system.getColliderTree().query(aabb, found);
+    ASSERT_EQ(found.size(), 1u);
+    EXPECT_EQ(colliders[found[0]].getShape(), plane.get());
+
+    // A moved obstacle is found at its new position after a step.
+    auto sphere = std::static_pointer_cast<SphereShape>(obstacles[199]);
+    sphere->setCenter(Vector4(0.5f, 2.f, 0.f));
+    system.step(1.f / 60.f);
+    found.clear();
+    aabb.set(Vector4(0.f, 1.9f, 0.f), Vector4(1.f, 2.f, 1.f));
+    system.getColliderTree().query(aabb, found);
+    EXPECT_EQ(found, std::vector<int>{ 100 });
+
+    // Removing the plane lets the chain fall.
+    system.removeCollider(plane);
+    EXPECT_FALSE(system.isSleeping());
+    const float height = system.getVertexPositions()[0](1);
+    for (int i = 0; i < 30; i++)
+    {
+        system.step(1.f / 60.f);
+    }
+    EXPECT_LT(system.getVertexPositions()[0](1), height - 0.5f);
+}
@@ -0,0 +1,113 @@
+/*
+* WorldTest.cpp
+*
+* Copyright (C) 2021 Kohei Nagasawa All Rights Reserved.
+*/
+
+#include <UnitTest/UnitTestPch.h>
+
+#include <Physics/World/World.h>
+#include <Physics/Systems/System.h>
+
+namespace
+{
+    // System which records how many times it and its prerequisite were stepped.
+    class CountingSystem : public System
+    {
+    public:
+        CountingSystem(const CountingSystem* prerequisite = nullptr, const Shape* shape = nullptr)
+            : m_prerequisite(prerequisite), m_shape(shape) {}
+
+        virtual void step(float /*deltaTime*/) override
+        {
+            m_numSteps++;
+
+            // The prerequisite has to be stepped already in this step.
+            if (m_prerequisite && m_prerequisite->m_numSteps != m_numSteps)
+            {
+                m_orderViolated = true;
+            }
+        }
+
+        virtual void getSharedShapes(std::vector<const Shape*>& shapesOut) const override
+        {
+            if (m_shape)
+            {
+                shapesOut.push_back(m_shape);
+            }
+        }
+
+        const CountingSystem* m_prerequisite;
+        const Shape* m_shape;
+        int m_numSteps = 0;
+        bool m_orderViolated = false;
+    };
+}
+
+TEST(World, StepSystems)
+{
+    // Create pairs of systems where the first system depends on the second one which is added later.
+    const int numPairs = 50;
+    std::vector<std::unique_ptr<CountingSystem>> prerequisites, systems;
+    World world;
+    for (int i = 0; i < numPairs; i++)
+    {
+        prerequisites.push_back(std::make_unique<CountingSystem>());
+        systems.push_back(std::make_unique<CountingSystem>(prerequisites.back().get()));
+        world.addSystem(*systems.back());
+    }
+    for (int i = 0; i < numPairs; i++)
+    {
+        world.addSystem(*prerequisites[i]);
+        world.addDependency(*systems[i], *prerequisites[i]);
+    }
+
+    world.setNumThreads(4);
+    for (int i = 0; i < 10; i++)
+    {
+        world.step(1.f / 60.f);
+    }
+
+    // Each pair is an island.
+    EXPECT_EQ(world.getNumIslands(), numPairs);
+    for (int i = 0; i < numPairs; i++)
+    {
+        EXPECT_EQ(prerequisites[i]->m_numSteps, 10);
+        EXPECT_EQ(systems[i]->m_numSteps, 10);
+        EXPECT_FALSE(systems[i]->m_orderViolated);
+    }
+}
+
+TEST(World, SharedShapes)
+{
+    // Use dummy addresses as shapes since shapes are only compared.
+    int dummies[2];
+    const Shape* shapeA = reinterpret_cast<const Shape*>(&dummies[0]);
+    const Shape* shapeB = reinterpret_cast<const Shape*>(&dummies[1]);
+
+    CountingSystem system1(nullptr, shapeA);
+    CountingSystem system2(nullptr, shapeB);
+    CountingSystem system3(nullptr, shapeA);
+    CountingSystem system4;
+
+    World world;
+    world.addSystem(system1);
+    world.addSystem(system2);
+    world.addSystem(system3);
+    world.addSystem(system4);
+    world.setNumThreads(2);
+
+    // Systems are independent without island detection.
+    world.step(1.f / 60.f);
+    EXPECT_EQ(world.getNumIslands(), 4);
+
+    // Systems sharing shapes are in the same island.
+    world.setDetectSharedShapes(true);
+    world.step(1.f / 60.f);
+    EXPECT_EQ(world.getNumIslands(), 3);
+
+    for (const CountingSystem* system : { &system1, &system2, &system3, &system4 })
+    {
+        EXPECT_EQ(system->m_numSteps, 2);
+    }
+}